@@ -39,6 +39,18 @@
 
 #define NO_PR_BITS_IMPLEMENTED							4
 
+//Debug and trace registers used for the cycle counter
+#define DRV_DEMCR								((__vo uint32_t*)0xE000EDFC)
+#define DRV_DWT_CTRL							((__vo uint32_t*)0xE0001000)
+#define DRV_DWT_CYCCNT							((__vo uint32_t*)0xE0001004)
+
+#define DRV_DEMCR_TRCENA						24
+#define DRV_DWT_CTRL_CYCCNTENA					0
+
+//Clock sources
+#define DRV_HSI_VALUE						16000000U	//internal RC oscillator
+#define DRV_HSE_VALUE						8000000U	//MCO of the ST-LINK on the NUCLEO-F401RE
+
 
 
 //Defining base addresses of Flash and SRAM
@@ -65,6 +77,8 @@
 #define DRV_GPIOE_BASEADDR					(DRV_AHB1PERIPH_BASEADDR + 0x1000)
 #define DRV_GPIOH_BASEADDR					(DRV_AHB1PERIPH_BASEADDR + 0x1C00)
 #define DRV_RCC_BASEADDR					(DRV_AHB1PERIPH_BASEADDR + 0x3800)
+#define DRV_DMA1_BASEADDR					(DRV_AHB1PERIPH_BASEADDR + 0x6000)
+#define DRV_DMA2_BASEADDR					(DRV_AHB1PERIPH_BASEADDR + 0x6400)
 
 
 //Defining the base addresses of peripherals that are connected to the APB1 bus
@@ -74,6 +88,10 @@
 #define DRV_SPI2_BASEADDR					(DRV_APB1PERIPH_BASEADDR + 0x3800)
 #define DRV_SPI3_BASEADDR					(DRV_APB1PERIPH_BASEADDR + 0x3C00)
 #define DRV_USART2_BASEADDR					(DRV_APB1PERIPH_BASEADDR + 0x4400)
+#define DRV_TIM2_BASEADDR					(DRV_APB1PERIPH_BASEADDR + 0x0000)
+#define DRV_TIM3_BASEADDR					(DRV_APB1PERIPH_BASEADDR + 0x0400)
+#define DRV_TIM4_BASEADDR					(DRV_APB1PERIPH_BASEADDR + 0x0800)
+#define DRV_TIM5_BASEADDR					(DRV_APB1PERIPH_BASEADDR + 0x0C00)
 
 
 //Defining the base addresses of peripherals that are connected to the APB2 bus
@@ -83,6 +101,10 @@
 #define DRV_USART6_BASEADDR					(DRV_APB2PERIPH_BASEADDR + 0x1400)
 #define DRV_SYSCFG_BASEADDR					(DRV_APB2PERIPH_BASEADDR + 0x3800)
 #define DRV_EXTI_BASEADDR					(DRV_APB2PERIPH_BASEADDR + 0x3C00)
+#define DRV_TIM1_BASEADDR					(DRV_APB2PERIPH_BASEADDR + 0x0000)
+#define DRV_TIM9_BASEADDR					(DRV_APB2PERIPH_BASEADDR + 0x4000)
+#define DRV_TIM10_BASEADDR					(DRV_APB2PERIPH_BASEADDR + 0x4400)
+#define DRV_TIM11_BASEADDR					(DRV_APB2PERIPH_BASEADDR + 0x4800)
 
 
 
@@ -215,6 +237,52 @@ typedef struct
 
 }USART_RegDef_t;
 
+/************************** DMA register definition structure ***********************************************/
+typedef struct
+{
+	__vo uint32_t CR;				//stream x configuration register							Address offset: 0x10 + 0x18 * x
+	__vo uint32_t NDTR;				//stream x number of data register							Address offset: 0x14 + 0x18 * x
+	__vo uint32_t PAR;				//stream x peripheral address register						Address offset: 0x18 + 0x18 * x
+	__vo uint32_t M0AR;				//stream x memory 0 address register						Address offset: 0x1C + 0x18 * x
+	__vo uint32_t M1AR;				//stream x memory 1 address register						Address offset: 0x20 + 0x18 * x
+	__vo uint32_t FCR;				//stream x FIFO control register							Address offset: 0x24 + 0x18 * x
+
+}DMA_Stream_RegDef_t;
+
+typedef struct
+{
+	__vo uint32_t LISR;				//low interrupt status register (streams 0..3)				Address offset: 0x00
+	__vo uint32_t HISR;				//high interrupt status register (streams 4..7)				Address offset: 0x04
+	__vo uint32_t LIFCR;			//low interrupt flag clear register							Address offset: 0x08
+	__vo uint32_t HIFCR;			//high interrupt flag clear register						Address offset: 0x0C
+	DMA_Stream_RegDef_t S[8];		//stream registers											Address offset: 0x10 - 0xCC
+
+}DMA_RegDef_t;
+
+/************************** TIM register definition structure ***********************************************/
+//TIM1 layout, the general purpose timers leave RCR and BDTR reserved and lack channels as documented
+typedef struct
+{
+	__vo uint32_t CR1;				//control register 1										Address offset: 0x00
+	__vo uint32_t CR2;				//control register 2										Address offset: 0x04
+	__vo uint32_t SMCR;				//slave mode control register								Address offset: 0x08
+	__vo uint32_t DIER;				//DMA/interrupt enable register								Address offset: 0x0C
+	__vo uint32_t SR;				//status register											Address offset: 0x10
+	__vo uint32_t EGR;				//event generation register									Address offset: 0x14
+	__vo uint32_t CCMR[2];			//capture/compare mode registers, channels 1-2 and 3-4		Address offset: 0x18 - 0x1C
+	__vo uint32_t CCER;				//capture/compare enable register							Address offset: 0x20
+	__vo uint32_t CNT;				//counter													Address offset: 0x24
+	__vo uint32_t PSC;				//prescaler													Address offset: 0x28
+	__vo uint32_t ARR;				//auto-reload register										Address offset: 0x2C
+	__vo uint32_t RCR;				//repetition counter register, TIM1 only					Address offset: 0x30
+	__vo uint32_t CCR[4];			//capture/compare registers 1 - 4							Address offset: 0x34 - 0x40
+	__vo uint32_t BDTR;				//break and dead-time register, TIM1 only					Address offset: 0x44
+	__vo uint32_t DCR;				//DMA control register										Address offset: 0x48
+	__vo uint32_t DMAR;				//DMA address for full transfer								Address offset: 0x4C
+	__vo uint32_t OR;				//option register, TIM2/TIM5/TIM11							Address offset: 0x50
+
+}TIM_RegDef_t;
+
 
 
 
@@ -249,6 +317,20 @@ typedef struct
 #define DRV_USART2							((USART_RegDef_t*) DRV_USART2_BASEADDR)
 #define DRV_USART6							((USART_RegDef_t*) DRV_USART6_BASEADDR)
 
+//Defining DMA
+#define DRV_DMA1							((DMA_RegDef_t*) DRV_DMA1_BASEADDR)
+#define DRV_DMA2							((DMA_RegDef_t*) DRV_DMA2_BASEADDR)
+
+//Defining TIM
+#define DRV_TIM1							((TIM_RegDef_t*) DRV_TIM1_BASEADDR)
+#define DRV_TIM2							((TIM_RegDef_t*) DRV_TIM2_BASEADDR)
+#define DRV_TIM3							((TIM_RegDef_t*) DRV_TIM3_BASEADDR)
+#define DRV_TIM4							((TIM_RegDef_t*) DRV_TIM4_BASEADDR)
+#define DRV_TIM5							((TIM_RegDef_t*) DRV_TIM5_BASEADDR)
+#define DRV_TIM9							((TIM_RegDef_t*) DRV_TIM9_BASEADDR)
+#define DRV_TIM10							((TIM_RegDef_t*) DRV_TIM10_BASEADDR)
+#define DRV_TIM11							((TIM_RegDef_t*) DRV_TIM11_BASEADDR)
+
 /***************************** Defining peripheral clock enable macros *********************************/
 
 //Clock enable macros for GPIOx peripherals
@@ -278,6 +360,20 @@ typedef struct
 //Defining SYSCFG clock enable macros
 #define DRV_SYSCFG_PCLK_EN()	(DRV_RCC->APB2ENR |= (1 << 14));
 
+//Defining DMA clock enable macros
+#define DRV_DMA1_PCLK_EN()		(DRV_RCC->AHB1ENR |= (1 << 21));
+#define DRV_DMA2_PCLK_EN()		(DRV_RCC->AHB1ENR |= (1 << 22));
+
+//Defining TIM clock enable macros
+#define DRV_TIM2_PCLK_EN()		(DRV_RCC->APB1ENR |= (1 << 0));
+#define DRV_TIM3_PCLK_EN()		(DRV_RCC->APB1ENR |= (1 << 1));
+#define DRV_TIM4_PCLK_EN()		(DRV_RCC->APB1ENR |= (1 << 2));
+#define DRV_TIM5_PCLK_EN()		(DRV_RCC->APB1ENR |= (1 << 3));
+#define DRV_TIM1_PCLK_EN()		(DRV_RCC->APB2ENR |= (1 << 0));
+#define DRV_TIM9_PCLK_EN()		(DRV_RCC->APB2ENR |= (1 << 16));
+#define DRV_TIM10_PCLK_EN()		(DRV_RCC->APB2ENR |= (1 << 17));
+#define DRV_TIM11_PCLK_EN()		(DRV_RCC->APB2ENR |= (1 << 18));
+
 
 /***************************** Defining peripheral clock disable macros *********************************/
 
@@ -308,6 +404,20 @@ typedef struct
 //Defining SYSCFG clock disable macros
 #define DRV_SYSCFG_PCLK_DI()	(DRV_RCC->APB2ENR &= ~(1 << 14));
 
+//Defining DMA clock disable macros
+#define DRV_DMA1_PCLK_DI()		(DRV_RCC->AHB1ENR &= ~(1 << 21));
+#define DRV_DMA2_PCLK_DI()		(DRV_RCC->AHB1ENR &= ~(1 << 22));
+
+//Defining TIM clock disable macros
+#define DRV_TIM2_PCLK_DI()		(DRV_RCC->APB1ENR &= ~(1 << 0));
+#define DRV_TIM3_PCLK_DI()		(DRV_RCC->APB1ENR &= ~(1 << 1));
+#define DRV_TIM4_PCLK_DI()		(DRV_RCC->APB1ENR &= ~(1 << 2));
+#define DRV_TIM5_PCLK_DI()		(DRV_RCC->APB1ENR &= ~(1 << 3));
+#define DRV_TIM1_PCLK_DI()		(DRV_RCC->APB2ENR &= ~(1 << 0));
+#define DRV_TIM9_PCLK_DI()		(DRV_RCC->APB2ENR &= ~(1 << 16));
+#define DRV_TIM10_PCLK_DI()		(DRV_RCC->APB2ENR &= ~(1 << 17));
+#define DRV_TIM11_PCLK_DI()		(DRV_RCC->APB2ENR &= ~(1 << 18));
+
 
 //Macros to reset the GPIO peripherals
 #define DRV_GPIOA_REG_RST()		do{(DRV_RCC->AHB1RSTR |= (1 << 0)); (DRV_RCC->AHB1RSTR &= ~(1 << 0));}while(0)
@@ -317,6 +427,10 @@ typedef struct
 #define DRV_GPIOE_REG_RST()		do{(DRV_RCC->AHB1RSTR |= (1 << 4)); (DRV_RCC->AHB1RSTR &= ~(1 << 4));}while(0)
 #define DRV_GPIOH_REG_RST()		do{(DRV_RCC->AHB1RSTR |= (1 << 7)); (DRV_RCC->AHB1RSTR &= ~(1 << 7));}while(0)
 
+//Macros to reset the DMA controllers
+#define DRV_DMA1_REG_RST()		do{(DRV_RCC->AHB1RSTR |= (1 << 21)); (DRV_RCC->AHB1RSTR &= ~(1 << 21));}while(0)
+#define DRV_DMA2_REG_RST()		do{(DRV_RCC->AHB1RSTR |= (1 << 22)); (DRV_RCC->AHB1RSTR &= ~(1 << 22));}while(0)
+
 
 #define GPIO_BASEADDR_TO_CODE(x)	   ((x == DRV_GPIOA)?0:\
 										(x == DRV_GPIOB)?1:\
@@ -353,6 +467,32 @@ typedef struct
 #define IRQ_NO_USART2           38
 #define IRQ_NO_USART6           71
 
+#define IRQ_NO_DMA1_STREAM0		11
+#define IRQ_NO_DMA1_STREAM1		12
+#define IRQ_NO_DMA1_STREAM2		13
+#define IRQ_NO_DMA1_STREAM3		14
+#define IRQ_NO_DMA1_STREAM4		15
+#define IRQ_NO_DMA1_STREAM5		16
+#define IRQ_NO_DMA1_STREAM6		17
+#define IRQ_NO_DMA1_STREAM7		47
+#define IRQ_NO_DMA2_STREAM0		56
+#define IRQ_NO_DMA2_STREAM1		57
+#define IRQ_NO_DMA2_STREAM2		58
+#define IRQ_NO_DMA2_STREAM3		59
+#define IRQ_NO_DMA2_STREAM4		60
+#define IRQ_NO_DMA2_STREAM5		68
+#define IRQ_NO_DMA2_STREAM6		69
+#define IRQ_NO_DMA2_STREAM7		70
+
+#define IRQ_NO_TIM1_BRK_TIM9	24
+#define IRQ_NO_TIM1_UP_TIM10	25
+#define IRQ_NO_TIM1_TRG_COM_TIM11	26
+#define IRQ_NO_TIM1_CC			27
+#define IRQ_NO_TIM2				28
+#define IRQ_NO_TIM3				29
+#define IRQ_NO_TIM4				30
+#define IRQ_NO_TIM5				50
+
 //IRQ priority def
 #define NVIC_IRQ_PRI0			0
 #define NVIC_IRQ_PRI1			1
@@ -381,6 +521,17 @@ typedef struct
 #define FLAG_SET				SET
 #define FLAG_RESET				RESET
 
+/*
+ * Critical section for state shared between thread mode and ISRs. The previous PRIMASK is
+ * saved so sections nest and can be used from ISRs as well. Host builds (tests/host) define
+ * their own.
+ */
+#ifndef DRV_ENTER_CRITICAL
+#define DRV_ENTER_CRITICAL(primask)		do{ __asm volatile ("MRS %0, primask" : "=r" (primask)); \
+											__asm volatile ("cpsid i" ::: "memory"); }while(0)
+#define DRV_EXIT_CRITICAL(primask)		__asm volatile ("MSR primask, %0" :: "r" (primask) : "memory")
+#endif
+
 /******************************************************************************
  * 					Bit position definitions of SPI peripheral
  ******************************************************************************/
@@ -421,6 +572,52 @@ typedef struct
 #define SPI_SR_BSY				7
 #define SPI_SR_FRE				8
 
+//Defining macros for I2SCFGR
+#define SPI_I2SCFGR_CHLEN		0
+#define SPI_I2SCFGR_DATLEN		1
+#define SPI_I2SCFGR_CKPOL		3
+#define SPI_I2SCFGR_I2SSTD		4
+#define SPI_I2SCFGR_PCMSYNC		7
+#define SPI_I2SCFGR_I2SCFG		8
+#define SPI_I2SCFGR_I2SE		10
+#define SPI_I2SCFGR_I2SMOD		11
+
+//Defining macros for I2SPR
+#define SPI_I2SPR_I2SDIV		0
+#define SPI_I2SPR_ODD			8
+#define SPI_I2SPR_MCKOE			9
+
+/******************************************************************************
+ * 					Bit position definitions of RCC peripheral
+ ******************************************************************************/
+
+//Defining macros for CR
+#define RCC_CR_HSION			0
+#define RCC_CR_HSEON			16
+#define RCC_CR_PLLON			24
+#define RCC_CR_PLLRDY			25
+#define RCC_CR_PLLI2SON			26
+#define RCC_CR_PLLI2SRDY		27
+
+//Defining macros for PLLCFGR
+#define RCC_PLLCFGR_PLLM		0
+#define RCC_PLLCFGR_PLLN		6
+#define RCC_PLLCFGR_PLLP		16
+#define RCC_PLLCFGR_PLLSRC		22
+#define RCC_PLLCFGR_PLLQ		24
+
+//Defining macros for CFGR
+#define RCC_CFGR_SW				0
+#define RCC_CFGR_SWS			2
+#define RCC_CFGR_HPRE			4
+#define RCC_CFGR_PPRE1			10
+#define RCC_CFGR_PPRE2			13
+#define RCC_CFGR_I2SSRC			23
+
+//Defining macros for PLLI2SCFGR
+#define RCC_PLLI2SCFGR_PLLI2SN	6
+#define RCC_PLLI2SCFGR_PLLI2SR	28
+
 
 /******************************************************************************
  * 					Bit position definitions of I2C peripheral
@@ -548,9 +745,88 @@ typedef struct
 #define USART_GTPR_PSC 			0
 #define USART_GTPR_GT 			8
 
+/******************************************************************************
+ * 					Bit position definitions of DMA peripheral
+ ******************************************************************************/
+
+//defining macros for SxCR
+#define DMA_SxCR_EN				0
+#define DMA_SxCR_DMEIE			1
+#define DMA_SxCR_TEIE			2
+#define DMA_SxCR_HTIE			3
+#define DMA_SxCR_TCIE			4
+#define DMA_SxCR_PFCTRL			5
+#define DMA_SxCR_DIR			6
+#define DMA_SxCR_CIRC			8
+#define DMA_SxCR_PINC			9
+#define DMA_SxCR_MINC			10
+#define DMA_SxCR_PSIZE			11
+#define DMA_SxCR_MSIZE			13
+#define DMA_SxCR_PINCOS			15
+#define DMA_SxCR_PL				16
+#define DMA_SxCR_DBM			18
+#define DMA_SxCR_CT				19
+#define DMA_SxCR_PBURST			21
+#define DMA_SxCR_MBURST			23
+#define DMA_SxCR_CHSEL			25
+
+//defining macros for SxFCR
+#define DMA_SxFCR_FTH			0
+#define DMA_SxFCR_DMDIS			2
+#define DMA_SxFCR_FS			3
+#define DMA_SxFCR_FEIE			7
+
+//defining macros for the per stream flags in LISR/HISR (relative to the stream offset)
+#define DMA_ISR_FEIF			0
+#define DMA_ISR_DMEIF			2
+#define DMA_ISR_TEIF			3
+#define DMA_ISR_HTIF			4
+#define DMA_ISR_TCIF			5
+
+/******************************************************************************
+ * 					Bit position definitions of TIM peripheral
+ ******************************************************************************/
+
+//defining macros for CR1
+#define TIM_CR1_CEN				0
+#define TIM_CR1_UDIS			1
+#define TIM_CR1_URS				2
+#define TIM_CR1_OPM				3
+#define TIM_CR1_DIR				4
+#define TIM_CR1_ARPE			7
+
+//defining macros for DIER
+#define TIM_DIER_UIE			0
+#define TIM_DIER_CC1IE			1	//CCxIE at CC1IE + x - 1
+#define TIM_DIER_UDE			8
+#define TIM_DIER_CC1DE			9	//CCxDE at CC1DE + x - 1
+
+//defining macros for SR
+#define TIM_SR_UIF				0
+#define TIM_SR_CC1IF			1	//CCxIF at CC1IF + x - 1
+#define TIM_SR_CC1OF			9	//CCxOF at CC1OF + x - 1
+
+//defining macros for EGR
+#define TIM_EGR_UG				0
+
+//defining macros for CCMRx, per channel fields at 8 * ((x - 1) % 2)
+#define TIM_CCMR_CCS			0
+#define TIM_CCMR_ICPSC			2
+#define TIM_CCMR_ICF			4
+
+//defining macros for CCER, per channel bits at 4 * (x - 1)
+#define TIM_CCER_CCE			0
+#define TIM_CCER_CCP			1
+#define TIM_CCER_CCNP			3
+
 
+#include "stm32f401xx_rcc_driver.h"
+#include "stm32f401xx_dwt_driver.h"
 #include "stm32f401xx_gpio_driver.h"
+#include "stm32f401xx_dma_driver.h"
+#include "stm32f401xx_tim_driver.h"
 #include "stm32f401xx_spi_driver.h"
+#include "stm32f401xx_i2s_driver.h"
 #include "stm32f401xx_i2c_driver.h"
 #include "stm32f401xx_usart_driver.h"
 
@@ -0,0 +1,107 @@
+/*
+ * stm32f401xx_dma_driver.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#ifndef INC_STM32F401XX_DMA_DRIVER_H_
+#define INC_STM32F401XX_DMA_DRIVER_H_
+
+#include "stm32f401xx.h"
+
+//configuration structure for a DMA stream
+typedef struct
+{
+	uint8_t DMA_Channel;			//possible values from @DMA_Channel
+	uint8_t DMA_Direction;			//possible values from @DMA_Direction
+	uint8_t DMA_DataSize;			//possible values from @DMA_DataSize, used for both peripheral and memory side
+	uint8_t DMA_MemInc;				//ENABLE or DISABLE
+	uint8_t DMA_Mode;				//possible values from @DMA_Mode
+	uint8_t DMA_Priority;			//possible values from @DMA_Priority
+	uint8_t DMA_ITControl;			//bitmask of @DMA_IT
+
+}DMA_Config_t;
+
+//Handle structure for a DMA stream
+typedef struct
+{
+	DMA_RegDef_t *pDMAx;			//DMA1 or DMA2
+	uint8_t DMA_StreamNumber;		//0 .. 7
+	DMA_Config_t DMAConfig;
+
+}DMA_Handle_t;
+
+//@DMA_Channel
+//request channel selection, see the DMA request mapping tables in the RM
+#define DMA_CHANNEL_0				0
+#define DMA_CHANNEL_1				1
+#define DMA_CHANNEL_2				2
+#define DMA_CHANNEL_3				3
+#define DMA_CHANNEL_4				4
+#define DMA_CHANNEL_5				5
+#define DMA_CHANNEL_6				6
+#define DMA_CHANNEL_7				7
+
+//@DMA_Direction
+#define DMA_DIR_PERIPH_TO_MEM		0
+#define DMA_DIR_MEM_TO_PERIPH		1
+#define DMA_DIR_MEM_TO_MEM			2
+
+//@DMA_DataSize
+#define DMA_DATA_SIZE_BYTE			0
+#define DMA_DATA_SIZE_HALFWORD		1
+#define DMA_DATA_SIZE_WORD			2
+
+//@DMA_Mode
+#define DMA_MODE_NORMAL				0
+#define DMA_MODE_CIRCULAR			1
+#define DMA_MODE_DOUBLE_BUFFER		2	//circular with hardware switching between M0AR and M1AR
+
+//@DMA_Priority
+#define DMA_PRIORITY_LOW			0
+#define DMA_PRIORITY_MEDIUM			1
+#define DMA_PRIORITY_HIGH			2
+#define DMA_PRIORITY_VERY_HIGH		3
+
+//@DMA_IT
+#define DMA_IT_TE					(1 << DMA_SxCR_TEIE)
+#define DMA_IT_HT					(1 << DMA_SxCR_HTIE)
+#define DMA_IT_TC					(1 << DMA_SxCR_TCIE)
+
+//DMA stream flags as returned by DMA_GetFlags
+#define DMA_FLAG_FE					(1 << DMA_ISR_FEIF)
+#define DMA_FLAG_DME				(1 << DMA_ISR_DMEIF)
+#define DMA_FLAG_TE					(1 << DMA_ISR_TEIF)
+#define DMA_FLAG_HT					(1 << DMA_ISR_HTIF)
+#define DMA_FLAG_TC					(1 << DMA_ISR_TCIF)
+#define DMA_FLAG_ALL				(DMA_FLAG_FE | DMA_FLAG_DME | DMA_FLAG_TE | DMA_FLAG_HT | DMA_FLAG_TC)
+
+
+/******************************************************************************************
+ *								APIs supported by this driver
+ *		 For more information about the APIs check the function definitions
+ ******************************************************************************************/
+
+//Peripheral clock setup
+void DMA_PeriClockControl(DMA_RegDef_t *pDMAx, uint8_t EnorDi);
+
+//Init and De-init
+void DMA_Init(DMA_Handle_t *pDMAHandle);
+void DMA_DeInit(DMA_RegDef_t *pDMAx);
+
+//Transfer control
+void DMA_StartTransfer(DMA_Handle_t *pDMAHandle, uint32_t PeriphAddr, uint32_t Mem0Addr, uint32_t Mem1Addr, uint16_t Len);
+void DMA_StopTransfer(DMA_Handle_t *pDMAHandle);
+uint16_t DMA_GetDataCounter(DMA_Handle_t *pDMAHandle);
+uint8_t DMA_GetCurrentTarget(DMA_Handle_t *pDMAHandle);
+
+//Flag handling
+uint8_t DMA_GetFlags(DMA_Handle_t *pDMAHandle);
+void DMA_ClearFlags(DMA_Handle_t *pDMAHandle, uint8_t Flags);
+
+//IRQ configuration
+void DMA_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi);
+void DMA_IRQPriorityConfig(uint8_t IRQNumber, uint32_t IRQPriority);
+
+#endif /* INC_STM32F401XX_DMA_DRIVER_H_ */
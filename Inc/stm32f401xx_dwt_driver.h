@@ -0,0 +1,29 @@
+/*
+ * stm32f401xx_dwt_driver.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#ifndef INC_STM32F401XX_DWT_DRIVER_H_
+#define INC_STM32F401XX_DWT_DRIVER_H_
+
+#include "stm32f401xx.h"
+
+/*
+ * The DWT cycle counter runs at HCLK and is used as the time base for the bounded
+ * timeouts of the drivers. At 84 MHz it wraps after about 51 s, longer timeouts
+ * cannot be expressed with it.
+ */
+
+/******************************************************************************************
+ *								APIs supported by this driver
+ *		 For more information about the APIs check the function definitions
+ ******************************************************************************************/
+void DWT_CycleCounterInit(void);
+uint32_t DWT_GetCycles(void);
+uint32_t DWT_UsToCycles(uint32_t Us);
+uint32_t DWT_MsToCycles(uint32_t Ms);
+uint8_t DWT_IsElapsed(uint32_t Start, uint32_t Cycles);
+
+#endif /* INC_STM32F401XX_DWT_DRIVER_H_ */
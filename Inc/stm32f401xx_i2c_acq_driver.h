@@ -0,0 +1,104 @@
+/*
+ * stm32f401xx_i2c_acq_driver.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#ifndef INC_STM32F401XX_I2C_ACQ_DRIVER_H_
+#define INC_STM32F401XX_I2C_ACQ_DRIVER_H_
+
+#include "stm32f401xx.h"
+
+#define ACQ_MAX_SENSORS						8
+#define ACQ_MAX_READ_LEN					16
+#define ACQ_RING_SIZE						64	//samples, power of two
+
+//We define the per sensor timing statistics, times in DWT cycles
+typedef struct{
+	uint32_t Samples;				//reads completed
+	uint32_t Errors;				//reads that failed on the bus
+	uint32_t Missed;				//periods skipped because the previous read was still running
+	uint32_t Late;					//reads completed more than one period after they were due
+	uint32_t LatencyMin;			//due time to data in memory
+	uint32_t LatencyMax;
+	uint64_t LatencySum;			//LatencySum / Samples gives the mean
+	uint32_t JitterMax;				//largest |interval between samples - period|
+
+}ACQ_Stats_t;
+
+//We define one registered sensor
+typedef struct{
+	uint8_t  SlaveAddr;				//7 bit address
+	uint8_t  Reg;					//first register of the burst read
+	uint8_t  Len;					//1 to ACQ_MAX_READ_LEN
+	uint32_t PeriodTicks;			//read period in scheduler ticks
+
+	//engine state
+	uint32_t NextDue;				//tick of the next read
+	uint32_t DueTick;				//tick that started the read in flight
+	uint32_t DueCycles;				//DWT time of the tick that started the read in flight
+	uint32_t LastCycles;			//DWT time of the previous sample
+	uint8_t  LastValid;				//LastCycles is the sample of the previous period, the jitter baseline
+	__vo uint8_t InFlight;
+	I2C_Txn_t Txn;
+	uint8_t  Buf[ACQ_MAX_READ_LEN];
+	ACQ_Stats_t Stats;
+
+}ACQ_Sensor_t;
+
+//We define one sample of the ring
+typedef struct{
+	uint32_t Timestamp;				//DWT cycle count when the read completed
+	uint32_t Tick;					//scheduler tick the read was due at
+	uint8_t  SensorId;
+	uint8_t  Status;				//ACQ_OK or ACQ_ERR_I2C
+	uint8_t  Len;
+	uint8_t  Data[ACQ_MAX_READ_LEN];
+
+}ACQ_Sample_t;
+
+//We define the handle structure of the acquisition engine
+typedef struct{
+	I2C_Handle_t *pI2CHandle;		//I2C master with a transaction queue (I2C_TxnQueueInit)
+	TIM_Handle_t *pTIMHandle;		//timer used as the scheduler tick, pTIMx set by the app
+	uint32_t TickHz;				//scheduler rate, every sensor period is a multiple of it
+	uint8_t  Prio;					//transaction queue priority of the reads
+
+	ACQ_Sensor_t Sensors[ACQ_MAX_SENSORS];
+	uint8_t  SensorCount;
+	__vo uint32_t Tick;
+	uint32_t PeriodCycles;			//DWT cycles per tick
+
+	//single producer (I2C ISR), single consumer (ACQ_ReadSample) ring
+	ACQ_Sample_t Ring[ACQ_RING_SIZE];
+	__vo uint32_t RingHead;			//written by the producer only
+	__vo uint32_t RingTail;			//written by the consumer only
+	uint32_t RingDrops;				//samples lost to a full ring
+
+}ACQ_Handle_t;
+
+//ACQ return codes
+#define ACQ_OK								0
+#define ACQ_ERR_PARAM						1
+#define ACQ_ERR_FULL						2	//no free sensor slot
+#define ACQ_ERR_I2C							3
+#define ACQ_ERR_TIMER						4
+
+
+/*
+ * 				We define the APIs supported by this driver
+ * */
+uint8_t ACQ_Init(ACQ_Handle_t *pACQHandle);
+uint8_t ACQ_AddSensor(ACQ_Handle_t *pACQHandle, uint8_t SlaveAddr, uint8_t Reg, uint8_t Len, uint32_t PeriodUs, uint8_t *pId);
+void ACQ_Start(ACQ_Handle_t *pACQHandle);
+void ACQ_Stop(ACQ_Handle_t *pACQHandle);
+
+uint8_t ACQ_ReadSample(ACQ_Handle_t *pACQHandle, ACQ_Sample_t *pSample);
+void ACQ_GetStats(ACQ_Handle_t *pACQHandle, uint8_t Id, ACQ_Stats_t *pStats);
+void ACQ_ResetStats(ACQ_Handle_t *pACQHandle, uint8_t Id);
+
+//to be called from the IRQ handler of the scheduler timer
+void ACQ_TimerIRQHandling(ACQ_Handle_t *pACQHandle);
+
+#endif /* INC_STM32F401XX_I2C_ACQ_DRIVER_H_ */
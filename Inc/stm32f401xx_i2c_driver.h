@@ -17,10 +17,75 @@ typedef struct{
 	uint8_t I2C_DeviceAddress; //mentioned by the user
 	uint8_t I2C_ACKControl;
 	uint16_t I2C_FMDutyCycle;
+	uint8_t I2C_Mode; //possible values from @I2C_Mode
+	uint8_t I2C_PEC; //ENABLE: hardware PEC on every transaction, SMBus modes only
 
 }I2C_Config_t;
 
 
+//number of priority levels of the transaction queue, 0 is served first
+#define I2C_TXN_PRIO_LEVELS		3
+
+//We define one queued I2C transaction, the entry is owned by the driver until its callback runs
+typedef struct I2C_Txn{
+	uint8_t  SlaveAddr; //7 bit slave address
+	uint8_t  *pTxBuffer; //write phase, sent first
+	uint32_t TxLen; //0 for a pure read
+	uint8_t  *pRxBuffer; //read phase, after a repeated start when TxLen > 0
+	uint32_t RxLen; //0 for a pure write
+	uint8_t  Sr; //I2C_ENABLE_SR leaves the bus without STOP, the next transaction starts with a repeated start
+	uint8_t  Flags; //@I2C_TxnFlags
+	void     (*pCallback)(struct I2C_Txn *pTxn, uint8_t AppEv); //called from the ISR with I2C_EV_TX_CMPLT/I2C_EV_RX_CMPLT or an error
+	void     *pContext; //free for the app
+	__vo uint8_t Status; //@I2C_TxnStatus
+	struct I2C_Txn *pNext;
+
+}I2C_Txn_t;
+
+//We define the transaction queue attached to a handle
+typedef struct{
+	I2C_Txn_t *pHead[I2C_TXN_PRIO_LEVELS];
+	I2C_Txn_t *pTail[I2C_TXN_PRIO_LEVELS];
+	I2C_Txn_t *pActive; //transaction on the bus, NULL when idle
+	uint32_t  Completed; //transactions finished, successfully or not
+	uint32_t  Deferred; //starts put off because the previous STOP was still pending
+
+}I2C_TxnQueue_t;
+
+
+//We define the per bus error counters
+typedef struct{
+	uint32_t BusErr; //BERR, misplaced START/STOP
+	uint32_t ArbLost; //ARLO
+	uint32_t AckFail; //AF, slave did not acknowledge
+	uint32_t Overrun; //OVR
+	uint32_t Timeout; //SCL held low or a blocking wait ran out of time
+	uint32_t Recoveries; //I2C_BusRecover runs
+	uint32_t RecoveryFail; //recoveries that could not free the bus
+
+}I2C_ErrCount_t;
+
+
+//We define the register file served in slave mode. The host writes a register address byte
+//followed by data, or reads from the current address, the address auto increments and wraps.
+typedef struct{
+	uint8_t  *pRegs; //register memory, RegCount bytes
+	uint16_t RegCount; //1 to 256
+	const uint32_t *pWritable; //bitmap, bit n set: register n can be written by the host, NULL: all read only
+	uint32_t *pWriteMask; //bitmap of registers written by the host, (RegCount + 31) / 32 words, may be NULL
+	uint8_t  NoStretch; //ENABLE: SCL is never stretched, the ISR must keep up with the bus
+	__vo uint16_t Ptr; //register address pointer
+
+	//driver state
+	uint8_t  AddrPhase; //next received byte is the register address
+	uint8_t  Written; //registers were written since the last STOP
+	uint16_t DmaStart; //Ptr when the TX stream was armed
+	uint16_t DmaLen; //length the TX stream was armed with, 0 when not in use
+	uint32_t RejectCount; //writes to read only registers, dropped
+
+}I2C_RegFile_t;
+
+
 //We define the handle structure for I2C
 typedef struct{
 	I2C_RegDef_t  *pI2Cx;
@@ -34,6 +99,26 @@ typedef struct{
 	uint8_t 	  DevAddr; //store slave/device address
 	uint32_t 	  RxSize; // to store Rx size
 	uint8_t 	  Sr; //To store repeated start value
+	uint8_t 	  MemAddr[2]; //register address sent ahead of the data, MSB first
+	uint8_t 	  MemAddrLen; //number of register address bytes, 0 for plain transfers
+	uint8_t 	  MemAddrIdx; //register address bytes already sent
+	uint8_t 	  XferOpt; //@I2C_XferOpt of the transfer in flight
+	DMA_Handle_t  *pTxDMA; //TX stream wired to this I2C, set by the app, NULL without DMA
+	DMA_Handle_t  *pRxDMA; //RX stream wired to this I2C, set by the app, NULL without DMA
+	I2C_TxnQueue_t *pQueue; //transaction queue, NULL when not used
+	I2C_RegFile_t *pRegFile; //slave register file, NULL keeps the I2C_EV_DATA_REQ/I2C_EV_DATA_RCV callbacks
+	GPIO_RegDef_t *pSCLPort; //SCL/SDA pins for the 9 clock recovery, NULL skips it
+	GPIO_RegDef_t *pSDAPort;
+	uint8_t 	  SCLPin;
+	uint8_t 	  SDAPin;
+	uint32_t 	  TimeoutUs; //bound of every blocking wait, I2C_DEFAULT_TIMEOUT_US if 0
+	uint32_t 	  RecoveryBudgetUs; //time budget of I2C_BusRecover, I2C_DEFAULT_RECOVERY_US if 0
+	I2C_ErrCount_t ErrCount;
+	uint32_t 	  PecErrCount; //SMBus reads whose PEC did not match
+	__vo uint8_t  SMBAlertAck; //SMBus device: alert response address received, our address goes out next
+	__vo uint8_t  RecoveryPending; //set by the error interrupt, see I2C_RecoverPending
+	uint32_t 	  AchievedSCL; //SCL frequency produced by CCR, filled by I2C_Init
+	int32_t 	  RiseMarginNs; //slack of tLOW/tHIGH over the I2C spec minimums, filled by I2C_Init
 
 }I2C_Handle_t;
 
@@ -46,8 +131,52 @@ typedef struct{
 #define I2C_ACK_DISABLE			0
 
 //@I2C_FMDutyCycle
-#define I2C_FM_DUTY_9			0
-#define I2C_FM_DUTY_16_9		1
+#define I2C_FM_DUTY_2			0	//tLOW/tHIGH = 2
+#define I2C_FM_DUTY_16_9		1	//tLOW/tHIGH = 16/9
+#define I2C_FM_DUTY_AUTO		2	//the timing solver picks the duty closest to I2C_SCLSpeed
+#define I2C_FM_DUTY_9			I2C_FM_DUTY_2	//old name of I2C_FM_DUTY_2
+
+//@I2C_Mode
+#define I2C_MODE_I2C			0
+#define I2C_MODE_SMBUS_DEVICE	1
+#define I2C_MODE_SMBUS_HOST		2
+
+//@I2C_MemAddrSize
+#define I2C_MEMADD_SIZE_8BIT	1
+#define I2C_MEMADD_SIZE_16BIT	2
+
+//@I2C_XferOpt
+#define I2C_XFER_MEM_READ		(1 << 0)	//repeated start into the read phase once the register address is out
+#define I2C_XFER_DMA			(1 << 1)	//payload moved by pTxDMA/pRxDMA instead of TXE/RXNE interrupts
+
+//@I2C_TxnFlags
+#define I2C_TXN_DMA				(1 << 0)	//move the data with pTxDMA/pRxDMA
+#define I2C_TXN_PROBE			(1 << 1)	//address only, TxLen = RxLen = 0, a NACK is an answer and not counted as error
+
+//@I2C_TxnStatus
+#define I2C_TXN_IDLE			0
+#define I2C_TXN_PENDING			1	//queued or on the bus
+#define I2C_TXN_DONE			2
+#define I2C_TXN_ERROR			3
+
+//I2C return codes
+#define I2C_OK					0
+#define I2C_ERR_TIMING			1	//SCL speed not reachable with the current PCLK1
+#define I2C_ERR_PARAM			2
+#define I2C_ERR_TIMEOUT			3	//a flag did not come within TimeoutUs
+#define I2C_ERR_NACK			4	//address or data not acknowledged
+#define I2C_ERR_BUS				5	//bus error, arbitration lost or bus still stuck after recovery
+#define I2C_ERR_PEC				6	//SMBus PEC mismatch
+#define I2C_ERR_PROTO			7	//SMBus block count out of range
+
+//Timeouts
+#define I2C_DEFAULT_TIMEOUT_US		25000	//SMBus low timeout, longer than any legitimate clock stretch
+#define I2C_DEFAULT_RECOVERY_US		2000
+#define I2C_SMBUS_TIMEOUT_US		35000	//tTIMEOUT max, the 25 ms minimum is detected by the hardware (SR1.TIMEOUT)
+
+//SMBus
+#define I2C_SMBUS_BLOCK_MAX			32
+#define I2C_SMBUS_ARA				0x0C	//alert response address
 
 //I2C application status
 #define I2C_READY				0
@@ -67,6 +196,7 @@ typedef struct{
 #define I2C_OVR_FLAG						(1 << I2C_SR1_OVR)
 #define I2C_PECERR_FLAG						(1 << I2C_SR1_PECERR)
 #define I2C_TIMEOUT_FLAG					(1 << I2C_SR1_TIMEOUT)
+#define I2C_SMBALERT_FLAG					(1 << I2C_SR1_SMBALERT)
 
 #define I2C_DISABLE_SR 						RESET
 #define I2C_ENABLE_SR 						SET
@@ -82,6 +212,9 @@ typedef struct{
 #define I2C_ERROR_TIMEOUT 					7
 #define I2C_EV_DATA_REQ						8
 #define I2C_EV_DATA_RCV						9
+#define I2C_ERROR_DMA						10
+#define I2C_EV_REG_WRITE					11	//the host wrote registers of the register file, see I2C_SlaveFetchWrites
+#define I2C_EV_SMBALERT						12	//host: a device pulled SMBA low. Device: our alert was answered
 
 
 
@@ -93,11 +226,15 @@ typedef struct{
 void I2C_PeriClockControl(I2C_RegDef_t *pI2Cx, uint8_t EnorDi);
 
 //Init and De-Init of I2C
-void I2C_Init(I2C_Handle_t *pI2CHandle);
+uint8_t I2C_Init(I2C_Handle_t *pI2CHandle);
 void I2C_DeInit(I2C_RegDef_t *pI2Cx);
 uint8_t I2CGetFlagStatus(I2C_RegDef_t *pI2Cx, uint32_t FlagSet);
 void I2C_GenerateStopCondition(I2C_RegDef_t *pI2Cx);
 
+//Timing
+uint8_t I2C_ComputeTiming(uint32_t PCLK1, uint32_t SCLSpeed, uint8_t DutyCycle, uint32_t *pCCR,
+		uint32_t *pTRISE, uint32_t *pAchievedSCL, int32_t *pRiseMarginNs);
+
 
 
 //IRQ configuration and ISR handling
@@ -112,21 +249,58 @@ void I2C_ManageAcking(I2C_RegDef_t *pI2Cx, uint8_t EnOrDi);
 
 void I2C_ApplicationEventCallback(I2C_Handle_t *pI2CHandle, uint8_t AppEv);
 
-void I2C_MasterSendData(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint8_t Len, uint8_t SlaveAddr, uint8_t Sr);
-void I2C_MasterRecieveData(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint8_t Len, uint8_t SlaveAddr, uint8_t Sr);
+uint8_t I2C_MasterSendData(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t Len, uint8_t SlaveAddr, uint8_t Sr);
+uint8_t I2C_MasterRecieveData(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint32_t Len, uint8_t SlaveAddr, uint8_t Sr);
+uint8_t I2C_MasterProbe(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr);
 
 void I2C_SlaveSendData(I2C_RegDef_t *pI2Cx, uint8_t data);
 uint8_t I2C_SlaveRecieveData(I2C_RegDef_t *pI2Cx);
 
+//Slave register file
+void I2C_SlaveRegFileStart(I2C_Handle_t *pI2CHandle, I2C_RegFile_t *pRegFile);
+void I2C_SlaveRegFileStop(I2C_Handle_t *pI2CHandle);
+uint32_t I2C_SlaveFetchWrites(I2C_Handle_t *pI2CHandle, uint16_t Word);
+
 
 void I2C_CloseSendData(I2C_Handle_t *pI2CHandle);
 void I2C_CloseRecieveData(I2C_Handle_t *pI2CHandle);
 
-uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint8_t Len, uint8_t SlaveAddr, uint8_t Sr);
-uint8_t I2C_MasterRecieveDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint8_t Len, uint8_t SlaveAddr, uint8_t Sr);
-
-uint32_t RCC_GetPCLK1Value(void);
-uint32_t RCC_GetPCLK2Value(void);
+uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t Len, uint8_t SlaveAddr, uint8_t Sr);
+uint8_t I2C_MasterRecieveDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint32_t Len, uint8_t SlaveAddr, uint8_t Sr);
+uint8_t I2C_MasterSendDataDMA(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t Len, uint8_t SlaveAddr, uint8_t Sr);
+uint8_t I2C_MasterRecieveDataDMA(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint32_t Len, uint8_t SlaveAddr, uint8_t Sr);
+
+//Register (memory) access: register address write, repeated start, data phase
+uint8_t I2C_MemWrite(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pTxBuffer, uint32_t Len);
+uint8_t I2C_MemRead(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t I2C_MemWriteIT(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pTxBuffer, uint32_t Len);
+uint8_t I2C_MemReadIT(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t I2C_MemWriteDMA(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pTxBuffer, uint32_t Len);
+uint8_t I2C_MemReadDMA(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pRxBuffer, uint32_t Len);
+
+//SMBus protocols, Cmd is the SMBus command code
+uint8_t I2C_SMBusWriteByte(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint8_t Cmd, uint8_t Data);
+uint8_t I2C_SMBusWriteWord(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint8_t Cmd, uint16_t Data);
+uint8_t I2C_SMBusBlockWrite(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint8_t Cmd, uint8_t *pTxBuffer, uint8_t Len);
+uint8_t I2C_SMBusReadByte(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint8_t Cmd, uint8_t *pData);
+uint8_t I2C_SMBusReadWord(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint8_t Cmd, uint16_t *pData);
+uint8_t I2C_SMBusBlockRead(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint8_t Cmd, uint8_t *pRxBuffer, uint8_t MaxLen, uint8_t *pLen);
+void I2C_SMBusAlertConfig(I2C_Handle_t *pI2CHandle, uint8_t EnOrDi);
+uint8_t I2C_SMBusAlertResponse(I2C_Handle_t *pI2CHandle, uint8_t *pSlaveAddr);
+
+//Error handling
+void I2C_AbortTransfer(I2C_Handle_t *pI2CHandle);
+uint8_t I2C_BusRecover(I2C_Handle_t *pI2CHandle);
+uint8_t I2C_RecoverPending(I2C_Handle_t *pI2CHandle);
+
+//Transaction queue
+void I2C_TxnQueueInit(I2C_Handle_t *pI2CHandle, I2C_TxnQueue_t *pQueue);
+uint8_t I2C_TxnSubmit(I2C_Handle_t *pI2CHandle, I2C_Txn_t *pTxn, uint8_t Prio);
+void I2C_TxnProcess(I2C_Handle_t *pI2CHandle);
+
+//to be called from the IRQ handlers of the DMA streams in pTxDMA/pRxDMA
+void I2C_TxDMAIRQHandling(I2C_Handle_t *pI2CHandle);
+void I2C_RxDMAIRQHandling(I2C_Handle_t *pI2CHandle);
 
 uint8_t I2CGetFlagStatus(I2C_RegDef_t *pI2C, uint32_t FlagSet);
 
@@ -0,0 +1,87 @@
+/*
+ * stm32f401xx_i2c_eeprom_driver.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#ifndef INC_STM32F401XX_I2C_EEPROM_DRIVER_H_
+#define INC_STM32F401XX_I2C_EEPROM_DRIVER_H_
+
+#include "stm32f401xx.h"
+
+//largest page of the supported 24Cxx parts (24C1025/24M02 class)
+#define EE_MAX_PAGE_SIZE					256
+
+//We define one asynchronous write request, owned by the driver until its callback runs
+typedef struct EE_Write{
+	uint32_t Addr;					//EEPROM byte address
+	uint8_t  *pData;				//must stay valid until the callback
+	uint32_t Len;
+	void     (*pCallback)(struct EE_Write *pReq, uint8_t Status); //called from the I2C ISR with an EE return code
+	void     *pContext;				//free for the app
+	__vo uint8_t Status;			//EE_BUSY while queued or in progress, then the EE return code
+	struct EE_Write *pNext;
+
+}EE_Write_t;
+
+//We define the handle structure for a 24Cxx I2C EEPROM
+typedef struct{
+	I2C_Handle_t *pI2CHandle;		//I2C initialized as master
+	uint8_t  DevAddr;				//7 bit address including the A2..A0 strapping, 0x50 to 0x57
+	uint8_t  AddrSize;				//I2C_MEMADD_SIZE_8BIT (24C01 to 24C16) or I2C_MEMADD_SIZE_16BIT (24C32 and up)
+	uint16_t PageSize;				//8 to EE_MAX_PAGE_SIZE, power of two, from the datasheet
+	uint32_t Capacity;				//in bytes
+	uint8_t  Prio;					//transaction queue priority of the asynchronous writes
+
+	//blocking write state
+	uint8_t  WriteCycle;			//a page was written, ACK polling still pending
+
+	//asynchronous write state
+	EE_Write_t *pHead;				//request in progress
+	EE_Write_t *pTail;
+	uint32_t Done;					//bytes of pHead already programmed
+	uint32_t ChunkLen;				//bytes of the page write on the bus
+	uint8_t  Phase;					//@EE_Phase
+	uint32_t PollStart;				//DWT cycle count at the end of the page write
+	I2C_Txn_t Txn;
+	uint8_t  PageBuf[2 + EE_MAX_PAGE_SIZE];	//address bytes followed by the page data
+
+	//statistics
+	uint32_t PagesWritten;
+	uint32_t PollCount;				//NACKed polls, ~ write cycle time / poll time
+
+}EE_Handle_t;
+
+//@EE_Phase
+#define EE_PHASE_IDLE						0
+#define EE_PHASE_PAGE						1	//page write on the bus
+#define EE_PHASE_POLL						2	//write cycle, ACK polling
+
+//EE return codes
+#define EE_OK								0
+#define EE_ERR_TIMEOUT						1	//the write cycle did not end within EE_TIMEOUT_WRITE_MS
+#define EE_ERR_RANGE						2
+#define EE_ERR_I2C							3	//NACK on data, bus error or I2C timeout
+#define EE_ERR_BUSY							4	//asynchronous writes in progress
+#define EE_BUSY								5	//request status while queued
+
+//tWR is 5 ms max on 24Cxx parts, with margin
+#define EE_TIMEOUT_WRITE_MS					10
+
+
+/*
+ * 				We define the APIs supported by this driver
+ * */
+uint8_t EE_Init(EE_Handle_t *pEEHandle);
+
+//blocking, not to be used while asynchronous writes are queued
+uint8_t EE_Read(EE_Handle_t *pEEHandle, uint32_t Addr, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t EE_Write(EE_Handle_t *pEEHandle, uint32_t Addr, uint8_t *pTxBuffer, uint32_t Len);
+uint8_t EE_WaitReady(EE_Handle_t *pEEHandle);
+
+//asynchronous writes over the I2C transaction queue
+uint8_t EE_WriteAsync(EE_Handle_t *pEEHandle, EE_Write_t *pReq);
+uint8_t EE_IsIdle(EE_Handle_t *pEEHandle);
+
+#endif /* INC_STM32F401XX_I2C_EEPROM_DRIVER_H_ */
@@ -0,0 +1,119 @@
+/*
+ * stm32f401xx_i2s_driver.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#ifndef INC_STM32F401XX_I2S_DRIVER_H_
+#define INC_STM32F401XX_I2S_DRIVER_H_
+
+#include "stm32f401xx.h"
+
+
+//We define the I2S configuration structure
+typedef struct{
+	uint8_t  I2S_Mode;				//possible values from @I2S_Mode
+	uint8_t  I2S_Standard;			//possible values from @I2S_Standard
+	uint8_t  I2S_DataFormat;		//possible values from @I2S_DataFormat
+	uint8_t  I2S_CPOL;				//possible values from @I2S_CPOL
+	uint8_t  I2S_MCLKOutput;		//ENABLE or DISABLE, master modes only
+	uint32_t I2S_AudioFreq;			//possible values from @I2S_AudioFreq, master modes only
+
+}I2S_Config_t;
+
+
+//We define the handle structure for I2S
+typedef struct{
+	SPI_RegDef_t *pSPIx;			//SPI2 or SPI3, the only instances with I2S on this device
+	I2S_Config_t I2SConfig;
+	DMA_Handle_t *pDMA;				//TX stream for the transmit modes, RX stream for the receive modes
+
+	uint16_t *pBuffer;				//circular audio buffer
+	uint32_t BufLen;				//buffer length in 16 bit words, split in two halves
+	uint8_t  State;					//to store the streaming state
+	uint32_t AchievedFreq;			//sample rate produced by the clock tree, master modes only
+	int32_t  FreqErrorPpm;			//(achieved - requested) / requested in ppm
+	uint32_t ErrCount;				//underrun/overrun errors seen while streaming
+
+}I2S_Handle_t;
+
+
+//@I2S_Mode
+#define I2S_MODE_SLAVE_TX					0
+#define I2S_MODE_SLAVE_RX					1
+#define I2S_MODE_MASTER_TX					2
+#define I2S_MODE_MASTER_RX					3
+
+//@I2S_Standard
+#define I2S_STD_PHILIPS						0
+#define I2S_STD_MSB							1
+#define I2S_STD_LSB							2
+#define I2S_STD_PCM_SHORT					3
+#define I2S_STD_PCM_LONG					4
+
+//@I2S_DataFormat
+#define I2S_DATAFORMAT_16B					0	//16 bit data in a 16 bit channel
+#define I2S_DATAFORMAT_16B_EXTENDED			1	//16 bit data in a 32 bit channel
+#define I2S_DATAFORMAT_24B					2	//24 bit data in a 32 bit channel
+#define I2S_DATAFORMAT_32B					3	//32 bit data in a 32 bit channel
+
+//@I2S_CPOL
+#define I2S_CPOL_LOW						0
+#define I2S_CPOL_HIGH						1
+
+//@I2S_AudioFreq
+#define I2S_AUDIOFREQ_8K					8000
+#define I2S_AUDIOFREQ_11K					11025
+#define I2S_AUDIOFREQ_16K					16000
+#define I2S_AUDIOFREQ_22K					22050
+#define I2S_AUDIOFREQ_32K					32000
+#define I2S_AUDIOFREQ_44K					44100
+#define I2S_AUDIOFREQ_48K					48000
+#define I2S_AUDIOFREQ_96K					96000
+
+//Possible I2S application states
+#define I2S_READY							0
+#define I2S_BUSY_IN_STREAM					1
+
+//Possible I2S return codes
+#define I2S_OK								0
+#define I2S_ERR_FREQ						1	//sample rate out of range or not reachable
+#define I2S_ERR_BUSY						2
+#define I2S_ERR_TIMEOUT						3	//PLLI2S did not lock, or the last frame did not go out
+
+//Bounds of the polling loops
+#define I2S_TIMEOUT_PLL_US					2000	//PLLI2S lock and unlock
+#define I2S_TIMEOUT_STOP_US					1000	//last frame on I2S_StopStream, longer than a frame at 8 kHz
+
+//Possible I2S application events
+#define I2S_EVENT_HALF_CMPLT				1	//first half of the buffer done, refill/consume it
+#define I2S_EVENT_CMPLT						2	//second half of the buffer done, refill/consume it
+#define I2S_EVENT_UDR_ERR					3
+#define I2S_EVENT_OVR_ERR					4
+#define I2S_EVENT_DMA_ERR					5
+#define I2S_EVENT_STOP_TIMEOUT				6	//the stream stopped after a DMA error, the last frame did not go out
+
+/*
+ * 				We define the APIs supported by this driver
+ * */
+
+//Init and De-Init
+uint8_t I2S_Init(I2S_Handle_t *pI2SHandle);
+void I2S_DeInit(I2S_Handle_t *pI2SHandle);
+
+//Clock tree
+uint8_t I2S_ComputeClock(uint32_t AudioFreq, uint8_t DataFormat, uint8_t MCLKOutput, uint32_t *pPLLI2SN,
+		uint32_t *pPLLI2SR, uint32_t *pI2SDiv, uint32_t *pAchievedFreq, int32_t *pErrorPpm);
+
+//Streaming
+uint8_t I2S_StartStreamDMA(I2S_Handle_t *pI2SHandle, uint16_t *pBuffer, uint32_t Len);
+uint8_t I2S_StopStream(I2S_Handle_t *pI2SHandle);
+
+//IRQ handling
+void I2S_DMAIRQHandling(I2S_Handle_t *pI2SHandle);
+void I2S_IRQHandling(I2S_Handle_t *pI2SHandle);
+
+void I2S_ApplicationEventCallback(I2S_Handle_t *pI2SHandle, uint8_t AppEv);
+
+#endif /* INC_STM32F401XX_I2S_DRIVER_H_ */
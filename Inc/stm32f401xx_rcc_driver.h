@@ -0,0 +1,27 @@
+/*
+ * stm32f401xx_rcc_driver.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#ifndef INC_STM32F401XX_RCC_DRIVER_H_
+#define INC_STM32F401XX_RCC_DRIVER_H_
+
+#include "stm32f401xx.h"
+
+/*
+ * Bus clock frequencies derived from the RCC registers. The oscillator values come from
+ * DRV_HSI_VALUE/DRV_HSE_VALUE, nothing is cached, a clock change is seen on the next call.
+ */
+
+/******************************************************************************************
+ *								APIs supported by this driver
+ *		 For more information about the APIs check the function definitions
+ ******************************************************************************************/
+uint32_t RCC_GetPLLOutputClock(void);
+uint32_t RCC_GetHCLKValue(void);
+uint32_t RCC_GetPCLK1Value(void);
+uint32_t RCC_GetPCLK2Value(void);
+
+#endif /* INC_STM32F401XX_RCC_DRIVER_H_ */
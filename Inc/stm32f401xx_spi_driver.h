@@ -15,15 +15,32 @@
 typedef struct{
 	uint8_t SPI_DeviceMode;
 	uint8_t SPI_BusConfig;
-	uint8_t SPI_SclkSpeed;
+	uint8_t SPI_SclkSpeed;			//possible values from @SPI_SclkSpeed
 	uint8_t SPI_DFF;
 	uint8_t SPI_CPOL;
 	uint8_t SPI_CPHA;
 	uint8_t SPI_SSM;
+	uint32_t SPI_MaxSclkHz;		//only read with SPI_SCLK_SPEED_AUTO: the fastest prescaler not exceeding it is used
 
 }SPI_Config_t;
 
 
+//We define the slave streaming context (ping-pong buffers filled by the RX DMA stream)
+typedef struct{
+	uint8_t  *pBuf[2];				//the two buffers, DMA fills one while the app owns the other
+	uint32_t BufLen;				//length of each buffer in bytes
+	DMA_Handle_t *pRxDMA;			//RX DMA stream wired to this SPI (channel/priority set by the app)
+	__vo uint8_t  ReadyIdx;			//index of the buffer handed over with SPI_EVENT_STREAM_BUF_FULL
+	__vo uint8_t  AppOwned[2];		//set while the buffer is held by the app, cleared by SPI_SlaveStreamRelease
+	__vo uint8_t  FrameEndIdx;		//buffer in which the last NSS framed transfer ended
+	__vo uint32_t FrameEndOffset;	//number of bytes of that buffer belonging to the finished frame
+	__vo uint32_t FrameCount;		//completed NSS frames
+	__vo uint32_t OverrunCount;		//buffers overwritten while still held by the app
+	__vo uint32_t OvrErrCount;		//SPI OVR errors (DR not read in time)
+
+}SPI_Stream_t;
+
+
 //We define the handle structure for SPI
 typedef struct{
 	SPI_RegDef_t *pSPIx;
@@ -35,6 +52,7 @@ typedef struct{
 	uint32_t RxLen;			//to store Rx len
 	uint8_t  TxState;		//to store Tx state
 	uint8_t  RxState;		//to store Rx state
+	SPI_Stream_t *pStream;	//slave streaming context, NULL when not streaming
 
 }SPI_Handle_t;
 
@@ -58,6 +76,7 @@ typedef struct{
 #define SPI_SCLK_SPEED_DIV64				5
 #define SPI_SCLK_SPEED_DIV128				6
 #define SPI_SCLK_SPEED_DIV256				7
+#define SPI_SCLK_SPEED_AUTO					8	//prescaler computed from SPI_MaxSclkHz
 
 //@SPI_DFF
 #define SPI_DFF_8BITS						0
@@ -77,18 +96,26 @@ typedef struct{
 
 #define SPI_TXE_FLAG						(1 << SPI_SR_TXE)
 #define SPI_RXNE_FLAG						(1 << SPI_SR_RXNE)
-#define SPI_BUSY_FLAG						(1 << SPI_SR_BUSY)
+#define SPI_BUSY_FLAG						(1 << SPI_SR_BSY)
 
 //Possible SPI application states
 #define SPI_READY							0
 #define SPI_BUSY_IN_RX						1
 #define SPI_BUSY_IN_TX						2
+#define SPI_BUSY_IN_STREAM					3
+
+//returned by SPI_SlaveStreamStart instead of a state when the arguments are not usable
+#define SPI_ERR_PARAM						0xFF
 
 //Possible SPI application events
 #define SPI_EVENT_TX_CMPLT					1
 #define SPI_EVENT_RX_CMPLT					2
 #define SPI_EVENT_OVR_ERR					3
 #define SPI_EVENT_CRC_ERR					4
+#define SPI_EVENT_STREAM_BUF_FULL			5
+#define SPI_EVENT_STREAM_FRAME_END			6
+#define SPI_EVENT_STREAM_OVERRUN			7
+#define SPI_EVENT_STREAM_DMA_ERR			8	//DMA transfer error, the stream was stopped
 
 /*
  * 				We define the APIs supported by this driver
@@ -105,6 +132,7 @@ uint8_t SPIGetFlagStatus(SPI_RegDef_t *pSPIx, uint32_t FlagSet);
 //Data send and receive
 void SPI_SendData(SPI_RegDef_t *pSPIx, uint8_t *pTxBuffer, uint32_t Len);
 void SPI_ReceiveData(SPI_RegDef_t *pSPIx, uint8_t *pRxBuffer, uint32_t Len);
+void SPI_TransferData(SPI_RegDef_t *pSPIx, uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len);
 
 //IRQ configuration and ISR handling
 void SPI_IRQITConfig(uint8_t IRQNumber, uint8_t EnorDi);
@@ -115,6 +143,11 @@ void SPI_IRQHandling(SPI_Handle_t *pSPIHandle);
 void SPI_PeripheralControl(SPI_RegDef_t *pSPIx, uint8_t EnOrDi);
 void SPI_SSIConfig(SPI_RegDef_t *pSPIx, uint8_t EnOrDi);
 
+//Serial clock
+uint8_t SPI_ComputeSclkSpeed(SPI_RegDef_t *pSPIx, uint32_t MaxSclkHz);
+uint32_t SPI_SetSclkFreq(SPI_Handle_t *pSPIHandle, uint32_t MaxSclkHz);
+uint32_t SPI_GetSclkFreq(SPI_RegDef_t *pSPIx);
+
 uint8_t SPI_SendDataIT(SPI_Handle_t *pSPIHandle, uint8_t *pTxBuffer, uint32_t Len);
 uint8_t SPI_ReceiveDataIT(SPI_Handle_t *pSPIHandle, uint8_t *pRxBuffer, uint32_t Len);
 
@@ -122,6 +155,13 @@ void SPI_ClearOVRFlag(SPI_RegDef_t *pSPIx);
 void SPI_CloseTransmission(SPI_Handle_t *pSPIHandle);
 void SPI_CloseReception(SPI_Handle_t *pSPIHandle);
 
+//Slave streaming with ping-pong buffers
+uint8_t SPI_SlaveStreamStart(SPI_Handle_t *pSPIHandle, SPI_Stream_t *pStream);
+void SPI_SlaveStreamStop(SPI_Handle_t *pSPIHandle);
+void SPI_SlaveStreamRelease(SPI_Handle_t *pSPIHandle, uint8_t BufIdx);
+void SPI_SlaveStreamDMAIRQHandling(SPI_Handle_t *pSPIHandle);
+void SPI_SlaveStreamNSSHandling(SPI_Handle_t *pSPIHandle);
+
 void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle, uint8_t AppEv);
 
 #endif /* INC_STM32F401XX_SPI_DRIVER_H_ */
@@ -0,0 +1,83 @@
+/*
+ * stm32f401xx_spi_nor_driver.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#ifndef INC_STM32F401XX_SPI_NOR_DRIVER_H_
+#define INC_STM32F401XX_SPI_NOR_DRIVER_H_
+
+#include "stm32f401xx.h"
+
+//size of the read-ahead cache used for short sequential reads
+#define NOR_READAHEAD_SIZE					64
+
+//We define the handle structure for a JEDEC SPI NOR flash
+typedef struct{
+	SPI_Handle_t  *pSPIHandle;		//SPI initialized as master, 8 bit, mode 0 or 3
+	GPIO_RegDef_t *pCSPort;			//port of the chip select pin (push-pull output)
+	uint8_t       CSPin;			//chip select pin number
+
+	//filled by NOR_Init
+	uint8_t  ManufacturerID;		//JEDEC manufacturer ID
+	uint8_t  MemoryType;			//JEDEC memory type
+	uint32_t Capacity;				//in bytes, 2^capacity code
+
+	//state
+	uint8_t  PendingOp;				//@NOR_PendingOp, program/erase whose WIP has not been checked yet
+	uint32_t CacheAddr;				//flash address of Cache[0]
+	uint32_t CacheLen;				//valid bytes in Cache, 0 when invalid
+	uint8_t  Cache[NOR_READAHEAD_SIZE];
+
+}NOR_Handle_t;
+
+//@NOR_PendingOp
+#define NOR_OP_NONE							0
+#define NOR_OP_PROGRAM						1
+#define NOR_OP_ERASE_SECTOR					2
+#define NOR_OP_ERASE_BLOCK					3
+
+//NOR return codes
+#define NOR_OK								0
+#define NOR_ERR_TIMEOUT						1
+#define NOR_ERR_ID							2	//no device or JEDEC ID not readable
+#define NOR_ERR_RANGE						3
+
+//Geometry
+#define NOR_PAGE_SIZE						256
+#define NOR_SECTOR_SIZE						4096
+#define NOR_BLOCK_SIZE						65536
+
+//JEDEC commands
+#define NOR_CMD_WRITE_ENABLE				0x06
+#define NOR_CMD_READ_STATUS1				0x05
+#define NOR_CMD_READ_JEDEC_ID				0x9F
+#define NOR_CMD_FAST_READ					0x0B
+#define NOR_CMD_PAGE_PROGRAM				0x02
+#define NOR_CMD_SECTOR_ERASE				0x20
+#define NOR_CMD_BLOCK_ERASE					0xD8
+
+//Status register 1
+#define NOR_SR_WIP							(1 << 0)
+#define NOR_SR_WEL							(1 << 1)
+
+//Worst case operation times (typical 25/W25 parts), used as WIP polling bounds
+#define NOR_TIMEOUT_PROGRAM_MS				5
+#define NOR_TIMEOUT_SECTOR_ERASE_MS			500
+#define NOR_TIMEOUT_BLOCK_ERASE_MS			2500
+
+
+/*
+ * 				We define the APIs supported by this driver
+ * */
+uint8_t NOR_Init(NOR_Handle_t *pNORHandle);
+uint8_t NOR_ReadJEDECID(NOR_Handle_t *pNORHandle, uint8_t *pID);
+uint8_t NOR_Read(NOR_Handle_t *pNORHandle, uint32_t Addr, uint8_t *pRxBuffer, uint32_t Len);
+uint8_t NOR_Write(NOR_Handle_t *pNORHandle, uint32_t Addr, uint8_t *pTxBuffer, uint32_t Len);
+uint8_t NOR_EraseSector(NOR_Handle_t *pNORHandle, uint32_t Addr);
+uint8_t NOR_EraseBlock(NOR_Handle_t *pNORHandle, uint32_t Addr);
+uint8_t NOR_WaitReady(NOR_Handle_t *pNORHandle);
+uint8_t NOR_IsBusy(NOR_Handle_t *pNORHandle);
+
+#endif /* INC_STM32F401XX_SPI_NOR_DRIVER_H_ */
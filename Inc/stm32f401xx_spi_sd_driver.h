@@ -0,0 +1,122 @@
+/*
+ * stm32f401xx_spi_sd_driver.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#ifndef INC_STM32F401XX_SPI_SD_DRIVER_H_
+#define INC_STM32F401XX_SPI_SD_DRIVER_H_
+
+#include "stm32f401xx.h"
+
+#define SD_BLOCK_SIZE						512
+
+//SCLK limits, the identification phase must not run above 400 kHz
+#define SD_INIT_SCLK_HZ						400000
+#define SD_MAX_SCLK_HZ						25000000
+
+//number of blocks the write-behind queue can hold
+#define SD_WB_QUEUE_DEPTH					8
+
+//We define one entry of the write-behind queue
+typedef struct{
+	uint32_t BlockAddr;				//block number on the card
+	uint8_t  *pData;				//SD_BLOCK_SIZE bytes, owned by the driver until SD_EVENT_WB_BLOCK_DONE
+
+}SD_WBEntry_t;
+
+//We define the handle structure for an SD card in SPI mode
+typedef struct{
+	SPI_Handle_t  *pSPIHandle;		//SPI initialized as master, 8 bit, mode 0
+	GPIO_RegDef_t *pCSPort;			//port of the chip select pin (push-pull output)
+	uint8_t       CSPin;			//chip select pin number
+	uint32_t      InitSclkHz;		//SCLK limit for the identification phase, SD_INIT_SCLK_HZ if 0
+	uint32_t      SclkHz;			//SCLK limit used after init, SD_MAX_SCLK_HZ if 0
+
+	//filled by SD_Init
+	uint8_t  CardType;				//@SD_CardType
+
+	//write-behind state
+	SD_WBEntry_t WBQueue[SD_WB_QUEUE_DEPTH];
+	uint8_t  WBHead;				//next free entry
+	uint8_t  WBTail;				//oldest queued entry
+	uint8_t  WBCount;				//number of queued entries
+	uint8_t  WBState;				//@SD_WBState
+	uint8_t  WBBusy;				//a block or stop token was sent, card busy not checked yet
+	uint32_t WBBusyStart;			//DWT cycle count when WBBusy was set
+	uint32_t WBNextBlock;			//block expected next by the open CMD25
+	uint32_t WBErrCount;			//blocks rejected by the card or lost to a timeout
+
+}SD_Handle_t;
+
+//@SD_CardType
+#define SD_TYPE_NONE						0
+#define SD_TYPE_V1							1	//SDSC v1, byte addressing
+#define SD_TYPE_V2							2	//SDSC v2, byte addressing
+#define SD_TYPE_V2HC						3	//SDHC/SDXC, block addressing
+
+//@SD_WBState
+#define SD_WB_IDLE							0
+#define SD_WB_MULTI							1	//CMD25 open, chip select held low
+
+//SD return codes
+#define SD_OK								0
+#define SD_ERR_TIMEOUT						1
+#define SD_ERR_NO_CARD						2	//no response to CMD0 or unusable card
+#define SD_ERR_CMD							3	//R1 reported an error
+#define SD_ERR_DATA							4	//data token/response error
+#define SD_ERR_QUEUE_FULL					5
+
+//Possible SD application events
+#define SD_EVENT_WB_BLOCK_DONE				1	//the buffer of the oldest queued block can be reused
+#define SD_EVENT_WB_ERR						2	//a queued block was rejected or timed out
+
+//Commands (SPI mode)
+#define SD_CMD0								0	//GO_IDLE_STATE
+#define SD_CMD8								8	//SEND_IF_COND
+#define SD_CMD12							12	//STOP_TRANSMISSION
+#define SD_CMD16							16	//SET_BLOCKLEN
+#define SD_CMD17							17	//READ_SINGLE_BLOCK
+#define SD_CMD18							18	//READ_MULTIPLE_BLOCK
+#define SD_CMD24							24	//WRITE_BLOCK
+#define SD_CMD25							25	//WRITE_MULTIPLE_BLOCK
+#define SD_CMD55							55	//APP_CMD
+#define SD_CMD58							58	//READ_OCR
+#define SD_ACMD23							23	//SET_WR_BLK_ERASE_COUNT
+#define SD_ACMD41							41	//SD_SEND_OP_COND
+
+//R1 bits
+#define SD_R1_IDLE							(1 << 0)
+#define SD_R1_ILLEGAL_CMD					(1 << 2)
+
+//Data tokens
+#define SD_TOKEN_START_BLOCK				0xFE	//CMD17/18/24
+#define SD_TOKEN_START_MULTI_WRITE			0xFC	//CMD25
+#define SD_TOKEN_STOP_TRAN					0xFD	//CMD25
+#define SD_DATA_RESP_MASK					0x1F
+#define SD_DATA_RESP_ACCEPTED				0x05
+
+//Timeouts from the physical layer spec
+#define SD_TIMEOUT_INIT_MS					1000
+#define SD_TIMEOUT_READ_MS					100
+#define SD_TIMEOUT_WRITE_MS					500
+
+
+/*
+ * 				We define the APIs supported by this driver
+ * */
+uint8_t SD_Init(SD_Handle_t *pSDHandle);
+
+//blocking transfers, any write-behind backlog is flushed first
+uint8_t SD_ReadBlocks(SD_Handle_t *pSDHandle, uint32_t BlockAddr, uint8_t *pRxBuffer, uint32_t Count);
+uint8_t SD_WriteBlocks(SD_Handle_t *pSDHandle, uint32_t BlockAddr, uint8_t *pTxBuffer, uint32_t Count);
+
+//write-behind
+uint8_t SD_WriteBlockAsync(SD_Handle_t *pSDHandle, uint32_t BlockAddr, uint8_t *pTxBuffer);
+uint8_t SD_Process(SD_Handle_t *pSDHandle);
+uint8_t SD_Flush(SD_Handle_t *pSDHandle);
+
+void SD_ApplicationEventCallback(SD_Handle_t *pSDHandle, uint8_t AppEv);
+
+#endif /* INC_STM32F401XX_SPI_SD_DRIVER_H_ */
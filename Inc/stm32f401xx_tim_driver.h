@@ -0,0 +1,82 @@
+/*
+ * stm32f401xx_tim_driver.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#ifndef INC_STM32F401XX_TIM_DRIVER_H_
+#define INC_STM32F401XX_TIM_DRIVER_H_
+
+#include "stm32f401xx.h"
+
+//configuration structure for a timer used as a time base
+typedef struct
+{
+	uint32_t TIM_CounterHz;			//counter clock after the prescaler, must divide the timer clock
+	uint32_t TIM_Period;			//counter clocks per update event, up to 65536 (2^32 on TIM2/TIM5)
+
+}TIM_Config_t;
+
+//Handle structure for a timer
+typedef struct
+{
+	TIM_RegDef_t *pTIMx;
+	TIM_Config_t TIMConfig;
+	uint32_t AchievedCounterHz;		//filled by TIM_Init
+
+}TIM_Handle_t;
+
+//@TIM_Flags
+#define TIM_FLAG_UPDATE				(1 << TIM_SR_UIF)
+#define TIM_FLAG_CC(x)				(1 << (TIM_SR_CC1IF + (x) - 1))
+#define TIM_FLAG_CCOF(x)			(1 << (TIM_SR_CC1OF + (x) - 1))
+
+//@TIM_ICPolarity
+#define TIM_IC_RISING				0
+#define TIM_IC_FALLING				1
+#define TIM_IC_BOTH					2
+
+//Possible TIM return codes
+#define TIM_OK						0
+#define TIM_ERR_PARAM				1	//counter clock not reachable or period too long
+
+//Possible TIM application events
+#define TIM_EVENT_UPDATE			1
+
+
+/******************************************************************************************
+ *								APIs supported by this driver
+ *		 For more information about the APIs check the function definitions
+ ******************************************************************************************/
+
+//Peripheral clock setup
+void TIM_PeriClockControl(TIM_RegDef_t *pTIMx, uint8_t EnorDi);
+uint32_t TIM_GetClock(TIM_RegDef_t *pTIMx);
+
+//Init and control
+uint8_t TIM_Init(TIM_Handle_t *pTIMHandle);
+void TIM_Start(TIM_RegDef_t *pTIMx);
+void TIM_Stop(TIM_RegDef_t *pTIMx);
+uint32_t TIM_GetCounter(TIM_RegDef_t *pTIMx);
+void TIM_UpdateITConfig(TIM_RegDef_t *pTIMx, uint8_t EnorDi);
+
+//Input capture, Channel 1 .. 4
+void TIM_ICConfig(TIM_RegDef_t *pTIMx, uint8_t Channel, uint8_t Polarity, uint8_t Filter);
+void TIM_ICDisable(TIM_RegDef_t *pTIMx, uint8_t Channel);
+void TIM_CCITConfig(TIM_RegDef_t *pTIMx, uint8_t Channel, uint8_t EnorDi);
+void TIM_CCDMAConfig(TIM_RegDef_t *pTIMx, uint8_t Channel, uint8_t EnorDi);
+uint32_t TIM_GetCapture(TIM_RegDef_t *pTIMx, uint8_t Channel);
+
+//Flags
+uint8_t TIM_GetFlagStatus(TIM_RegDef_t *pTIMx, uint32_t Flag);
+void TIM_ClearFlag(TIM_RegDef_t *pTIMx, uint32_t Flag);
+
+//IRQ configuration and ISR handling
+void TIM_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi);
+void TIM_IRQPriorityConfig(uint8_t IRQNumber, uint32_t IRQPriority);
+void TIM_IRQHandling(TIM_Handle_t *pTIMHandle);
+
+void TIM_ApplicationEventCallback(TIM_Handle_t *pTIMHandle, uint8_t AppEv);
+
+#endif /* INC_STM32F401XX_TIM_DRIVER_H_ */
@@ -19,9 +19,90 @@ typedef struct
 	uint8_t USART_WordLength;
 	uint8_t USART_ParityControl;
 	uint8_t USART_HWFlowControl;
+	uint8_t USART_WakeMode;			//possible values from @USART_WakeMode
+	uint8_t USART_NodeAddr;			//4 bit node address for address mark wakeup
+	uint8_t USART_DEMode;			//possible values from @USART_DEMode
+	uint8_t USART_RTSMode;			//possible values from @USART_RTSMode
 
 }USART_Config_t;
 
+//We define the circular DMA reception context
+typedef struct
+{
+	uint8_t  *pBuf;					//circular buffer filled by the RX DMA stream
+	uint16_t BufLen;				//in bytes, 8 bit frames
+	DMA_Handle_t *pRxDMA;			//RX DMA stream wired to this USART (channel/priority set by the app)
+	uint16_t ReadPos;				//first byte not handed to the app yet
+	uint8_t  *pSlice;				//slice reported with USART_EVENT_RX_SLICE, points into pBuf
+	uint16_t SliceLen;
+	uint32_t FrameCount;			//IDLE terminated frames
+	__vo uint16_t Held;				//bytes handed over in slices and not yet returned with USART_DMARxRelease, at most BufLen
+	uint32_t Overruns;				//the DMA lapped ReadPos, the unread bytes were dropped
+
+	//driver state, the USART (IDLE) and DMA (HT/TC) interrupts both hand over slices
+	__vo uint8_t Busy;				//slices are being handed over, a nested call only leaves Again
+	__vo uint8_t Again;				//new data or a frame end came in while Busy
+	__vo uint8_t FrameEnd;			//frame end to report once the pending slices are out
+	__vo uint32_t DmaWraps;			//TC interrupts, buffer wraps of the DMA
+	uint32_t SeenWraps;				//wraps seen as a write position behind ReadPos
+
+}USART_DMARx_t;
+
+//We define one segment of a scatter-gather transmission
+typedef struct USART_TxSeg
+{
+	const uint8_t *pData;
+	uint16_t Len;					//0 is allowed, the segment is skipped
+	struct USART_TxSeg *pNext;		//NULL on the last segment of the chain
+
+}USART_TxSeg_t;
+
+//We define a chain of segments sent back to back as one transmission
+typedef struct USART_TxChain
+{
+	USART_TxSeg_t *pSegs;			//segments and data must stay valid until USART_EVENT_TX_CHAIN_DONE
+	void     *pContext;				//free for the app
+	__vo uint8_t Status;			//USART_ERR_BUSY while queued or on the line, then USART_OK or USART_ERR_DMA
+	struct USART_TxChain *pNext;
+
+}USART_TxChain_t;
+
+//We define the scatter-gather DMA transmission context
+typedef struct
+{
+	DMA_Handle_t *pTxDMA;			//TX DMA stream wired to this USART (channel/priority set by the app)
+	USART_TxChain_t *pHead;			//chain on the line
+	USART_TxChain_t *pTail;
+	USART_TxSeg_t *pCurSeg;			//segment the DMA is moving
+	USART_TxChain_t *pDoneChain;	//chain reported with USART_EVENT_TX_CHAIN_DONE
+	uint8_t  Active;				//chains are being sent
+	uint32_t ChainCount;			//completed chains
+
+}USART_DMATx_t;
+
+//edges captured for the longest sync pattern (0x55: start bit, 8 data bits and the stop bit edge)
+#define USART_AUTOBAUD_MAX_EDGES		10
+
+//We define the automatic baud rate detection context
+typedef struct
+{
+	TIM_Handle_t *pTIMHandle;		//32 bit timer (TIM2/TIM5) with a channel input on the RX pin
+	uint8_t  TIMChannel;			//1 .. 4, e.g. TIM2 CH4 on PA3 for USART2
+	DMA_Handle_t *pCapDMA;			//stream of the CCx DMA request (channel/priority set by the app), e.g. DMA1 stream 6 channel 3 for TIM2_CH4
+	GPIO_RegDef_t *pRxPort;			//RX pin, configured in alternate function mode
+	uint8_t  RxPin;
+	uint8_t  RxAF;					//alternate function of the pin for the USART
+	uint8_t  TIMAF;					//alternate function of the pin for the timer
+	uint8_t  Sync;					//@USART_AutoBaudSync
+
+	uint32_t Captures[USART_AUTOBAUD_MAX_EDGES];	//edge timestamps written by the DMA
+	uint32_t MeasuredBaud;			//from the edge timestamps
+	uint32_t Baud;					//programmed, a standard rate when the measurement is close to one
+	uint32_t Rejects;				//characters that did not match the sync pattern
+	__vo uint8_t Status;			//USART_ERR_BUSY while measuring, then USART_OK or USART_ERR_BAUD
+
+}USART_AutoBaud_t;
+
 //Handle structure for USART peripheral
 typedef struct
 {
@@ -33,6 +114,34 @@ typedef struct
 	uint32_t RxLen;
 	uint8_t TxBusyState;
 	uint8_t RxBusyState;
+
+	//streaming mode, see USART_StreamStart
+	uint8_t Streaming;
+	uint8_t *pTxRing;
+	uint8_t *pRxRing;
+	uint32_t TxRingSize;			//power of two
+	uint32_t RxRingSize;			//power of two
+	__vo uint32_t TxHead;			//written by USART_StreamWrite
+	__vo uint32_t TxTail;			//written by the ISR
+	__vo uint32_t RxHead;			//written by the ISR
+	__vo uint32_t RxTail;			//written by USART_StreamRead
+	uint32_t RxHighWater;			//RX fill level that raises USART_EVENT_RX_HIGH_WATER and releases RTS, 0 selects 3/4 of the ring (DMA RX: bytes held)
+	uint32_t RxLowWater;			//RX fill level that raises USART_EVENT_RX_LOW_WATER, 0 selects 1/4 of the ring
+	uint32_t TxLowWater;			//TX fill level that raises USART_EVENT_TX_LOW_WATER, 0 selects 1/4 of the ring
+	__vo uint8_t RxAboveHigh;		//high watermark reported, low watermark not yet
+	uint32_t RxDrops;				//bytes lost because the RX ring was full
+
+	USART_DMARx_t *pDMARx;			//circular DMA reception context, NULL when not used
+	USART_DMATx_t *pDMATx;			//scatter-gather DMA transmission context, NULL when not used
+	USART_AutoBaud_t *pAutoBaud;	//baud rate detection context, NULL when not detecting
+
+	//RS-485 driver enable, only used with USART_DEMode USART_DE_GPIO
+	GPIO_RegDef_t *pDEPort;			//port of the DE(/RE) pin, push-pull output
+	uint8_t DEPin;					//high while transmitting
+
+	//software RTS, only used with USART_RTSMode USART_RTS_GPIO
+	GPIO_RegDef_t *pRTSPort;		//port of the RTS pin, push-pull output (not the USART AF)
+	uint8_t RTSPin;					//low while the receiver can take more data
 }USART_Handle_t;
 
 
@@ -44,6 +153,40 @@ typedef struct
 #define USART_MODE_ONLY_RX 1
 #define USART_MODE_TXRX  2
 
+/*
+ *@USART_WakeMode
+ *Possible options for USART_WakeMode (multiprocessor communication)
+ */
+#define USART_WAKE_NONE				0
+#define USART_WAKE_IDLE_LINE		1	//mute until the line goes idle
+#define USART_WAKE_ADDRESS_MARK		2	//mute until an address byte (MSB set) matching USART_NodeAddr
+
+/*
+ *@USART_DEMode
+ *Possible options for USART_DEMode (RS-485 transceiver direction)
+ */
+#define USART_DE_NONE				0	//the transceiver direction is not controlled, pDEPort is ignored
+#define USART_DE_GPIO				1	//pDEPort/DEPin high while transmitting
+
+/*
+ *@USART_RTSMode
+ *Possible options for USART_RTSMode, only used when USART_HWFlowControl includes RTS
+ */
+#define USART_RTS_HW				0	//RTS pin in alternate function mode, pRTSPort is ignored
+#define USART_RTS_GPIO				1	//RTS managed in software on pRTSPort/RTSPin
+
+/*
+ *@USART_AutoBaudSync
+ *Character the automatic baud rate detection measures
+ */
+#define USART_AUTOBAUD_START_BIT	0	//width of the start bit, any character with bit 0 set
+#define USART_AUTOBAUD_SYNC_0X55	1	//9 equal bits from the start edge to the stop bit
+#define USART_AUTOBAUD_SYNC_0X7F	2	//1, 7 and 1 bits from the start edge to the stop bit
+
+//detection range
+#define USART_AUTOBAUD_MIN			1200
+#define USART_AUTOBAUD_MAX			3000000
+
 /*
  *@USART_Baud
  *Possible options for USART_Baud
@@ -59,7 +202,21 @@ typedef struct
 #define USART_STD_BAUD_460800 				460800
 #define USART_STD_BAUD_921600 				921600
 #define USART_STD_BAUD_2M 					2000000
-#define SUART_STD_BAUD_3M 					3000000
+#define USART_STD_BAUD_3M 					3000000
+#define SUART_STD_BAUD_3M 					USART_STD_BAUD_3M	//old misspelled name, kept for existing code
+
+//largest baud rate error USART_SetBaudRate accepts, in ppm of the requested rate
+#define USART_BAUD_TOLERANCE_PPM			15000
+
+//We define the result of the baud rate solver
+typedef struct
+{
+	uint32_t AchievedBaud;
+	int32_t  ErrorPpm;				//(achieved - requested) / requested, in ppm
+	uint16_t BRR;					//value for the BRR register
+	uint8_t  Over8;					//1 if oversampling by 8 has to be selected
+
+}USART_Baud_t;
 
 
 /*
@@ -89,6 +246,11 @@ typedef struct
 /*
  *@USART_HWFlowControl
  *Possible options for USART_HWFlowControl
+ *With RTS and USART_RTS_GPIO the driver manages RTS in software: streaming releases it at the
+ *RX high watermark and asserts it again at the low watermark, leave enough room above the
+ *high watermark for the bytes the sender still has in flight. The circular DMA receiver does
+ *the same with the bytes held by the app (see USART_DMARxRelease), USART_ReceiveDataIT asserts
+ *RTS while a reception is armed and releases it with the last frame.
  */
 #define USART_HW_FLOW_CTRL_NONE    	0
 #define USART_HW_FLOW_CTRL_CTS    	1
@@ -115,6 +277,22 @@ typedef struct
 #define		USART_ERREVENT_FE     	5
 #define		USART_ERREVENT_NF   	 6
 #define		USART_ERREVENT_ORE    	7
+#define		USART_EVENT_RX_HIGH_WATER	8	//from the ISR
+#define		USART_EVENT_RX_LOW_WATER	9	//from USART_StreamRead or USART_DMARxRelease, in the caller's context
+#define		USART_EVENT_TX_LOW_WATER	10	//from the ISR, room to queue more data
+#define		USART_EVENT_RX_SLICE		11	//pDMARx->pSlice/SliceLen received, valid during the callback only
+#define		USART_EVENT_RX_FRAME_END	12	//the line went idle, the slices since the previous one form a frame
+#define		USART_EVENT_DMA_ERR			13	//DMA transfer error, the reception was stopped
+#define		USART_EVENT_TX_CHAIN_DONE	14	//pDMATx->pDoneChain is sent (or failed, see its Status) and owned by the app again
+#define		USART_EVENT_AUTOBAUD		15	//pAutoBaud->Status and Baud are final, the USART is enabled again
+#define		USART_EVENT_RX_OVERRUN		16	//the RX DMA overwrote bytes not handed over yet, pDMARx->Overruns counts it
+
+//USART return codes
+#define USART_OK					0
+#define USART_ERR_PARAM				1
+#define USART_ERR_BUSY				2
+#define USART_ERR_DMA				3
+#define USART_ERR_BAUD				4	//the baud rate cannot be reached within the tolerance
 
 
 
@@ -130,7 +308,7 @@ void USART_PeriClockControl(USART_RegDef_t *pUSARTx, uint8_t EnorDi);
 /*
  * Init and De-init
  */
-void USART_Init(USART_Handle_t *pUSARTHandle);
+uint8_t USART_Init(USART_Handle_t *pUSARTHandle);
 void USART_DeInit(USART_RegDef_t *pUSARTx);
 
 
@@ -142,6 +320,46 @@ void USART_ReceiveData(USART_Handle_t *pUSARTHandle, uint8_t *pRxBuffer, uint32_
 uint8_t USART_SendDataIT(USART_Handle_t *pUSARTHandle,uint8_t *pTxBuffer, uint32_t Len);
 uint8_t USART_ReceiveDataIT(USART_Handle_t *pUSARTHandle, uint8_t *pRxBuffer, uint32_t Len);
 
+/*
+ * Streaming over lock-free TX/RX rings (8 bit frames)
+ */
+uint8_t USART_StreamStart(USART_Handle_t *pUSARTHandle, uint8_t *pTxRing, uint32_t TxSize, uint8_t *pRxRing, uint32_t RxSize);
+void USART_StreamStop(USART_Handle_t *pUSARTHandle);
+uint32_t USART_StreamWrite(USART_Handle_t *pUSARTHandle, const uint8_t *pData, uint32_t Len);
+uint32_t USART_StreamRead(USART_Handle_t *pUSARTHandle, uint8_t *pData, uint32_t Len);
+uint32_t USART_StreamRxCount(USART_Handle_t *pUSARTHandle);
+uint32_t USART_StreamTxFree(USART_Handle_t *pUSARTHandle);
+
+/*
+ * Circular DMA reception with IDLE line framing (8 bit frames)
+ */
+uint8_t USART_DMARxStart(USART_Handle_t *pUSARTHandle, USART_DMARx_t *pDMARx);
+void USART_DMARxStop(USART_Handle_t *pUSARTHandle);
+void USART_DMARxRelease(USART_Handle_t *pUSARTHandle, uint16_t Len);
+void USART_DMARxIRQHandling(USART_Handle_t *pUSARTHandle);
+
+/*
+ * Scatter-gather DMA transmission
+ */
+uint8_t USART_DMATxStart(USART_Handle_t *pUSARTHandle, USART_DMATx_t *pDMATx);
+void USART_DMATxStop(USART_Handle_t *pUSARTHandle);
+uint8_t USART_DMATxSubmit(USART_Handle_t *pUSARTHandle, USART_TxChain_t *pChain);
+void USART_DMATxIRQHandling(USART_Handle_t *pUSARTHandle);
+
+/*
+ * Multiprocessor communication (RS-485 multi-drop)
+ */
+void USART_EnterMute(USART_RegDef_t *pUSARTx);
+uint8_t USART_IsMuted(USART_RegDef_t *pUSARTx);
+void USART_SendAddress(USART_Handle_t *pUSARTHandle, uint8_t NodeAddr);
+
+/*
+ * Automatic baud rate detection
+ */
+uint8_t USART_AutoBaudStart(USART_Handle_t *pUSARTHandle, USART_AutoBaud_t *pAutoBaud);
+void USART_AutoBaudStop(USART_Handle_t *pUSARTHandle);
+void USART_AutoBaudDMAIRQHandling(USART_Handle_t *pUSARTHandle);
+
 /*
  * IRQ Configuration and ISR handling
  */
@@ -161,7 +379,8 @@ void USART_ClearFlag(USART_RegDef_t *pUSARTx, uint16_t StatusFlagName);
  */
 void USART_ApplicationEventCallback(USART_Handle_t *pUSARTHandle,uint8_t AppEv);
 
-void USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate);
+uint8_t USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate);
+uint8_t USART_SolveBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate, uint32_t TolPpm, USART_Baud_t *pBaud);
 
 
 
@@ -0,0 +1,76 @@
+/*
+ * stm32f401xx_usart_link_driver.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#ifndef INC_STM32F401XX_USART_LINK_DRIVER_H_
+#define INC_STM32F401XX_USART_LINK_DRIVER_H_
+
+#include "stm32f401xx.h"
+
+/*
+ * Packet link layer over USART. A frame is payload + CRC (little endian), COBS encoded and
+ * terminated by a 0x00 delimiter, so a receiver resynchronises at the next zero byte after
+ * any corruption. Frames are limited to one COBS block (254 bytes of payload + CRC), which
+ * lets both encoding and decoding work in place.
+ *
+ * TX buffer layout: [code][payload ... ][CRC][0x00], write the payload at LINK_TX_PAYLOAD
+ * and call LINK_Encode, the whole buffer is then ready to be sent.
+ */
+
+#define LINK_MAX_BLOCK						254		//payload + CRC
+#define LINK_MAX_PAYLOAD(crc)				(LINK_MAX_BLOCK - LINK_CRC_LEN(crc))
+#define LINK_MAX_ENCODED					(LINK_MAX_BLOCK + 1)	//without the delimiter
+#define LINK_TX_BUF_SIZE					(LINK_MAX_ENCODED + 1)
+
+#define LINK_TX_PAYLOAD(pBuf)				((pBuf) + 1)
+#define LINK_CRC_LEN(crc)					(((crc) == LINK_CRC32) ? 4 : 2)
+
+//We define the handle structure of a link
+typedef struct LINK_Handle{
+	uint8_t  CrcType;				//@LINK_CrcType
+	void     (*pFrameCallback)(struct LINK_Handle *pLINKHandle, uint8_t *pData, uint16_t Len);	//good frames, pData valid during the call only
+	void     *pContext;				//free for the app
+
+	//receive state
+	uint8_t  RxBuf[LINK_MAX_ENCODED];
+	uint16_t RxLen;
+	uint8_t  RxDiscard;				//frame too long, skipping to the next delimiter
+
+	//statistics
+	uint32_t FramesOk;
+	uint32_t CrcErrors;
+	uint32_t FramingErrors;			//invalid COBS or too short
+	uint32_t Overflows;				//frames longer than LINK_MAX_ENCODED
+
+}LINK_Handle_t;
+
+//@LINK_CrcType
+#define LINK_CRC16							0	//CRC-16/CCITT-FALSE
+#define LINK_CRC32							1	//CRC-32 (IEEE 802.3)
+
+//LINK return codes
+#define LINK_OK								0
+#define LINK_ERR_PARAM						1
+#define LINK_ERR_BUSY						2	//not enough room in the USART TX ring
+
+
+/*
+ * 				We define the APIs supported by this driver
+ * */
+void LINK_Init(LINK_Handle_t *pLINKHandle);
+
+//transmit
+uint16_t LINK_Encode(LINK_Handle_t *pLINKHandle, uint8_t *pBuf, uint16_t Len);
+uint8_t LINK_Send(LINK_Handle_t *pLINKHandle, USART_Handle_t *pUSARTHandle, uint8_t *pBuf, uint16_t Len);
+
+//receive, feed with bytes from USART_StreamRead or with USART_EVENT_RX_SLICE slices
+void LINK_RxBytes(LINK_Handle_t *pLINKHandle, const uint8_t *pData, uint32_t Len);
+
+//CRC helpers
+uint16_t LINK_Crc16(const uint8_t *pData, uint32_t Len);
+uint32_t LINK_Crc32(const uint8_t *pData, uint32_t Len);
+
+#endif /* INC_STM32F401XX_USART_LINK_DRIVER_H_ */
@@ -0,0 +1,79 @@
+/*
+ * stm32f401xx_usart_log_driver.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#ifndef INC_STM32F401XX_USART_LOG_DRIVER_H_
+#define INC_STM32F401XX_USART_LOG_DRIVER_H_
+
+#include "stm32f401xx.h"
+
+/*
+ * Deferred binary logging. A log call stores the format string ID, a DWT timestamp and the
+ * raw 32 bit arguments in a ring, nothing is formatted on the target. LOG_Process ships
+ * the records over a streaming USART and the host tool tools/stm32f401xx_usart_log_decode.py
+ * turns them back into text using the format strings of the ELF file.
+ *
+ * Record on the wire, little endian 32 bit words:
+ *   word 0   header: [31:24] LOG_RECORD_MARKER, [23:21] number of arguments,
+ *            [20:0] offset of the format string in the log_fmt section of the ELF
+ *   word 1   DWT cycle count
+ *   word 2.. arguments
+ *
+ * Arguments are passed as 32 bit words, so %d, %u, %x, %c and %p work. Strings (%s) are
+ * only meaningful for pointers into the flash image and doubles are not supported.
+ * The log_fmt section is never read by the firmware, it can be placed in a non loaded
+ * (INFO) output section of the linker script to keep the strings out of the flash.
+ */
+
+#define LOG_MAX_ARGS						4
+#define LOG_RECORD_MARKER					0xA5
+
+//We define the handle structure of the logger
+typedef struct{
+	USART_Handle_t *pUSARTHandle;	//USART in streaming mode (USART_StreamStart)
+	uint32_t *pRing;				//record ring
+	uint32_t RingWords;				//size in 32 bit words, power of two
+	__vo uint32_t Head;				//written by the log calls
+	__vo uint32_t Tail;				//written by LOG_Process
+	uint8_t  TxBytes;				//bytes of the word at Tail already passed to the USART
+	__vo uint32_t Records;			//records stored
+	__vo uint32_t Drops;			//records lost because the ring was full
+
+}LOG_Handle_t;
+
+//LOG return codes
+#define LOG_OK								0
+#define LOG_ERR_PARAM						1
+
+//start of the format string section, provided by the linker
+extern const char __start_log_fmt[];
+
+#define LOG_FMT_SECTION						__attribute__((section("log_fmt"), used))
+
+#define LOG_HEADER(fmt, n)					(((uint32_t)LOG_RECORD_MARKER << 24) | ((uint32_t)(n) << 21) | \
+											 (((uint32_t)(fmt) - (uint32_t)__start_log_fmt) & 0x1FFFFF))
+
+#define LOG_EMIT(n, fmt, a0, a1, a2, a3)	do{ static const char log_fmt_str[] LOG_FMT_SECTION = fmt; \
+											LOG_Write(LOG_HEADER(log_fmt_str, n), (uint32_t)(a0), (uint32_t)(a1), \
+											(uint32_t)(a2), (uint32_t)(a3)); }while(0)
+
+//log calls, usable from any context including interrupts. Not lock free, PRIMASK is set
+//while the record is stored, so they add a few cycles of interrupt latency
+#define LOG_0(fmt)							LOG_EMIT(0, fmt, 0, 0, 0, 0)
+#define LOG_1(fmt, a0)						LOG_EMIT(1, fmt, a0, 0, 0, 0)
+#define LOG_2(fmt, a0, a1)					LOG_EMIT(2, fmt, a0, a1, 0, 0)
+#define LOG_3(fmt, a0, a1, a2)				LOG_EMIT(3, fmt, a0, a1, a2, 0)
+#define LOG_4(fmt, a0, a1, a2, a3)			LOG_EMIT(4, fmt, a0, a1, a2, a3)
+
+
+/*
+ * 				We define the APIs supported by this driver
+ * */
+uint8_t LOG_Init(LOG_Handle_t *pLOGHandle);
+void LOG_Write(uint32_t Header, uint32_t A0, uint32_t A1, uint32_t A2, uint32_t A3);
+uint32_t LOG_Process(LOG_Handle_t *pLOGHandle);
+
+#endif /* INC_STM32F401XX_USART_LOG_DRIVER_H_ */
@@ -0,0 +1,286 @@
+/*
+ * stm32f401xx_dma_driver.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+//the device header pulls in the driver headers in dependency order, the other
+//drivers reference DMA_Handle_t so it has to be seen through it first
+#include "stm32f401xx.h"
+
+//position of the stream flags inside LISR/HISR (streams 0..3 and 4..7 share the same layout)
+static const uint8_t dma_flag_offset[4] = {0, 6, 16, 22};
+
+
+/*********************************************************************
+ * @fn      		  - DMA_PeriClockControl
+ *
+ * @brief             - enables or disables the clock of DMA1 or DMA2
+ *
+ * @param[in]         - base address of the DMA controller
+ * @param[in]         - ENABLE or DISABLE
+ *
+ * @return            - none
+ */
+void DMA_PeriClockControl(DMA_RegDef_t *pDMAx, uint8_t EnorDi)
+{
+	if (EnorDi == ENABLE)
+	{
+		if (pDMAx == DRV_DMA1)
+		{
+			DRV_DMA1_PCLK_EN();
+		}
+		else
+		{
+			DRV_DMA2_PCLK_EN();
+		}
+	}
+	else
+	{
+		if (pDMAx == DRV_DMA1)
+		{
+			DRV_DMA1_PCLK_DI();
+		}
+		else
+		{
+			DRV_DMA2_PCLK_DI();
+		}
+	}
+}
+
+/*********************************************************************
+ * @fn      		  - DMA_Init
+ *
+ * @brief             - programs the stream configuration, the stream stays disabled
+ *
+ * @param[in]         - handle of the DMA stream
+ *
+ * @return            - none
+ *
+ * @Note              - the FIFO is left in direct mode for peripheral transfers so that
+ *                      NDTR always reflects what has actually reached memory
+ */
+void DMA_Init(DMA_Handle_t *pDMAHandle)
+{
+	DMA_Stream_RegDef_t *pStream = &pDMAHandle->pDMAx->S[pDMAHandle->DMA_StreamNumber];
+	uint32_t tempreg = 0;
+
+	DMA_PeriClockControl(pDMAHandle->pDMAx, ENABLE);
+
+	//the stream has to be disabled before it can be configured
+	pStream->CR &= ~(1 << DMA_SxCR_EN);
+	while(pStream->CR & (1 << DMA_SxCR_EN));
+
+	tempreg |= ((uint32_t)pDMAHandle->DMAConfig.DMA_Channel << DMA_SxCR_CHSEL);
+	tempreg |= ((uint32_t)pDMAHandle->DMAConfig.DMA_Priority << DMA_SxCR_PL);
+	tempreg |= (pDMAHandle->DMAConfig.DMA_DataSize << DMA_SxCR_MSIZE);
+	tempreg |= (pDMAHandle->DMAConfig.DMA_DataSize << DMA_SxCR_PSIZE);
+	tempreg |= (pDMAHandle->DMAConfig.DMA_Direction << DMA_SxCR_DIR);
+
+	if (pDMAHandle->DMAConfig.DMA_MemInc == ENABLE)
+	{
+		tempreg |= (1 << DMA_SxCR_MINC);
+	}
+
+	if (pDMAHandle->DMAConfig.DMA_Mode == DMA_MODE_CIRCULAR)
+	{
+		tempreg |= (1 << DMA_SxCR_CIRC);
+	}
+	else if (pDMAHandle->DMAConfig.DMA_Mode == DMA_MODE_DOUBLE_BUFFER)
+	{
+		//double buffer mode forces circular mode in hardware
+		tempreg |= (1 << DMA_SxCR_CIRC);
+		tempreg |= (1 << DMA_SxCR_DBM);
+	}
+
+	tempreg |= (pDMAHandle->DMAConfig.DMA_ITControl & (DMA_IT_TE | DMA_IT_HT | DMA_IT_TC));
+
+	if (pDMAHandle->DMAConfig.DMA_Direction == DMA_DIR_MEM_TO_MEM)
+	{
+		//memory to memory needs the FIFO and increments both sides
+		tempreg |= (1 << DMA_SxCR_PINC);
+		pStream->FCR = (1 << DMA_SxFCR_DMDIS) | (3 << DMA_SxFCR_FTH);
+	}
+	else
+	{
+		pStream->FCR = 0;
+	}
+
+	pStream->CR = tempreg;
+}
+
+/*********************************************************************
+ * @fn      		  - DMA_DeInit
+ *
+ * @brief             - resets all registers of the given DMA controller
+ *
+ * @param[in]         - base address of the DMA controller
+ *
+ * @return            - none
+ */
+void DMA_DeInit(DMA_RegDef_t *pDMAx)
+{
+	if (pDMAx == DRV_DMA1)
+	{
+		DRV_DMA1_REG_RST();
+	}
+	else
+	{
+		DRV_DMA2_REG_RST();
+	}
+}
+
+/*********************************************************************
+ * @fn      		  - DMA_StartTransfer
+ *
+ * @brief             - programs the addresses and item count and enables the stream
+ *
+ * @param[in]         - handle of the DMA stream
+ * @param[in]         - peripheral address (source address in memory to memory mode)
+ * @param[in]         - memory 0 address
+ * @param[in]         - memory 1 address, only used in double buffer mode
+ * @param[in]         - number of data items (not bytes) per buffer
+ *
+ * @return            - none
+ */
+void DMA_StartTransfer(DMA_Handle_t *pDMAHandle, uint32_t PeriphAddr, uint32_t Mem0Addr, uint32_t Mem1Addr, uint16_t Len)
+{
+	DMA_Stream_RegDef_t *pStream = &pDMAHandle->pDMAx->S[pDMAHandle->DMA_StreamNumber];
+
+	pStream->CR &= ~(1 << DMA_SxCR_EN);
+	while(pStream->CR & (1 << DMA_SxCR_EN));
+
+	//stale flags of a previous transfer would block the new one
+	DMA_ClearFlags(pDMAHandle, DMA_FLAG_ALL);
+
+	pStream->PAR = PeriphAddr;
+	pStream->M0AR = Mem0Addr;
+	if (pStream->CR & (1 << DMA_SxCR_DBM))
+	{
+		pStream->M1AR = Mem1Addr;
+		pStream->CR &= ~(1 << DMA_SxCR_CT);
+	}
+	pStream->NDTR = Len;
+
+	pStream->CR |= (1 << DMA_SxCR_EN);
+}
+
+/*********************************************************************
+ * @fn      		  - DMA_StopTransfer
+ *
+ * @brief             - disables the stream and waits until the ongoing beat completes
+ *
+ * @param[in]         - handle of the DMA stream
+ *
+ * @return            - none
+ */
+void DMA_StopTransfer(DMA_Handle_t *pDMAHandle)
+{
+	DMA_Stream_RegDef_t *pStream = &pDMAHandle->pDMAx->S[pDMAHandle->DMA_StreamNumber];
+
+	pStream->CR &= ~(1 << DMA_SxCR_EN);
+	while(pStream->CR & (1 << DMA_SxCR_EN));
+
+	DMA_ClearFlags(pDMAHandle, DMA_FLAG_ALL);
+}
+
+uint16_t DMA_GetDataCounter(DMA_Handle_t *pDMAHandle)
+{
+	return (uint16_t)pDMAHandle->pDMAx->S[pDMAHandle->DMA_StreamNumber].NDTR;
+}
+
+//returns 0 while the stream writes through M0AR and 1 while it writes through M1AR
+uint8_t DMA_GetCurrentTarget(DMA_Handle_t *pDMAHandle)
+{
+	return (pDMAHandle->pDMAx->S[pDMAHandle->DMA_StreamNumber].CR >> DMA_SxCR_CT) & 0x1;
+}
+
+/*********************************************************************
+ * @fn      		  - DMA_GetFlags
+ *
+ * @brief             - reads the status flags of one stream
+ *
+ * @param[in]         - handle of the DMA stream
+ *
+ * @return            - flags shifted down to the @DMA_FLAG positions
+ */
+uint8_t DMA_GetFlags(DMA_Handle_t *pDMAHandle)
+{
+	uint8_t stream = pDMAHandle->DMA_StreamNumber;
+	uint32_t isr;
+
+	isr = (stream < 4) ? pDMAHandle->pDMAx->LISR : pDMAHandle->pDMAx->HISR;
+
+	return (uint8_t)((isr >> dma_flag_offset[stream & 0x3]) & DMA_FLAG_ALL);
+}
+
+void DMA_ClearFlags(DMA_Handle_t *pDMAHandle, uint8_t Flags)
+{
+	uint8_t stream = pDMAHandle->DMA_StreamNumber;
+	uint32_t mask = (uint32_t)(Flags & DMA_FLAG_ALL) << dma_flag_offset[stream & 0x3];
+
+	//the clear registers are write 1 to clear, no read-modify-write
+	if (stream < 4)
+	{
+		pDMAHandle->pDMAx->LIFCR = mask;
+	}
+	else
+	{
+		pDMAHandle->pDMAx->HIFCR = mask;
+	}
+}
+
+/*
+ * IRQ Configuration
+ */
+//ISER/ICER are write 1 to set/clear, a plain write leaves the other IRQs of the word untouched
+void DMA_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
+{
+	if(EnorDi == ENABLE)
+	{
+		if(IRQNumber <= 31)
+		{
+			//program ISER0 register
+			*DRV_NVIC_ISER0 = ( 1 << IRQNumber );
+		}
+		else if(IRQNumber > 31 && IRQNumber < 64 )
+		{
+			//program ISER1 register
+			*DRV_NVIC_ISER1 = ( 1 << (IRQNumber % 32) );
+		}
+		else if(IRQNumber >= 64 && IRQNumber < 96 )
+		{
+			//program ISER2 register
+			*DRV_NVIC_ISER2 = ( 1 << (IRQNumber % 64) );
+		}
+	}
+	else
+	{
+		if(IRQNumber <= 31)
+		{
+			//program ICER0 register
+			*DRV_NVIC_ICER0 = ( 1 << IRQNumber );
+		}
+		else if(IRQNumber > 31 && IRQNumber < 64 )
+		{
+			//program ICER1 register
+			*DRV_NVIC_ICER1 = ( 1 << (IRQNumber % 32) );
+		}
+		else if(IRQNumber >= 64 && IRQNumber < 96 )
+		{
+			//program ICER2 register
+			*DRV_NVIC_ICER2 = ( 1 << (IRQNumber % 64) );
+		}
+	}
+}
+
+void DMA_IRQPriorityConfig(uint8_t IRQNumber, uint32_t IRQPriority)
+{
+	uint8_t iprx = IRQNumber / 4;
+	uint8_t iprx_section = IRQNumber % 4;
+
+	uint8_t shift_amount = (8 * iprx_section) + (8 - NO_PR_BITS_IMPLEMENTED);
+
+	*(DRV_NVIC_IPR_BASE_ADDR + iprx) |= (IRQPriority << shift_amount);
+}
@@ -0,0 +1,60 @@
+/*
+ * stm32f401xx_dwt_driver.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#include "stm32f401xx_dwt_driver.h"
+
+//HCLK cycles per microsecond, latched by DWT_CycleCounterInit
+static uint32_t dwt_cycles_per_us = DRV_HSI_VALUE / 1000000U;
+
+
+/*********************************************************************
+ * @fn      		  - DWT_CycleCounterInit
+ *
+ * @brief             - enables the cycle counter and latches the current HCLK
+ *
+ * @return            - none
+ *
+ * @Note              - call again after the system clock has been changed. The counter is
+ *                      not reset, so drivers can call this while other timeouts are running.
+ */
+void DWT_CycleCounterInit(void)
+{
+	*DRV_DEMCR |= (1 << DRV_DEMCR_TRCENA);
+	*DRV_DWT_CTRL |= (1 << DRV_DWT_CTRL_CYCCNTENA);
+
+	dwt_cycles_per_us = RCC_GetHCLKValue() / 1000000U;
+	if (dwt_cycles_per_us == 0)
+	{
+		dwt_cycles_per_us = 1;
+	}
+}
+
+uint32_t DWT_GetCycles(void)
+{
+	return *DRV_DWT_CYCCNT;
+}
+
+uint32_t DWT_UsToCycles(uint32_t Us)
+{
+	uint64_t cycles = (uint64_t)Us * dwt_cycles_per_us;
+
+	return (cycles > 0xFFFFFFFFULL) ? 0xFFFFFFFFU : (uint32_t)cycles;
+}
+
+uint32_t DWT_MsToCycles(uint32_t Ms)
+{
+	uint64_t cycles = (uint64_t)Ms * 1000U * dwt_cycles_per_us;
+
+	return (cycles > 0xFFFFFFFFULL) ? 0xFFFFFFFFU : (uint32_t)cycles;
+}
+
+//returns SET once Cycles have passed since Start, unsigned arithmetic handles the wrap
+uint8_t DWT_IsElapsed(uint32_t Start, uint32_t Cycles)
+{
+	if ((uint32_t)(*DRV_DWT_CYCCNT - Start) >= Cycles) return SET;
+	return RESET;
+}
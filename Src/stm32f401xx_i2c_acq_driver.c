@@ -0,0 +1,309 @@
+/*
+ * stm32f401xx_i2c_acq_driver.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#include "stm32f401xx_i2c_acq_driver.h"
+
+//the scheduler timer counts microseconds
+#define ACQ_TIMER_COUNTER_HZ		1000000U
+
+//orders the sample writes before the index update that publishes them
+#define ACQ_MEMORY_BARRIER()		__asm volatile ("dmb" ::: "memory")
+
+
+static void acq_push_sample(ACQ_Handle_t *pACQHandle, ACQ_Sensor_t *pSensor, uint8_t Id, uint8_t Status, uint32_t Now)
+{
+	uint32_t head = pACQHandle->RingHead;
+	ACQ_Sample_t *pSample;
+
+	if ((head - pACQHandle->RingTail) >= ACQ_RING_SIZE)
+	{
+		pACQHandle->RingDrops++;
+		return;
+	}
+
+	pSample = &pACQHandle->Ring[head & (ACQ_RING_SIZE - 1)];
+	pSample->Timestamp = Now;
+	pSample->Tick = pSensor->DueTick;
+	pSample->SensorId = Id;
+	pSample->Status = Status;
+	pSample->Len = pSensor->Len;
+	for (uint8_t i = 0; i < pSensor->Len; i++)
+	{
+		pSample->Data[i] = pSensor->Buf[i];
+	}
+
+	ACQ_MEMORY_BARRIER();
+	pACQHandle->RingHead = head + 1;
+}
+
+//completion of a burst read, runs in the I2C interrupt
+static void acq_txn_callback(I2C_Txn_t *pTxn, uint8_t AppEv)
+{
+	ACQ_Handle_t *pACQHandle = (ACQ_Handle_t *)pTxn->pContext;
+	ACQ_Sensor_t *pSensor = (ACQ_Sensor_t *)((uint8_t *)pTxn - offsetof(ACQ_Sensor_t, Txn));
+	ACQ_Stats_t *pStats = &pSensor->Stats;
+	uint32_t now = DWT_GetCycles();
+	uint32_t period = pSensor->PeriodTicks * pACQHandle->PeriodCycles;
+	uint32_t latency, interval, dev;
+
+	if (AppEv != I2C_EV_RX_CMPLT)
+	{
+		pStats->Errors++;
+		acq_push_sample(pACQHandle, pSensor, (uint8_t)(pSensor - pACQHandle->Sensors), ACQ_ERR_I2C, now);
+
+		//the next good sample is two periods away, it starts a new jitter baseline
+		pSensor->LastValid = RESET;
+		pSensor->InFlight = RESET;
+		return;
+	}
+
+	latency = now - pSensor->DueCycles;
+	if (pStats->Samples == 0)
+	{
+		pStats->LatencyMin = latency;
+		pStats->LatencyMax = latency;
+	}
+	else
+	{
+		if (latency < pStats->LatencyMin) pStats->LatencyMin = latency;
+		if (latency > pStats->LatencyMax) pStats->LatencyMax = latency;
+	}
+	if (pSensor->LastValid)
+	{
+		interval = now - pSensor->LastCycles;
+		dev = (interval > period) ? (interval - period) : (period - interval);
+		if (dev > pStats->JitterMax) pStats->JitterMax = dev;
+	}
+	pStats->LatencySum += latency;
+	if (latency > period)
+	{
+		pStats->Late++;
+	}
+	pStats->Samples++;
+	pSensor->LastCycles = now;
+
+	//a period skipped while this read ran leaves the next interval without a reference
+	pSensor->LastValid = ((pSensor->NextDue - pSensor->DueTick) == pSensor->PeriodTicks);
+
+	acq_push_sample(pACQHandle, pSensor, (uint8_t)(pSensor - pACQHandle->Sensors), ACQ_OK, now);
+	pSensor->InFlight = RESET;
+}
+
+
+/*********************************************************************
+ * @fn      		  - ACQ_Init
+ *
+ * @brief             - resets the engine and programs the scheduler timer
+ *
+ * @param[in]         - handle with pI2CHandle, pTIMHandle (pTIMx), TickHz and Prio filled in
+ *
+ * @return            - ACQ_OK, ACQ_ERR_PARAM or ACQ_ERR_TIMER
+ *
+ * @Note              - TickHz has to divide 1 MHz. The app enables the timer IRQ in the NVIC
+ *                      and calls ACQ_TimerIRQHandling from it. The I2C IRQ should have the
+ *                      same or a higher priority than the timer.
+ */
+uint8_t ACQ_Init(ACQ_Handle_t *pACQHandle)
+{
+	if ((pACQHandle->pI2CHandle->pQueue == NULL) || (pACQHandle->TickHz == 0)) return ACQ_ERR_PARAM;
+	if ((ACQ_TIMER_COUNTER_HZ % pACQHandle->TickHz) != 0) return ACQ_ERR_PARAM;
+
+	DWT_CycleCounterInit();
+
+	pACQHandle->SensorCount = 0;
+	pACQHandle->Tick = 0;
+	pACQHandle->RingHead = 0;
+	pACQHandle->RingTail = 0;
+	pACQHandle->RingDrops = 0;
+	pACQHandle->PeriodCycles = DWT_UsToCycles(ACQ_TIMER_COUNTER_HZ / pACQHandle->TickHz);
+
+	pACQHandle->pTIMHandle->TIMConfig.TIM_CounterHz = ACQ_TIMER_COUNTER_HZ;
+	pACQHandle->pTIMHandle->TIMConfig.TIM_Period = ACQ_TIMER_COUNTER_HZ / pACQHandle->TickHz;
+	if (TIM_Init(pACQHandle->pTIMHandle) != TIM_OK) return ACQ_ERR_TIMER;
+	TIM_UpdateITConfig(pACQHandle->pTIMHandle->pTIMx, ENABLE);
+
+	return ACQ_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - ACQ_AddSensor
+ *
+ * @brief             - registers a periodic burst read
+ *
+ * @param[in]         - acquisition handle
+ * @param[in]         - 7 bit slave address
+ * @param[in]         - first register of the burst
+ * @param[in]         - number of bytes, 1 to ACQ_MAX_READ_LEN
+ * @param[in]         - period in us, rounded to a whole number of ticks
+ * @param[out]        - sensor id, SensorId of its samples
+ *
+ * @return            - ACQ_OK, ACQ_ERR_PARAM or ACQ_ERR_FULL
+ *
+ * @Note              - every sensor is first due at the next tick, so sensors with periods that
+ *                      are multiples of each other stay aligned and share ticks
+ */
+uint8_t ACQ_AddSensor(ACQ_Handle_t *pACQHandle, uint8_t SlaveAddr, uint8_t Reg, uint8_t Len, uint32_t PeriodUs, uint8_t *pId)
+{
+	ACQ_Sensor_t *pSensor;
+	uint32_t ticks;
+
+	if ((Len == 0) || (Len > ACQ_MAX_READ_LEN)) return ACQ_ERR_PARAM;
+	if (pACQHandle->SensorCount >= ACQ_MAX_SENSORS) return ACQ_ERR_FULL;
+
+	ticks = (uint32_t)(((uint64_t)PeriodUs * pACQHandle->TickHz + (ACQ_TIMER_COUNTER_HZ / 2)) / ACQ_TIMER_COUNTER_HZ);
+	if (ticks == 0) return ACQ_ERR_PARAM;
+
+	pSensor = &pACQHandle->Sensors[pACQHandle->SensorCount];
+	pSensor->SlaveAddr = SlaveAddr;
+	pSensor->Reg = Reg;
+	pSensor->Len = Len;
+	pSensor->PeriodTicks = ticks;
+	pSensor->NextDue = pACQHandle->Tick + 1;
+	pSensor->LastValid = RESET;
+	pSensor->InFlight = RESET;
+	pSensor->Txn.Status = I2C_TXN_IDLE;
+
+	//register address write, repeated start, burst read
+	pSensor->Txn.SlaveAddr = SlaveAddr;
+	pSensor->Txn.pTxBuffer = &pSensor->Reg;
+	pSensor->Txn.TxLen = 1;
+	pSensor->Txn.pRxBuffer = pSensor->Buf;
+	pSensor->Txn.RxLen = Len;
+	pSensor->Txn.Sr = I2C_DISABLE_SR;
+	pSensor->Txn.Flags = 0;
+	pSensor->Txn.pCallback = acq_txn_callback;
+	pSensor->Txn.pContext = pACQHandle;
+
+	ACQ_ResetStats(pACQHandle, pACQHandle->SensorCount);
+	*pId = pACQHandle->SensorCount;
+
+	//the timer ISR only looks at sensors below SensorCount
+	ACQ_MEMORY_BARRIER();
+	pACQHandle->SensorCount++;
+
+	return ACQ_OK;
+}
+
+void ACQ_Start(ACQ_Handle_t *pACQHandle)
+{
+	TIM_Start(pACQHandle->pTIMHandle->pTIMx);
+}
+
+//stops the tick, reads already on the bus still complete into the ring
+void ACQ_Stop(ACQ_Handle_t *pACQHandle)
+{
+	TIM_Stop(pACQHandle->pTIMHandle->pTIMx);
+}
+
+/*********************************************************************
+ * @fn      		  - ACQ_TimerIRQHandling
+ *
+ * @brief             - scheduler tick, call it from the IRQ handler of the timer
+ *
+ * @param[in]         - acquisition handle
+ *
+ * @return            - none
+ *
+ * @Note              - all reads due at this tick are queued together, the I2C transaction
+ *                      queue then runs them back to back from the I2C interrupt without any
+ *                      further tick or thread involvement. A sensor whose previous read has
+ *                      not completed skips this period and counts it as missed.
+ */
+void ACQ_TimerIRQHandling(ACQ_Handle_t *pACQHandle)
+{
+	TIM_RegDef_t *pTIMx = pACQHandle->pTIMHandle->pTIMx;
+	ACQ_Sensor_t *pSensor;
+	uint32_t now = DWT_GetCycles();
+	uint32_t tick;
+
+	if (!TIM_GetFlagStatus(pTIMx, TIM_FLAG_UPDATE)) return;
+	TIM_ClearFlag(pTIMx, TIM_FLAG_UPDATE);
+
+	tick = pACQHandle->Tick + 1;
+	pACQHandle->Tick = tick;
+
+	//a queued start deferred behind a pending STOP is retried every tick
+	I2C_TxnProcess(pACQHandle->pI2CHandle);
+
+	for (uint8_t id = 0; id < pACQHandle->SensorCount; id++)
+	{
+		pSensor = &pACQHandle->Sensors[id];
+
+		if ((int32_t)(tick - pSensor->NextDue) < 0) continue;
+		pSensor->NextDue += pSensor->PeriodTicks;
+
+		if (pSensor->InFlight)
+		{
+			pSensor->Stats.Missed++;
+			continue;
+		}
+
+		pSensor->DueTick = tick;
+		pSensor->DueCycles = now;
+		pSensor->InFlight = SET;
+		if (I2C_TxnSubmit(pACQHandle->pI2CHandle, &pSensor->Txn, pACQHandle->Prio) != I2C_OK)
+		{
+			pSensor->InFlight = RESET;
+			pSensor->LastValid = RESET;
+			pSensor->Stats.Errors++;
+		}
+	}
+}
+
+/*********************************************************************
+ * @fn      		  - ACQ_ReadSample
+ *
+ * @brief             - takes the oldest sample out of the ring
+ *
+ * @param[in]         - acquisition handle
+ * @param[out]        - sample
+ *
+ * @return            - 1 if a sample was copied, 0 if the ring is empty
+ *
+ * @Note              - lock free, the I2C interrupt is the only producer and the caller must
+ *                      be the only consumer
+ */
+uint8_t ACQ_ReadSample(ACQ_Handle_t *pACQHandle, ACQ_Sample_t *pSample)
+{
+	uint32_t tail = pACQHandle->RingTail;
+
+	if (tail == pACQHandle->RingHead) return 0;
+
+	ACQ_MEMORY_BARRIER();
+	*pSample = pACQHandle->Ring[tail & (ACQ_RING_SIZE - 1)];
+	ACQ_MEMORY_BARRIER();
+	pACQHandle->RingTail = tail + 1;
+
+	return 1;
+}
+
+//consistent copy of the statistics of one sensor
+void ACQ_GetStats(ACQ_Handle_t *pACQHandle, uint8_t Id, ACQ_Stats_t *pStats)
+{
+	uint32_t primask;
+
+	DRV_ENTER_CRITICAL(primask);
+	*pStats = pACQHandle->Sensors[Id].Stats;
+	DRV_EXIT_CRITICAL(primask);
+}
+
+void ACQ_ResetStats(ACQ_Handle_t *pACQHandle, uint8_t Id)
+{
+	ACQ_Stats_t *pStats = &pACQHandle->Sensors[Id].Stats;
+	uint32_t primask;
+
+	DRV_ENTER_CRITICAL(primask);
+	pStats->Samples = 0;
+	pStats->Errors = 0;
+	pStats->Missed = 0;
+	pStats->Late = 0;
+	pStats->LatencyMin = 0;
+	pStats->LatencyMax = 0;
+	pStats->LatencySum = 0;
+	pStats->JitterMax = 0;
+	DRV_EXIT_CRITICAL(primask);
+}
@@ -8,10 +8,6 @@
 #include "stm32f401xx_i2c_driver.h"
 
 
-uint16_t AHB_PreScaler[9] = {2, 4, 8, 16, 32, 64, 128, 256, 512};
-uint16_t APB_PreScaler[4] = {2, 4, 8, 16};
-
-
 
 
 uint8_t I2CGetFlagStatus(I2C_RegDef_t *pI2C, uint32_t FlagSet)
@@ -39,29 +35,195 @@ static void I2C_ExecuteAddressPhaseWrite(I2C_RegDef_t *pI2Cx, uint8_t SlaveAddr)
 	pI2Cx->DR = SlaveAddr;
 }
 
+//the read phase uses DMA only from 2 bytes on, a single byte has to be NACKed before ADDR is cleared
+static uint8_t i2c_rx_uses_dma(I2C_Handle_t *pI2CHandle)
+{
+	return ((pI2CHandle->XferOpt & I2C_XFER_DMA) && (pI2CHandle->RxSize >= 2));
+}
+
+//NDTR is 16 bit, longer transfers are moved in chunks
+static void i2c_dma_tx_next(I2C_Handle_t *pI2CHandle)
+{
+	uint32_t chunk = (pI2CHandle->TxLen > 0xFFFF) ? 0xFFFF : pI2CHandle->TxLen;
+
+	DMA_StartTransfer(pI2CHandle->pTxDMA, (uint32_t)&pI2CHandle->pI2Cx->DR, (uint32_t)pI2CHandle->pTxBuffer, 0, (uint16_t)chunk);
+	pI2CHandle->pTxBuffer += chunk;
+	pI2CHandle->TxLen -= chunk;
+}
+
+static void i2c_dma_rx_next(I2C_Handle_t *pI2CHandle)
+{
+	uint32_t chunk = (pI2CHandle->RxLen > 0xFFFF) ? 0xFFFF : pI2CHandle->RxLen;
+
+	//a final chunk of one byte would be too late for LAST to NACK it
+	if ((pI2CHandle->RxLen - chunk) == 1)
+	{
+		chunk--;
+	}
+
+	//LAST makes the I2C NACK the byte ending the final chunk
+	if (chunk == pI2CHandle->RxLen)
+	{
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_LAST);
+	}
+
+	DMA_StartTransfer(pI2CHandle->pRxDMA, (uint32_t)&pI2CHandle->pI2Cx->DR, (uint32_t)pI2CHandle->pRxBuffer, 0, (uint16_t)chunk);
+	pI2CHandle->pRxBuffer += chunk;
+	pI2CHandle->RxLen -= chunk;
+}
+
+/*
+ * Register file, slave side. Everything runs from the event interrupt (or the TX stream for host
+ * reads), the application is only involved once per write transaction through I2C_EV_REG_WRITE.
+ */
+static void i2c_regfile_addr(I2C_Handle_t *pI2CHandle, uint32_t Tra)
+{
+	I2C_RegFile_t *pRF = pI2CHandle->pRegFile;
+
+	if (!Tra)
+	{
+		//host write, the first byte is the register address
+		pRF->AddrPhase = SET;
+		return;
+	}
+
+	pRF->AddrPhase = RESET;
+
+	if (pI2CHandle->pTxDMA != NULL)
+	{
+		//host read served by the stream up to the end of the file, TXE interrupts would race it
+		pRF->DmaStart = pRF->Ptr;
+		pRF->DmaLen = pRF->RegCount - pRF->Ptr;
+		pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_ITBUFEN);
+		DMA_StartTransfer(pI2CHandle->pTxDMA, (uint32_t)&pI2CHandle->pI2Cx->DR, (uint32_t)&pRF->pRegs[pRF->Ptr], 0, pRF->DmaLen);
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_DMAEN);
+	}
+}
+
+//host read byte request
+static void i2c_regfile_tx(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegFile_t *pRF = pI2CHandle->pRegFile;
+
+	pI2CHandle->pI2Cx->DR = pRF->pRegs[pRF->Ptr];
+	pRF->Ptr = (pRF->Ptr + 1) % pRF->RegCount;
+}
+
+//host write byte
+static void i2c_regfile_rx(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegFile_t *pRF = pI2CHandle->pRegFile;
+	uint8_t data = (uint8_t)pI2CHandle->pI2Cx->DR;
+	uint16_t reg;
+
+	if (pRF->AddrPhase)
+	{
+		pRF->AddrPhase = RESET;
+		pRF->Ptr = data % pRF->RegCount;
+		return;
+	}
+
+	reg = pRF->Ptr;
+	if ((pRF->pWritable != NULL) && (pRF->pWritable[reg >> 5] & (1UL << (reg & 31))))
+	{
+		pRF->pRegs[reg] = data;
+		if (pRF->pWriteMask != NULL)
+		{
+			pRF->pWriteMask[reg >> 5] |= (1UL << (reg & 31));
+		}
+		pRF->Written = SET;
+	}
+	else
+	{
+		pRF->RejectCount++;
+	}
+	pRF->Ptr = (reg + 1) % pRF->RegCount;
+}
+
+/*
+ * End of a host read (AF on the last byte). The byte loaded behind the NACKed one was never
+ * sent, step the pointer back over it so the next read continues at the right register.
+ */
+static void i2c_regfile_tx_end(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegFile_t *pRF = pI2CHandle->pRegFile;
+
+	if (pRF->DmaLen != 0)
+	{
+		DMA_StopTransfer(pI2CHandle->pTxDMA);
+		pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_DMAEN);
+		pRF->Ptr = (pRF->DmaStart + pRF->DmaLen - DMA_GetDataCounter(pI2CHandle->pTxDMA)) % pRF->RegCount;
+		pRF->DmaLen = 0;
+	}
+
+	pRF->Ptr = (pRF->Ptr + pRF->RegCount - 1) % pRF->RegCount;
+	pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITBUFEN);
+}
+
 static void I2C_ClearADDRFlag(I2C_Handle_t *pI2CHandle)
 {
 	uint32_t dummy_read;
 	//check device mode
-	if(pI2CHandle->pI2Cx->SR2 & (1 << I2C_SR2_MSL))
+	//reading SR2 already clears ADDR, an interrupt/DMA transfer is known to be master from its
+	//state so the N=1/N=2 and DMA set-up below still happens before ADDR is cleared
+	if((pI2CHandle->TxRxState == I2C_BUSY_IN_RX) || (pI2CHandle->TxRxState == I2C_BUSY_IN_TX)
+			|| (pI2CHandle->pI2Cx->SR2 & (1 << I2C_SR2_MSL)))
 	{
 		//device is in master mode
-		if(pI2CHandle->TxRxState == I2C_BUSY_IN_RX)
+		if((pI2CHandle->TxRxState == I2C_BUSY_IN_RX) && i2c_rx_uses_dma(pI2CHandle))
+		{
+			//the stream has to be armed before ADDR is cleared, the first byte follows right after
+			pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_ITBUFEN);
+			pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_DMAEN);
+			i2c_dma_rx_next(pI2CHandle);
+
+			dummy_read = pI2CHandle->pI2Cx->SR1;
+			dummy_read = pI2CHandle->pI2Cx->SR2;
+			(void)dummy_read;
+		}
+		else if(pI2CHandle->TxRxState == I2C_BUSY_IN_RX)
 		{
 			if (pI2CHandle->RxSize == 1)
 			{
 				//first disable teh ACK
 				I2C_ManageAcking(pI2CHandle->pI2Cx, DISABLE);
+			}
+			else if (pI2CHandle->RxSize == 2)
+			{
+				//NACK has to apply to the byte in the shift register, POS before ADDR is cleared
+				I2C_ManageAcking(pI2CHandle->pI2Cx, DISABLE);
+				pI2CHandle->pI2Cx->CR1 |= (1 << I2C_CR1_POS);
+			}
 
-				//clear ADDR flag
-				//read SR1 and SR2
-				dummy_read = pI2CHandle->pI2Cx->SR1;
-				dummy_read = pI2CHandle->pI2Cx->SR2;
-				(void)dummy_read;
+			//clear ADDR flag
+			//read SR1 and SR2
+			dummy_read = pI2CHandle->pI2Cx->SR1;
+			dummy_read = pI2CHandle->pI2Cx->SR2;
+			(void)dummy_read;
+
+			if (pI2CHandle->RxSize == 1)
+			{
+				//the single byte is NACKed, STOP goes out right after it
+				if(pI2CHandle->Sr == I2C_DISABLE_SR)
+				{
+					I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+				}
+			}
+			else if (pI2CHandle->RxSize <= 3)
+			{
+				//the last bytes are BTF driven, RXNE must not take them
+				pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_ITBUFEN);
 			}
 		}
 		else
 			{
+				if((pI2CHandle->TxRxState == I2C_BUSY_IN_TX) && (pI2CHandle->XferOpt & I2C_XFER_DMA)
+						&& (pI2CHandle->MemAddrLen == 0) && (pI2CHandle->TxLen > 0))
+				{
+					//no register address to send, the stream serves the very first TXE
+					pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_DMAEN);
+					i2c_dma_tx_next(pI2CHandle);
+				}
 
 				//clear ADDR flag
 				//read SR1 and SR2
@@ -77,7 +239,17 @@ static void I2C_ClearADDRFlag(I2C_Handle_t *pI2CHandle)
 		//clear ADDR flag
 		//read SR1 and SR2
 		dummy_read = pI2CHandle->pI2Cx->SR1;
+		if ((dummy_read & I2C_SMBALERT_FLAG) && (pI2CHandle->I2CConfig.I2C_Mode == I2C_MODE_SMBUS_DEVICE))
+		{
+			//alert response address, the TXE handler answers with our address
+			pI2CHandle->SMBAlertAck = SET;
+		}
 		dummy_read = pI2CHandle->pI2Cx->SR2;
+
+		if ((pI2CHandle->pRegFile != NULL) && !pI2CHandle->SMBAlertAck)
+		{
+			i2c_regfile_addr(pI2CHandle, dummy_read & (1 << I2C_SR2_TRA));
+		}
 		(void)dummy_read;
 
 	}
@@ -110,10 +282,15 @@ void I2C_CloseRecieveData(I2C_Handle_t *pI2CHandle)
 	//disable ITEVFEN control bit
 	pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_ITEVTEN);
 
+	pI2CHandle->pI2Cx->CR2 &= ~((1 << I2C_CR2_DMAEN) | (1 << I2C_CR2_LAST));
+	pI2CHandle->XferOpt = 0;
+	pI2CHandle->MemAddrLen = 0;
+
 	pI2CHandle->TxRxState = I2C_READY;
 	pI2CHandle->pRxBuffer = NULL;
 	pI2CHandle->RxLen = 0;
 	pI2CHandle->RxSize = 0;
+	pI2CHandle->pI2Cx->CR1 &= ~(1 << I2C_CR1_POS);
 	if (pI2CHandle->I2CConfig.I2C_ACKControl == I2C_ACK_ENABLE)
 	{
 		I2C_ManageAcking(pI2CHandle->pI2Cx, ENABLE);
@@ -128,6 +305,10 @@ void I2C_CloseSendData(I2C_Handle_t *pI2CHandle)
 	//disable ITEVFEN control bit
 	pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_ITEVTEN);
 
+	pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_DMAEN);
+	pI2CHandle->XferOpt = 0;
+	pI2CHandle->MemAddrLen = 0;
+
 	pI2CHandle->TxRxState = I2C_READY;
 	pI2CHandle->pTxBuffer = NULL;
 	pI2CHandle->TxLen = 0;
@@ -180,297 +361,575 @@ void I2C_PeriClockControl(I2C_RegDef_t *pI2Cx, uint8_t EnorDi)
 
 }
 
-uint32_t RCC_GetPLLOutputClock()
-{
-  return 0;
-}
-
+//I2C bus timing limits (UM10204), in ns
+#define I2C_SM_TLOW_MIN_NS		4700
+#define I2C_SM_THIGH_MIN_NS		4000
+#define I2C_SM_TR_MAX_NS		1000
+#define I2C_FM_TLOW_MIN_NS		1300
+#define I2C_FM_THIGH_MIN_NS		600
+#define I2C_FM_TR_MAX_NS		300
 
+//CR2.FREQ range in MHz, fast mode needs at least 4 MHz
+#define I2C_FREQ_MIN_MHZ		2
+#define I2C_FREQ_MIN_FM_MHZ		4
+#define I2C_FREQ_MAX_MHZ		50
 
-uint32_t RCC_GetPCLK1Value(void)
+/*
+ * Computes CCR for one duty setting. LowMul/HighMul are the number of CCR periods in
+ * tLOW/tHIGH (1/1 standard, 2/1 duty 2, 16/9 duty 16/9). CCR is rounded up so SCL never
+ * exceeds the request. Returns the achieved SCL, 0 if CCR is out of range.
+ */
+static uint32_t i2c_solve_ccr(uint32_t PCLK1, uint32_t SCLSpeed, uint32_t LowMul, uint32_t HighMul,
+		uint32_t CCRMin, uint32_t *pCCR)
 {
-	uint32_t pclk1, SystemClk, temp;
-	uint8_t clksrc, ahbp, apb1p;
-
-	clksrc =((DRV_RCC->CFGR >> 2) & 0x3);
+	uint32_t div = (LowMul + HighMul) * SCLSpeed;
+	uint32_t ccr = (PCLK1 + div - 1) / div;
 
-	if(clksrc == 0)
-	{
-		SystemClk = 16000000;
-	}
-	else if(clksrc == 1)
-	{
-		SystemClk = 8000000;
-	}
-	else if(clksrc == 2)
+	if (ccr < CCRMin)
 	{
-		SystemClk = RCC_GetPLLOutputClock();
+		ccr = CCRMin;
 	}
+	if (ccr > 0xFFF) return 0;
 
-	//for ahb
-	temp = ((DRV_RCC->CFGR >> 4) & 0xF);
+	*pCCR = ccr;
+	return PCLK1 / ((LowMul + HighMul) * ccr);
+}
+
+/*********************************************************************
+ * @fn      		  - I2C_ComputeTiming
+ *
+ * @brief             - computes CCR and TRISE for the requested SCL speed
+ *
+ * @param[in]         - PCLK1 in Hz
+ * @param[in]         - requested SCL in Hz, up to I2C_SCL_SPEED_FM
+ * @param[in]         - @I2C_FMDutyCycle, ignored in standard mode
+ * @param[out]        - value for the CCR register (F/S, DUTY and CCR fields)
+ * @param[out]        - value for the TRISE register
+ * @param[out]        - achieved SCL in Hz, never above the request (rise/fall times add to it)
+ * @param[out]        - smaller of the tLOW and tHIGH slacks over the spec minimums, in ns
+ *
+ * @return            - I2C_OK or I2C_ERR_TIMING
+ *
+ * @Note              - The minimum CCR is 4, except for duty 16/9 where it is 1. With
+ *                      I2C_FM_DUTY_AUTO the duty giving the SCL closest to the request is
+ *                      used, duty 2 wins a tie. Combinations that break the spec minimums or
+ *                      the CR2.FREQ range return I2C_ERR_TIMING.
+ */
+uint8_t I2C_ComputeTiming(uint32_t PCLK1, uint32_t SCLSpeed, uint8_t DutyCycle, uint32_t *pCCR,
+		uint32_t *pTRISE, uint32_t *pAchievedSCL, int32_t *pRiseMarginNs)
+{
+	uint32_t freq_mhz = PCLK1 / 1000000U;
+	uint32_t ccr = 0, ccr169 = 0, scl, scl169;
+	uint32_t low_mul, high_mul, tlow_min, thigh_min, tr_max;
+	uint64_t tlow, thigh;
+	int32_t margin;
 
-	if(temp < 8)
+	if ((SCLSpeed == 0) || (SCLSpeed > I2C_SCL_SPEED_FM)) return I2C_ERR_TIMING;
+	if ((freq_mhz < I2C_FREQ_MIN_MHZ) || (freq_mhz > I2C_FREQ_MAX_MHZ)) return I2C_ERR_TIMING;
+
+	if (SCLSpeed <= I2C_SCL_SPEED_SM)
 	{
-		ahbp = 1;
+		//standard mode
+		low_mul = 1;
+		high_mul = 1;
+		scl = i2c_solve_ccr(PCLK1, SCLSpeed, 1, 1, 4, &ccr);
+		if (scl == 0) return I2C_ERR_TIMING;
+
+		*pCCR = ccr;
+		tlow_min = I2C_SM_TLOW_MIN_NS;
+		thigh_min = I2C_SM_THIGH_MIN_NS;
+		tr_max = I2C_SM_TR_MAX_NS;
 	}
 	else
 	{
-	  ahbp = AHB_PreScaler[temp - 8];
-	}
+		//fast mode
+		if (freq_mhz < I2C_FREQ_MIN_FM_MHZ) return I2C_ERR_TIMING;
 
-	//for apb1
-	temp = ((DRV_RCC->CFGR >> 10) & 0x7);
+		scl = 0;
+		scl169 = 0;
+		if (DutyCycle != I2C_FM_DUTY_16_9)
+		{
+			scl = i2c_solve_ccr(PCLK1, SCLSpeed, 2, 1, 4, &ccr);
+		}
+		if (DutyCycle != I2C_FM_DUTY_2)
+		{
+			scl169 = i2c_solve_ccr(PCLK1, SCLSpeed, 16, 9, 1, &ccr169);
+		}
 
-	if(temp < 4)
-	{
-		apb1p = 1;
+		if (scl169 > scl)
+		{
+			scl = scl169;
+			ccr = ccr169;
+			low_mul = 16;
+			high_mul = 9;
+			*pCCR = (1 << I2C_CCR_FS) | (1 << I2C_CCR_DUTY) | ccr;
+		}
+		else
+		{
+			if (scl == 0) return I2C_ERR_TIMING;
+			low_mul = 2;
+			high_mul = 1;
+			*pCCR = (1 << I2C_CCR_FS) | ccr;
+		}
+		tlow_min = I2C_FM_TLOW_MIN_NS;
+		thigh_min = I2C_FM_THIGH_MIN_NS;
+		tr_max = I2C_FM_TR_MAX_NS;
 	}
-	else
+
+	tlow = ((uint64_t)low_mul * ccr * 1000000000ULL) / PCLK1;
+	thigh = ((uint64_t)high_mul * ccr * 1000000000ULL) / PCLK1;
+	margin = (int32_t)tlow - (int32_t)tlow_min;
+	if (((int32_t)thigh - (int32_t)thigh_min) < margin)
 	{
-		apb1p = APB_PreScaler[temp - 4];
+		margin = (int32_t)thigh - (int32_t)thigh_min;
 	}
+	if (margin < 0) return I2C_ERR_TIMING;
 
-	pclk1 = (SystemClk - ahbp)/apb1p;
+	//TRISE is the maximum rise time in PCLK1 periods plus one
+	*pTRISE = ((freq_mhz * tr_max) / 1000U) + 1;
+	*pAchievedSCL = scl;
+	*pRiseMarginNs = margin;
 
-	return pclk1;
+	return I2C_OK;
 }
 
-uint32_t RCC_GetPCLK2Value(void)
+//Init and De-Init of I2C
+/*********************************************************************
+ * @fn      		  - I2C_Init
+ *
+ * @brief             - configures ACK, CR2.FREQ, the own address and the SCL timing
+ *
+ * @param[in]         - I2C handle
+ *
+ * @return            - I2C_OK or I2C_ERR_TIMING, the timing registers are left untouched on error
+ *
+ * @Note              - the achieved SCL and the rise time margin are stored in the handle
+ */
+uint8_t I2C_Init(I2C_Handle_t *pI2CHandle)
 {
-	uint32_t pclk2, SystemClk, temp;
-	uint8_t clksrc, ahbp, apb2p;
+	uint32_t pclk1 = RCC_GetPCLK1Value();
+	uint32_t tempreg = 0, ccr, trise;
+	uint8_t status;
 
-	clksrc =((DRV_RCC->CFGR >> 2) & 0x3);
+	I2C_PeriClockControl(pI2CHandle->pI2Cx, ENABLE);
 
-	if(clksrc == 0)
-	{
-		SystemClk = 16000000;
-	}
-	else if(clksrc == 1)
+	//no transaction queue until I2C_TxnQueueInit is called
+	pI2CHandle->pQueue = NULL;
+	pI2CHandle->pRegFile = NULL;
+
+	//time base of the blocking timeouts and the bus recovery
+	DWT_CycleCounterInit();
+
+	pI2CHandle->PecErrCount = 0;
+	pI2CHandle->SMBAlertAck = RESET;
+	pI2CHandle->RecoveryPending = RESET;
+
+	tempreg |= pI2CHandle->I2CConfig.I2C_ACKControl << I2C_CR1_ACK;
+
+	//SMBus mode, SMBTYPE selects host or device, PEC is computed over every byte by the hardware
+	if (pI2CHandle->I2CConfig.I2C_Mode != I2C_MODE_I2C)
 	{
-		SystemClk = 8000000;
+		tempreg |= (1 << I2C_CR1_SMBUS);
+		if (pI2CHandle->I2CConfig.I2C_Mode == I2C_MODE_SMBUS_HOST)
+		{
+			tempreg |= (1 << I2C_CR1_SMBTYPE);
+		}
+		if (pI2CHandle->I2CConfig.I2C_PEC == ENABLE)
+		{
+			tempreg |= (1 << I2C_CR1_ENPEC);
+		}
 	}
-	else if(clksrc == 2)
+	pI2CHandle->pI2Cx->CR1 = tempreg;
+
+	//configure the FREQ field of CR2
+	tempreg = pI2CHandle->pI2Cx->CR2 & ~(0x3F << I2C_CR2_FREQ);
+	tempreg |= ((pclk1 / 1000000U) & 0x3F) << I2C_CR2_FREQ;
+	pI2CHandle->pI2Cx->CR2 = tempreg;
+
+	//we program the devices own address, bit 14 has to be kept at 1
+	tempreg = (uint32_t)pI2CHandle->I2CConfig.I2C_DeviceAddress << 1;
+	tempreg |= (1 << 14);
+	pI2CHandle->pI2Cx->OAR1 = tempreg;
+
+	//CCR and TRISE calculations
+	status = I2C_ComputeTiming(pclk1, pI2CHandle->I2CConfig.I2C_SCLSpeed, pI2CHandle->I2CConfig.I2C_FMDutyCycle,
+			&ccr, &trise, &pI2CHandle->AchievedSCL, &pI2CHandle->RiseMarginNs);
+	if (status != I2C_OK)
 	{
-		SystemClk = RCC_GetPLLOutputClock();
+		pI2CHandle->AchievedSCL = 0;
+		pI2CHandle->RiseMarginNs = 0;
+		return status;
 	}
 
-	//for ahb
-	temp = ((DRV_RCC->CFGR >> 4) & 0xF);
+	pI2CHandle->pI2Cx->CCR = ccr;
+	pI2CHandle->pI2Cx->TRISE = (trise & 0x3F);
 
-	if(temp < 8)
-	{
-		ahbp = 1;
-	}
-	else
+	return I2C_OK;
+}
+void I2C_DeInit(I2C_RegDef_t *pI2Cx);
+
+
+//bound of a blocking wait, SMBus allows clock stretching up to tTIMEOUT
+static uint32_t i2c_timeout_cycles(I2C_Handle_t *pI2CHandle)
+{
+	if (pI2CHandle->TimeoutUs) return DWT_UsToCycles(pI2CHandle->TimeoutUs);
+	if (pI2CHandle->I2CConfig.I2C_Mode != I2C_MODE_I2C) return DWT_UsToCycles(I2C_SMBUS_TIMEOUT_US);
+	return DWT_UsToCycles(I2C_DEFAULT_TIMEOUT_US);
+}
+
+/*
+ * Waits for an SR1 flag within TimeoutUs. AF, BERR and ARLO end the wait at once, the
+ * flag would never come. In SMBus mode so does the hardware 25 ms SCL low TIMEOUT.
+ */
+static uint8_t i2c_wait_flag(I2C_Handle_t *pI2CHandle, uint32_t Flag)
+{
+	uint32_t start = DWT_GetCycles();
+	uint32_t budget = i2c_timeout_cycles(pI2CHandle);
+	uint32_t sr1;
+
+	while(1)
 	{
-	  ahbp = AHB_PreScaler[temp - 8];
+		sr1 = pI2CHandle->pI2Cx->SR1;
+		if (sr1 & Flag) return I2C_OK;
+		if (sr1 & I2C_AF_FLAG) return I2C_ERR_NACK;
+		if (sr1 & (I2C_BERR_FLAG | I2C_ARLO_FLAG)) return I2C_ERR_BUS;
+		if ((sr1 & I2C_TIMEOUT_FLAG) || DWT_IsElapsed(start, budget)) return I2C_ERR_TIMEOUT;
 	}
+}
 
-	//for apb2
-	temp = ((DRV_RCC->CFGR >> 13) & 0x7);
+//the bus has to be free before a blocking transfer generates its START, a recovery left by
+//the error interrupt runs first
+static uint8_t i2c_wait_bus_free(I2C_Handle_t *pI2CHandle)
+{
+	uint32_t start;
+	uint32_t budget = i2c_timeout_cycles(pI2CHandle);
 
-	if(temp < 4)
+	if (pI2CHandle->RecoveryPending)
 	{
-		apb2p = 1;
+		uint8_t status = I2C_BusRecover(pI2CHandle);
+		if (status != I2C_OK) return status;
 	}
-	else
+
+	start = DWT_GetCycles();
+
+	while(pI2CHandle->pI2Cx->SR2 & (1 << I2C_SR2_BUSY))
 	{
-		apb2p = APB_PreScaler[temp - 4];
+		if (DWT_IsElapsed(start, budget)) return I2C_ERR_TIMEOUT;
 	}
 
-	pclk2 = (SystemClk - ahbp)/apb2p;
-
-	return pclk2;
+	return I2C_OK;
 }
 
-//Init and De-Init of I2C
-void I2C_Init(I2C_Handle_t *pI2CHandle)
+/*
+ * Common exit of a failed blocking transfer. A NACK only needs a STOP, a timeout or a bus
+ * error runs the bus recovery. The handle is left ready for the next transfer.
+ */
+static uint8_t i2c_blocking_fail(I2C_Handle_t *pI2CHandle, uint8_t Status)
 {
-	uint32_t tempreg = 0;
-
-	tempreg |= pI2CHandle->I2CConfig.I2C_ACKControl << 10;
-	pI2CHandle->pI2Cx->CR1 = tempreg;
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
 
-	//configure the FREQ field of CR2
-	tempreg |= 0;
-	tempreg |= RCC_GetPCLK1Value() / 1000000U;
-	pI2CHandle->pI2Cx->CR2 |= (tempreg & 0x3F);
-
-	//we program the devices own address
-	tempreg |= pI2CHandle->I2CConfig.I2C_DeviceAddress << 1;
-	tempreg |= ( 1 << 14);
-	pI2CHandle->pI2Cx->OAR1 |= tempreg;
-
-	//CCR calculations
-	uint16_t ccr_value = 0;
-	tempreg = 0;
-	if (pI2CHandle->I2CConfig.I2C_SCLSpeed <= I2C_SCL_SPEED_SM)
+	if (Status == I2C_ERR_NACK)
 	{
-		//standard mode
-		ccr_value = RCC_GetPCLK1Value()/(2 * pI2CHandle->I2CConfig.I2C_SCLSpeed);
-		tempreg |= (ccr_value & 0xFFF);
+		pI2CHandle->ErrCount.AckFail++;
+		I2C_GenerateStopCondition(pI2Cx);
+		pI2Cx->SR1 &= ~(1 << I2C_SR1_AF);
 	}
 	else
 	{
-		//fast mode
-		tempreg |= (1 << 15);
-		tempreg |= (pI2CHandle->I2CConfig.I2C_FMDutyCycle << 14);
-		if (pI2CHandle->I2CConfig.I2C_FMDutyCycle == I2C_FM_DUTY_9)
-		{
-			ccr_value = RCC_GetPCLK1Value()/(3 * pI2CHandle->I2CConfig.I2C_SCLSpeed);
-		}
-		else
+		if (Status == I2C_ERR_TIMEOUT)
 		{
-			ccr_value = RCC_GetPCLK1Value()/(25 * pI2CHandle->I2CConfig.I2C_SCLSpeed);
+			pI2CHandle->ErrCount.Timeout++;
 		}
-		ccr_value |= (ccr_value & 0xFFF);
-	}
-	pI2CHandle->pI2Cx->CCR = tempreg;
-
-	//TRISE configuration
-	if (pI2CHandle->I2CConfig.I2C_SCLSpeed <= I2C_SCL_SPEED_SM)
+		else if (pI2Cx->SR1 & I2C_ARLO_FLAG)
 		{
-			//standard mode
-
-			tempreg = (RCC_GetPCLK1Value()/1000000U) + 1;
+			pI2CHandle->ErrCount.ArbLost++;
 		}
 		else
 		{
-			//fast mode
-			tempreg = ((RCC_GetPCLK1Value()*300)/1000000000U) + 1;
+			pI2CHandle->ErrCount.BusErr++;
 		}
-	pI2CHandle->pI2Cx->TRISE = (tempreg & 0x3F);
+		I2C_BusRecover(pI2CHandle);
+	}
 
-}
-void I2C_DeInit(I2C_RegDef_t *pI2Cx);
+	pI2Cx->CR1 &= ~(1 << I2C_CR1_POS);
+	if(pI2CHandle->I2CConfig.I2C_ACKControl == I2C_ACK_ENABLE)
+	{
+		I2C_ManageAcking(pI2Cx, I2C_ACK_ENABLE);
+	}
 
+	return Status;
+}
 
-void I2C_MasterSendData(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint8_t Len, uint8_t SlaveAddr, uint8_t Sr)
+/*
+ * Blocking write phase: address, optional register address bytes, then the data.
+ * With I2C_ENABLE_SR it returns with BTF set and SCL stretched, ready for a repeated start.
+ */
+static uint8_t i2c_master_write(I2C_Handle_t *pI2CHandle, uint8_t *pHdr, uint8_t HdrLen, uint8_t *pTxBuffer, uint32_t Len, uint8_t SlaveAddr, uint8_t Sr)
 {
+	uint8_t status;
+
+	//a repeated start is issued while we still own the bus
+	if (!(pI2CHandle->pI2Cx->SR2 & (1 << I2C_SR2_MSL)))
+	{
+		status = i2c_wait_bus_free(pI2CHandle);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+	}
+
 	//generate the start condition
 	I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
 
 	//Confirm the start generation is completed by checking the SB flag
 	//in SR1
-	while(!I2CGetFlagStatus(pI2CHandle->pI2Cx, I2C_SB_FLAG));
+	status = i2c_wait_flag(pI2CHandle, I2C_SB_FLAG);
+	if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
 
 	//Send the address of the slave
 	I2C_ExecuteAddressPhaseWrite(pI2CHandle->pI2Cx, SlaveAddr);
 
 	//Confirm the address phase is completed by checking the ADDR flag in SR1
-	while(!I2CGetFlagStatus(pI2CHandle->pI2Cx, I2C_ADDR_FLAG));
+	status = i2c_wait_flag(pI2CHandle, I2C_ADDR_FLAG);
+	if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
 
 	//Clear the ADDR flag according to its software sequence
 	I2C_ClearADDRFlag(pI2CHandle);
 
+	//Send the register address first
+	while(HdrLen > 0)
+	{
+		status = i2c_wait_flag(pI2CHandle, I2C_TXE_FLAG);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+		pI2CHandle->pI2Cx->DR = *pHdr;
+		pHdr++;
+		HdrLen--;
+	}
+
 	//Send data until the Len = 0
 	while(Len > 0)
 	{
-		while(!I2CGetFlagStatus(pI2CHandle->pI2Cx, I2C_TXE_FLAG)); //wait until TXE is set
+		//wait until TXE is set
+		status = i2c_wait_flag(pI2CHandle, I2C_TXE_FLAG);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
 		pI2CHandle->pI2Cx->DR = *pTxBuffer;
 		pTxBuffer++;
 		Len--;
 	}
 
 	//We wait until TXE = 1 and BTF = 1
-	while(!I2CGetFlagStatus(pI2CHandle->pI2Cx, I2C_TXE_FLAG));
+	status = i2c_wait_flag(pI2CHandle, I2C_TXE_FLAG);
+	if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+
+	//SMBus: the PEC byte follows the last byte of a write transaction, BTF comes after it
+	if ((Sr == I2C_DISABLE_SR) && (pI2CHandle->pI2Cx->CR1 & (1 << I2C_CR1_ENPEC)))
+	{
+		pI2CHandle->pI2Cx->CR1 |= (1 << I2C_CR1_PEC);
+	}
 
-	while(!I2CGetFlagStatus(pI2CHandle->pI2Cx, I2C_BTF_FLAG));
+	status = i2c_wait_flag(pI2CHandle, I2C_BTF_FLAG);
+	if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
 
-	//Send the STOP condition
-	if(Sr == I2C_ENABLE_SR)
+	//Send the STOP condition, unless a repeated start follows
+	if(Sr == I2C_DISABLE_SR)
 	{
 		I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
 	}
 
+	return I2C_OK;
+}
+
+//returns I2C_OK, I2C_ERR_NACK, I2C_ERR_TIMEOUT or I2C_ERR_BUS, the bus is recovered on the last two
+uint8_t I2C_MasterSendData(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t Len, uint8_t SlaveAddr, uint8_t Sr)
+{
+	return i2c_master_write(pI2CHandle, NULL, 0, pTxBuffer, Len, SlaveAddr, Sr);
+}
+
+/*********************************************************************
+ * @fn      		  - I2C_MasterProbe
+ *
+ * @brief             - checks whether a slave acknowledges its address (START, address, STOP)
+ *
+ * @param[in]         - I2C handle
+ * @param[in]         - 7 bit slave address
+ *
+ * @return            - I2C_OK (ACK), I2C_ERR_NACK, I2C_ERR_TIMEOUT or I2C_ERR_BUS
+ *
+ * @Note              - used for device detection and for ACK polling of memories in their
+ *                      write cycle, a NACK is expected there and is not counted in ErrCount
+ */
+uint8_t I2C_MasterProbe(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint8_t status;
+
+	status = i2c_wait_bus_free(pI2CHandle);
+	if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+
+	I2C_GenerateStartCondition(pI2Cx);
+
+	status = i2c_wait_flag(pI2CHandle, I2C_SB_FLAG);
+	if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+
+	I2C_ExecuteAddressPhaseWrite(pI2Cx, SlaveAddr);
+
+	status = i2c_wait_flag(pI2CHandle, I2C_ADDR_FLAG);
+	if (status == I2C_ERR_NACK)
+	{
+		I2C_GenerateStopCondition(pI2Cx);
+		pI2Cx->SR1 &= ~(1 << I2C_SR1_AF);
+		return I2C_ERR_NACK;
+	}
+	if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+
+	I2C_ClearADDRFlag(pI2CHandle);
+	I2C_GenerateStopCondition(pI2Cx);
+
+	return I2C_OK;
 }
 
-void I2C_MasterRecieveData(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint8_t Len, uint8_t SlaveAddr, uint8_t Sr)
+/*********************************************************************
+ * @fn      		  - I2C_MasterRecieveData
+ *
+ * @brief             - blocking master reception with the reference manual sequences
+ *
+ * @param[in]         - I2C handle
+ * @param[in]         - destination buffer
+ * @param[in]         - number of bytes
+ * @param[in]         - 7 bit slave address
+ * @param[in]         - I2C_ENABLE_SR to skip the STOP (a repeated start follows)
+ *
+ * @return            - I2C_OK, I2C_ERR_NACK, I2C_ERR_TIMEOUT or I2C_ERR_BUS
+ *
+ * @Note              - N=1: NACK and STOP are set around the ADDR clear.
+ *                      N=2: POS makes the NACK apply to the second byte, both bytes are read
+ *                      after BTF. N>2: bytes are read on RXNE until three are left, the last
+ *                      three are BTF gated so ACK/STOP are changed while SCL is stretched and
+ *                      no extra byte is clocked.
+ *                      Every wait is bounded by TimeoutUs, a timeout or bus error recovers the bus.
+ */
+uint8_t I2C_MasterRecieveData(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint32_t Len, uint8_t SlaveAddr, uint8_t Sr)
 {
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint8_t status;
+
+	if (Len == 0) return I2C_OK;
+
+	if (!(pI2Cx->SR2 & (1 << I2C_SR2_MSL)))
+	{
+		status = i2c_wait_bus_free(pI2CHandle);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+	}
+
 	//Generate the start condition
-	I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+	I2C_GenerateStartCondition(pI2Cx);
 
 	//confirm that start generation is completed by checking the SB flag in the SRI
 	//NOTE: until SB is cleared, SCL will be stretched
-	while(!I2CGetFlagStatus(pI2CHandle->pI2Cx, I2C_SB_FLAG));
+	status = i2c_wait_flag(pI2CHandle, I2C_SB_FLAG);
+	if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
 
 	//send the address of the slave with r/nw bit set to R(1) (total 8 bits)
-	I2C_ExecuteAddressPhaseRead(pI2CHandle->pI2Cx, SlaveAddr);
+	I2C_ExecuteAddressPhaseRead(pI2Cx, SlaveAddr);
 
 	//wait until address phase is completed by checking ADDR flag in SR1
-	while(!I2CGetFlagStatus(pI2CHandle->pI2Cx, I2C_ADDR_FLAG));
+	status = i2c_wait_flag(pI2CHandle, I2C_ADDR_FLAG);
+	if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
 
 	//procedure to read only 1 byte from slave
 	if (Len == 1)
 	{
 		//Disable Acking
-		I2C_ManageAcking(pI2CHandle->pI2Cx, I2C_ACK_DISABLE);
-
+		I2C_ManageAcking(pI2Cx, I2C_ACK_DISABLE);
 
 		//clear the ADDR flag
 		I2C_ClearADDRFlag(pI2CHandle);
 
-		//wait until RXNE becomes 1
-		while(!I2CGetFlagStatus(pI2CHandle->pI2Cx, I2C_RXNE_FLAG)); //wait until RXNE is set
-
 		//Generate STOP condition
 		if(Sr == I2C_DISABLE_SR)
-			{
-				I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
-			}
-
+		{
+			I2C_GenerateStopCondition(pI2Cx);
+		}
 
+		//wait until RXNE becomes 1
+		status = i2c_wait_flag(pI2CHandle, I2C_RXNE_FLAG);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
 
 		//read data into buffer
-		*pRxBuffer = pI2CHandle->pI2Cx->DR;
+		*pRxBuffer = pI2Cx->DR;
 	}
-	//procedure to read more than byte from slave
-	if (Len > 1)
-		{
+	//procedure to read 2 bytes from slave
+	else if (Len == 2)
+	{
+		I2C_ManageAcking(pI2Cx, I2C_ACK_DISABLE);
+		pI2Cx->CR1 |= (1 << I2C_CR1_POS);
 
-			//clear the ADDR flag
-			I2C_ClearADDRFlag(pI2CHandle);
+		I2C_ClearADDRFlag(pI2CHandle);
 
-			//Read the data until Len becomes zero
-			for(uint32_t i = Len; i > 0; i++)
-			{
+		//data 1 in DR, data 2 in the shift register
+		status = i2c_wait_flag(pI2CHandle, I2C_BTF_FLAG);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
 
-				//wait until RXNE becomes 1
-				while(!I2CGetFlagStatus(pI2CHandle->pI2Cx, I2C_RXNE_FLAG)); //wait until RXNE is set
+		if(Sr == I2C_DISABLE_SR)
+		{
+			I2C_GenerateStopCondition(pI2Cx);
+		}
 
-				if (i == 2)
-				{
-					//clear the ACK bit
-					I2C_ManageAcking(pI2CHandle->pI2Cx, I2C_ACK_DISABLE);
+		pRxBuffer[0] = pI2Cx->DR;
+		pRxBuffer[1] = pI2Cx->DR;
 
-					//generate stop condition
-					if(Sr == I2C_DISABLE_SR)
-						{
-							I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
-						}
+		pI2Cx->CR1 &= ~(1 << I2C_CR1_POS);
+	}
+	//procedure to read more than 2 bytes from slave
+	else
+	{
+		I2C_ManageAcking(pI2Cx, I2C_ACK_ENABLE);
 
-				}
+		//clear the ADDR flag
+		I2C_ClearADDRFlag(pI2CHandle);
 
+		//Read the data until three bytes are left
+		while(Len > 3)
+		{
+			//wait until RXNE becomes 1
+			status = i2c_wait_flag(pI2CHandle, I2C_RXNE_FLAG);
+			if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
 
-				//read data into buffer
-				*pRxBuffer = pI2CHandle->pI2Cx->DR;
+			*pRxBuffer++ = pI2Cx->DR;
+			Len--;
+		}
 
-				pRxBuffer++;
+		//data N-2 in DR, data N-1 in the shift register
+		status = i2c_wait_flag(pI2CHandle, I2C_BTF_FLAG);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
 
-			}
+		//data N will be NACKed
+		I2C_ManageAcking(pI2Cx, I2C_ACK_DISABLE);
+		*pRxBuffer++ = pI2Cx->DR;
 
-		}
+		//data N-1 in DR, data N in the shift register
+		status = i2c_wait_flag(pI2CHandle, I2C_BTF_FLAG);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
 
-	if(pI2CHandle->I2CConfig.I2C_ACKControl == I2C_ACK_ENABLE)
-	{
-		I2C_ManageAcking(pI2CHandle->pI2Cx, I2C_ACK_DISABLE);
+		if(Sr == I2C_DISABLE_SR)
+		{
+			I2C_GenerateStopCondition(pI2Cx);
+		}
+
+		*pRxBuffer++ = pI2Cx->DR;
 
+		status = i2c_wait_flag(pI2CHandle, I2C_RXNE_FLAG);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+		*pRxBuffer = pI2Cx->DR;
 	}
+
+	//re-enable acking if it was enabled before
+	if(pI2CHandle->I2CConfig.I2C_ACKControl == I2C_ACK_ENABLE)
+	{
+		I2C_ManageAcking(pI2Cx, I2C_ACK_ENABLE);
+	}
+
+	return I2C_OK;
 }
 
-uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint8_t Len, uint8_t SlaveAddr, uint8_t Sr)
+uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t Len, uint8_t SlaveAddr, uint8_t Sr)
 {
 	uint8_t busystate = pI2CHandle->TxRxState;
 
@@ -481,6 +940,9 @@ uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint8
 		pI2CHandle->TxRxState = I2C_BUSY_IN_TX;
 		pI2CHandle->DevAddr = SlaveAddr;
 		pI2CHandle->Sr = Sr;
+		pI2CHandle->MemAddrLen = 0;
+		pI2CHandle->MemAddrIdx = 0;
+		pI2CHandle->XferOpt = 0;
 
 		//Implement code to Generate START Condition
 		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
@@ -500,7 +962,7 @@ uint8_t I2C_MasterSendDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint8
 
 	return busystate;
 }
-uint8_t I2C_MasterRecieveDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint8_t Len, uint8_t SlaveAddr, uint8_t Sr)
+uint8_t I2C_MasterRecieveDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint32_t Len, uint8_t SlaveAddr, uint8_t Sr)
 {
 	uint8_t busystate = pI2CHandle->TxRxState;
 
@@ -512,6 +974,11 @@ uint8_t I2C_MasterRecieveDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, ui
 		pI2CHandle->RxSize = Len; //Rxsize is used in the ISR code to manage the data reception
 		pI2CHandle->DevAddr = SlaveAddr;
 		pI2CHandle->Sr = Sr;
+		pI2CHandle->MemAddrLen = 0;
+		pI2CHandle->MemAddrIdx = 0;
+		pI2CHandle->XferOpt = 0;
+
+		I2C_ManageAcking(pI2CHandle->pI2Cx, I2C_ACK_ENABLE);
 
 		//Implement code to Generate START Condition
 		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
@@ -531,9 +998,801 @@ uint8_t I2C_MasterRecieveDataIT(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, ui
 	return busystate;
 }
 
+/*********************************************************************
+ * @fn      		  - I2C_MasterSendDataDMA
+ *
+ * @brief             - master transmission with the data moved by pTxDMA
+ *
+ * @param[in]         - I2C handle, pTxDMA initialized memory to peripheral, byte size, TC/TE interrupts
+ * @param[in]         - data to send
+ * @param[in]         - number of bytes
+ * @param[in]         - 7 bit slave address
+ * @param[in]         - I2C_ENABLE_SR to skip the STOP (a repeated start follows)
+ *
+ * @return            - previous state, I2C_READY if the transfer was started
+ *
+ * @Note              - SB and ADDR are served by the event interrupt, the stream is armed
+ *                      while ADDR is cleared and BTF closes the transfer with
+ *                      I2C_EV_TX_CMPLT. No per byte interrupt is taken.
+ */
+uint8_t I2C_MasterSendDataDMA(I2C_Handle_t *pI2CHandle, uint8_t *pTxBuffer, uint32_t Len, uint8_t SlaveAddr, uint8_t Sr)
+{
+	uint8_t busystate = pI2CHandle->TxRxState;
+
+	if( (busystate != I2C_BUSY_IN_TX) && (busystate != I2C_BUSY_IN_RX))
+	{
+		pI2CHandle->pTxBuffer = pTxBuffer;
+		pI2CHandle->TxLen = Len;
+		pI2CHandle->TxRxState = I2C_BUSY_IN_TX;
+		pI2CHandle->DevAddr = SlaveAddr;
+		pI2CHandle->Sr = Sr;
+		pI2CHandle->MemAddrLen = 0;
+		pI2CHandle->MemAddrIdx = 0;
+		pI2CHandle->XferOpt = I2C_XFER_DMA;
+
+		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+		//ITBUFEN stays off, TXE is a DMA request
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITEVTEN);
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITERREN);
+	}
+
+	return busystate;
+}
+
+/*********************************************************************
+ * @fn      		  - I2C_MasterRecieveDataDMA
+ *
+ * @brief             - master reception with the data moved by pRxDMA
+ *
+ * @param[in]         - I2C handle, pRxDMA initialized peripheral to memory, byte size, TC/TE interrupts
+ * @param[in]         - destination buffer
+ * @param[in]         - number of bytes
+ * @param[in]         - 7 bit slave address
+ * @param[in]         - I2C_ENABLE_SR to skip the STOP (a repeated start follows)
+ *
+ * @return            - previous state, I2C_READY if the transfer was started
+ *
+ * @Note              - LAST NACKs the final byte, the RX stream EOT programs STOP and reports
+ *                      I2C_EV_RX_CMPLT. A single byte is received through RXNE.
+ */
+uint8_t I2C_MasterRecieveDataDMA(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint32_t Len, uint8_t SlaveAddr, uint8_t Sr)
+{
+	uint8_t busystate = pI2CHandle->TxRxState;
+
+	if (Len == 0) return busystate;
+
+	if( (busystate != I2C_BUSY_IN_TX) && (busystate != I2C_BUSY_IN_RX))
+	{
+		pI2CHandle->pRxBuffer = pRxBuffer;
+		pI2CHandle->RxLen = Len;
+		pI2CHandle->RxSize = Len;
+		pI2CHandle->TxRxState = I2C_BUSY_IN_RX;
+		pI2CHandle->DevAddr = SlaveAddr;
+		pI2CHandle->Sr = Sr;
+		pI2CHandle->MemAddrLen = 0;
+		pI2CHandle->MemAddrIdx = 0;
+		pI2CHandle->XferOpt = I2C_XFER_DMA;
+
+		I2C_ManageAcking(pI2CHandle->pI2Cx, I2C_ACK_ENABLE);
+
+		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+		//the SB handler turns ITBUFEN on only for the RXNE fallback
+		pI2CHandle->pI2Cx->CR2 &= ~( 1 << I2C_CR2_ITBUFEN);
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITEVTEN);
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITERREN);
+	}
+
+	return busystate;
+}
+
+static uint8_t i2c_set_mem_addr(I2C_Handle_t *pI2CHandle, uint16_t MemAddr, uint8_t MemAddrSize)
+{
+	if (MemAddrSize == I2C_MEMADD_SIZE_16BIT)
+	{
+		pI2CHandle->MemAddr[0] = (uint8_t)(MemAddr >> 8);
+		pI2CHandle->MemAddr[1] = (uint8_t)MemAddr;
+		return 2;
+	}
+
+	pI2CHandle->MemAddr[0] = (uint8_t)MemAddr;
+	return 1;
+}
+
+/*********************************************************************
+ * @fn      		  - I2C_MemWrite
+ *
+ * @brief             - blocking register write: register address and data in one write phase
+ *
+ * @param[in]         - I2C handle
+ * @param[in]         - 7 bit slave address
+ * @param[in]         - register address
+ * @param[in]         - @I2C_MemAddrSize
+ * @param[in]         - data to write
+ * @param[in]         - number of bytes
+ *
+ * @return            - I2C_OK, I2C_ERR_NACK, I2C_ERR_TIMEOUT or I2C_ERR_BUS
+ */
+uint8_t I2C_MemWrite(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pTxBuffer, uint32_t Len)
+{
+	uint8_t hdr_len = i2c_set_mem_addr(pI2CHandle, MemAddr, MemAddrSize);
+
+	return i2c_master_write(pI2CHandle, pI2CHandle->MemAddr, hdr_len, pTxBuffer, Len, SlaveAddr, I2C_DISABLE_SR);
+}
+
+/*********************************************************************
+ * @fn      		  - I2C_MemRead
+ *
+ * @brief             - blocking register read: register address write, repeated start, read
+ *
+ * @param[in]         - I2C handle
+ * @param[in]         - 7 bit slave address
+ * @param[in]         - register address
+ * @param[in]         - @I2C_MemAddrSize
+ * @param[in]         - destination buffer
+ * @param[in]         - number of bytes
+ *
+ * @return            - I2C_OK, I2C_ERR_NACK, I2C_ERR_TIMEOUT or I2C_ERR_BUS
+ */
+uint8_t I2C_MemRead(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint8_t hdr_len = i2c_set_mem_addr(pI2CHandle, MemAddr, MemAddrSize);
+	uint8_t status;
+
+	status = i2c_master_write(pI2CHandle, pI2CHandle->MemAddr, hdr_len, NULL, 0, SlaveAddr, I2C_ENABLE_SR);
+	if (status != I2C_OK) return status;
+
+	return I2C_MasterRecieveData(pI2CHandle, pRxBuffer, Len, SlaveAddr, I2C_DISABLE_SR);
+}
+
+/*
+ * SMBus. The protocols map onto the register access paths: the command code is the register
+ * address. With I2C_PEC enabled the hardware appends the PEC to writes (see i2c_master_write)
+ * and checks it on reads, no CRC is computed in software.
+ */
+
+//stores a received byte, the PEC byte after the data is only checked by the hardware
+static void i2c_smbus_store(uint8_t **ppRxBuffer, uint32_t *pLen, uint8_t Data)
+{
+	if (*pLen > 0)
+	{
+		**ppRxBuffer = Data;
+		(*ppRxBuffer)++;
+		(*pLen)--;
+	}
+}
+
+/*
+ * Receives one or two bytes (data and the optional PEC) with ADDR still set. ACK and POS have to
+ * be in place before ADDR is cleared or the slave already gets an ACK for the last byte.
+ */
+static uint8_t i2c_smbus_rx_short(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint32_t Len, uint8_t Pec)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint8_t status;
+
+	I2C_ManageAcking(pI2Cx, I2C_ACK_DISABLE);
+
+	if ((Len + Pec) == 1)
+	{
+		I2C_ClearADDRFlag(pI2CHandle);
+		I2C_GenerateStopCondition(pI2Cx);
+
+		status = i2c_wait_flag(pI2CHandle, I2C_RXNE_FLAG);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+		i2c_smbus_store(&pRxBuffer, &Len, pI2Cx->DR);
+
+		return I2C_OK;
+	}
+
+	//NACK goes to the byte in the shift register, with POS that is the second one
+	pI2Cx->CR1 |= (1 << I2C_CR1_POS);
+	I2C_ClearADDRFlag(pI2CHandle);
+	if (Pec)
+	{
+		pI2Cx->CR1 |= (1 << I2C_CR1_PEC);
+	}
+
+	//first byte in DR, second in the shift register
+	status = i2c_wait_flag(pI2CHandle, I2C_BTF_FLAG);
+	if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+
+	I2C_GenerateStopCondition(pI2Cx);
+	i2c_smbus_store(&pRxBuffer, &Len, pI2Cx->DR);
+	i2c_smbus_store(&pRxBuffer, &Len, pI2Cx->DR);
+
+	pI2Cx->CR1 &= ~(1 << I2C_CR1_POS);
+
+	return I2C_OK;
+}
+
+/*
+ * Receives Len data bytes and the optional PEC after ADDR was cleared with ACK on, the first byte
+ * is already on the wire (block reads, after the count byte, and fixed reads of 3 bytes or more).
+ * NACK goes to the final byte, PEC is set once the byte before the PEC is in DR as the reference
+ * manual asks.
+ */
+static uint8_t i2c_smbus_rx(I2C_Handle_t *pI2CHandle, uint8_t *pRxBuffer, uint32_t Len, uint8_t Pec)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint32_t left = Len + Pec;
+	uint8_t status;
+
+	if (left >= 3)
+	{
+		while(left > 3)
+		{
+			status = i2c_wait_flag(pI2CHandle, I2C_RXNE_FLAG);
+			if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+			i2c_smbus_store(&pRxBuffer, &Len, pI2Cx->DR);
+			left--;
+		}
+
+		//byte N-2 in DR, N-1 in the shift register
+		status = i2c_wait_flag(pI2CHandle, I2C_BTF_FLAG);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+
+		I2C_ManageAcking(pI2Cx, I2C_ACK_DISABLE);
+		i2c_smbus_store(&pRxBuffer, &Len, pI2Cx->DR);
+		if (Pec)
+		{
+			pI2Cx->CR1 |= (1 << I2C_CR1_PEC);
+		}
+
+		status = i2c_wait_flag(pI2CHandle, I2C_BTF_FLAG);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+
+		I2C_GenerateStopCondition(pI2Cx);
+		i2c_smbus_store(&pRxBuffer, &Len, pI2Cx->DR);
+	}
+	else if (left == 2)
+	{
+		//first byte in DR, the last one on the wire
+		status = i2c_wait_flag(pI2CHandle, I2C_RXNE_FLAG);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+
+		I2C_ManageAcking(pI2Cx, I2C_ACK_DISABLE);
+		if (Pec)
+		{
+			pI2Cx->CR1 |= (1 << I2C_CR1_PEC);
+		}
+		I2C_GenerateStopCondition(pI2Cx);
+		i2c_smbus_store(&pRxBuffer, &Len, pI2Cx->DR);
+	}
+	else
+	{
+		I2C_ManageAcking(pI2Cx, I2C_ACK_DISABLE);
+		I2C_GenerateStopCondition(pI2Cx);
+	}
+
+	status = i2c_wait_flag(pI2CHandle, I2C_RXNE_FLAG);
+	if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+	i2c_smbus_store(&pRxBuffer, &Len, pI2Cx->DR);
+
+	return I2C_OK;
+}
+
+//command write, repeated start, then Len bytes, or a count byte and up to Len bytes for a block read
+static uint8_t i2c_smbus_read(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint8_t Cmd, uint8_t *pRxBuffer,
+		uint32_t Len, uint8_t Block, uint8_t *pCount)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint8_t pec = (pI2Cx->CR1 & (1 << I2C_CR1_ENPEC)) ? 1 : 0;
+	uint8_t status, count;
+
+	status = i2c_master_write(pI2CHandle, &Cmd, 1, NULL, 0, SlaveAddr, I2C_ENABLE_SR);
+	if (status != I2C_OK) return status;
+
+	//fixed length without PEC is a plain register read
+	if (!Block && !pec)
+	{
+		return I2C_MasterRecieveData(pI2CHandle, pRxBuffer, Len, SlaveAddr, I2C_DISABLE_SR);
+	}
+
+	I2C_GenerateStartCondition(pI2Cx);
+
+	status = i2c_wait_flag(pI2CHandle, I2C_SB_FLAG);
+	if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+
+	I2C_ExecuteAddressPhaseRead(pI2Cx, SlaveAddr);
+
+	status = i2c_wait_flag(pI2CHandle, I2C_ADDR_FLAG);
+	if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+
+	if (Block)
+	{
+		I2C_ManageAcking(pI2Cx, I2C_ACK_ENABLE);
+		I2C_ClearADDRFlag(pI2CHandle);
+
+		//the count decides the length while the next byte is already coming
+		status = i2c_wait_flag(pI2CHandle, I2C_RXNE_FLAG);
+		if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+		count = pI2Cx->DR;
+
+		if ((count == 0) || (count > I2C_SMBUS_BLOCK_MAX) || (count > Len))
+		{
+			I2C_ManageAcking(pI2Cx, I2C_ACK_DISABLE);
+			I2C_GenerateStopCondition(pI2Cx);
+			status = i2c_wait_flag(pI2CHandle, I2C_RXNE_FLAG);
+			if (status != I2C_OK) return i2c_blocking_fail(pI2CHandle, status);
+			(void)pI2Cx->DR;
+			status = I2C_ERR_PROTO;
+		}
+		else
+		{
+			Len = count;
+			*pCount = count;
+			status = i2c_smbus_rx(pI2CHandle, pRxBuffer, Len, pec);
+		}
+	}
+	else if ((Len + pec) <= 2)
+	{
+		//Read Byte with PEC, ACK and POS are set up while ADDR holds the bus
+		status = i2c_smbus_rx_short(pI2CHandle, pRxBuffer, Len, pec);
+	}
+	else
+	{
+		I2C_ManageAcking(pI2Cx, I2C_ACK_ENABLE);
+		I2C_ClearADDRFlag(pI2CHandle);
+		status = i2c_smbus_rx(pI2CHandle, pRxBuffer, Len, pec);
+	}
+
+	if (status == I2C_OK)
+	{
+		if (pI2Cx->SR1 & I2C_PECERR_FLAG)
+		{
+			pI2Cx->SR1 &= ~(1 << I2C_SR1_PECERR);
+			pI2CHandle->PecErrCount++;
+			status = I2C_ERR_PEC;
+		}
+
+		if(pI2CHandle->I2CConfig.I2C_ACKControl == I2C_ACK_ENABLE)
+		{
+			I2C_ManageAcking(pI2Cx, I2C_ACK_ENABLE);
+		}
+	}
+	else if (status == I2C_ERR_PROTO)
+	{
+		if(pI2CHandle->I2CConfig.I2C_ACKControl == I2C_ACK_ENABLE)
+		{
+			I2C_ManageAcking(pI2Cx, I2C_ACK_ENABLE);
+		}
+	}
+
+	return status;
+}
+
+//SMBus Write Byte: [cmd][data][PEC]
+uint8_t I2C_SMBusWriteByte(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint8_t Cmd, uint8_t Data)
+{
+	return i2c_master_write(pI2CHandle, &Cmd, 1, &Data, 1, SlaveAddr, I2C_DISABLE_SR);
+}
+
+//SMBus Write Word: [cmd][low][high][PEC]
+uint8_t I2C_SMBusWriteWord(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint8_t Cmd, uint16_t Data)
+{
+	uint8_t data[2];
+
+	data[0] = (uint8_t)Data;
+	data[1] = (uint8_t)(Data >> 8);
+
+	return i2c_master_write(pI2CHandle, &Cmd, 1, data, 2, SlaveAddr, I2C_DISABLE_SR);
+}
+
+//SMBus Block Write: [cmd][count][data]...[PEC], 1 to I2C_SMBUS_BLOCK_MAX bytes
+uint8_t I2C_SMBusBlockWrite(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint8_t Cmd, uint8_t *pTxBuffer, uint8_t Len)
+{
+	uint8_t hdr[2];
+
+	if ((Len == 0) || (Len > I2C_SMBUS_BLOCK_MAX)) return I2C_ERR_PARAM;
+
+	hdr[0] = Cmd;
+	hdr[1] = Len;
+
+	return i2c_master_write(pI2CHandle, hdr, 2, pTxBuffer, Len, SlaveAddr, I2C_DISABLE_SR);
+}
+
+//SMBus Read Byte: [cmd] Sr [data][PEC]
+uint8_t I2C_SMBusReadByte(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint8_t Cmd, uint8_t *pData)
+{
+	return i2c_smbus_read(pI2CHandle, SlaveAddr, Cmd, pData, 1, RESET, NULL);
+}
+
+//SMBus Read Word: [cmd] Sr [low][high][PEC]
+uint8_t I2C_SMBusReadWord(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint8_t Cmd, uint16_t *pData)
+{
+	uint8_t data[2];
+	uint8_t status;
+
+	status = i2c_smbus_read(pI2CHandle, SlaveAddr, Cmd, data, 2, RESET, NULL);
+	if (status == I2C_OK)
+	{
+		*pData = (uint16_t)data[0] | ((uint16_t)data[1] << 8);
+	}
+
+	return status;
+}
+
+/*********************************************************************
+ * @fn      		  - I2C_SMBusBlockRead
+ *
+ * @brief             - SMBus Block Read: [cmd] Sr [count][data]...[PEC]
+ *
+ * @param[in]         - I2C handle
+ * @param[in]         - 7 bit slave address
+ * @param[in]         - command code
+ * @param[in]         - destination buffer
+ * @param[in]         - size of the buffer
+ * @param[out]        - number of bytes the device sent
+ *
+ * @return            - I2C_OK, I2C_ERR_PEC, I2C_ERR_PROTO (count 0, above 32 or above MaxLen),
+ *                      I2C_ERR_NACK, I2C_ERR_TIMEOUT or I2C_ERR_BUS
+ *
+ * @Note              - the count byte is handled on RXNE while the next byte is on the wire,
+ *                      a count of 1 leaves one byte time to NACK the last byte
+ */
+uint8_t I2C_SMBusBlockRead(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint8_t Cmd, uint8_t *pRxBuffer, uint8_t MaxLen, uint8_t *pLen)
+{
+	*pLen = 0;
+	return i2c_smbus_read(pI2CHandle, SlaveAddr, Cmd, pRxBuffer, MaxLen, SET, pLen);
+}
+
+/*********************************************************************
+ * @fn      		  - I2C_SMBusAlertConfig
+ *
+ * @brief             - SMBus alert handling
+ *
+ * @param[in]         - I2C handle
+ * @param[in]         - ENABLE or DISABLE
+ *
+ * @return            - none
+ *
+ * @Note              - host: ENABLE reports a falling SMBA as I2C_EV_SMBALERT, the app then
+ *                      calls I2C_SMBusAlertResponse. Device: ENABLE pulls SMBA low, the driver
+ *                      answers the alert response address with our address, releases SMBA
+ *                      and reports I2C_EV_SMBALERT.
+ */
+void I2C_SMBusAlertConfig(I2C_Handle_t *pI2CHandle, uint8_t EnOrDi)
+{
+	if (EnOrDi == ENABLE)
+	{
+		pI2CHandle->pI2Cx->SR1 &= ~(1 << I2C_SR1_SMBALERT);
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITERREN);
+		pI2CHandle->pI2Cx->CR1 |= (1 << I2C_CR1_ALERT);
+	}
+	else
+	{
+		pI2CHandle->pI2Cx->CR1 &= ~(1 << I2C_CR1_ALERT);
+	}
+}
+
+//reads the address of the alerting device from the alert response address, lowest address wins
+uint8_t I2C_SMBusAlertResponse(I2C_Handle_t *pI2CHandle, uint8_t *pSlaveAddr)
+{
+	uint8_t data;
+	uint8_t status;
+
+	status = I2C_MasterRecieveData(pI2CHandle, &data, 1, I2C_SMBUS_ARA, I2C_DISABLE_SR);
+	if (status == I2C_OK)
+	{
+		*pSlaveAddr = data >> 1;
+	}
+
+	return status;
+}
+
+//common start of the interrupt driven register accesses, the write phase always comes first
+static uint8_t i2c_mem_start_it(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize,
+		uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len, uint8_t XferOpt)
+{
+	uint8_t busystate = pI2CHandle->TxRxState;
+
+	if( (busystate != I2C_BUSY_IN_TX) && (busystate != I2C_BUSY_IN_RX))
+	{
+		pI2CHandle->MemAddrLen = i2c_set_mem_addr(pI2CHandle, MemAddr, MemAddrSize);
+		pI2CHandle->MemAddrIdx = 0;
+		pI2CHandle->XferOpt = XferOpt;
+		pI2CHandle->DevAddr = SlaveAddr;
+		pI2CHandle->Sr = I2C_DISABLE_SR;
+
+		if (XferOpt & I2C_XFER_MEM_READ)
+		{
+			pI2CHandle->pTxBuffer = NULL;
+			pI2CHandle->TxLen = 0;
+			pI2CHandle->pRxBuffer = pRxBuffer;
+			pI2CHandle->RxLen = Len;
+			pI2CHandle->RxSize = Len;
+			I2C_ManageAcking(pI2CHandle->pI2Cx, I2C_ACK_ENABLE);
+		}
+		else
+		{
+			pI2CHandle->pTxBuffer = pTxBuffer;
+			pI2CHandle->TxLen = Len;
+		}
+		pI2CHandle->TxRxState = I2C_BUSY_IN_TX;
+
+		I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+		//the register address always goes out on TXE, DMA only takes over the data
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITBUFEN);
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITEVTEN);
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITERREN);
+	}
+
+	return busystate;
+}
+
+uint8_t I2C_MemWriteIT(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pTxBuffer, uint32_t Len)
+{
+	return i2c_mem_start_it(pI2CHandle, SlaveAddr, MemAddr, MemAddrSize, pTxBuffer, NULL, Len, 0);
+}
+
+/*********************************************************************
+ * @fn      		  - I2C_MemReadIT
+ *
+ * @brief             - interrupt driven register read
+ *
+ * @param[in]         - I2C handle
+ * @param[in]         - 7 bit slave address
+ * @param[in]         - register address
+ * @param[in]         - @I2C_MemAddrSize
+ * @param[in]         - destination buffer
+ * @param[in]         - number of bytes
+ *
+ * @return            - previous state, I2C_READY if the transfer was started
+ *
+ * @Note              - the repeated start is issued from the BTF interrupt of the write phase,
+ *                      the application only sees I2C_EV_RX_CMPLT at the end
+ */
+uint8_t I2C_MemReadIT(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pRxBuffer, uint32_t Len)
+{
+	if (Len == 0) return pI2CHandle->TxRxState;
+
+	return i2c_mem_start_it(pI2CHandle, SlaveAddr, MemAddr, MemAddrSize, NULL, pRxBuffer, Len, I2C_XFER_MEM_READ);
+}
+
+//as I2C_MemWriteIT, the data bytes are moved by pTxDMA
+uint8_t I2C_MemWriteDMA(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pTxBuffer, uint32_t Len)
+{
+	return i2c_mem_start_it(pI2CHandle, SlaveAddr, MemAddr, MemAddrSize, pTxBuffer, NULL, Len, I2C_XFER_DMA);
+}
+
+//as I2C_MemReadIT, the data bytes are moved by pRxDMA (a single byte read falls back to RXNE)
+uint8_t I2C_MemReadDMA(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pRxBuffer, uint32_t Len)
+{
+	if (Len == 0) return pI2CHandle->TxRxState;
+
+	return i2c_mem_start_it(pI2CHandle, SlaveAddr, MemAddr, MemAddrSize, NULL, pRxBuffer, Len, I2C_XFER_MEM_READ | I2C_XFER_DMA);
+}
+
+/*
+ * Starts a queued transaction, the handle has to be idle. A transaction with both phases
+ * runs through the register read path: write phase, repeated start from BTF, read phase.
+ */
+static void i2c_txn_start(I2C_Handle_t *pI2CHandle, I2C_Txn_t *pTxn)
+{
+	pI2CHandle->DevAddr = pTxn->SlaveAddr;
+	pI2CHandle->Sr = pTxn->Sr;
+	pI2CHandle->MemAddrLen = 0;
+	pI2CHandle->MemAddrIdx = 0;
+	pI2CHandle->XferOpt = (pTxn->Flags & I2C_TXN_DMA) ? I2C_XFER_DMA : 0;
+	pI2CHandle->pTxBuffer = pTxn->pTxBuffer;
+	pI2CHandle->TxLen = pTxn->TxLen;
+	pI2CHandle->pRxBuffer = pTxn->pRxBuffer;
+	pI2CHandle->RxLen = pTxn->RxLen;
+	pI2CHandle->RxSize = pTxn->RxLen;
+
+	if (pTxn->RxLen > 0)
+	{
+		I2C_ManageAcking(pI2CHandle->pI2Cx, I2C_ACK_ENABLE);
+	}
+
+	if ((pTxn->TxLen > 0) || (pTxn->RxLen == 0))
+	{
+		//a probe is a write without data
+		pI2CHandle->TxRxState = I2C_BUSY_IN_TX;
+		if (pTxn->RxLen > 0)
+		{
+			pI2CHandle->XferOpt |= I2C_XFER_MEM_READ;
+		}
+	}
+	else
+	{
+		pI2CHandle->TxRxState = I2C_BUSY_IN_RX;
+	}
+
+	I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+
+	//TXE interrupts only for a write phase with data and without DMA, the SB handler takes care of RXNE
+	if ((pI2CHandle->TxRxState == I2C_BUSY_IN_TX) && (pI2CHandle->TxLen > 0) && !(pI2CHandle->XferOpt & I2C_XFER_DMA))
+	{
+		pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITBUFEN);
+	}
+	else
+	{
+		pI2CHandle->pI2Cx->CR2 &= ~( 1 << I2C_CR2_ITBUFEN);
+	}
+	pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITEVTEN);
+	pI2CHandle->pI2Cx->CR2 |= ( 1 << I2C_CR2_ITERREN);
+}
+
+/*
+ * Starts the highest priority queued transaction, if any, on an idle handle. CR1 must not be
+ * written while a STOP requested by the previous transfer is still pending, the read-modify-
+ * write of ACK/START would act on it. There is no interrupt once the STOP is on the bus, so
+ * the start is deferred instead of waited for: I2C_TxnProcess and I2C_TxnSubmit retry it,
+ * the queue is left untouched until then.
+ */
+static void i2c_txn_start_next(I2C_Handle_t *pI2CHandle)
+{
+	I2C_TxnQueue_t *pQueue = pI2CHandle->pQueue;
+	I2C_Txn_t *pTxn;
+	uint32_t primask;
+
+	if ((pQueue == NULL) || (pQueue->pActive != NULL)) return;
+
+	//the bus is broken until I2C_RecoverPending has run
+	if (pI2CHandle->RecoveryPending) return;
+
+	if (pI2CHandle->pI2Cx->CR1 & (1 << I2C_CR1_STOP))
+	{
+		pQueue->Deferred++;
+		return;
+	}
+
+	DRV_ENTER_CRITICAL(primask);
+
+	if ((pQueue != NULL) && (pQueue->pActive == NULL) && (pI2CHandle->TxRxState == I2C_READY))
+	{
+		for (uint8_t prio = 0; prio < I2C_TXN_PRIO_LEVELS; prio++)
+		{
+			pTxn = pQueue->pHead[prio];
+			if (pTxn != NULL)
+			{
+				pQueue->pHead[prio] = pTxn->pNext;
+				if (pQueue->pHead[prio] == NULL)
+				{
+					pQueue->pTail[prio] = NULL;
+				}
+				pTxn->pNext = NULL;
+				pQueue->pActive = pTxn;
+				i2c_txn_start(pI2CHandle, pTxn);
+				break;
+			}
+		}
+	}
+
+	DRV_EXIT_CRITICAL(primask);
+}
+
+/*
+ * End of every interrupt/DMA driven master transfer. A queued transaction is completed
+ * through its own callback, the next one is started first so the bus does not wait for
+ * the callback. Direct transfers go to the application callback as before.
+ */
+static void I2C_MasterNotifyDone(I2C_Handle_t *pI2CHandle, uint8_t AppEv)
+{
+	I2C_TxnQueue_t *pQueue = pI2CHandle->pQueue;
+	I2C_Txn_t *pTxn;
+
+	if ((pQueue != NULL) && (pQueue->pActive != NULL))
+	{
+		pTxn = pQueue->pActive;
+		pQueue->pActive = NULL;
+		pQueue->Completed++;
+		pTxn->Status = ((AppEv == I2C_EV_TX_CMPLT) || (AppEv == I2C_EV_RX_CMPLT)) ? I2C_TXN_DONE : I2C_TXN_ERROR;
+
+		i2c_txn_start_next(pI2CHandle);
+
+		if (pTxn->pCallback != NULL)
+		{
+			pTxn->pCallback(pTxn, AppEv);
+		}
+		return;
+	}
+
+	I2C_ApplicationEventCallback(pI2CHandle, AppEv);
+	i2c_txn_start_next(pI2CHandle);
+}
+
+//attaches an empty transaction queue to the handle, call it after I2C_Init
+void I2C_TxnQueueInit(I2C_Handle_t *pI2CHandle, I2C_TxnQueue_t *pQueue)
+{
+	for (uint8_t prio = 0; prio < I2C_TXN_PRIO_LEVELS; prio++)
+	{
+		pQueue->pHead[prio] = NULL;
+		pQueue->pTail[prio] = NULL;
+	}
+	pQueue->pActive = NULL;
+	pQueue->Completed = 0;
+	pQueue->Deferred = 0;
+
+	pI2CHandle->pQueue = pQueue;
+}
+
+/*********************************************************************
+ * @fn      		  - I2C_TxnSubmit
+ *
+ * @brief             - queues a transaction, it starts at once if the bus is idle
+ *
+ * @param[in]         - I2C handle with a queue attached by I2C_TxnQueueInit
+ * @param[in]         - transaction, owned by the driver until its callback runs
+ * @param[in]         - priority, 0 (highest) to I2C_TXN_PRIO_LEVELS - 1
+ *
+ * @return            - I2C_OK or I2C_ERR_PARAM
+ *
+ * @Note              - Safe from thread mode and from ISRs. Completion chains the next
+ *                      transaction from the I2C/DMA interrupt, unless the STOP of the one that
+ *                      completed is still pending, then I2C_TxnProcess has to pick it up.
+ *                      Within a priority the order is FIFO. The blocking APIs must not be
+ *                      used on a bus with a queue.
+ */
+uint8_t I2C_TxnSubmit(I2C_Handle_t *pI2CHandle, I2C_Txn_t *pTxn, uint8_t Prio)
+{
+	I2C_TxnQueue_t *pQueue = pI2CHandle->pQueue;
+	uint32_t primask;
+
+	if ((pQueue == NULL) || (Prio >= I2C_TXN_PRIO_LEVELS)) return I2C_ERR_PARAM;
+	if ((pTxn->TxLen == 0) && (pTxn->RxLen == 0) && !(pTxn->Flags & I2C_TXN_PROBE)) return I2C_ERR_PARAM;
+	if (pTxn->Status == I2C_TXN_PENDING) return I2C_ERR_PARAM;
+
+	pTxn->Status = I2C_TXN_PENDING;
+	pTxn->pNext = NULL;
+
+	DRV_ENTER_CRITICAL(primask);
+
+	if (pQueue->pTail[Prio] != NULL)
+	{
+		pQueue->pTail[Prio]->pNext = pTxn;
+	}
+	else
+	{
+		pQueue->pHead[Prio] = pTxn;
+	}
+	pQueue->pTail[Prio] = pTxn;
+
+	DRV_EXIT_CRITICAL(primask);
+
+	i2c_txn_start_next(pI2CHandle);
+
+	return I2C_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - I2C_TxnProcess
+ *
+ * @brief             - starts the next queued transaction if a start had to be deferred
+ *
+ * @param[in]         - I2C handle with a queue attached by I2C_TxnQueueInit
+ *
+ * @return            - none
+ *
+ * @Note              - a transaction that completes while its STOP is still on the way cannot
+ *                      start the next one, call this from the main loop or a periodic
+ *                      interrupt to pick it up. It never waits, safe from any context.
+ */
+void I2C_TxnProcess(I2C_Handle_t *pI2CHandle)
+{
+	i2c_txn_start_next(pI2CHandle);
+}
+
 static void I2C_MasterHandleTXEInterrupt(I2C_Handle_t *pI2CHandle)
 {
-	if (pI2CHandle->TxLen > 0)
+	if (pI2CHandle->MemAddrIdx < pI2CHandle->MemAddrLen)
+	{
+		//register address goes first
+		pI2CHandle->pI2Cx->DR = pI2CHandle->MemAddr[pI2CHandle->MemAddrIdx];
+		pI2CHandle->MemAddrIdx++;
+	}
+	else if ((pI2CHandle->XferOpt & I2C_XFER_DMA) && (pI2CHandle->TxLen > 0))
+	{
+		//hand the data over to the stream, TXE requests go to the DMA from now on
+		pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_ITBUFEN);
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_DMAEN);
+		i2c_dma_tx_next(pI2CHandle);
+	}
+	else if (pI2CHandle->TxLen > 0)
 	{
 		//we load the data into DR
 		pI2CHandle->pI2Cx->DR = *(pI2CHandle->pTxBuffer);
@@ -546,42 +1805,70 @@ static void I2C_MasterHandleTXEInterrupt(I2C_Handle_t *pI2CHandle)
 	}
 }
 
+static void I2C_MasterCloseReception(I2C_Handle_t *pI2CHandle)
+{
+	//close i2c rx
+	I2C_CloseRecieveData(pI2CHandle);
+
+	//notify the application
+	I2C_MasterNotifyDone(pI2CHandle, I2C_EV_RX_CMPLT);
+}
+
+/*
+ * RXNE only serves N=1 and the bytes of N>2 before the last three, the ADDR handler
+ * and the code below switch ITBUFEN off so the tail is handled on BTF
+ */
 static void I2C_MasterHandleRXNEInterrupt(I2C_Handle_t *pI2CHandle)
 {
 	if (pI2CHandle->RxSize == 1)
 	{
+		//NACK and STOP were set when ADDR was cleared
 		*pI2CHandle->pRxBuffer = pI2CHandle->pI2Cx->DR;
 		pI2CHandle->RxLen--;
+		I2C_MasterCloseReception(pI2CHandle);
+		return;
+	}
 
+	if (pI2CHandle->RxLen > 3)
+	{
+		*pI2CHandle->pRxBuffer = pI2CHandle->pI2Cx->DR;
+		pI2CHandle->pRxBuffer++;
+		pI2CHandle->RxLen--;
 	}
 
-	if (pI2CHandle->RxSize > 1)
+	if (pI2CHandle->RxLen <= 3)
 	{
-		if(pI2CHandle->RxLen == 2)
-		{
-			//clear the ACK bit
-			I2C_ManageAcking(pI2CHandle->pI2Cx, I2C_ACK_DISABLE);
+		pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_ITBUFEN);
+	}
+}
 
-		}
+/*
+ * BTF in reception means DR and the shift register are both full and SCL is stretched,
+ * ACK and STOP can be changed without the slave sending another byte
+ */
+static void I2C_MasterHandleBTFRxInterrupt(I2C_Handle_t *pI2CHandle)
+{
+	if (pI2CHandle->RxLen == 3)
+	{
+		//data N-2 in DR, data N-1 in the shift register, data N will be NACKed
+		I2C_ManageAcking(pI2CHandle->pI2Cx, I2C_ACK_DISABLE);
 		*pI2CHandle->pRxBuffer = pI2CHandle->pI2Cx->DR;
 		pI2CHandle->pRxBuffer++;
 		pI2CHandle->RxLen--;
 	}
-
-	if (pI2CHandle->RxSize == 0)
+	else if (pI2CHandle->RxLen == 2)
 	{
-		//close the I2C data reception and notify the app
-		//generate the stop condition
+		//data N-1 in DR, data N in the shift register (N=2: NACK already set with POS)
 		if(pI2CHandle->Sr == I2C_DISABLE_SR)
 		{
-			I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+			I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
 		}
 
-		//close i2c rx
-		I2C_CloseRecieveData(pI2CHandle);
+		pI2CHandle->pRxBuffer[0] = pI2CHandle->pI2Cx->DR;
+		pI2CHandle->pRxBuffer[1] = pI2CHandle->pI2Cx->DR;
+		pI2CHandle->RxLen = 0;
 
-		//notify the application
-		I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_RX_CMPLT);
+		I2C_MasterCloseReception(pI2CHandle);
 	}
 }
 
@@ -594,6 +1881,84 @@ uint8_t I2C_SlaveRecieveData(I2C_RegDef_t *pI2Cx)
 	return (uint8_t)pI2Cx->DR;
 }
 
+/*********************************************************************
+ * @fn      		  - I2C_SlaveRegFileStart
+ *
+ * @brief             - serves a register file at I2C_DeviceAddress without app involvement
+ *
+ * @param[in]         - I2C handle, initialized with I2C_Init
+ * @param[in]         - register file, owned by the driver until I2C_SlaveRegFileStop
+ *
+ * @return            - none
+ *
+ * @Note              - host write: [reg][data]... stores data from reg on, writes to read only
+ *                      registers are dropped. Host read: data from the current pointer, usually
+ *                      after a [reg] write and a repeated start. The pointer wraps at RegCount.
+ *                      With pTxDMA set, host reads are served by the stream.
+ *                      I2C_EV_REG_WRITE is reported at the STOP of a transaction that wrote.
+ *                      NoStretch removes clock stretching, each byte must then be served within
+ *                      one SCL period (2.5 us at 400 kHz), OVR is counted when it is not.
+ */
+void I2C_SlaveRegFileStart(I2C_Handle_t *pI2CHandle, I2C_RegFile_t *pRegFile)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+
+	pRegFile->Ptr = 0;
+	pRegFile->AddrPhase = RESET;
+	pRegFile->Written = RESET;
+	pRegFile->DmaLen = 0;
+	pRegFile->RejectCount = 0;
+	pI2CHandle->pRegFile = pRegFile;
+
+	//NOSTRETCH can only be changed with the peripheral disabled
+	pI2Cx->CR1 &= ~(1 << I2C_CR1_PE);
+	if (pRegFile->NoStretch == ENABLE)
+	{
+		pI2Cx->CR1 |= (1 << I2C_CR1_NOSTRETCH);
+	}
+	else
+	{
+		pI2Cx->CR1 &= ~(1 << I2C_CR1_NOSTRETCH);
+	}
+	pI2Cx->CR1 |= (1 << I2C_CR1_PE);
+
+	//the slave has to ACK its address
+	I2C_ManageAcking(pI2Cx, I2C_ACK_ENABLE);
+
+	pI2Cx->CR2 |= (1 << I2C_CR2_ITEVTEN) | (1 << I2C_CR2_ITBUFEN) | (1 << I2C_CR2_ITERREN);
+}
+
+void I2C_SlaveRegFileStop(I2C_Handle_t *pI2CHandle)
+{
+	pI2CHandle->pI2Cx->CR2 &= ~((1 << I2C_CR2_ITEVTEN) | (1 << I2C_CR2_ITBUFEN) | (1 << I2C_CR2_DMAEN));
+
+	if ((pI2CHandle->pRegFile != NULL) && (pI2CHandle->pRegFile->DmaLen != 0))
+	{
+		DMA_StopTransfer(pI2CHandle->pTxDMA);
+	}
+
+	pI2CHandle->pI2Cx->CR1 &= ~(1 << I2C_CR1_NOSTRETCH);
+	pI2CHandle->pRegFile = NULL;
+}
+
+//returns and clears one word of the write notification bitmap (registers 32*Word to 32*Word+31),
+//0 without a register file, without a bitmap or for a word past the last register
+uint32_t I2C_SlaveFetchWrites(I2C_Handle_t *pI2CHandle, uint16_t Word)
+{
+	I2C_RegFile_t *pRegFile = pI2CHandle->pRegFile;
+	uint32_t primask, mask;
+
+	if ((pRegFile == NULL) || (pRegFile->pWriteMask == NULL)) return 0;
+	if (Word >= ((pRegFile->RegCount + 31) / 32)) return 0;
+
+	DRV_ENTER_CRITICAL(primask);
+	mask = pRegFile->pWriteMask[Word];
+	pRegFile->pWriteMask[Word] = 0;
+	DRV_EXIT_CRITICAL(primask);
+
+	return mask;
+}
+
 
 void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 {
@@ -613,6 +1978,12 @@ void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 		if(pI2CHandle->TxRxState == I2C_BUSY_IN_RX)
 		{
 			I2C_ExecuteAddressPhaseRead(pI2CHandle->pI2Cx, pI2CHandle->DevAddr);
+
+			//ITBUFEN is off after the write phase of a register read, RXNE needs it again
+			if(!i2c_rx_uses_dma(pI2CHandle))
+			{
+				pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITBUFEN);
+			}
 		}
 		else if(pI2CHandle->TxRxState == I2C_BUSY_IN_TX)
 		{
@@ -626,38 +1997,60 @@ void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 		{
 			//ADDR flag is set
 		I2C_ClearADDRFlag(pI2CHandle);
+
+		if((pI2CHandle->TxRxState == I2C_BUSY_IN_TX) && (pI2CHandle->TxLen == 0) && (pI2CHandle->MemAddrLen == 0))
+		{
+			//address only write (probe), the ACK is all we wanted, no TXE/BTF will follow
+			if (pI2CHandle->Sr == I2C_DISABLE_SR)
+			{
+				I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+			}
+			I2C_CloseSendData(pI2CHandle);
+			I2C_MasterNotifyDone(pI2CHandle, I2C_EV_TX_CMPLT);
+		}
 		}
 
 	//Handle the BTF event
 	temp3 = pI2CHandle->pI2Cx->SR1 & (1 << I2C_SR1_BTF);
 	if (temp1 && temp3)
+	{
+		//BTF flag is set
+		if(pI2CHandle->TxRxState == I2C_BUSY_IN_TX)
 		{
-			//BTF flag is set
-			if(pI2CHandle->TxRxState == I2C_BUSY_IN_TX)
+			//make sure TXE is also set
+			if(pI2CHandle->pI2Cx->SR1 & (1 << I2C_SR1_TXE))
 			{
-				//make sure TXE is also set
-				if(pI2CHandle->pI2Cx->SR1 & (1 << I2C_SR1_TXE))
+				//BTF and TXE both set
+				//close the transmision
+				if((pI2CHandle->TxLen == 0) && (pI2CHandle->MemAddrIdx == pI2CHandle->MemAddrLen)
+						&& (pI2CHandle->XferOpt & I2C_XFER_MEM_READ))
+				{
+					//register address is out, switch to the read phase without involving the app
+					pI2CHandle->XferOpt &= ~I2C_XFER_MEM_READ;
+					pI2CHandle->MemAddrLen = 0;
+					pI2CHandle->TxRxState = I2C_BUSY_IN_RX;
+					pI2CHandle->pI2Cx->CR2 &= ~((1 << I2C_CR2_ITBUFEN) | (1 << I2C_CR2_DMAEN));
+					I2C_GenerateStartCondition(pI2CHandle->pI2Cx);
+				}
+				else if((pI2CHandle->TxLen == 0) && (pI2CHandle->MemAddrIdx == pI2CHandle->MemAddrLen))
 				{
-					//BTF and TXE both set
-					//close the transmision
-					if(pI2CHandle->TxLen == 0)
-					{
-
-						if (pI2CHandle->Sr == I2C_DISABLE_SR)
-						{
-							I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
-						}
-						I2C_CloseSendData(pI2CHandle);
 
-						I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_TX_CMPLT);
-						}
+					if (pI2CHandle->Sr == I2C_DISABLE_SR)
+					{
+						I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+					}
+					I2C_CloseSendData(pI2CHandle);
 
+					I2C_MasterNotifyDone(pI2CHandle, I2C_EV_TX_CMPLT);
 				}
-			else if(pI2CHandle->TxRxState == I2C_BUSY_IN_RX)
-			{
-				//This block is empty
 			}
 		}
+		else if((pI2CHandle->TxRxState == I2C_BUSY_IN_RX) && !(pI2CHandle->pI2Cx->SR2 & (1 << I2C_SR2_TRA)))
+		{
+			//TRA still set means BTF is left over from the write phase of a register read
+			I2C_MasterHandleBTFRxInterrupt(pI2CHandle);
+		}
+	}
 
 	//Handle interrupt for STOPF event
 	temp3 = pI2CHandle->pI2Cx->SR1 & (1 << I2C_SR1_STOPF);
@@ -669,8 +2062,20 @@ void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 			//we have read SR1 before the if so no need to  do it again
 			pI2CHandle->pI2Cx->CR1 |= 0x0000;
 
-			//notifying the app that stop is detected
-			I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_STOP);
+			if (pI2CHandle->pRegFile != NULL)
+			{
+				//one notification per write transaction, none for reads
+				if (pI2CHandle->pRegFile->Written)
+				{
+					pI2CHandle->pRegFile->Written = RESET;
+					I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_REG_WRITE);
+				}
+			}
+			else
+			{
+				//notifying the app that stop is detected
+				I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_STOP);
+			}
 		}
 
 	//Handle interrupt for the TXE event
@@ -694,18 +2099,38 @@ void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 			if(pI2CHandle->pI2Cx->SR2 & (1 << I2C_SR2_TRA))
 			{
 				//device is in transmitter mode
-				I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_DATA_REQ);
+				if (pI2CHandle->SMBAlertAck)
+				{
+					//alert response: our address, SMBA is released once it is out
+					if (pI2CHandle->pI2Cx->CR1 & (1 << I2C_CR1_ALERT))
+					{
+						pI2CHandle->pI2Cx->DR = (uint8_t)pI2CHandle->pI2Cx->OAR1;
+						pI2CHandle->pI2Cx->CR1 &= ~(1 << I2C_CR1_ALERT);
+					}
+					else
+					{
+						pI2CHandle->pI2Cx->DR = 0xFF;
+					}
+				}
+				else if (pI2CHandle->pRegFile != NULL)
+				{
+					i2c_regfile_tx(pI2CHandle);
+				}
+				else
+				{
+					I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_DATA_REQ);
+				}
 			}
 		}
 	}
-}
 
 	//Handle interrupt for the RXNE event
 	temp3 = pI2CHandle->pI2Cx->SR1 & (1 << I2C_SR1_RXNE);
 	if (temp1 && temp2 && temp3)
 	{
 		//check device mode
-		if(pI2CHandle->pI2Cx->SR2 & (1 << I2C_SR2_MSL))
+		//MSL is gone once the N=1 STOP is out, which happens before its byte is read
+		if((pI2CHandle->TxRxState == I2C_BUSY_IN_RX) || (pI2CHandle->pI2Cx->SR2 & (1 << I2C_SR2_MSL)))
 		{
 			//device is master
 
@@ -720,10 +2145,17 @@ void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 		else
 		{
 			//slave mode
-			if(pI2CHandle->pI2Cx->SR2 & (1 << I2C_SR2_TRA))
+			if(!(pI2CHandle->pI2Cx->SR2 & (1 << I2C_SR2_TRA)))
 			{
-				//device is in transmitter mode
-				I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_DATA_RCV);
+				//device is in receiver mode
+				if (pI2CHandle->pRegFile != NULL)
+				{
+					i2c_regfile_rx(pI2CHandle);
+				}
+				else
+				{
+					I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_DATA_RCV);
+				}
 			}
 		}
 
@@ -731,9 +2163,316 @@ void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
 }
 
 
+/*********************************************************************
+ * @fn      		  - I2C_TxDMAIRQHandling
+ *
+ * @brief             - services the TX stream, call it from the IRQ handler of pTxDMA
+ *
+ * @param[in]         - I2C handle
+ *
+ * @return            - none
+ *
+ * @Note              - stream completion only means the last byte is in DR, the transfer is
+ *                      closed by the BTF event like in interrupt mode
+ */
+void I2C_TxDMAIRQHandling(I2C_Handle_t *pI2CHandle)
+{
+	uint8_t flags = DMA_GetFlags(pI2CHandle->pTxDMA);
+
+	DMA_ClearFlags(pI2CHandle->pTxDMA, flags);
+
+	if ((pI2CHandle->pRegFile != NULL) && (pI2CHandle->pRegFile->DmaLen != 0))
+	{
+		//host read ran to the end of the register file, TXE interrupts continue from register 0
+		pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_DMAEN);
+		pI2CHandle->pRegFile->Ptr = 0;
+		pI2CHandle->pRegFile->DmaLen = 0;
+		pI2CHandle->pI2Cx->CR2 |= (1 << I2C_CR2_ITBUFEN);
+		return;
+	}
+
+	if (pI2CHandle->TxRxState != I2C_BUSY_IN_TX) return;
+
+	if (flags & DMA_FLAG_TE)
+	{
+		DMA_StopTransfer(pI2CHandle->pTxDMA);
+		I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+		I2C_CloseSendData(pI2CHandle);
+		I2C_MasterNotifyDone(pI2CHandle, I2C_ERROR_DMA);
+		return;
+	}
+
+	if (flags & DMA_FLAG_TC)
+	{
+		if (pI2CHandle->TxLen > 0)
+		{
+			i2c_dma_tx_next(pI2CHandle);
+		}
+		else
+		{
+			pI2CHandle->pI2Cx->CR2 &= ~(1 << I2C_CR2_DMAEN);
+		}
+	}
+}
+
+/*********************************************************************
+ * @fn      		  - I2C_RxDMAIRQHandling
+ *
+ * @brief             - services the RX stream, call it from the IRQ handler of pRxDMA
+ *
+ * @param[in]         - I2C handle
+ *
+ * @return            - none
+ *
+ * @Note              - LAST already NACKed the final byte, STOP is programmed after the EOT
+ *                      as the reference manual requires
+ */
+void I2C_RxDMAIRQHandling(I2C_Handle_t *pI2CHandle)
+{
+	uint8_t flags = DMA_GetFlags(pI2CHandle->pRxDMA);
+
+	DMA_ClearFlags(pI2CHandle->pRxDMA, flags);
+
+	if (pI2CHandle->TxRxState != I2C_BUSY_IN_RX) return;
+
+	if (flags & DMA_FLAG_TE)
+	{
+		DMA_StopTransfer(pI2CHandle->pRxDMA);
+		I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+		I2C_CloseRecieveData(pI2CHandle);
+		I2C_MasterNotifyDone(pI2CHandle, I2C_ERROR_DMA);
+		return;
+	}
+
+	if (flags & DMA_FLAG_TC)
+	{
+		if (pI2CHandle->RxLen > 0)
+		{
+			i2c_dma_rx_next(pI2CHandle);
+			return;
+		}
+
+		if(pI2CHandle->Sr == I2C_DISABLE_SR)
+		{
+			I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+		}
+		I2C_MasterCloseReception(pI2CHandle);
+	}
+}
+
+
+/*********************************************************************
+ * @fn      		  - I2C_AbortTransfer
+ *
+ * @brief             - stops the interrupt/DMA transfer in flight and makes the handle ready
+ *
+ * @param[in]         - I2C handle
+ *
+ * @return            - none
+ *
+ * @Note              - nothing is reported, the caller notifies the application
+ */
+void I2C_AbortTransfer(I2C_Handle_t *pI2CHandle)
+{
+	if (pI2CHandle->pI2Cx->CR2 & (1 << I2C_CR2_DMAEN))
+	{
+		if ((pI2CHandle->TxRxState == I2C_BUSY_IN_TX) && (pI2CHandle->pTxDMA != NULL))
+		{
+			DMA_StopTransfer(pI2CHandle->pTxDMA);
+		}
+		else if ((pI2CHandle->TxRxState == I2C_BUSY_IN_RX) && (pI2CHandle->pRxDMA != NULL))
+		{
+			DMA_StopTransfer(pI2CHandle->pRxDMA);
+		}
+	}
+
+	I2C_CloseSendData(pI2CHandle);
+	I2C_CloseRecieveData(pI2CHandle);
+}
+
+static void i2c_delay(uint32_t Cycles)
+{
+	uint32_t start = DWT_GetCycles();
+
+	while(!DWT_IsElapsed(start, Cycles));
+}
+
+//switches SCL/SDA between open drain GPIO outputs and their I2C alternate function
+static void i2c_pins_to_gpio(I2C_Handle_t *pI2CHandle, uint8_t EnOrDi)
+{
+	uint32_t mode = (EnOrDi == ENABLE) ? GPIO_MODE_OUT : GPIO_MODE_ALTFN;
+
+	if (EnOrDi == ENABLE)
+	{
+		GPIO_WriteToOutputPin(pI2CHandle->pSCLPort, pI2CHandle->SCLPin, GPIO_PIN_SET);
+		GPIO_WriteToOutputPin(pI2CHandle->pSDAPort, pI2CHandle->SDAPin, GPIO_PIN_SET);
+		pI2CHandle->pSCLPort->OTYPER |= (1 << pI2CHandle->SCLPin);
+		pI2CHandle->pSDAPort->OTYPER |= (1 << pI2CHandle->SDAPin);
+	}
+
+	pI2CHandle->pSCLPort->MODER &= ~(0x3 << (2 * pI2CHandle->SCLPin));
+	pI2CHandle->pSCLPort->MODER |= (mode << (2 * pI2CHandle->SCLPin));
+	pI2CHandle->pSDAPort->MODER &= ~(0x3 << (2 * pI2CHandle->SDAPin));
+	pI2CHandle->pSDAPort->MODER |= (mode << (2 * pI2CHandle->SDAPin));
+}
+
+/*
+ * Clocks SCL until a slave stuck in the middle of a byte releases SDA (at most 9 pulses), then
+ * sends a STOP. Returns I2C_ERR_TIMEOUT if SCL is held low or the budget runs out.
+ */
+static uint8_t i2c_clock_out_slave(I2C_Handle_t *pI2CHandle, uint32_t Start, uint32_t Budget)
+{
+	//half period of a 100 kHz clock
+	uint32_t half = DWT_UsToCycles(5);
+
+	for (uint8_t i = 0; i < 9; i++)
+	{
+		if (GPIO_ReadFromInputPin(pI2CHandle->pSDAPort, pI2CHandle->SDAPin)) break;
+
+		GPIO_WriteToOutputPin(pI2CHandle->pSCLPort, pI2CHandle->SCLPin, GPIO_PIN_RESET);
+		i2c_delay(half);
+		GPIO_WriteToOutputPin(pI2CHandle->pSCLPort, pI2CHandle->SCLPin, GPIO_PIN_SET);
+
+		//the slave may stretch the clock
+		while(!GPIO_ReadFromInputPin(pI2CHandle->pSCLPort, pI2CHandle->SCLPin))
+		{
+			if (DWT_IsElapsed(Start, Budget)) return I2C_ERR_TIMEOUT;
+		}
+		i2c_delay(half);
+	}
+
+	//STOP: SDA rises while SCL is high
+	GPIO_WriteToOutputPin(pI2CHandle->pSCLPort, pI2CHandle->SCLPin, GPIO_PIN_RESET);
+	i2c_delay(half);
+	GPIO_WriteToOutputPin(pI2CHandle->pSDAPort, pI2CHandle->SDAPin, GPIO_PIN_RESET);
+	i2c_delay(half);
+	GPIO_WriteToOutputPin(pI2CHandle->pSCLPort, pI2CHandle->SCLPin, GPIO_PIN_SET);
+	i2c_delay(half);
+	GPIO_WriteToOutputPin(pI2CHandle->pSDAPort, pI2CHandle->SDAPin, GPIO_PIN_SET);
+	i2c_delay(half);
+
+	if (!GPIO_ReadFromInputPin(pI2CHandle->pSCLPort, pI2CHandle->SCLPin)) return I2C_ERR_TIMEOUT;
+	if (!GPIO_ReadFromInputPin(pI2CHandle->pSDAPort, pI2CHandle->SDAPin)) return I2C_ERR_BUS;
+
+	return I2C_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - I2C_BusRecover
+ *
+ * @brief             - frees a stuck bus and brings the peripheral back with its configuration
+ *
+ * @param[in]         - I2C handle
+ *
+ * @return            - I2C_OK, I2C_ERR_BUS (bus still busy) or I2C_ERR_TIMEOUT (budget exceeded)
+ *
+ * @Note              - 1. the transfer in flight is aborted, the handle is ready afterwards
+ *                      2. with pSCLPort/pSDAPort set, up to 9 SCL pulses and a STOP are sent
+ *                         through GPIO to release a slave holding SDA low
+ *                      3. SWRST clears the BUSY flag that the peripheral may keep after a
+ *                         glitch, CR1/CR2/OAR1/OAR2/CCR/TRISE are saved and restored around it
+ *                      The whole sequence runs within RecoveryBudgetUs, thread mode only. It
+ *                      is also called from the blocking paths, the error interrupt leaves
+ *                      RecoveryPending for I2C_RecoverPending instead.
+ */
+uint8_t I2C_BusRecover(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint32_t cr1, cr2, oar1, oar2, ccr, trise;
+	uint32_t start = DWT_GetCycles();
+	uint32_t budget = DWT_UsToCycles(pI2CHandle->RecoveryBudgetUs ? pI2CHandle->RecoveryBudgetUs : I2C_DEFAULT_RECOVERY_US);
+	uint8_t status = I2C_OK;
+
+	pI2CHandle->ErrCount.Recoveries++;
+	pI2CHandle->RecoveryPending = RESET;
+
+	if (pI2CHandle->TxRxState != I2C_READY)
+	{
+		I2C_AbortTransfer(pI2CHandle);
+	}
+
+	//configuration to restore, the one shot control bits are left out
+	cr1 = pI2Cx->CR1 & ~((1 << I2C_CR1_START) | (1 << I2C_CR1_STOP) | (1 << I2C_CR1_POS) |
+			(1 << I2C_CR1_PEC) | (1 << I2C_CR1_SWRST));
+	cr2 = pI2Cx->CR2 & ~((1 << I2C_CR2_DMAEN) | (1 << I2C_CR2_LAST));
+	oar1 = pI2Cx->OAR1;
+	oar2 = pI2Cx->OAR2;
+	ccr = pI2Cx->CCR;
+	trise = pI2Cx->TRISE;
+
+	pI2Cx->CR1 &= ~(1 << I2C_CR1_PE);
+
+	if ((pI2CHandle->pSCLPort != NULL) && (pI2CHandle->pSDAPort != NULL))
+	{
+		i2c_pins_to_gpio(pI2CHandle, ENABLE);
+		status = i2c_clock_out_slave(pI2CHandle, start, budget);
+		i2c_pins_to_gpio(pI2CHandle, DISABLE);
+	}
+
+	pI2Cx->CR1 |= (1 << I2C_CR1_SWRST);
+	pI2Cx->CR1 &= ~(1 << I2C_CR1_SWRST);
+
+	pI2Cx->CR2 = cr2;
+	pI2Cx->OAR1 = oar1;
+	pI2Cx->OAR2 = oar2;
+	pI2Cx->CCR = ccr;
+	pI2Cx->TRISE = trise;
+	pI2Cx->CR1 = cr1;
+
+	if ((status == I2C_OK) && (pI2Cx->SR2 & (1 << I2C_SR2_BUSY)))
+	{
+		status = I2C_ERR_BUS;
+	}
+	if ((status == I2C_OK) && DWT_IsElapsed(start, budget))
+	{
+		status = I2C_ERR_TIMEOUT;
+	}
+
+	if (status != I2C_OK)
+	{
+		pI2CHandle->ErrCount.RecoveryFail++;
+	}
+
+	return status;
+}
+
+/*********************************************************************
+ * @fn      		  - I2C_RecoverPending
+ *
+ * @brief             - runs the bus recovery requested by the error interrupt, if any
+ *
+ * @param[in]         - I2C handle
+ *
+ * @return            - I2C_OK if nothing was pending, else the I2C_BusRecover result
+ *
+ * @Note              - call it from thread mode (main loop) after I2C_ERROR_BERR or
+ *                      I2C_ERROR_TIMEOUT. Queued transactions are held back while a recovery
+ *                      is pending and resume from here. Blocking transfers run it themselves.
+ */
+uint8_t I2C_RecoverPending(I2C_Handle_t *pI2CHandle)
+{
+	uint8_t status;
+
+	if (!pI2CHandle->RecoveryPending) return I2C_OK;
+
+	status = I2C_BusRecover(pI2CHandle);
+	i2c_txn_start_next(pI2CHandle);
+
+	return status;
+}
+
+/*
+ * Error interrupt. Every error is counted. A master transfer in flight is aborted and completed
+ * with the error event (queued transactions through their callback), so the handle never stays
+ * busy. BERR and the SCL low TIMEOUT of our own transfer request a bus recovery. Without a
+ * transfer of ours the bus may belong to another master, only the SMBus TIMEOUT (SCL measured
+ * low for 25 ms) proves it stuck. The recovery busy-waits, it runs from I2C_RecoverPending,
+ * never here. Slave side errors (AF at the end of a slave transmission) are only reported.
+ */
 void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
 {
 	uint32_t temp1, temp2;
+	uint8_t error = 0, recover = RESET, stuck = RESET;
 
 	//read the ITERREN flag
 	temp2 = (pI2CHandle->pI2Cx->CR2) & (1 << I2C_CR2_ITERREN);
@@ -747,8 +2486,9 @@ void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
 		//Implement the code to clear the buss error flag
 		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_BERR);
 
-		//Implement the code to notify the application about the error
-	   I2C_ApplicationEventCallback(pI2CHandle,I2C_ERROR_BERR);
+		pI2CHandle->ErrCount.BusErr++;
+		error = I2C_ERROR_BERR;
+		recover = SET;
 	}
 
 	/***********************Check for arbitration lost error************************************/
@@ -760,9 +2500,9 @@ void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
 		//Implement the code to clear the arbitration lost error flag
 		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_ARLO);
 
-		//Implement the code to notify the application about the error
-		I2C_ApplicationEventCallback(pI2CHandle,I2C_ERROR_ARLO);
-
+		//the other master owns the bus, nothing to recover
+		pI2CHandle->ErrCount.ArbLost++;
+		error = I2C_ERROR_ARLO;
 	}
 
 	/***********************Check for ACK failure  error************************************/
@@ -775,8 +2515,31 @@ void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
 		//Implement the code to clear the ACK failure error flag
 		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_AF);
 
-		//Implement the code to notify the application about the error
-		I2C_ApplicationEventCallback(pI2CHandle,I2C_ERROR_AF);
+		if ((pI2CHandle->TxRxState == I2C_READY) && pI2CHandle->SMBAlertAck)
+		{
+			//the host NACKs our address at the end of the alert response
+			pI2CHandle->SMBAlertAck = RESET;
+			I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_SMBALERT);
+		}
+		else if ((pI2CHandle->TxRxState == I2C_READY) && (pI2CHandle->pRegFile != NULL))
+		{
+			//the host NACKs the last byte it reads, this is the normal end of a read
+			i2c_regfile_tx_end(pI2CHandle);
+		}
+		else
+		{
+			if (!((pI2CHandle->pQueue != NULL) && (pI2CHandle->pQueue->pActive != NULL)
+					&& (pI2CHandle->pQueue->pActive->Flags & I2C_TXN_PROBE)))
+			{
+				pI2CHandle->ErrCount.AckFail++;
+			}
+			if (pI2CHandle->TxRxState != I2C_READY)
+			{
+				//the master has to release the bus itself
+				I2C_GenerateStopCondition(pI2CHandle->pI2Cx);
+			}
+			error = I2C_ERROR_AF;
+		}
 	}
 
 	/***********************Check for Overrun/underrun error************************************/
@@ -788,8 +2551,8 @@ void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
 		//Implement the code to clear the Overrun/underrun error flag
 		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_OVR);
 
-		//Implement the code to notify the application about the error
-		I2C_ApplicationEventCallback(pI2CHandle,I2C_ERROR_OVR);
+		pI2CHandle->ErrCount.Overrun++;
+		error = I2C_ERROR_OVR;
 	}
 
 	/***********************Check for Time out error************************************/
@@ -801,7 +2564,47 @@ void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
 		//Implement the code to clear the Time out error flag
 		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_TIMEOUT);
 
-		//Implement the code to notify the application about the error
-		I2C_ApplicationEventCallback(pI2CHandle,I2C_ERROR_TIMEOUT);
+		pI2CHandle->ErrCount.Timeout++;
+		error = I2C_ERROR_TIMEOUT;
+		recover = SET;
+		stuck = SET;
+	}
+
+	/***********************Check for SMBus alert************************************/
+	temp1 = (pI2CHandle->pI2Cx->SR1) & ( 1 << I2C_SR1_SMBALERT);
+	if(temp1  && temp2)
+	{
+		pI2CHandle->pI2Cx->SR1 &= ~( 1 << I2C_SR1_SMBALERT);
+
+		if (pI2CHandle->I2CConfig.I2C_Mode == I2C_MODE_SMBUS_HOST)
+		{
+			//a device pulled SMBA low
+			I2C_ApplicationEventCallback(pI2CHandle, I2C_EV_SMBALERT);
+		}
+		else
+		{
+			//alert response address received, answered from the TXE handler
+			pI2CHandle->SMBAlertAck = SET;
+		}
+	}
+
+	if (error == 0) return;
+
+	if (pI2CHandle->TxRxState != I2C_READY)
+	{
+		I2C_AbortTransfer(pI2CHandle);
+		if (recover)
+		{
+			pI2CHandle->RecoveryPending = SET;
+		}
+		I2C_MasterNotifyDone(pI2CHandle, error);
+	}
+	else
+	{
+		if (stuck)
+		{
+			pI2CHandle->RecoveryPending = SET;
+		}
+		I2C_ApplicationEventCallback(pI2CHandle, error);
 	}
 }
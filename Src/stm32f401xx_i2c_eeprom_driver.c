@@ -0,0 +1,418 @@
+/*
+ * stm32f401xx_i2c_eeprom_driver.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#include "stm32f401xx_i2c_eeprom_driver.h"
+
+
+//7 bit device address, address bits above the address bytes go into the A2..A0 field
+static uint8_t ee_dev_addr(EE_Handle_t *pEEHandle, uint32_t Addr)
+{
+	return pEEHandle->DevAddr | ((Addr >> (8 * pEEHandle->AddrSize)) & 0x07);
+}
+
+//bytes reachable through one device address
+static uint32_t ee_block_size(EE_Handle_t *pEEHandle)
+{
+	return (1UL << (8 * pEEHandle->AddrSize));
+}
+
+//bytes from Addr to the end of its page, a page write wraps inside the page past that
+static uint32_t ee_page_room(EE_Handle_t *pEEHandle, uint32_t Addr)
+{
+	return pEEHandle->PageSize - (Addr & (pEEHandle->PageSize - 1));
+}
+
+
+/*********************************************************************
+ * @fn      		  - EE_Init
+ *
+ * @brief             - resets the driver state and checks that the EEPROM answers
+ *
+ * @param[in]         - EEPROM handle with pI2CHandle, DevAddr, AddrSize, PageSize and Capacity filled in
+ *
+ * @return            - EE_OK, EE_ERR_TIMEOUT (no ACK) or EE_ERR_I2C
+ *
+ * @Note              - the I2C has to be initialized by the app. Asynchronous writes also need a
+ *                      transaction queue on the bus (I2C_TxnQueueInit).
+ */
+uint8_t EE_Init(EE_Handle_t *pEEHandle)
+{
+	DWT_CycleCounterInit();
+
+	pEEHandle->pHead = NULL;
+	pEEHandle->pTail = NULL;
+	pEEHandle->Done = 0;
+	pEEHandle->ChunkLen = 0;
+	pEEHandle->Phase = EE_PHASE_IDLE;
+	pEEHandle->PagesWritten = 0;
+	pEEHandle->PollCount = 0;
+	pEEHandle->Txn.Status = I2C_TXN_IDLE;
+
+	//a write cycle may still be running from before a reset
+	pEEHandle->WriteCycle = SET;
+	return EE_WaitReady(pEEHandle);
+}
+
+/*********************************************************************
+ * @fn      		  - EE_WaitReady
+ *
+ * @brief             - ACK polls the device until the write cycle of the last page write ends
+ *
+ * @param[in]         - EEPROM handle
+ *
+ * @return            - EE_OK, EE_ERR_TIMEOUT or EE_ERR_I2C
+ *
+ * @Note              - returns at once if no blocking write is pending. The device does not
+ *                      acknowledge its address while it programs, the first ACK ends the wait,
+ *                      typically well before the 5 ms datasheet maximum.
+ */
+uint8_t EE_WaitReady(EE_Handle_t *pEEHandle)
+{
+	uint32_t start = DWT_GetCycles();
+	uint8_t status;
+
+	if (!pEEHandle->WriteCycle) return EE_OK;
+
+	while(1)
+	{
+		status = I2C_MasterProbe(pEEHandle->pI2CHandle, pEEHandle->DevAddr);
+		if (status == I2C_OK) break;
+		if (status != I2C_ERR_NACK) return EE_ERR_I2C;
+
+		pEEHandle->PollCount++;
+		if (DWT_IsElapsed(start, DWT_MsToCycles(EE_TIMEOUT_WRITE_MS))) return EE_ERR_TIMEOUT;
+	}
+
+	pEEHandle->WriteCycle = RESET;
+	return EE_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - EE_Read
+ *
+ * @brief             - sequential read of any length
+ *
+ * @param[in]         - EEPROM handle
+ * @param[in]         - EEPROM byte address
+ * @param[in]         - destination buffer
+ * @param[in]         - number of bytes
+ *
+ * @return            - EE_OK, EE_ERR_RANGE, EE_ERR_BUSY, EE_ERR_TIMEOUT or EE_ERR_I2C
+ *
+ * @Note              - one register read per device address block, the device increments its
+ *                      address pointer across pages on reads
+ */
+uint8_t EE_Read(EE_Handle_t *pEEHandle, uint32_t Addr, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint32_t block = ee_block_size(pEEHandle);
+	uint32_t chunk;
+	uint8_t status;
+
+	if ((Addr + Len) > pEEHandle->Capacity) return EE_ERR_RANGE;
+	if (pEEHandle->pHead != NULL) return EE_ERR_BUSY;
+
+	status = EE_WaitReady(pEEHandle);
+	if (status != EE_OK) return status;
+
+	while(Len > 0)
+	{
+		chunk = block - (Addr & (block - 1));
+		if (chunk > Len) chunk = Len;
+
+		if (I2C_MemRead(pEEHandle->pI2CHandle, ee_dev_addr(pEEHandle, Addr), (uint16_t)(Addr & (block - 1)),
+				pEEHandle->AddrSize, pRxBuffer, chunk) != I2C_OK)
+		{
+			return EE_ERR_I2C;
+		}
+
+		Addr += chunk;
+		pRxBuffer += chunk;
+		Len -= chunk;
+	}
+
+	return EE_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - EE_Write
+ *
+ * @brief             - blocking write of any length, split at page boundaries
+ *
+ * @param[in]         - EEPROM handle
+ * @param[in]         - EEPROM byte address
+ * @param[in]         - source buffer
+ * @param[in]         - number of bytes
+ *
+ * @return            - EE_OK, EE_ERR_RANGE, EE_ERR_BUSY, EE_ERR_TIMEOUT or EE_ERR_I2C
+ *
+ * @Note              - each page is sent as soon as ACK polling shows the previous write cycle
+ *                      ended. The write cycle of the last page is left running, the next call
+ *                      (or EE_WaitReady) polls for it.
+ */
+uint8_t EE_Write(EE_Handle_t *pEEHandle, uint32_t Addr, uint8_t *pTxBuffer, uint32_t Len)
+{
+	uint32_t block = ee_block_size(pEEHandle);
+	uint32_t chunk;
+	uint8_t status;
+
+	if ((Addr + Len) > pEEHandle->Capacity) return EE_ERR_RANGE;
+	if (pEEHandle->pHead != NULL) return EE_ERR_BUSY;
+
+	while(Len > 0)
+	{
+		chunk = ee_page_room(pEEHandle, Addr);
+		if (chunk > Len) chunk = Len;
+
+		status = EE_WaitReady(pEEHandle);
+		if (status != EE_OK) return status;
+
+		if (I2C_MemWrite(pEEHandle->pI2CHandle, ee_dev_addr(pEEHandle, Addr), (uint16_t)(Addr & (block - 1)),
+				pEEHandle->AddrSize, pTxBuffer, chunk) != I2C_OK)
+		{
+			return EE_ERR_I2C;
+		}
+		pEEHandle->WriteCycle = SET;
+		pEEHandle->PagesWritten++;
+
+		Addr += chunk;
+		pTxBuffer += chunk;
+		Len -= chunk;
+	}
+
+	return EE_OK;
+}
+
+
+/*
+ * Asynchronous writes. Each request is a chain of I2C transactions driven from the transaction
+ * callback: poll, page, poll, page, ..., poll. A request starts with a poll, which also covers a
+ * write cycle left running by a blocking write or a failed request, and completes once the
+ * last page is programmed.
+ */
+static void ee_txn_callback(I2C_Txn_t *pTxn, uint8_t AppEv);
+
+//returns the I2C_TxnSubmit status
+static uint8_t ee_submit_poll(EE_Handle_t *pEEHandle)
+{
+	I2C_Txn_t *pTxn = &pEEHandle->Txn;
+
+	pTxn->SlaveAddr = pEEHandle->DevAddr;
+	pTxn->pTxBuffer = NULL;
+	pTxn->TxLen = 0;
+	pTxn->pRxBuffer = NULL;
+	pTxn->RxLen = 0;
+	pTxn->Sr = I2C_DISABLE_SR;
+	pTxn->Flags = I2C_TXN_PROBE;
+	pTxn->pCallback = ee_txn_callback;
+	pTxn->pContext = pEEHandle;
+
+	pEEHandle->Phase = EE_PHASE_POLL;
+	return I2C_TxnSubmit(pEEHandle->pI2CHandle, pTxn, pEEHandle->Prio);
+}
+
+static uint8_t ee_submit_page(EE_Handle_t *pEEHandle)
+{
+	I2C_Txn_t *pTxn = &pEEHandle->Txn;
+	EE_Write_t *pReq = pEEHandle->pHead;
+	uint32_t addr = pReq->Addr + pEEHandle->Done;
+	uint32_t chunk = ee_page_room(pEEHandle, addr);
+	uint8_t hdr = 0;
+
+	if (chunk > (pReq->Len - pEEHandle->Done))
+	{
+		chunk = pReq->Len - pEEHandle->Done;
+	}
+
+	//address bytes MSB first, then the data in one transfer
+	if (pEEHandle->AddrSize == I2C_MEMADD_SIZE_16BIT)
+	{
+		pEEHandle->PageBuf[hdr++] = (uint8_t)(addr >> 8);
+	}
+	pEEHandle->PageBuf[hdr++] = (uint8_t)addr;
+	for (uint32_t i = 0; i < chunk; i++)
+	{
+		pEEHandle->PageBuf[hdr + i] = pReq->pData[pEEHandle->Done + i];
+	}
+
+	pTxn->SlaveAddr = ee_dev_addr(pEEHandle, addr);
+	pTxn->pTxBuffer = pEEHandle->PageBuf;
+	pTxn->TxLen = hdr + chunk;
+	pTxn->pRxBuffer = NULL;
+	pTxn->RxLen = 0;
+	pTxn->Sr = I2C_DISABLE_SR;
+	pTxn->Flags = 0;
+	pTxn->pCallback = ee_txn_callback;
+	pTxn->pContext = pEEHandle;
+
+	pEEHandle->ChunkLen = chunk;
+	pEEHandle->Phase = EE_PHASE_PAGE;
+	return I2C_TxnSubmit(pEEHandle->pI2CHandle, pTxn, pEEHandle->Prio);
+}
+
+//starts the request at pHead with its initial poll
+static uint8_t ee_start_request(EE_Handle_t *pEEHandle)
+{
+	pEEHandle->Done = 0;
+	pEEHandle->PollStart = DWT_GetCycles();
+	return ee_submit_poll(pEEHandle);
+}
+
+/*
+ * Completes the request at pHead and moves on to the next one. A next request whose first
+ * transaction cannot be submitted is completed with EE_ERR_I2C as well, in queue order.
+ */
+static void ee_finish(EE_Handle_t *pEEHandle, uint8_t Status)
+{
+	EE_Write_t *pReq;
+	uint32_t primask;
+	uint8_t next;
+
+	do
+	{
+		DRV_ENTER_CRITICAL(primask);
+		pReq = pEEHandle->pHead;
+		pEEHandle->pHead = pReq->pNext;
+		if (pEEHandle->pHead == NULL)
+		{
+			pEEHandle->pTail = NULL;
+		}
+		DRV_EXIT_CRITICAL(primask);
+
+		pReq->Status = Status;
+
+		next = I2C_OK;
+		if (pEEHandle->pHead != NULL)
+		{
+			next = ee_start_request(pEEHandle);
+		}
+		else
+		{
+			pEEHandle->Phase = EE_PHASE_IDLE;
+		}
+
+		if (pReq->pCallback != NULL)
+		{
+			pReq->pCallback(pReq, Status);
+		}
+
+		Status = EE_ERR_I2C;
+	} while (next != I2C_OK);
+}
+
+static void ee_txn_callback(I2C_Txn_t *pTxn, uint8_t AppEv)
+{
+	EE_Handle_t *pEEHandle = (EE_Handle_t *)pTxn->pContext;
+
+	if (pEEHandle->Phase == EE_PHASE_PAGE)
+	{
+		if (AppEv != I2C_EV_TX_CMPLT)
+		{
+			ee_finish(pEEHandle, EE_ERR_I2C);
+			return;
+		}
+
+		pEEHandle->Done += pEEHandle->ChunkLen;
+		pEEHandle->PagesWritten++;
+		pEEHandle->PollStart = DWT_GetCycles();
+		if (ee_submit_poll(pEEHandle) != I2C_OK)
+		{
+			ee_finish(pEEHandle, EE_ERR_I2C);
+		}
+		return;
+	}
+
+	//EE_PHASE_POLL
+	if (AppEv == I2C_EV_TX_CMPLT)
+	{
+		//write cycle over, the next page goes out right away
+		if (pEEHandle->Done == pEEHandle->pHead->Len)
+		{
+			ee_finish(pEEHandle, EE_OK);
+		}
+		else if (ee_submit_page(pEEHandle) != I2C_OK)
+		{
+			ee_finish(pEEHandle, EE_ERR_I2C);
+		}
+	}
+	else if (AppEv == I2C_ERROR_AF)
+	{
+		pEEHandle->PollCount++;
+		if (DWT_IsElapsed(pEEHandle->PollStart, DWT_MsToCycles(EE_TIMEOUT_WRITE_MS)))
+		{
+			ee_finish(pEEHandle, EE_ERR_TIMEOUT);
+		}
+		else if (ee_submit_poll(pEEHandle) != I2C_OK)
+		{
+			ee_finish(pEEHandle, EE_ERR_I2C);
+		}
+	}
+	else
+	{
+		ee_finish(pEEHandle, EE_ERR_I2C);
+	}
+}
+
+/*********************************************************************
+ * @fn      		  - EE_WriteAsync
+ *
+ * @brief             - queues a write of any length, it starts at once if the driver is idle
+ *
+ * @param[in]         - EEPROM handle, its bus needs a transaction queue
+ * @param[in]         - request, owned by the driver until its callback runs
+ *
+ * @return            - EE_OK, EE_ERR_RANGE or EE_ERR_I2C (no transaction queue)
+ *
+ * @Note              - requests complete in order. Pages are chained from the I2C interrupt,
+ *                      each one is sent on the first ACK of the poll that follows the previous
+ *                      page. The data is copied page by page, pData must stay valid until the
+ *                      callback. Other transactions of the bus interleave with the polls.
+ */
+uint8_t EE_WriteAsync(EE_Handle_t *pEEHandle, EE_Write_t *pReq)
+{
+	uint32_t primask;
+	uint8_t start;
+
+	if ((pReq->Len == 0) || ((pReq->Addr + pReq->Len) > pEEHandle->Capacity)) return EE_ERR_RANGE;
+	if (pEEHandle->pI2CHandle->pQueue == NULL) return EE_ERR_I2C;
+
+	pReq->Status = EE_BUSY;
+	pReq->pNext = NULL;
+
+	DRV_ENTER_CRITICAL(primask);
+	if (pEEHandle->pTail != NULL)
+	{
+		pEEHandle->pTail->pNext = pReq;
+	}
+	else
+	{
+		pEEHandle->pHead = pReq;
+	}
+	pEEHandle->pTail = pReq;
+	start = (pEEHandle->pHead == pReq);
+	DRV_EXIT_CRITICAL(primask);
+
+	if (start)
+	{
+		//a write cycle left by a blocking write is covered by the first poll
+		pEEHandle->WriteCycle = RESET;
+		if (ee_start_request(pEEHandle) != I2C_OK)
+		{
+			//reported through the callback like any other failed request
+			ee_finish(pEEHandle, EE_ERR_I2C);
+		}
+	}
+
+	return EE_OK;
+}
+
+//returns 1 when no asynchronous write is queued or in progress, polling it also restarts
+//a bus start deferred behind a pending STOP
+uint8_t EE_IsIdle(EE_Handle_t *pEEHandle)
+{
+	I2C_TxnProcess(pEEHandle->pI2CHandle);
+	return (pEEHandle->pHead == NULL);
+}
@@ -0,0 +1,395 @@
+/*
+ * stm32f401xx_i2s_driver.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#include "stm32f401xx_i2s_driver.h"
+
+//limits of the PLLI2S and of the I2S prescaler (RM0368)
+#define I2S_PLLI2SN_MIN				50
+#define I2S_PLLI2SN_MAX				432
+#define I2S_PLLI2SR_MIN				2
+#define I2S_PLLI2SR_MAX				7
+#define I2S_VCO_MIN					100000000ULL
+#define I2S_VCO_MAX					432000000ULL
+#define I2S_CLK_MAX					192000000ULL
+#define I2S_DIV_MIN					2
+#define I2S_DIV_MAX					255
+
+//waits until (*pReg & Mask) == Value, at most TimeoutUs
+static uint8_t i2s_wait(__vo uint32_t *pReg, uint32_t Mask, uint32_t Value, uint32_t TimeoutUs)
+{
+	uint32_t start = DWT_GetCycles();
+	uint32_t budget = DWT_UsToCycles(TimeoutUs);
+
+	while ((*pReg & Mask) != Value)
+	{
+		if (DWT_IsElapsed(start, budget)) return I2S_ERR_TIMEOUT;
+	}
+
+	return I2S_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - I2S_ComputeClock
+ *
+ * @brief             - searches PLLI2SN, PLLI2SR, I2SDIV and ODD for the closest sample rate
+ *
+ * @param[in]         - requested sample rate in Hz (8 kHz .. 96 kHz)
+ * @param[in]         - @I2S_DataFormat, selects a 16 or 32 bit channel
+ * @param[in]         - ENABLE when MCLK is output (fixes the ratio to 256 * Fs)
+ * @param[out]        - PLLI2SN
+ * @param[out]        - PLLI2SR
+ * @param[out]        - I2SPR value without MCKOE (I2SDIV | ODD << 8)
+ * @param[out]        - sample rate that will actually be produced, rounded to 1 Hz
+ * @param[out]        - signed error of the exact achieved rate against the requested one, in ppm
+ *
+ * @return            - I2S_OK or I2S_ERR_FREQ
+ *
+ * @Note              - Fs = PLL input / PLLM * PLLI2SN / PLLI2SR / (K * (2 * I2SDIV + ODD)),
+ *                      with K = 256 with MCLK, 32 for a 16 bit and 64 for a 32 bit channel.
+ *                      PLLM and the PLL source are shared with the main PLL and are taken as
+ *                      they are. Candidates are compared on the exact fraction, not on the
+ *                      rounded frequency.
+ */
+uint8_t I2S_ComputeClock(uint32_t AudioFreq, uint8_t DataFormat, uint8_t MCLKOutput, uint32_t *pPLLI2SN,
+		uint32_t *pPLLI2SR, uint32_t *pI2SDiv, uint32_t *pAchievedFreq, int32_t *pErrorPpm)
+{
+	uint64_t src, vco, target, num, den, err;
+	uint64_t best_num = 0, best_den = 1, best_err = 0;
+	uint32_t pllm, k, n, r, div;
+	uint32_t best_n = 0, best_r = 0, best_div = 0;
+
+	if ((AudioFreq < I2S_AUDIOFREQ_8K) || (AudioFreq > I2S_AUDIOFREQ_96K)) return I2S_ERR_FREQ;
+
+	src = (DRV_RCC->PLLCFGR & (1 << RCC_PLLCFGR_PLLSRC)) ? DRV_HSE_VALUE : DRV_HSI_VALUE;
+	pllm = (DRV_RCC->PLLCFGR >> RCC_PLLCFGR_PLLM) & 0x3F;
+	if (pllm < 2) return I2S_ERR_FREQ;
+
+	if (MCLKOutput == ENABLE)
+	{
+		k = 256;
+	}
+	else if (DataFormat == I2S_DATAFORMAT_16B)
+	{
+		k = 32;
+	}
+	else
+	{
+		k = 64;
+	}
+
+	for (n = I2S_PLLI2SN_MIN; n <= I2S_PLLI2SN_MAX; n++)
+	{
+		vco = (src * n) / pllm;
+		if ((vco < I2S_VCO_MIN) || (vco > I2S_VCO_MAX)) continue;
+
+		for (r = I2S_PLLI2SR_MIN; r <= I2S_PLLI2SR_MAX; r++)
+		{
+			if ((vco / r) > I2S_CLK_MAX) continue;
+
+			//Fs = src * n / (pllm * r * k * div), pick the nearest divider
+			num = src * n;
+			target = (uint64_t)pllm * r * k * AudioFreq;
+			div = (uint32_t)((num + target / 2) / target);
+			if (div < (2 * I2S_DIV_MIN)) div = 2 * I2S_DIV_MIN;
+			if (div > (2 * I2S_DIV_MAX + 1)) div = 2 * I2S_DIV_MAX + 1;
+
+			//|Fs - AudioFreq| / AudioFreq = |num - target * div| / (target * div), in 0.01 ppm
+			den = target * div;
+			err = (num > den) ? (num - den) : (den - num);
+			err = (err * 100000000ULL) / den;
+
+			if ((best_div == 0) || (err < best_err))
+			{
+				best_err = err;
+				best_num = num;
+				best_den = (uint64_t)pllm * r * k * div;
+				best_n = n;
+				best_r = r;
+				best_div = div;
+			}
+		}
+	}
+
+	if (best_div == 0) return I2S_ERR_FREQ;
+
+	*pPLLI2SN = best_n;
+	*pPLLI2SR = best_r;
+	*pI2SDiv = (best_div / 2) | ((best_div & 0x1) << SPI_I2SPR_ODD);
+	*pAchievedFreq = (uint32_t)((best_num + best_den / 2) / best_den);
+	*pErrorPpm = (int32_t)(best_err / 100);
+	if (best_num < (best_den * AudioFreq))
+	{
+		*pErrorPpm = -*pErrorPpm;
+	}
+
+	return I2S_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - I2S_Init
+ *
+ * @brief             - configures SPI2/SPI3 in I2S mode, in master modes also the PLLI2S
+ *
+ * @param[in]         - I2S handle
+ *
+ * @return            - I2S_OK, I2S_ERR_FREQ or I2S_ERR_TIMEOUT if PLLI2S does not lock
+ *
+ * @Note              - PLLI2S feeds both SPI2 and SPI3, a second master instance has to use
+ *                      a sample rate reachable from the same PLLI2S settings
+ */
+uint8_t I2S_Init(I2S_Handle_t *pI2SHandle)
+{
+	uint32_t tempreg = 0;
+	uint32_t plln, pllr, i2sdiv, achieved;
+	int32_t ppm;
+	uint8_t mode = pI2SHandle->I2SConfig.I2S_Mode;
+	uint8_t std = pI2SHandle->I2SConfig.I2S_Standard;
+
+	SPI_PeriClockControl(pI2SHandle->pSPIx, ENABLE);
+	DWT_CycleCounterInit();
+
+	//the peripheral has to be disabled while it is configured
+	pI2SHandle->pSPIx->I2SCFGR &= ~(1 << SPI_I2SCFGR_I2SE);
+
+	pI2SHandle->State = I2S_READY;
+	pI2SHandle->ErrCount = 0;
+	pI2SHandle->AchievedFreq = 0;
+	pI2SHandle->FreqErrorPpm = 0;
+
+	if ((mode == I2S_MODE_MASTER_TX) || (mode == I2S_MODE_MASTER_RX))
+	{
+		if (I2S_ComputeClock(pI2SHandle->I2SConfig.I2S_AudioFreq, pI2SHandle->I2SConfig.I2S_DataFormat,
+				pI2SHandle->I2SConfig.I2S_MCLKOutput, &plln, &pllr, &i2sdiv, &achieved, &ppm) != I2S_OK)
+		{
+			return I2S_ERR_FREQ;
+		}
+
+		//PLLI2S can only be reprogrammed while it is off
+		DRV_RCC->CR &= ~(1 << RCC_CR_PLLI2SON);
+		if (i2s_wait(&DRV_RCC->CR, (1 << RCC_CR_PLLI2SRDY), 0, I2S_TIMEOUT_PLL_US) != I2S_OK) return I2S_ERR_TIMEOUT;
+
+		DRV_RCC->PLLI2SCFGR = (plln << RCC_PLLI2SCFGR_PLLI2SN) | (pllr << RCC_PLLI2SCFGR_PLLI2SR);
+
+		DRV_RCC->CR |= (1 << RCC_CR_PLLI2SON);
+		if (i2s_wait(&DRV_RCC->CR, (1 << RCC_CR_PLLI2SRDY), (1 << RCC_CR_PLLI2SRDY), I2S_TIMEOUT_PLL_US) != I2S_OK)
+		{
+			return I2S_ERR_TIMEOUT;
+		}
+
+		//I2S clock taken from PLLI2S, not from the external I2S_CKIN pin
+		DRV_RCC->CFGR &= ~(1 << RCC_CFGR_I2SSRC);
+
+		if (pI2SHandle->I2SConfig.I2S_MCLKOutput == ENABLE)
+		{
+			i2sdiv |= (1 << SPI_I2SPR_MCKOE);
+		}
+		pI2SHandle->pSPIx->I2SPR = i2sdiv;
+
+		pI2SHandle->AchievedFreq = achieved;
+		pI2SHandle->FreqErrorPpm = ppm;
+	}
+	else
+	{
+		//the slave takes CK and WS from the master, the prescaler is not used
+		pI2SHandle->pSPIx->I2SPR = (I2S_DIV_MIN << SPI_I2SPR_I2SDIV);
+	}
+
+	//I2S mode and direction
+	tempreg |= (1 << SPI_I2SCFGR_I2SMOD);
+	tempreg |= (mode << SPI_I2SCFGR_I2SCFG);
+
+	//standard, the two PCM variants only differ in the frame sync length
+	if (std >= I2S_STD_PCM_SHORT)
+	{
+		tempreg |= (3 << SPI_I2SCFGR_I2SSTD);
+		if (std == I2S_STD_PCM_LONG)
+		{
+			tempreg |= (1 << SPI_I2SCFGR_PCMSYNC);
+		}
+	}
+	else
+	{
+		tempreg |= (std << SPI_I2SCFGR_I2SSTD);
+	}
+
+	//clock polarity
+	tempreg |= (pI2SHandle->I2SConfig.I2S_CPOL << SPI_I2SCFGR_CKPOL);
+
+	//data and channel length
+	if (pI2SHandle->I2SConfig.I2S_DataFormat == I2S_DATAFORMAT_16B_EXTENDED)
+	{
+		tempreg |= (1 << SPI_I2SCFGR_CHLEN);
+	}
+	else if (pI2SHandle->I2SConfig.I2S_DataFormat == I2S_DATAFORMAT_24B)
+	{
+		tempreg |= (1 << SPI_I2SCFGR_DATLEN);
+		tempreg |= (1 << SPI_I2SCFGR_CHLEN);
+	}
+	else if (pI2SHandle->I2SConfig.I2S_DataFormat == I2S_DATAFORMAT_32B)
+	{
+		tempreg |= (2 << SPI_I2SCFGR_DATLEN);
+		tempreg |= (1 << SPI_I2SCFGR_CHLEN);
+	}
+
+	pI2SHandle->pSPIx->I2SCFGR = tempreg;
+
+	return I2S_OK;
+}
+
+void I2S_DeInit(I2S_Handle_t *pI2SHandle)
+{
+	I2S_StopStream(pI2SHandle);
+	pI2SHandle->pSPIx->I2SCFGR = 0;
+}
+
+/*********************************************************************
+ * @fn      		  - I2S_StartStreamDMA
+ *
+ * @brief             - starts continuous transmission/reception from/into a circular buffer
+ *
+ * @param[in]         - I2S handle
+ * @param[in]         - audio buffer, left/right samples interleaved
+ * @param[in]         - buffer length in 16 bit words, even, at most 65535
+ *
+ * @return            - I2S_OK or I2S_ERR_BUSY
+ *
+ * @Note              - 24 and 32 bit samples take two words each, most significant word first.
+ *                      The DMA runs in circular mode and raises I2S_EVENT_HALF_CMPLT and
+ *                      I2S_EVENT_CMPLT; the app refills (TX) or consumes (RX) the half that was
+ *                      just finished and has a full half buffer period for it, independent of
+ *                      CPU load in between.
+ */
+uint8_t I2S_StartStreamDMA(I2S_Handle_t *pI2SHandle, uint16_t *pBuffer, uint32_t Len)
+{
+	uint8_t mode = pI2SHandle->I2SConfig.I2S_Mode;
+	uint8_t tx = ((mode == I2S_MODE_MASTER_TX) || (mode == I2S_MODE_SLAVE_TX));
+
+	if (pI2SHandle->State != I2S_READY) return I2S_ERR_BUSY;
+
+	pI2SHandle->pBuffer = pBuffer;
+	pI2SHandle->BufLen = Len;
+	pI2SHandle->State = I2S_BUSY_IN_STREAM;
+
+	pI2SHandle->pDMA->DMAConfig.DMA_Direction = tx ? DMA_DIR_MEM_TO_PERIPH : DMA_DIR_PERIPH_TO_MEM;
+	pI2SHandle->pDMA->DMAConfig.DMA_DataSize = DMA_DATA_SIZE_HALFWORD;
+	pI2SHandle->pDMA->DMAConfig.DMA_MemInc = ENABLE;
+	pI2SHandle->pDMA->DMAConfig.DMA_Mode = DMA_MODE_CIRCULAR;
+	pI2SHandle->pDMA->DMAConfig.DMA_ITControl = DMA_IT_HT | DMA_IT_TC | DMA_IT_TE;
+	DMA_Init(pI2SHandle->pDMA);
+	DMA_StartTransfer(pI2SHandle->pDMA, (uint32_t)&pI2SHandle->pSPIx->DR, (uint32_t)pBuffer, 0, (uint16_t)Len);
+
+	//the DMA request has to be enabled before I2SE so the first frame is already loaded
+	if (tx)
+	{
+		pI2SHandle->pSPIx->CR2 |= (1 << SPI_CR2_TXDMAEN);
+	}
+	else
+	{
+		pI2SHandle->pSPIx->CR2 |= (1 << SPI_CR2_RXDMAEN);
+	}
+	pI2SHandle->pSPIx->CR2 |= (1 << SPI_CR2_ERRIE);
+
+	pI2SHandle->pSPIx->I2SCFGR |= (1 << SPI_I2SCFGR_I2SE);
+
+	return I2S_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - I2S_StopStream
+ *
+ * @brief             - stops the DMA and the peripheral, in the transmit modes after the last frame
+ *
+ * @param[in]         - I2S handle
+ *
+ * @return            - I2S_OK, or I2S_ERR_TIMEOUT if the last frame did not go out within
+ *                      I2S_TIMEOUT_STOP_US (e.g. a slave without clock from the master)
+ *
+ * @Note              - also called from I2S_DMAIRQHandling on a transfer error, the waits are
+ *                      bounded for that reason. The stream is stopped in any case.
+ */
+uint8_t I2S_StopStream(I2S_Handle_t *pI2SHandle)
+{
+	uint8_t mode = pI2SHandle->I2SConfig.I2S_Mode;
+	uint8_t status = I2S_OK;
+
+	if (pI2SHandle->State != I2S_BUSY_IN_STREAM) return I2S_OK;
+
+	pI2SHandle->pSPIx->CR2 &= ~((1 << SPI_CR2_TXDMAEN) | (1 << SPI_CR2_RXDMAEN) | (1 << SPI_CR2_ERRIE));
+	DMA_StopTransfer(pI2SHandle->pDMA);
+
+	if ((mode == I2S_MODE_MASTER_TX) || (mode == I2S_MODE_SLAVE_TX))
+	{
+		//let the last frame go out before switching off
+		status = i2s_wait(&pI2SHandle->pSPIx->SR, (1 << SPI_SR_TXE), (1 << SPI_SR_TXE), I2S_TIMEOUT_STOP_US);
+		if (status == I2S_OK)
+		{
+			status = i2s_wait(&pI2SHandle->pSPIx->SR, (1 << SPI_SR_BSY), 0, I2S_TIMEOUT_STOP_US);
+		}
+	}
+
+	pI2SHandle->pSPIx->I2SCFGR &= ~(1 << SPI_I2SCFGR_I2SE);
+	pI2SHandle->State = I2S_READY;
+
+	return status;
+}
+
+//to be called from the IRQ handler of the DMA stream
+void I2S_DMAIRQHandling(I2S_Handle_t *pI2SHandle)
+{
+	uint8_t flags = DMA_GetFlags(pI2SHandle->pDMA);
+
+	DMA_ClearFlags(pI2SHandle->pDMA, flags);
+
+	if (flags & DMA_FLAG_HT)
+	{
+		I2S_ApplicationEventCallback(pI2SHandle, I2S_EVENT_HALF_CMPLT);
+	}
+
+	if (flags & DMA_FLAG_TC)
+	{
+		I2S_ApplicationEventCallback(pI2SHandle, I2S_EVENT_CMPLT);
+	}
+
+	if (flags & DMA_FLAG_TE)
+	{
+		//the hardware has disabled the stream
+		if (I2S_StopStream(pI2SHandle) != I2S_OK)
+		{
+			I2S_ApplicationEventCallback(pI2SHandle, I2S_EVENT_STOP_TIMEOUT);
+		}
+		I2S_ApplicationEventCallback(pI2SHandle, I2S_EVENT_DMA_ERR);
+	}
+}
+
+//to be called from the SPI2/SPI3 IRQ handler
+void I2S_IRQHandling(I2S_Handle_t *pI2SHandle)
+{
+	uint32_t sr = pI2SHandle->pSPIx->SR;
+	uint32_t temp;
+
+	if (sr & (1 << SPI_SR_UDR))
+	{
+		//cleared by the SR read above
+		pI2SHandle->ErrCount++;
+		I2S_ApplicationEventCallback(pI2SHandle, I2S_EVENT_UDR_ERR);
+	}
+
+	if (sr & (1 << SPI_SR_OVR))
+	{
+		//cleared by reading DR and then SR
+		temp = pI2SHandle->pSPIx->DR;
+		temp = pI2SHandle->pSPIx->SR;
+		(void)temp;
+		pI2SHandle->ErrCount++;
+		I2S_ApplicationEventCallback(pI2SHandle, I2S_EVENT_OVR_ERR);
+	}
+}
+
+__weak void I2S_ApplicationEventCallback(I2S_Handle_t *pI2SHandle, uint8_t AppEv)
+{
+	//this is a weak implementation and it can be overriden by the app
+}
@@ -0,0 +1,106 @@
+/*
+ * stm32f401xx_rcc_driver.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#include "stm32f401xx_rcc_driver.h"
+
+
+uint16_t AHB_PreScaler[8] = {2, 4, 8, 16, 64, 128, 256, 512};	//HPRE has no divide by 32
+uint16_t APB_PreScaler[4] = {2, 4, 8, 16};
+
+
+uint32_t RCC_GetPLLOutputClock()
+{
+	uint64_t pllin;
+	uint32_t pllm, plln, pllp;
+
+	//PLL input is HSE or HSI, divided by PLLM, multiplied by PLLN and divided by PLLP
+	pllin = (DRV_RCC->PLLCFGR & (1 << RCC_PLLCFGR_PLLSRC)) ? DRV_HSE_VALUE : DRV_HSI_VALUE;
+	pllm = (DRV_RCC->PLLCFGR >> RCC_PLLCFGR_PLLM) & 0x3F;
+	plln = (DRV_RCC->PLLCFGR >> RCC_PLLCFGR_PLLN) & 0x1FF;
+	pllp = (((DRV_RCC->PLLCFGR >> RCC_PLLCFGR_PLLP) & 0x3) + 1) * 2;
+
+	if (pllm == 0) return 0;
+
+	return (uint32_t)((pllin * plln) / (pllm * pllp));
+}
+
+
+uint32_t RCC_GetHCLKValue(void)
+{
+	uint32_t SystemClk = DRV_HSI_VALUE, temp;
+	uint16_t ahbp;
+	uint8_t clksrc;
+
+	clksrc =((DRV_RCC->CFGR >> RCC_CFGR_SWS) & 0x3);
+
+	if(clksrc == 0)
+	{
+		SystemClk = DRV_HSI_VALUE;
+	}
+	else if(clksrc == 1)
+	{
+		SystemClk = DRV_HSE_VALUE;
+	}
+	else if(clksrc == 2)
+	{
+		SystemClk = RCC_GetPLLOutputClock();
+	}
+
+	//for ahb
+	temp = ((DRV_RCC->CFGR >> RCC_CFGR_HPRE) & 0xF);
+
+	if(temp < 8)
+	{
+		ahbp = 1;
+	}
+	else
+	{
+	  ahbp = AHB_PreScaler[temp - 8];
+	}
+
+	return SystemClk / ahbp;
+}
+
+uint32_t RCC_GetPCLK1Value(void)
+{
+	uint32_t temp;
+	uint8_t apb1p;
+
+	//for apb1
+	temp = ((DRV_RCC->CFGR >> RCC_CFGR_PPRE1) & 0x7);
+
+	if(temp < 4)
+	{
+		apb1p = 1;
+	}
+	else
+	{
+		apb1p = APB_PreScaler[temp - 4];
+	}
+
+	return RCC_GetHCLKValue() / apb1p;
+}
+
+uint32_t RCC_GetPCLK2Value(void)
+{
+	uint32_t temp;
+	uint8_t apb2p;
+
+	//for apb2
+	temp = ((DRV_RCC->CFGR >> RCC_CFGR_PPRE2) & 0x7);
+
+	if(temp < 4)
+	{
+		apb2p = 1;
+	}
+	else
+	{
+		apb2p = APB_PreScaler[temp - 4];
+	}
+
+	return RCC_GetHCLKValue() / apb2p;
+}
@@ -86,8 +86,15 @@ void SPI_Init(SPI_Handle_t *pSPIHandle)
 		tempreg |= (1 << 10);
 	}
 
-	//configure the spi serial clock speed
-	tempreg |= pSPIHandle->SPIConfig.SPI_SclkSpeed << 3;
+	//configure the spi serial clock speed, either the raw divider or one computed from a frequency
+	if(pSPIHandle->SPIConfig.SPI_SclkSpeed == SPI_SCLK_SPEED_AUTO)
+	{
+		tempreg |= SPI_ComputeSclkSpeed(pSPIHandle->pSPIx, pSPIHandle->SPIConfig.SPI_MaxSclkHz) << 3;
+	}
+	else
+	{
+		tempreg |= pSPIHandle->SPIConfig.SPI_SclkSpeed << 3;
+	}
 
 	//configure the DFF
 	tempreg |= pSPIHandle->SPIConfig.SPI_DFF << 11;
@@ -98,8 +105,21 @@ void SPI_Init(SPI_Handle_t *pSPIHandle)
 	//configure the CPHA
 	tempreg |= pSPIHandle->SPIConfig.SPI_CPHA << 0;
 
+	//configure the SSM, a master managing NSS in software needs SSI high or it faults with MODF
+	if(pSPIHandle->SPIConfig.SPI_SSM == SPI_SSM_EN)
+	{
+		tempreg |= (1 << SPI_CR1_SSM);
+		if(pSPIHandle->SPIConfig.SPI_DeviceMode == SPI_DEVICE_MODE_MASTER)
+		{
+			tempreg |= (1 << SPI_CR1_SSI);
+		}
+	}
+
 
 	pSPIHandle->pSPIx->CR1 = tempreg;
+
+	//no streaming context until SPI_SlaveStreamStart is called
+	pSPIHandle->pStream = NULL;
 }
 void SPI_DeInit(SPI_RegDef_t *pSPIx); //To do
 
@@ -149,6 +169,83 @@ void SPI_PeripheralControl(SPI_RegDef_t *pSPIx, uint8_t EnOrDi){
 	}
 }
 
+//SPI1 and SPI4 sit on APB2, SPI2 and SPI3 on APB1
+static uint32_t spi_get_pclk(SPI_RegDef_t *pSPIx)
+{
+	if ((pSPIx == DRV_SPI1) || (pSPIx == DRV_SPI4))
+	{
+		return RCC_GetPCLK2Value();
+	}
+
+	return RCC_GetPCLK1Value();
+}
+
+/*********************************************************************
+ * @fn      		  - SPI_ComputeSclkSpeed
+ *
+ * @brief             - picks the fastest baud rate prescaler whose SCLK does not exceed MaxSclkHz
+ *
+ * @param[in]         - SPI peripheral, selects the APB bus clock
+ * @param[in]         - highest SCLK frequency the slave accepts
+ *
+ * @return            - @SPI_SclkSpeed code
+ *
+ * @Note              - if even PCLK/256 is too fast the slowest divider is returned
+ */
+uint8_t SPI_ComputeSclkSpeed(SPI_RegDef_t *pSPIx, uint32_t MaxSclkHz)
+{
+	uint32_t pclk = spi_get_pclk(pSPIx);
+	uint8_t br;
+
+	for (br = SPI_SCLK_SPEED_DIV2; br < SPI_SCLK_SPEED_DIV256; br++)
+	{
+		if ((pclk >> (br + 1)) <= MaxSclkHz) break;
+	}
+
+	return br;
+}
+
+/*********************************************************************
+ * @fn      		  - SPI_SetSclkFreq
+ *
+ * @brief             - changes the prescaler at runtime, e.g. after a slow identification phase
+ *
+ * @param[in]         - SPI handle
+ * @param[in]         - highest SCLK frequency the slave accepts
+ *
+ * @return            - achieved SCLK frequency in Hz
+ *
+ * @Note              - BR may only be written with the peripheral disabled, it waits for the
+ *                      ongoing frame and restores SPE afterwards. The handle is switched to
+ *                      SPI_SCLK_SPEED_AUTO so a later SPI_Init keeps the frequency
+ */
+uint32_t SPI_SetSclkFreq(SPI_Handle_t *pSPIHandle, uint32_t MaxSclkHz)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+	uint32_t spe = pSPIx->CR1 & (1 << SPI_CR1_SPE);
+	uint8_t br = SPI_ComputeSclkSpeed(pSPIx, MaxSclkHz);
+
+	while(SPIGetFlagStatus(pSPIx, SPI_BUSY_FLAG));
+	pSPIx->CR1 &= ~(1 << SPI_CR1_SPE);
+
+	pSPIx->CR1 &= ~(0x7 << SPI_CR1_BR);
+	pSPIx->CR1 |= ((uint32_t)br << SPI_CR1_BR);
+	pSPIx->CR1 |= spe;
+
+	pSPIHandle->SPIConfig.SPI_SclkSpeed = SPI_SCLK_SPEED_AUTO;
+	pSPIHandle->SPIConfig.SPI_MaxSclkHz = MaxSclkHz;
+
+	return SPI_GetSclkFreq(pSPIx);
+}
+
+//SCLK produced by the prescaler currently programmed in CR1
+uint32_t SPI_GetSclkFreq(SPI_RegDef_t *pSPIx)
+{
+	uint8_t br = (pSPIx->CR1 >> SPI_CR1_BR) & 0x7;
+
+	return spi_get_pclk(pSPIx) >> (br + 1);
+}
+
 void SPI_SSIConfig(SPI_RegDef_t *pSPIx, uint8_t EnOrDi){
 	if (EnOrDi == ENABLE)
 	{
@@ -186,6 +283,42 @@ void SPI_ReceiveData(SPI_RegDef_t *pSPIx, uint8_t *pRxBuffer, uint32_t Len){
 		}
 }
 
+/*********************************************************************
+ * @fn      		  - SPI_TransferData
+ *
+ * @brief             - full duplex 8 bit transfer, every byte sent clocks one byte in
+ *
+ * @param[in]         - SPI peripheral
+ * @param[in]         - bytes to send, NULL sends 0xFF (dummy bytes for reading)
+ * @param[in]         - buffer for the received bytes, NULL discards them
+ * @param[in]         - number of bytes
+ *
+ * @return            - none
+ *
+ * @Note              - returns once the last byte is completely clocked, so the caller can
+ *                      release a software chip select right after. RXNE is drained for every
+ *                      byte, no OVR is left behind.
+ */
+void SPI_TransferData(SPI_RegDef_t *pSPIx, uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint8_t data;
+
+	while (Len > 0)
+	{
+		while(SPIGetFlagStatus(pSPIx, SPI_TXE_FLAG) == FLAG_RESET);
+		pSPIx->DR = (pTxBuffer != NULL) ? *pTxBuffer++ : 0xFF;
+
+		while(SPIGetFlagStatus(pSPIx, SPI_RXNE_FLAG) == FLAG_RESET);
+		data = (uint8_t)pSPIx->DR;
+		if (pRxBuffer != NULL)
+		{
+			*pRxBuffer++ = data;
+		}
+
+		Len--;
+	}
+}
+
 //IRQ configuration and ISR handling
 void SPI_IRQITConfig(uint8_t IRQNumber, uint8_t EnorDi);
 
@@ -312,7 +445,15 @@ static void spi_ovr_interrupt_handle(SPI_Handle_t *pSPIHandle)
 {
 	uint8_t temp;
 
-	if (pSPIHandle->TxState != SPI_BUSY_IN_TX){
+	if (pSPIHandle->pStream != NULL)
+	{
+		//a DR read here would take a byte from the DMA and shift the stream. OVR clears with
+		//the SR read once the DMA has read DR, which it does as it drains.
+		pSPIHandle->pStream->OvrErrCount++;
+		temp = pSPIHandle->pSPIx->SR;
+		(void)temp;
+	}
+	else if (pSPIHandle->TxState != SPI_BUSY_IN_TX){
 
 		temp = pSPIHandle->pSPIx->DR;
 		temp = pSPIHandle->pSPIx->SR;
@@ -344,6 +485,176 @@ void SPI_CloseReception(SPI_Handle_t *pSPIHandle)
 }
 
 
+/*********************************************************************
+ * @fn      		  - SPI_SlaveStreamStart
+ *
+ * @brief             - starts continuous slave reception into two ping-pong buffers
+ *
+ * @param[in]         - SPI handle, configured as slave
+ * @param[in]         - streaming context with pBuf, BufLen and pRxDMA filled in
+ *
+ * @return            - previous RxState, SPI_READY means the stream was started. SPI_ERR_PARAM
+ *                      if BufLen is 0, more than 65535 data items (NDTR is 16 bit) or odd with
+ *                      16 bit frames
+ *
+ * @Note              - The RX DMA stream runs in double buffer mode, so the hardware switches
+ *                      to the other buffer on its own and no byte depends on ISR latency.
+ *                      Use SPI_SSM_DI (hardware NSS) and route the NSS pin to an EXTI line on
+ *                      the rising edge whose handler calls SPI_SlaveStreamNSSHandling.
+ *                      Enable the peripheral with SPI_PeripheralControl after this call.
+ */
+uint8_t SPI_SlaveStreamStart(SPI_Handle_t *pSPIHandle, SPI_Stream_t *pStream)
+{
+	uint8_t state = pSPIHandle->RxState;
+	uint32_t items = pStream->BufLen;
+
+	//the DMA moves data items, in 16 bit mode that is half the number of bytes
+	if(pSPIHandle->pSPIx->CR1 & (1 << SPI_CR1_DFF))
+	{
+		if (items & 0x1) return SPI_ERR_PARAM;
+		items /= 2;
+	}
+	if ((items == 0) || (items > 0xFFFF)) return SPI_ERR_PARAM;
+
+	if(state == SPI_READY)
+	{
+		pStream->ReadyIdx = 0;
+		pStream->AppOwned[0] = 0;
+		pStream->AppOwned[1] = 0;
+		pStream->FrameEndIdx = 0;
+		pStream->FrameEndOffset = 0;
+		pStream->FrameCount = 0;
+		pStream->OverrunCount = 0;
+		pStream->OvrErrCount = 0;
+
+		pSPIHandle->pStream = pStream;
+		pSPIHandle->RxState = SPI_BUSY_IN_STREAM;
+
+		pStream->pRxDMA->DMAConfig.DMA_DataSize = DMA_DATA_SIZE_BYTE;
+		if(pSPIHandle->pSPIx->CR1 & (1 << SPI_CR1_DFF))
+		{
+			pStream->pRxDMA->DMAConfig.DMA_DataSize = DMA_DATA_SIZE_HALFWORD;
+		}
+		pStream->pRxDMA->DMAConfig.DMA_Direction = DMA_DIR_PERIPH_TO_MEM;
+		pStream->pRxDMA->DMAConfig.DMA_MemInc = ENABLE;
+		pStream->pRxDMA->DMAConfig.DMA_Mode = DMA_MODE_DOUBLE_BUFFER;
+		pStream->pRxDMA->DMAConfig.DMA_ITControl = DMA_IT_TC | DMA_IT_TE;
+		DMA_Init(pStream->pRxDMA);
+
+		//a stale byte in DR would shift the whole stream by one
+		SPI_ClearOVRFlag(pSPIHandle->pSPIx);
+
+		DMA_StartTransfer(pStream->pRxDMA, (uint32_t)&pSPIHandle->pSPIx->DR,
+				(uint32_t)pStream->pBuf[0], (uint32_t)pStream->pBuf[1], (uint16_t)items);
+
+		//data goes through DMA, only errors are left to the SPI interrupt
+		pSPIHandle->pSPIx->CR2 |= (1 << SPI_CR2_RXDMAEN);
+		pSPIHandle->pSPIx->CR2 |= (1 << SPI_CR2_ERRIE);
+	}
+	return state;
+}
+
+void SPI_SlaveStreamStop(SPI_Handle_t *pSPIHandle)
+{
+	if (pSPIHandle->pStream == NULL) return;
+
+	pSPIHandle->pSPIx->CR2 &= ~(1 << SPI_CR2_RXDMAEN);
+	pSPIHandle->pSPIx->CR2 &= ~(1 << SPI_CR2_ERRIE);
+	DMA_StopTransfer(pSPIHandle->pStream->pRxDMA);
+
+	pSPIHandle->pStream = NULL;
+	pSPIHandle->RxState = SPI_READY;
+}
+
+//gives a buffer received with SPI_EVENT_STREAM_BUF_FULL back to the stream
+void SPI_SlaveStreamRelease(SPI_Handle_t *pSPIHandle, uint8_t BufIdx)
+{
+	if (pSPIHandle->pStream == NULL) return;
+
+	pSPIHandle->pStream->AppOwned[BufIdx & 0x1] = 0;
+}
+
+/*********************************************************************
+ * @fn      		  - SPI_SlaveStreamDMAIRQHandling
+ *
+ * @brief             - to be called from the IRQ handler of the RX DMA stream
+ *
+ * @param[in]         - SPI handle
+ *
+ * @return            - none
+ *
+ * @Note              - On every buffer switch the completed buffer is handed to the app. If the
+ *                      buffer the DMA switched into is still held by the app, its content is
+ *                      being overwritten and the overrun counter is incremented.
+ */
+void SPI_SlaveStreamDMAIRQHandling(SPI_Handle_t *pSPIHandle)
+{
+	SPI_Stream_t *pStream = pSPIHandle->pStream;
+	uint8_t flags, done;
+
+	if (pStream == NULL) return;
+
+	flags = DMA_GetFlags(pStream->pRxDMA);
+	DMA_ClearFlags(pStream->pRxDMA, flags);
+
+	if (flags & DMA_FLAG_TC)
+	{
+		//CT already points to the buffer being filled, the other one is complete
+		done = DMA_GetCurrentTarget(pStream->pRxDMA) ^ 0x1;
+
+		if (pStream->AppOwned[done ^ 0x1])
+		{
+			pStream->AppOwned[done ^ 0x1] = 0;
+			pStream->OverrunCount++;
+			SPI_ApplicationEventCallback(pSPIHandle, SPI_EVENT_STREAM_OVERRUN);
+		}
+
+		pStream->AppOwned[done] = 1;
+		pStream->ReadyIdx = done;
+		SPI_ApplicationEventCallback(pSPIHandle, SPI_EVENT_STREAM_BUF_FULL);
+	}
+
+	if (flags & DMA_FLAG_TE)
+	{
+		//the hardware has disabled the stream, nothing more will be received
+		SPI_SlaveStreamStop(pSPIHandle);
+		SPI_ApplicationEventCallback(pSPIHandle, SPI_EVENT_STREAM_DMA_ERR);
+	}
+}
+
+/*********************************************************************
+ * @fn      		  - SPI_SlaveStreamNSSHandling
+ *
+ * @brief             - to be called from the EXTI handler of the NSS pin (rising edge)
+ *
+ * @param[in]         - SPI handle
+ *
+ * @return            - none
+ *
+ * @Note              - records where the finished frame ends. An offset of 0 means the frame
+ *                      ended exactly with the previous buffer.
+ */
+void SPI_SlaveStreamNSSHandling(SPI_Handle_t *pSPIHandle)
+{
+	SPI_Stream_t *pStream = pSPIHandle->pStream;
+	uint32_t remaining;
+
+	if (pStream == NULL) return;
+
+	remaining = DMA_GetDataCounter(pStream->pRxDMA);
+	if(pSPIHandle->pSPIx->CR1 & (1 << SPI_CR1_DFF))
+	{
+		remaining *= 2;
+	}
+
+	pStream->FrameEndIdx = DMA_GetCurrentTarget(pStream->pRxDMA);
+	pStream->FrameEndOffset = pStream->BufLen - remaining;
+	pStream->FrameCount++;
+
+	SPI_ApplicationEventCallback(pSPIHandle, SPI_EVENT_STREAM_FRAME_END);
+}
+
+
 __weak void SPI_ApplicationEventCallback(SPI_Handle_t *pSPIHandle, uint8_t AppEv){
 	//this is a weak implementation and it can be overriden by the app
 }
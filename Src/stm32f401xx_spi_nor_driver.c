@@ -0,0 +1,343 @@
+/*
+ * stm32f401xx_spi_nor_driver.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#include "stm32f401xx_spi_nor_driver.h"
+
+//largest address reachable with 3 byte addressing
+#define NOR_MAX_3B_CAPACITY			(1UL << 24)
+
+
+static void nor_select(NOR_Handle_t *pNORHandle)
+{
+	GPIO_WriteToOutputPin(pNORHandle->pCSPort, pNORHandle->CSPin, GPIO_PIN_RESET);
+}
+
+static void nor_deselect(NOR_Handle_t *pNORHandle)
+{
+	GPIO_WriteToOutputPin(pNORHandle->pCSPort, pNORHandle->CSPin, GPIO_PIN_SET);
+}
+
+//sends a command byte followed by a 24 bit address, chip select stays low
+static void nor_send_cmd_addr(NOR_Handle_t *pNORHandle, uint8_t Cmd, uint32_t Addr)
+{
+	uint8_t frame[4];
+
+	frame[0] = Cmd;
+	frame[1] = (uint8_t)(Addr >> 16);
+	frame[2] = (uint8_t)(Addr >> 8);
+	frame[3] = (uint8_t)Addr;
+	SPI_TransferData(pNORHandle->pSPIHandle->pSPIx, frame, NULL, 4);
+}
+
+static void nor_send_cmd(NOR_Handle_t *pNORHandle, uint8_t Cmd)
+{
+	nor_select(pNORHandle);
+	SPI_TransferData(pNORHandle->pSPIHandle->pSPIx, &Cmd, NULL, 1);
+	nor_deselect(pNORHandle);
+}
+
+static uint8_t nor_read_status(NOR_Handle_t *pNORHandle)
+{
+	uint8_t frame[2] = {NOR_CMD_READ_STATUS1, 0xFF};
+
+	nor_select(pNORHandle);
+	SPI_TransferData(pNORHandle->pSPIHandle->pSPIx, frame, frame, 2);
+	nor_deselect(pNORHandle);
+
+	return frame[1];
+}
+
+//drops the read-ahead cache if it overlaps [Addr, Addr + Len)
+static void nor_invalidate(NOR_Handle_t *pNORHandle, uint32_t Addr, uint32_t Len)
+{
+	if ((Addr < (pNORHandle->CacheAddr + pNORHandle->CacheLen)) && (pNORHandle->CacheAddr < (Addr + Len)))
+	{
+		pNORHandle->CacheLen = 0;
+	}
+}
+
+static void nor_fast_read(NOR_Handle_t *pNORHandle, uint32_t Addr, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint8_t dummy = 0xFF;
+
+	nor_select(pNORHandle);
+	nor_send_cmd_addr(pNORHandle, NOR_CMD_FAST_READ, Addr);
+	SPI_TransferData(pNORHandle->pSPIHandle->pSPIx, &dummy, NULL, 1);
+	SPI_TransferData(pNORHandle->pSPIHandle->pSPIx, NULL, pRxBuffer, Len);
+	nor_deselect(pNORHandle);
+}
+
+
+/*********************************************************************
+ * @fn      		  - NOR_Init
+ *
+ * @brief             - probes the flash through its JEDEC ID and resets the driver state
+ *
+ * @param[in]         - NOR handle with pSPIHandle, pCSPort and CSPin filled in
+ *
+ * @return            - NOR_OK or NOR_ERR_ID
+ *
+ * @Note              - the SPI and the chip select pin have to be initialized by the app.
+ *                      Only 3 byte addressing is used, larger parts are limited to 16 MB.
+ */
+uint8_t NOR_Init(NOR_Handle_t *pNORHandle)
+{
+	uint8_t id[3];
+	uint8_t code;
+
+	nor_deselect(pNORHandle);
+	SPI_PeripheralControl(pNORHandle->pSPIHandle->pSPIx, ENABLE);
+	DWT_CycleCounterInit();
+
+	pNORHandle->PendingOp = NOR_OP_NONE;
+	pNORHandle->CacheAddr = 0;
+	pNORHandle->CacheLen = 0;
+	pNORHandle->Capacity = 0;
+
+	NOR_ReadJEDECID(pNORHandle, id);
+
+	//a floating or missing chip reads as all zeros or all ones
+	if ((id[0] == 0x00) || (id[0] == 0xFF)) return NOR_ERR_ID;
+
+	pNORHandle->ManufacturerID = id[0];
+	pNORHandle->MemoryType = id[1];
+
+	//capacity code is log2 of the size in bytes, parts above 16 MB (0x19, 0x20 and up, some
+	//vendors skip 0x1A-0x1F) are used through their first 16 MB, the shift would overflow
+	code = id[2];
+	if (code < 0x10) return NOR_ERR_ID;
+	if (code >= 24)
+	{
+		pNORHandle->Capacity = NOR_MAX_3B_CAPACITY;
+	}
+	else
+	{
+		pNORHandle->Capacity = (1UL << code);
+	}
+
+	//a program or erase may still be running from before a reset
+	pNORHandle->PendingOp = NOR_OP_ERASE_BLOCK;
+	return NOR_WaitReady(pNORHandle);
+}
+
+uint8_t NOR_ReadJEDECID(NOR_Handle_t *pNORHandle, uint8_t *pID)
+{
+	uint8_t cmd = NOR_CMD_READ_JEDEC_ID;
+
+	nor_select(pNORHandle);
+	SPI_TransferData(pNORHandle->pSPIHandle->pSPIx, &cmd, NULL, 1);
+	SPI_TransferData(pNORHandle->pSPIHandle->pSPIx, NULL, pID, 3);
+	nor_deselect(pNORHandle);
+
+	return NOR_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - NOR_WaitReady
+ *
+ * @brief             - polls WIP until the pending program/erase is done
+ *
+ * @param[in]         - NOR handle
+ *
+ * @return            - NOR_OK or NOR_ERR_TIMEOUT
+ *
+ * @Note              - the bound is the worst case time of the pending operation
+ */
+uint8_t NOR_WaitReady(NOR_Handle_t *pNORHandle)
+{
+	uint32_t start, budget;
+
+	if (pNORHandle->PendingOp == NOR_OP_NONE) return NOR_OK;
+
+	if (pNORHandle->PendingOp == NOR_OP_PROGRAM)
+	{
+		budget = DWT_MsToCycles(NOR_TIMEOUT_PROGRAM_MS);
+	}
+	else if (pNORHandle->PendingOp == NOR_OP_ERASE_SECTOR)
+	{
+		budget = DWT_MsToCycles(NOR_TIMEOUT_SECTOR_ERASE_MS);
+	}
+	else
+	{
+		budget = DWT_MsToCycles(NOR_TIMEOUT_BLOCK_ERASE_MS);
+	}
+
+	start = DWT_GetCycles();
+	while (nor_read_status(pNORHandle) & NOR_SR_WIP)
+	{
+		if (DWT_IsElapsed(start, budget)) return NOR_ERR_TIMEOUT;
+	}
+
+	pNORHandle->PendingOp = NOR_OP_NONE;
+	return NOR_OK;
+}
+
+//non blocking check whether a program/erase is still running
+uint8_t NOR_IsBusy(NOR_Handle_t *pNORHandle)
+{
+	if (pNORHandle->PendingOp == NOR_OP_NONE) return RESET;
+
+	if (nor_read_status(pNORHandle) & NOR_SR_WIP) return SET;
+
+	pNORHandle->PendingOp = NOR_OP_NONE;
+	return RESET;
+}
+
+/*********************************************************************
+ * @fn      		  - NOR_Read
+ *
+ * @brief             - fast read (0x0B) of any length
+ *
+ * @param[in]         - NOR handle
+ * @param[in]         - flash address
+ * @param[in]         - destination buffer
+ * @param[in]         - number of bytes
+ *
+ * @return            - NOR_OK, NOR_ERR_RANGE or NOR_ERR_TIMEOUT
+ *
+ * @Note              - Reads shorter than NOR_READAHEAD_SIZE go through the read-ahead cache,
+ *                      so a run of small sequential reads costs one command per cache line
+ *                      instead of one per call. Longer reads go straight to the caller.
+ */
+uint8_t NOR_Read(NOR_Handle_t *pNORHandle, uint32_t Addr, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint32_t offset, chunk;
+	uint8_t status;
+
+	if ((Addr >= pNORHandle->Capacity) || (Len > (pNORHandle->Capacity - Addr))) return NOR_ERR_RANGE;
+
+	status = NOR_WaitReady(pNORHandle);
+	if (status != NOR_OK) return status;
+
+	if (Len >= NOR_READAHEAD_SIZE)
+	{
+		nor_fast_read(pNORHandle, Addr, pRxBuffer, Len);
+		return NOR_OK;
+	}
+
+	while (Len > 0)
+	{
+		if ((Addr < pNORHandle->CacheAddr) || (Addr >= (pNORHandle->CacheAddr + pNORHandle->CacheLen)))
+		{
+			//miss, fetch the next cache line starting at the requested address
+			chunk = pNORHandle->Capacity - Addr;
+			if (chunk > NOR_READAHEAD_SIZE)
+			{
+				chunk = NOR_READAHEAD_SIZE;
+			}
+			nor_fast_read(pNORHandle, Addr, pNORHandle->Cache, chunk);
+			pNORHandle->CacheAddr = Addr;
+			pNORHandle->CacheLen = chunk;
+		}
+
+		offset = Addr - pNORHandle->CacheAddr;
+		chunk = pNORHandle->CacheLen - offset;
+		if (chunk > Len)
+		{
+			chunk = Len;
+		}
+
+		for (uint32_t i = 0; i < chunk; i++)
+		{
+			pRxBuffer[i] = pNORHandle->Cache[offset + i];
+		}
+
+		pRxBuffer += chunk;
+		Addr += chunk;
+		Len -= chunk;
+	}
+
+	return NOR_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - NOR_Write
+ *
+ * @brief             - programs any length, split at the 256 byte page boundaries
+ *
+ * @param[in]         - NOR handle
+ * @param[in]         - flash address
+ * @param[in]         - data to program (the area has to be erased)
+ * @param[in]         - number of bytes
+ *
+ * @return            - NOR_OK, NOR_ERR_RANGE or NOR_ERR_TIMEOUT
+ *
+ * @Note              - WIP is only polled right before the next command needs the bus. The
+ *                      pages are programmed one after the other, the call returns as soon
+ *                      as the last page is issued; only its program time overlaps with
+ *                      whatever the caller does next.
+ */
+uint8_t NOR_Write(NOR_Handle_t *pNORHandle, uint32_t Addr, uint8_t *pTxBuffer, uint32_t Len)
+{
+	uint32_t chunk;
+	uint8_t status;
+
+	if ((Addr >= pNORHandle->Capacity) || (Len > (pNORHandle->Capacity - Addr))) return NOR_ERR_RANGE;
+
+	nor_invalidate(pNORHandle, Addr, Len);
+
+	while (Len > 0)
+	{
+		//never cross a page, the device would wrap to the start of the page
+		chunk = NOR_PAGE_SIZE - (Addr & (NOR_PAGE_SIZE - 1));
+		if (chunk > Len)
+		{
+			chunk = Len;
+		}
+
+		status = NOR_WaitReady(pNORHandle);
+		if (status != NOR_OK) return status;
+
+		nor_send_cmd(pNORHandle, NOR_CMD_WRITE_ENABLE);
+
+		nor_select(pNORHandle);
+		nor_send_cmd_addr(pNORHandle, NOR_CMD_PAGE_PROGRAM, Addr);
+		SPI_TransferData(pNORHandle->pSPIHandle->pSPIx, pTxBuffer, NULL, chunk);
+		nor_deselect(pNORHandle);
+		pNORHandle->PendingOp = NOR_OP_PROGRAM;
+
+		pTxBuffer += chunk;
+		Addr += chunk;
+		Len -= chunk;
+	}
+
+	return NOR_OK;
+}
+
+static uint8_t nor_erase(NOR_Handle_t *pNORHandle, uint8_t Cmd, uint8_t Op, uint32_t Addr, uint32_t Size)
+{
+	uint8_t status;
+
+	if (Addr >= pNORHandle->Capacity) return NOR_ERR_RANGE;
+
+	Addr &= ~(Size - 1);
+	nor_invalidate(pNORHandle, Addr, Size);
+
+	status = NOR_WaitReady(pNORHandle);
+	if (status != NOR_OK) return status;
+
+	nor_send_cmd(pNORHandle, NOR_CMD_WRITE_ENABLE);
+
+	nor_select(pNORHandle);
+	nor_send_cmd_addr(pNORHandle, Cmd, Addr);
+	nor_deselect(pNORHandle);
+	pNORHandle->PendingOp = Op;
+
+	return NOR_OK;
+}
+
+//erases the 4 KB sector containing Addr, completion is checked by the next access
+uint8_t NOR_EraseSector(NOR_Handle_t *pNORHandle, uint32_t Addr)
+{
+	return nor_erase(pNORHandle, NOR_CMD_SECTOR_ERASE, NOR_OP_ERASE_SECTOR, Addr, NOR_SECTOR_SIZE);
+}
+
+//erases the 64 KB block containing Addr, completion is checked by the next access
+uint8_t NOR_EraseBlock(NOR_Handle_t *pNORHandle, uint32_t Addr)
+{
+	return nor_erase(pNORHandle, NOR_CMD_BLOCK_ERASE, NOR_OP_ERASE_BLOCK, Addr, NOR_BLOCK_SIZE);
+}
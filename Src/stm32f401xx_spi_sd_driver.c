@@ -0,0 +1,603 @@
+/*
+ * stm32f401xx_spi_sd_driver.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#include "stm32f401xx_spi_sd_driver.h"
+
+//ACMD41 argument announcing high capacity support (HCS)
+#define SD_ACMD41_HCS				(1UL << 30)
+//OCR card capacity status, set for block addressed cards
+#define SD_OCR_CCS					(1UL << 30)
+//CMD8 argument, 2.7-3.6 V and check pattern 0xAA
+#define SD_CMD8_ARG					0x1AA
+
+
+static void sd_select(SD_Handle_t *pSDHandle)
+{
+	GPIO_WriteToOutputPin(pSDHandle->pCSPort, pSDHandle->CSPin, GPIO_PIN_RESET);
+}
+
+//the card only releases DO on the clock edge following the chip select, one extra byte is sent
+static void sd_deselect(SD_Handle_t *pSDHandle)
+{
+	GPIO_WriteToOutputPin(pSDHandle->pCSPort, pSDHandle->CSPin, GPIO_PIN_SET);
+	SPI_TransferData(pSDHandle->pSPIHandle->pSPIx, NULL, NULL, 1);
+}
+
+static uint8_t sd_xchg(SD_Handle_t *pSDHandle, uint8_t Data)
+{
+	SPI_TransferData(pSDHandle->pSPIHandle->pSPIx, &Data, &Data, 1);
+	return Data;
+}
+
+//waits until the card releases DO (busy after a write or before a command)
+static uint8_t sd_wait_ready(SD_Handle_t *pSDHandle, uint32_t TimeoutMs)
+{
+	uint32_t start = DWT_GetCycles();
+	uint32_t budget = DWT_MsToCycles(TimeoutMs);
+
+	while (sd_xchg(pSDHandle, 0xFF) != 0xFF)
+	{
+		if (DWT_IsElapsed(start, budget)) return SD_ERR_TIMEOUT;
+	}
+
+	return SD_OK;
+}
+
+/*
+ * Sends a command with the chip select already low and returns R1, 0xFF if the card did not answer.
+ * The CRC is only checked by the card for CMD0 and CMD8, the others get a dummy CRC with the stop bit.
+ */
+static uint8_t sd_send_cmd(SD_Handle_t *pSDHandle, uint8_t Cmd, uint32_t Arg)
+{
+	uint8_t frame[6];
+	uint8_t r1 = 0xFF;
+
+	//CMD0 resets a card in any state, CMD12 interrupts a CMD18 data stream, where DO carries
+	//data and never reads as ready
+	if ((Cmd != SD_CMD0) && (Cmd != SD_CMD12))
+	{
+		if (sd_wait_ready(pSDHandle, SD_TIMEOUT_WRITE_MS) != SD_OK) return 0xFF;
+	}
+
+	frame[0] = 0x40 | Cmd;
+	frame[1] = (uint8_t)(Arg >> 24);
+	frame[2] = (uint8_t)(Arg >> 16);
+	frame[3] = (uint8_t)(Arg >> 8);
+	frame[4] = (uint8_t)Arg;
+	if (Cmd == SD_CMD0)
+	{
+		frame[5] = 0x95;
+	}
+	else if (Cmd == SD_CMD8)
+	{
+		frame[5] = 0x87;
+	}
+	else
+	{
+		frame[5] = 0x01;
+	}
+	SPI_TransferData(pSDHandle->pSPIHandle->pSPIx, frame, NULL, 6);
+
+	//CMD12 is followed by a stuff byte that may look like a response
+	if (Cmd == SD_CMD12)
+	{
+		sd_xchg(pSDHandle, 0xFF);
+	}
+
+	//the response comes within 8 bytes (NCR) and has bit 7 cleared
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		r1 = sd_xchg(pSDHandle, 0xFF);
+		if (!(r1 & 0x80)) break;
+	}
+
+	return r1;
+}
+
+static uint8_t sd_send_acmd(SD_Handle_t *pSDHandle, uint8_t Cmd, uint32_t Arg)
+{
+	uint8_t r1 = sd_send_cmd(pSDHandle, SD_CMD55, 0);
+
+	if (r1 & ~SD_R1_IDLE) return r1;
+
+	return sd_send_cmd(pSDHandle, Cmd, Arg);
+}
+
+//SDSC cards take a byte address, SDHC/SDXC a block number
+static uint32_t sd_card_addr(SD_Handle_t *pSDHandle, uint32_t BlockAddr)
+{
+	return (pSDHandle->CardType == SD_TYPE_V2HC) ? BlockAddr : (BlockAddr * SD_BLOCK_SIZE);
+}
+
+static uint8_t sd_read_data(SD_Handle_t *pSDHandle, uint8_t *pRxBuffer)
+{
+	uint32_t start = DWT_GetCycles();
+	uint32_t budget = DWT_MsToCycles(SD_TIMEOUT_READ_MS);
+	uint8_t token;
+
+	do
+	{
+		token = sd_xchg(pSDHandle, 0xFF);
+		if (DWT_IsElapsed(start, budget)) return SD_ERR_TIMEOUT;
+	}while (token == 0xFF);
+
+	//anything else than the start token is a data error token
+	if (token != SD_TOKEN_START_BLOCK) return SD_ERR_DATA;
+
+	SPI_TransferData(pSDHandle->pSPIHandle->pSPIx, NULL, pRxBuffer, SD_BLOCK_SIZE);
+	//CRC is not checked in SPI mode
+	SPI_TransferData(pSDHandle->pSPIHandle->pSPIx, NULL, NULL, 2);
+
+	return SD_OK;
+}
+
+//sends one data block and checks the data response, the card is busy afterwards
+static uint8_t sd_write_data(SD_Handle_t *pSDHandle, uint8_t Token, uint8_t *pTxBuffer)
+{
+	uint8_t resp;
+
+	sd_xchg(pSDHandle, Token);
+	SPI_TransferData(pSDHandle->pSPIHandle->pSPIx, pTxBuffer, NULL, SD_BLOCK_SIZE);
+	SPI_TransferData(pSDHandle->pSPIHandle->pSPIx, NULL, NULL, 2);
+
+	resp = sd_xchg(pSDHandle, 0xFF);
+	if ((resp & SD_DATA_RESP_MASK) != SD_DATA_RESP_ACCEPTED) return SD_ERR_DATA;
+
+	return SD_OK;
+}
+
+
+/*********************************************************************
+ * @fn      		  - SD_Init
+ *
+ * @brief             - brings the card into SPI mode and identifies it (CMD0/8/55+41/58)
+ *
+ * @param[in]         - SD handle with pSPIHandle and the chip select filled in
+ *
+ * @return            - SD_OK, SD_ERR_NO_CARD or SD_ERR_TIMEOUT
+ *
+ * @Note              - the identification runs at InitSclkHz, the SPI is switched to the fastest
+ *                      prescaler not exceeding SclkHz once the card has left the idle state
+ */
+uint8_t SD_Init(SD_Handle_t *pSDHandle)
+{
+	uint8_t r1, ocr[4];
+	uint32_t start, budget, arg = 0;
+
+	pSDHandle->CardType = SD_TYPE_NONE;
+	pSDHandle->WBHead = 0;
+	pSDHandle->WBTail = 0;
+	pSDHandle->WBCount = 0;
+	pSDHandle->WBState = SD_WB_IDLE;
+	pSDHandle->WBBusy = RESET;
+	pSDHandle->WBErrCount = 0;
+
+	DWT_CycleCounterInit();
+	GPIO_WriteToOutputPin(pSDHandle->pCSPort, pSDHandle->CSPin, GPIO_PIN_SET);
+	if (pSDHandle->InitSclkHz == 0)
+	{
+		pSDHandle->InitSclkHz = SD_INIT_SCLK_HZ;
+	}
+	if (pSDHandle->SclkHz == 0)
+	{
+		pSDHandle->SclkHz = SD_MAX_SCLK_HZ;
+	}
+	SPI_SetSclkFreq(pSDHandle->pSPIHandle, pSDHandle->InitSclkHz);
+	SPI_PeripheralControl(pSDHandle->pSPIHandle->pSPIx, ENABLE);
+
+	//at least 74 clocks with chip select and DI high
+	SPI_TransferData(pSDHandle->pSPIHandle->pSPIx, NULL, NULL, 10);
+
+	sd_select(pSDHandle);
+
+	for (uint8_t i = 0; i < 10; i++)
+	{
+		r1 = sd_send_cmd(pSDHandle, SD_CMD0, 0);
+		if (r1 == SD_R1_IDLE) break;
+	}
+	if (r1 != SD_R1_IDLE)
+	{
+		sd_deselect(pSDHandle);
+		return SD_ERR_NO_CARD;
+	}
+
+	r1 = sd_send_cmd(pSDHandle, SD_CMD8, SD_CMD8_ARG);
+	if (r1 == SD_R1_IDLE)
+	{
+		//R7, the card has to echo the voltage range and the check pattern
+		SPI_TransferData(pSDHandle->pSPIHandle->pSPIx, NULL, ocr, 4);
+		if (((ocr[2] & 0x0F) != 0x01) || (ocr[3] != 0xAA))
+		{
+			sd_deselect(pSDHandle);
+			return SD_ERR_NO_CARD;
+		}
+		arg = SD_ACMD41_HCS;
+	}
+	else if (!(r1 & SD_R1_ILLEGAL_CMD))
+	{
+		sd_deselect(pSDHandle);
+		return SD_ERR_NO_CARD;
+	}
+
+	start = DWT_GetCycles();
+	budget = DWT_MsToCycles(SD_TIMEOUT_INIT_MS);
+	do
+	{
+		r1 = sd_send_acmd(pSDHandle, SD_ACMD41, arg);
+		if (DWT_IsElapsed(start, budget))
+		{
+			sd_deselect(pSDHandle);
+			return SD_ERR_TIMEOUT;
+		}
+	}while (r1 == SD_R1_IDLE);
+
+	if (r1 != 0)
+	{
+		sd_deselect(pSDHandle);
+		return SD_ERR_NO_CARD;
+	}
+
+	if (arg == SD_ACMD41_HCS)
+	{
+		if (sd_send_cmd(pSDHandle, SD_CMD58, 0) != 0)
+		{
+			sd_deselect(pSDHandle);
+			return SD_ERR_CMD;
+		}
+		SPI_TransferData(pSDHandle->pSPIHandle->pSPIx, NULL, ocr, 4);
+		pSDHandle->CardType = (ocr[0] & (SD_OCR_CCS >> 24)) ? SD_TYPE_V2HC : SD_TYPE_V2;
+	}
+	else
+	{
+		pSDHandle->CardType = SD_TYPE_V1;
+	}
+
+	//byte addressed cards may power up with another block length
+	if (pSDHandle->CardType != SD_TYPE_V2HC)
+	{
+		if (sd_send_cmd(pSDHandle, SD_CMD16, SD_BLOCK_SIZE) != 0)
+		{
+			pSDHandle->CardType = SD_TYPE_NONE;
+			sd_deselect(pSDHandle);
+			return SD_ERR_CMD;
+		}
+	}
+
+	sd_deselect(pSDHandle);
+	SPI_SetSclkFreq(pSDHandle->pSPIHandle, pSDHandle->SclkHz);
+
+	return SD_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - SD_ReadBlocks
+ *
+ * @brief             - reads Count blocks, CMD17 for one block and CMD18 + CMD12 for more
+ *
+ * @param[in]         - SD handle
+ * @param[in]         - first block number
+ * @param[in]         - destination, Count * SD_BLOCK_SIZE bytes
+ * @param[in]         - number of blocks
+ *
+ * @return            - SD_OK or an SD error code
+ */
+uint8_t SD_ReadBlocks(SD_Handle_t *pSDHandle, uint32_t BlockAddr, uint8_t *pRxBuffer, uint32_t Count)
+{
+	uint8_t status;
+
+	if (Count == 0) return SD_OK;
+
+	//the card cannot serve a read while a write-behind CMD25 is open
+	status = SD_Flush(pSDHandle);
+	if (status != SD_OK) return status;
+
+	sd_select(pSDHandle);
+
+	if (Count == 1)
+	{
+		if (sd_send_cmd(pSDHandle, SD_CMD17, sd_card_addr(pSDHandle, BlockAddr)) != 0)
+		{
+			status = SD_ERR_CMD;
+		}
+		else
+		{
+			status = sd_read_data(pSDHandle, pRxBuffer);
+		}
+	}
+	else
+	{
+		if (sd_send_cmd(pSDHandle, SD_CMD18, sd_card_addr(pSDHandle, BlockAddr)) != 0)
+		{
+			status = SD_ERR_CMD;
+		}
+		else
+		{
+			while (Count > 0)
+			{
+				status = sd_read_data(pSDHandle, pRxBuffer);
+				if (status != SD_OK) break;
+				pRxBuffer += SD_BLOCK_SIZE;
+				Count--;
+			}
+			sd_send_cmd(pSDHandle, SD_CMD12, 0);
+			if (sd_wait_ready(pSDHandle, SD_TIMEOUT_WRITE_MS) != SD_OK)
+			{
+				status = SD_ERR_TIMEOUT;
+			}
+		}
+	}
+
+	sd_deselect(pSDHandle);
+
+	return status;
+}
+
+/*********************************************************************
+ * @fn      		  - SD_WriteBlocks
+ *
+ * @brief             - writes Count blocks and waits until the card has programmed them
+ *
+ * @param[in]         - SD handle
+ * @param[in]         - first block number
+ * @param[in]         - data, Count * SD_BLOCK_SIZE bytes
+ * @param[in]         - number of blocks
+ *
+ * @return            - SD_OK or an SD error code
+ *
+ * @Note              - more than one block uses ACMD23 + CMD25, so the card can pre-erase
+ *                      the whole range instead of erasing per block
+ */
+uint8_t SD_WriteBlocks(SD_Handle_t *pSDHandle, uint32_t BlockAddr, uint8_t *pTxBuffer, uint32_t Count)
+{
+	uint8_t status;
+
+	if (Count == 0) return SD_OK;
+
+	status = SD_Flush(pSDHandle);
+	if (status != SD_OK) return status;
+
+	sd_select(pSDHandle);
+
+	if (Count == 1)
+	{
+		if (sd_send_cmd(pSDHandle, SD_CMD24, sd_card_addr(pSDHandle, BlockAddr)) != 0)
+		{
+			status = SD_ERR_CMD;
+		}
+		else
+		{
+			sd_xchg(pSDHandle, 0xFF);
+			status = sd_write_data(pSDHandle, SD_TOKEN_START_BLOCK, pTxBuffer);
+		}
+	}
+	else
+	{
+		//the pre-erase count is only a hint, a failing ACMD23 does not stop the write
+		sd_send_acmd(pSDHandle, SD_ACMD23, Count);
+
+		if (sd_send_cmd(pSDHandle, SD_CMD25, sd_card_addr(pSDHandle, BlockAddr)) != 0)
+		{
+			status = SD_ERR_CMD;
+		}
+		else
+		{
+			sd_xchg(pSDHandle, 0xFF);
+			while (Count > 0)
+			{
+				status = sd_write_data(pSDHandle, SD_TOKEN_START_MULTI_WRITE, pTxBuffer);
+				if (status != SD_OK) break;
+				if (sd_wait_ready(pSDHandle, SD_TIMEOUT_WRITE_MS) != SD_OK)
+				{
+					status = SD_ERR_TIMEOUT;
+					break;
+				}
+				pTxBuffer += SD_BLOCK_SIZE;
+				Count--;
+			}
+			sd_xchg(pSDHandle, SD_TOKEN_STOP_TRAN);
+			sd_xchg(pSDHandle, 0xFF);
+		}
+	}
+
+	if ((sd_wait_ready(pSDHandle, SD_TIMEOUT_WRITE_MS) != SD_OK) && (status == SD_OK))
+	{
+		status = SD_ERR_TIMEOUT;
+	}
+
+	sd_deselect(pSDHandle);
+
+	return status;
+}
+
+/*********************************************************************
+ * @fn      		  - SD_WriteBlockAsync
+ *
+ * @brief             - queues one block for the write-behind engine
+ *
+ * @param[in]         - SD handle
+ * @param[in]         - block number
+ * @param[in]         - SD_BLOCK_SIZE bytes, must stay untouched until SD_EVENT_WB_BLOCK_DONE
+ *
+ * @return            - SD_OK or SD_ERR_QUEUE_FULL
+ *
+ * @Note              - nothing is sent here, SD_Process moves the queue to the card
+ */
+uint8_t SD_WriteBlockAsync(SD_Handle_t *pSDHandle, uint32_t BlockAddr, uint8_t *pTxBuffer)
+{
+	if (pSDHandle->WBCount >= SD_WB_QUEUE_DEPTH) return SD_ERR_QUEUE_FULL;
+
+	pSDHandle->WBQueue[pSDHandle->WBHead].BlockAddr = BlockAddr;
+	pSDHandle->WBQueue[pSDHandle->WBHead].pData = pTxBuffer;
+	pSDHandle->WBHead = (pSDHandle->WBHead + 1) % SD_WB_QUEUE_DEPTH;
+	pSDHandle->WBCount++;
+
+	return SD_OK;
+}
+
+//closes the open CMD25, the card programs its buffer after the stop token
+static void sd_wb_stop(SD_Handle_t *pSDHandle)
+{
+	sd_xchg(pSDHandle, SD_TOKEN_STOP_TRAN);
+	sd_xchg(pSDHandle, 0xFF);
+	pSDHandle->WBState = SD_WB_IDLE;
+	pSDHandle->WBBusy = SET;
+	pSDHandle->WBBusyStart = DWT_GetCycles();
+}
+
+static void sd_wb_pop(SD_Handle_t *pSDHandle, uint8_t AppEv)
+{
+	pSDHandle->WBTail = (pSDHandle->WBTail + 1) % SD_WB_QUEUE_DEPTH;
+	pSDHandle->WBCount--;
+	SD_ApplicationEventCallback(pSDHandle, AppEv);
+}
+
+/*********************************************************************
+ * @fn      		  - SD_Process
+ *
+ * @brief             - runs one step of the write-behind engine, never waits for card busy
+ *
+ * @param[in]         - SD handle
+ *
+ * @return            - SD_OK, SD_ERR_CMD or SD_ERR_TIMEOUT
+ *
+ * @Note              - Call it from the main loop. While the card is busy it only samples DO
+ *                      once and returns. Otherwise it sends the next queued block: consecutive
+ *                      blocks share one ACMD23 + CMD25, which is closed when the queue runs
+ *                      empty or the next block is not contiguous.
+ *                      The chip select stays low while a CMD25 is open, the bus cannot be
+ *                      shared with other devices until the queue has drained.
+ */
+uint8_t SD_Process(SD_Handle_t *pSDHandle)
+{
+	SD_WBEntry_t *pEntry;
+	uint32_t run;
+	uint8_t idx;
+
+	if (pSDHandle->WBBusy)
+	{
+		if (pSDHandle->WBState == SD_WB_IDLE)
+		{
+			sd_select(pSDHandle);
+		}
+
+		if (sd_xchg(pSDHandle, 0xFF) != 0xFF)
+		{
+			if (!DWT_IsElapsed(pSDHandle->WBBusyStart, DWT_MsToCycles(SD_TIMEOUT_WRITE_MS)))
+			{
+				if (pSDHandle->WBState == SD_WB_IDLE)
+				{
+					sd_deselect(pSDHandle);
+				}
+				return SD_OK;
+			}
+
+			//the card is stuck, drop the session, the next command starts from scratch
+			pSDHandle->WBBusy = RESET;
+			pSDHandle->WBState = SD_WB_IDLE;
+			pSDHandle->WBErrCount++;
+			sd_deselect(pSDHandle);
+			SD_ApplicationEventCallback(pSDHandle, SD_EVENT_WB_ERR);
+			return SD_ERR_TIMEOUT;
+		}
+
+		pSDHandle->WBBusy = RESET;
+		if (pSDHandle->WBState == SD_WB_IDLE)
+		{
+			sd_deselect(pSDHandle);
+		}
+	}
+
+	if (pSDHandle->WBCount == 0)
+	{
+		if (pSDHandle->WBState == SD_WB_MULTI)
+		{
+			sd_wb_stop(pSDHandle);
+		}
+		return SD_OK;
+	}
+
+	pEntry = &pSDHandle->WBQueue[pSDHandle->WBTail];
+
+	if ((pSDHandle->WBState == SD_WB_MULTI) && (pEntry->BlockAddr != pSDHandle->WBNextBlock))
+	{
+		sd_wb_stop(pSDHandle);
+		return SD_OK;
+	}
+
+	if (pSDHandle->WBState == SD_WB_IDLE)
+	{
+		//pre-erase the contiguous run that is already queued
+		run = 1;
+		idx = pSDHandle->WBTail;
+		while (run < pSDHandle->WBCount)
+		{
+			uint8_t next = (idx + 1) % SD_WB_QUEUE_DEPTH;
+			if (pSDHandle->WBQueue[next].BlockAddr != (pSDHandle->WBQueue[idx].BlockAddr + 1)) break;
+			idx = next;
+			run++;
+		}
+
+		sd_select(pSDHandle);
+		sd_send_acmd(pSDHandle, SD_ACMD23, run);
+		if (sd_send_cmd(pSDHandle, SD_CMD25, sd_card_addr(pSDHandle, pEntry->BlockAddr)) != 0)
+		{
+			sd_deselect(pSDHandle);
+			pSDHandle->WBErrCount++;
+			sd_wb_pop(pSDHandle, SD_EVENT_WB_ERR);
+			return SD_ERR_CMD;
+		}
+		sd_xchg(pSDHandle, 0xFF);
+		pSDHandle->WBState = SD_WB_MULTI;
+		pSDHandle->WBNextBlock = pEntry->BlockAddr;
+	}
+
+	if (sd_write_data(pSDHandle, SD_TOKEN_START_MULTI_WRITE, pEntry->pData) != SD_OK)
+	{
+		//a rejected block ends the multiple block write
+		pSDHandle->WBErrCount++;
+		sd_wb_stop(pSDHandle);
+		sd_wb_pop(pSDHandle, SD_EVENT_WB_ERR);
+		return SD_OK;
+	}
+
+	pSDHandle->WBNextBlock++;
+	pSDHandle->WBBusy = SET;
+	pSDHandle->WBBusyStart = DWT_GetCycles();
+	sd_wb_pop(pSDHandle, SD_EVENT_WB_BLOCK_DONE);
+
+	return SD_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - SD_Flush
+ *
+ * @brief             - drains the write-behind queue and waits until the card is idle
+ *
+ * @param[in]         - SD handle
+ *
+ * @return            - SD_OK or the first error reported by SD_Process
+ */
+uint8_t SD_Flush(SD_Handle_t *pSDHandle)
+{
+	uint8_t status = SD_OK, ret;
+
+	while ((pSDHandle->WBCount > 0) || (pSDHandle->WBState != SD_WB_IDLE) || pSDHandle->WBBusy)
+	{
+		ret = SD_Process(pSDHandle);
+		if ((ret != SD_OK) && (status == SD_OK))
+		{
+			status = ret;
+		}
+	}
+
+	return status;
+}
+
+__weak void SD_ApplicationEventCallback(SD_Handle_t *pSDHandle, uint8_t AppEv)
+{
+	//this is a weak implementation and it can be overriden by the app
+}
@@ -0,0 +1,360 @@
+/*
+ * stm32f401xx_tim_driver.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+//the USART driver references TIM_Handle_t, the device header includes the
+//driver headers in dependency order
+#include "stm32f401xx.h"
+
+
+//TIM2 and TIM5 have 32 bit counters, the others 16 bit
+static uint8_t tim_is_32bit(TIM_RegDef_t *pTIMx)
+{
+	return ((pTIMx == DRV_TIM2) || (pTIMx == DRV_TIM5));
+}
+
+static uint8_t tim_on_apb2(TIM_RegDef_t *pTIMx)
+{
+	return ((pTIMx == DRV_TIM1) || (pTIMx == DRV_TIM9) || (pTIMx == DRV_TIM10) || (pTIMx == DRV_TIM11));
+}
+
+
+/*********************************************************************
+ * @fn      		  - TIM_PeriClockControl
+ *
+ * @brief             - enables or disables the clock of a timer
+ *
+ * @param[in]         - base address of the timer
+ * @param[in]         - ENABLE or DISABLE
+ *
+ * @return            - none
+ */
+void TIM_PeriClockControl(TIM_RegDef_t *pTIMx, uint8_t EnorDi)
+{
+	if (EnorDi == ENABLE)
+	{
+		if (pTIMx == DRV_TIM1)
+		{
+			DRV_TIM1_PCLK_EN();
+		}
+		else if (pTIMx == DRV_TIM2)
+		{
+			DRV_TIM2_PCLK_EN();
+		}
+		else if (pTIMx == DRV_TIM3)
+		{
+			DRV_TIM3_PCLK_EN();
+		}
+		else if (pTIMx == DRV_TIM4)
+		{
+			DRV_TIM4_PCLK_EN();
+		}
+		else if (pTIMx == DRV_TIM5)
+		{
+			DRV_TIM5_PCLK_EN();
+		}
+		else if (pTIMx == DRV_TIM9)
+		{
+			DRV_TIM9_PCLK_EN();
+		}
+		else if (pTIMx == DRV_TIM10)
+		{
+			DRV_TIM10_PCLK_EN();
+		}
+		else if (pTIMx == DRV_TIM11)
+		{
+			DRV_TIM11_PCLK_EN();
+		}
+	}
+	else
+	{
+		if (pTIMx == DRV_TIM1)
+		{
+			DRV_TIM1_PCLK_DI();
+		}
+		else if (pTIMx == DRV_TIM2)
+		{
+			DRV_TIM2_PCLK_DI();
+		}
+		else if (pTIMx == DRV_TIM3)
+		{
+			DRV_TIM3_PCLK_DI();
+		}
+		else if (pTIMx == DRV_TIM4)
+		{
+			DRV_TIM4_PCLK_DI();
+		}
+		else if (pTIMx == DRV_TIM5)
+		{
+			DRV_TIM5_PCLK_DI();
+		}
+		else if (pTIMx == DRV_TIM9)
+		{
+			DRV_TIM9_PCLK_DI();
+		}
+		else if (pTIMx == DRV_TIM10)
+		{
+			DRV_TIM10_PCLK_DI();
+		}
+		else if (pTIMx == DRV_TIM11)
+		{
+			DRV_TIM11_PCLK_DI();
+		}
+	}
+}
+
+/*********************************************************************
+ * @fn      		  - TIM_GetClock
+ *
+ * @brief             - returns the kernel clock of a timer
+ *
+ * @param[in]         - base address of the timer
+ *
+ * @return            - clock in Hz
+ *
+ * @Note              - the timers run at twice the APB clock when the APB prescaler is not 1
+ *                      (DCKCFGR.TIMPRE is assumed to be 0)
+ */
+uint32_t TIM_GetClock(TIM_RegDef_t *pTIMx)
+{
+	uint32_t hclk = RCC_GetHCLKValue();
+	uint32_t pclk = tim_on_apb2(pTIMx) ? RCC_GetPCLK2Value() : RCC_GetPCLK1Value();
+
+	return (pclk == hclk) ? pclk : (2 * pclk);
+}
+
+/*********************************************************************
+ * @fn      		  - TIM_Init
+ *
+ * @brief             - programs the timer as an up counting time base, the counter stays stopped
+ *
+ * @param[in]         - timer handle
+ *
+ * @return            - TIM_OK or TIM_ERR_PARAM
+ *
+ * @Note              - PSC and ARR are preloaded with an update event generated with URS set,
+ *                      so no update interrupt is raised by the init itself
+ */
+uint8_t TIM_Init(TIM_Handle_t *pTIMHandle)
+{
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+	uint32_t clk, psc, max_arr;
+
+	TIM_PeriClockControl(pTIMx, ENABLE);
+	clk = TIM_GetClock(pTIMx);
+
+	if ((pTIMHandle->TIMConfig.TIM_CounterHz == 0) || (pTIMHandle->TIMConfig.TIM_Period == 0)) return TIM_ERR_PARAM;
+
+	psc = clk / pTIMHandle->TIMConfig.TIM_CounterHz;
+	if ((psc == 0) || (psc > 0x10000)) return TIM_ERR_PARAM;
+
+	max_arr = tim_is_32bit(pTIMx) ? 0xFFFFFFFFU : 0xFFFFU;
+	if ((pTIMHandle->TIMConfig.TIM_Period - 1) > max_arr) return TIM_ERR_PARAM;
+
+	pTIMHandle->AchievedCounterHz = clk / psc;
+
+	pTIMx->CR1 = (1 << TIM_CR1_ARPE) | (1 << TIM_CR1_URS);
+	pTIMx->PSC = psc - 1;
+	pTIMx->ARR = pTIMHandle->TIMConfig.TIM_Period - 1;
+	pTIMx->CNT = 0;
+	pTIMx->EGR = (1 << TIM_EGR_UG);
+	pTIMx->SR = ~TIM_FLAG_UPDATE;
+
+	return TIM_OK;
+}
+
+void TIM_Start(TIM_RegDef_t *pTIMx)
+{
+	pTIMx->CR1 |= (1 << TIM_CR1_CEN);
+}
+
+void TIM_Stop(TIM_RegDef_t *pTIMx)
+{
+	pTIMx->CR1 &= ~(1 << TIM_CR1_CEN);
+}
+
+uint32_t TIM_GetCounter(TIM_RegDef_t *pTIMx)
+{
+	return pTIMx->CNT;
+}
+
+void TIM_UpdateITConfig(TIM_RegDef_t *pTIMx, uint8_t EnorDi)
+{
+	if (EnorDi == ENABLE)
+	{
+		pTIMx->DIER |= (1 << TIM_DIER_UIE);
+	}
+	else
+	{
+		pTIMx->DIER &= ~(1 << TIM_DIER_UIE);
+	}
+}
+
+/*********************************************************************
+ * @fn      		  - TIM_ICConfig
+ *
+ * @brief             - configures a channel for input capture on its own TIx input
+ *
+ * @param[in]         - base address of the timer
+ * @param[in]         - channel, 1 to 4
+ * @param[in]         - edge selection from @TIM_ICPolarity
+ * @param[in]         - ICxF digital filter, 0 to 15
+ *
+ * @return            - none
+ *
+ * @Note              - the capture is enabled on return, no prescaler. CCxS can only be written
+ *                      with the channel disabled, so the channel is switched off first.
+ */
+void TIM_ICConfig(TIM_RegDef_t *pTIMx, uint8_t Channel, uint8_t Polarity, uint8_t Filter)
+{
+	uint8_t ccmr = (Channel - 1) / 2;
+	uint8_t ccmr_shift = ((Channel - 1) % 2) * 8;
+	uint8_t ccer_shift = (Channel - 1) * 4;
+	uint32_t tempreg;
+
+	pTIMx->CCER &= ~(0xF << ccer_shift);
+
+	//CCxS = 01, ICx mapped on TIx
+	tempreg = pTIMx->CCMR[ccmr];
+	tempreg &= ~(0xFF << ccmr_shift);
+	tempreg |= (0x1 << (TIM_CCMR_CCS + ccmr_shift));
+	tempreg |= ((Filter & 0xF) << (TIM_CCMR_ICF + ccmr_shift));
+	pTIMx->CCMR[ccmr] = tempreg;
+
+	tempreg = (1 << TIM_CCER_CCE);
+	if (Polarity == TIM_IC_FALLING)
+	{
+		tempreg |= (1 << TIM_CCER_CCP);
+	}
+	else if (Polarity == TIM_IC_BOTH)
+	{
+		tempreg |= (1 << TIM_CCER_CCP) | (1 << TIM_CCER_CCNP);
+	}
+	pTIMx->CCER |= (tempreg << ccer_shift);
+}
+
+void TIM_ICDisable(TIM_RegDef_t *pTIMx, uint8_t Channel)
+{
+	pTIMx->CCER &= ~(1 << (TIM_CCER_CCE + ((Channel - 1) * 4)));
+}
+
+void TIM_CCITConfig(TIM_RegDef_t *pTIMx, uint8_t Channel, uint8_t EnorDi)
+{
+	if (EnorDi == ENABLE)
+	{
+		pTIMx->DIER |= (1 << (TIM_DIER_CC1IE + Channel - 1));
+	}
+	else
+	{
+		pTIMx->DIER &= ~(1 << (TIM_DIER_CC1IE + Channel - 1));
+	}
+}
+
+//a capture raises a DMA request, the DMA reading CCRx clears CCxIF
+void TIM_CCDMAConfig(TIM_RegDef_t *pTIMx, uint8_t Channel, uint8_t EnorDi)
+{
+	if (EnorDi == ENABLE)
+	{
+		pTIMx->DIER |= (1 << (TIM_DIER_CC1DE + Channel - 1));
+	}
+	else
+	{
+		pTIMx->DIER &= ~(1 << (TIM_DIER_CC1DE + Channel - 1));
+	}
+}
+
+uint32_t TIM_GetCapture(TIM_RegDef_t *pTIMx, uint8_t Channel)
+{
+	return pTIMx->CCR[Channel - 1];
+}
+
+uint8_t TIM_GetFlagStatus(TIM_RegDef_t *pTIMx, uint32_t Flag)
+{
+	if (pTIMx->SR & Flag) return FLAG_SET;
+	return FLAG_RESET;
+}
+
+//SR bits are rc_w0, writing 1 to the others leaves them untouched
+void TIM_ClearFlag(TIM_RegDef_t *pTIMx, uint32_t Flag)
+{
+	pTIMx->SR = ~Flag;
+}
+
+
+/*********************************************************************
+ * @fn      		  - TIM_IRQInterruptConfig
+ *
+ * @brief             - enables or disables a timer IRQ in the NVIC
+ *
+ * @param[in]         - IRQ number (@IRQ_NO_TIMx)
+ * @param[in]         - ENABLE or DISABLE
+ *
+ * @return            - none
+ */
+void TIM_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
+{
+	if(EnorDi == ENABLE)
+	{
+		if(IRQNumber <= 31)
+		{
+			//program ISER0 register
+			*DRV_NVIC_ISER0 = ( 1 << IRQNumber );
+		}
+		else if(IRQNumber > 31 && IRQNumber < 64 )
+		{
+			//program ISER1 register
+			*DRV_NVIC_ISER1 = ( 1 << (IRQNumber % 32) );
+		}
+		else if(IRQNumber >= 64 && IRQNumber < 96 )
+		{
+			//program ISER2 register
+			*DRV_NVIC_ISER2 = ( 1 << (IRQNumber % 64) );
+		}
+	}
+	else
+	{
+		if(IRQNumber <= 31)
+		{
+			//program ICER0 register
+			*DRV_NVIC_ICER0 = ( 1 << IRQNumber );
+		}
+		else if(IRQNumber > 31 && IRQNumber < 64 )
+		{
+			//program ICER1 register
+			*DRV_NVIC_ICER1 = ( 1 << (IRQNumber % 32) );
+		}
+		else if(IRQNumber >= 64 && IRQNumber < 96 )
+		{
+			//program ICER2 register
+			*DRV_NVIC_ICER2 = ( 1 << (IRQNumber % 64) );
+		}
+	}
+}
+
+void TIM_IRQPriorityConfig(uint8_t IRQNumber, uint32_t IRQPriority)
+{
+	uint8_t iprx = IRQNumber / 4;
+	uint8_t iprx_section = IRQNumber % 4;
+
+	uint8_t shift_amount = (8 * iprx_section) + (8 - NO_PR_BITS_IMPLEMENTED);
+
+	*(DRV_NVIC_IPR_BASE_ADDR + iprx) |= (IRQPriority << shift_amount);
+}
+
+//update event handling for timers used as plain time bases
+void TIM_IRQHandling(TIM_Handle_t *pTIMHandle)
+{
+	if ((pTIMHandle->pTIMx->SR & TIM_FLAG_UPDATE) && (pTIMHandle->pTIMx->DIER & (1 << TIM_DIER_UIE)))
+	{
+		TIM_ClearFlag(pTIMHandle->pTIMx, TIM_FLAG_UPDATE);
+		TIM_ApplicationEventCallback(pTIMHandle, TIM_EVENT_UPDATE);
+	}
+}
+
+__weak void TIM_ApplicationEventCallback(TIM_Handle_t *pTIMHandle, uint8_t AppEv)
+{
+	//This is a weak implementation, the application may override this function
+}
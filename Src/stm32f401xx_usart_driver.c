@@ -11,6 +11,35 @@
 
 #include "stm32f401xx_usart_driver.h"
 
+//drives a software managed RTS pin, active low: ENABLE lets the sender transmit
+static void usart_rts_control(USART_Handle_t *pUSARTHandle, uint8_t EnorDi)
+{
+	if (pUSARTHandle->pRTSPort == NULL) return;
+
+	if (EnorDi == ENABLE)
+	{
+		pUSARTHandle->pRTSPort->BSRR = (1 << (pUSARTHandle->RTSPin + 16));
+	}
+	else
+	{
+		pUSARTHandle->pRTSPort->BSRR = (1 << pUSARTHandle->RTSPin);
+	}
+}
+
+//switches the RS-485 transceiver, BSRR keeps it atomic against the ISR
+static void usart_de_control(USART_Handle_t *pUSARTHandle, uint8_t EnorDi)
+{
+	if (pUSARTHandle->pDEPort == NULL) return;
+
+	if (EnorDi == ENABLE)
+	{
+		pUSARTHandle->pDEPort->BSRR = (1 << pUSARTHandle->DEPin);
+	}
+	else
+	{
+		pUSARTHandle->pDEPort->BSRR = (1 << (pUSARTHandle->DEPin + 16));
+	}
+}
 
 
 
@@ -53,18 +82,18 @@ void USART_PeriClockControl(USART_RegDef_t *pUSARTx, uint8_t EnorDi)
 /*********************************************************************
  * @fn      		  - USART_Init
  *
- * @brief             -
+ * @brief             - configures the USART from USART_Config, the peripheral stays disabled
  *
- * @param[in]         -
- * @param[in]         -
- * @param[in]         -
+ * @param[in]         - USART handle
  *
- * @return            -
+ * @return            - USART_OK, or USART_ERR_BAUD if USART_Baud cannot be reached within
+ *                      USART_BAUD_TOLERANCE_PPM (BRR is left unprogrammed then)
  *
- * @Note              - Resolve all the TODOs
-
+ * @Note              - pDEPort/DEPin are only read with USART_DEMode USART_DE_GPIO and
+ *                      pRTSPort/RTSPin with USART_RTSMode USART_RTS_GPIO, the handle does
+ *                      not need to be zeroed
  */
-void USART_Init(USART_Handle_t *pUSARTHandle)
+uint8_t USART_Init(USART_Handle_t *pUSARTHandle)
 {
 
 	//Temporary variable
@@ -75,6 +104,28 @@ void USART_Init(USART_Handle_t *pUSARTHandle)
 	//Implement the code to enable the Clock for given USART peripheral
 	USART_PeriClockControl(pUSARTHandle->pUSARTx, ENABLE);
 
+	pUSARTHandle->Streaming = RESET;
+	pUSARTHandle->pDMARx = NULL;
+	pUSARTHandle->pDMATx = NULL;
+	pUSARTHandle->pAutoBaud = NULL;
+
+	//from here on pDEPort NULL means no transceiver control
+	if (pUSARTHandle->USART_Config.USART_DEMode != USART_DE_GPIO)
+	{
+		pUSARTHandle->pDEPort = NULL;
+	}
+
+	//same for pRTSPort, software RTS without RTS flow control would hold off the sender
+	if ((pUSARTHandle->USART_Config.USART_RTSMode != USART_RTS_GPIO) ||
+	    ((pUSARTHandle->USART_Config.USART_HWFlowControl != USART_HW_FLOW_CTRL_RTS) &&
+	     (pUSARTHandle->USART_Config.USART_HWFlowControl != USART_HW_FLOW_CTRL_CTS_RTS)))
+	{
+		pUSARTHandle->pRTSPort = NULL;
+	}
+
+	//receiver side of the transceiver until something is sent
+	usart_de_control(pUSARTHandle, DISABLE);
+
 	//Enable USART Tx and Rx engines according to the USART_Mode configuration item
 	if ( pUSARTHandle->USART_Config.USART_Mode == USART_MODE_ONLY_RX)
 	{
@@ -114,6 +165,12 @@ void USART_Init(USART_Handle_t *pUSARTHandle)
 
 	}
 
+	//address mark wakeup, idle line is the reset value of WAKE
+	if ( pUSARTHandle->USART_Config.USART_WakeMode == USART_WAKE_ADDRESS_MARK)
+	{
+		tempreg |= ( 1 << USART_CR1_WAKE);
+	}
+
    //Program the CR1 register
 	pUSARTHandle->pUSARTx->CR1 = tempreg;
 
@@ -124,6 +181,9 @@ void USART_Init(USART_Handle_t *pUSARTHandle)
 	//Implement the code to configure the number of stop bits inserted during USART frame transmission
 	tempreg |= pUSARTHandle->USART_Config.USART_NoOfStopBits << USART_CR2_STOP;
 
+	//node address for address mark wakeup
+	tempreg |= (pUSARTHandle->USART_Config.USART_NodeAddr & 0x0F) << USART_CR2_ADD;
+
 	//Program the CR2 register
 	pUSARTHandle->pUSARTx->CR2 = tempreg;
 
@@ -132,22 +192,27 @@ void USART_Init(USART_Handle_t *pUSARTHandle)
 	tempreg=0;
 
 	//Configuration of USART hardware flow control
-	if ( pUSARTHandle->USART_Config.USART_HWFlowControl == USART_HW_FLOW_CTRL_CTS)
+	if ( (pUSARTHandle->USART_Config.USART_HWFlowControl == USART_HW_FLOW_CTRL_CTS) ||
+	     (pUSARTHandle->USART_Config.USART_HWFlowControl == USART_HW_FLOW_CTRL_CTS_RTS) )
 	{
-		//Implement the code to enable CTS flow control
+		//the transmitter waits for CTS on its own, CTSIE reports the changes of the line
 		tempreg |= ( 1 << USART_CR3_CTSE);
+		tempreg |= ( 1 << USART_CR3_CTSIE);
+	}
 
-
-	}else if (pUSARTHandle->USART_Config.USART_HWFlowControl == USART_HW_FLOW_CTRL_RTS)
-	{
-		//Implement the code to enable RTS flow control
-		tempreg |= USART_CR3_RTSE;
-
-	}else if (pUSARTHandle->USART_Config.USART_HWFlowControl == USART_HW_FLOW_CTRL_CTS_RTS)
+	if ( (pUSARTHandle->USART_Config.USART_HWFlowControl == USART_HW_FLOW_CTRL_RTS) ||
+	     (pUSARTHandle->USART_Config.USART_HWFlowControl == USART_HW_FLOW_CTRL_CTS_RTS) )
 	{
-		//Implement the code to enable both CTS and RTS Flow control
-		tempreg |= ( 1 << USART_CR3_CTSE);
-		tempreg |= USART_CR3_RTSE;
+		if (pUSARTHandle->pRTSPort == NULL)
+		{
+			//hardware RTS, deasserted while DR holds an unread byte
+			tempreg |= ( 1 << USART_CR3_RTSE);
+		}
+		else
+		{
+			//software RTS on a GPIO, ready to receive until a ring watermark says otherwise
+			usart_rts_control(pUSARTHandle, ENABLE);
+		}
 	}
 
 
@@ -156,9 +221,7 @@ void USART_Init(USART_Handle_t *pUSARTHandle)
 /******************************** Configuration of BRR(Baudrate register)******************************************/
 
 	//Implement the code to configure the baud rate
-	//We will cover this in the lecture. No action required here
-	USART_SetBaudRate(pUSARTHandle->pUSARTx, pUSARTHandle->USART_Config.USART_Baud);
-
+	return USART_SetBaudRate(pUSARTHandle->pUSARTx, pUSARTHandle->USART_Config.USART_Baud);
 }
 
 void USART_DeInit(USART_RegDef_t *pUSARTx)
@@ -190,11 +253,14 @@ void USART_SendData(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint32_t L
 {
 
 	uint16_t *pdata;
+
+	usart_de_control(pUSARTHandle, ENABLE);
+
    //Loop over until "Len" number of bytes are transferred
 	for(uint32_t i = 0 ; i < Len; i++)
 	{
 		//Implement the code to wait until TXE flag is set in the SR
-		while(! USART_GetFlagStatus(pUSARTHandle->pUSARTx,USART_SR_TXE));
+		while(! USART_GetFlagStatus(pUSARTHandle->pUSARTx,USART_FLAG_TXE));
 
          //Check the USART_WordLength item for 9BIT or 8BIT in a frame
 		if(pUSARTHandle->USART_Config.USART_WordLength == USART_WORDLEN_9BITS)
@@ -230,6 +296,9 @@ void USART_SendData(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint32_t L
 
 	//Implement the code to wait till TC flag is set in the SR
 	while( ! USART_GetFlagStatus(pUSARTHandle->pUSARTx,USART_FLAG_TC));
+
+	//the last stop bit is out, give the bus back
+	usart_de_control(pUSARTHandle, DISABLE);
 }
 
 
@@ -254,7 +323,7 @@ void USART_ReceiveData(USART_Handle_t *pUSARTHandle, uint8_t *pRxBuffer, uint32_
 	for(uint32_t i = 0 ; i < Len; i++)
 	{
 		//Implement the code to wait until RXNE flag is set in the SR
-		while(! USART_GetFlagStatus(pUSARTHandle->pUSARTx,USART_SR_RXNE));
+		while(! USART_GetFlagStatus(pUSARTHandle->pUSARTx,USART_FLAG_RXNE));
 
 		//Check the USART_WordLength to decide whether we are going to receive 9bit of data in a frame or 8 bit
 		if(pUSARTHandle->USART_Config.USART_WordLength == USART_WORDLEN_9BITS)
@@ -335,6 +404,8 @@ uint8_t USART_SendDataIT(USART_Handle_t *pUSARTHandle,uint8_t *pTxBuffer, uint32
 		pUSARTHandle->pTxBuffer = pTxBuffer;
 		pUSARTHandle->TxBusyState = USART_BUSY_IN_TX;
 
+		usart_de_control(pUSARTHandle, ENABLE);
+
 		//Implement the code to enable interrupt for TXE
 		pUSARTHandle->pUSARTx->CR1 |= ( 1 << USART_CR1_TXEIE);
 
@@ -368,17 +439,20 @@ uint8_t USART_ReceiveDataIT(USART_Handle_t *pUSARTHandle,uint8_t *pRxBuffer, uin
 {
 	uint8_t rxstate = pUSARTHandle->RxBusyState;
 
-	if(rxstate != USART_MODE_ONLY_RX)
+	if(rxstate != USART_BUSY_IN_RX)
 	{
 		pUSARTHandle->RxLen = Len;
 		pUSARTHandle->pRxBuffer = pRxBuffer;
-		pUSARTHandle->RxBusyState = USART_MODE_ONLY_RX;
+		pUSARTHandle->RxBusyState = USART_BUSY_IN_RX;
 
 		(void)pUSARTHandle->pUSARTx->DR;
 
 		//Implement the code to enable interrupt for RXNE
 		pUSARTHandle->pUSARTx->CR1 |= ( 1 << USART_CR1_RXNEIE);
 
+		//there is room for Len frames now
+		usart_rts_control(pUSARTHandle, ENABLE);
+
 	}
 
 	return rxstate;
@@ -388,394 +462,1340 @@ uint8_t USART_ReceiveDataIT(USART_Handle_t *pUSARTHandle,uint8_t *pRxBuffer, uin
 
 
 /*
- * IRQ Configuration and ISR handling
+ * Streaming
  */
-void USART_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
+
+//orders the ring data accesses against the index update that publishes them
+#ifndef USART_MEMORY_BARRIER
+#define USART_MEMORY_BARRIER()		__asm volatile ("dmb" ::: "memory")
+#endif
+
+//returns 1 if DR was written
+static uint8_t usart_stream_tx(USART_Handle_t *pUSARTHandle)
 {
+	uint32_t tail = pUSARTHandle->TxTail;
+	uint32_t count = pUSARTHandle->TxHead - tail;
 
-	if(EnorDi == ENABLE)
+	if (count == 0)
 	{
-		if(IRQNumber <= 31)
-		{
-			//program ISER0 register
-			*DRV_NVIC_ISER0 |= ( 1 << IRQNumber );
+		//ring drained, USART_StreamWrite enables TXEIE again
+		pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_TXEIE);
 
-		}else if(IRQNumber > 31 && IRQNumber < 64 ) //32 to 63
+		//the transceiver is switched back once the last byte is out
+		if (pUSARTHandle->pDEPort != NULL)
 		{
-			//program ISER1 register
-			*DRV_NVIC_ISER1 |= ( 1 << (IRQNumber % 32) );
-		}
-		else if(IRQNumber >= 64 && IRQNumber < 96 )
-		{
-			//program ISER2 register //64 to 95
-			*DRV_NVIC_ISER3 |= ( 1 << (IRQNumber % 64) );
+			pUSARTHandle->pUSARTx->CR1 |= ( 1 << USART_CR1_TCIE);
 		}
-	}else
+		return 0;
+	}
+
+	USART_MEMORY_BARRIER();
+	pUSARTHandle->pUSARTx->DR = pUSARTHandle->pTxRing[tail & (pUSARTHandle->TxRingSize - 1)];
+	USART_MEMORY_BARRIER();
+	pUSARTHandle->TxTail = tail + 1;
+
+	if ((count - 1) == pUSARTHandle->TxLowWater)
 	{
-		if(IRQNumber <= 31)
-		{
-			//program ICER0 register
-			*DRV_NVIC_ICER0 |= ( 1 << IRQNumber );
-		}else if(IRQNumber > 31 && IRQNumber < 64 )
-		{
-			//program ICER1 register
-			*DRV_NVIC_ICER1 |= ( 1 << (IRQNumber % 32) );
-		}
-		else if(IRQNumber >= 6 && IRQNumber < 96 )
-		{
-			//program ICER2 register
-			*DRV_NVIC_ICER3 |= ( 1 << (IRQNumber % 64) );
-		}
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_TX_LOW_WATER);
 	}
 
+	return 1;
 }
 
-void USART_IRQPriorityConfig(uint8_t IRQNumber,uint32_t IRQPriority)
+static void usart_stream_rx(USART_Handle_t *pUSARTHandle)
 {
-	//1. first lets find out the ipr register
-	uint8_t iprx = IRQNumber / 4;
-	uint8_t iprx_section  = IRQNumber %4 ;
+	uint32_t head = pUSARTHandle->RxHead;
+	uint32_t count = head - pUSARTHandle->RxTail;
+	uint8_t data;
 
-	uint8_t shift_amount = ( 8 * iprx_section) + ( 8 - NO_PR_BITS_IMPLEMENTED) ;
+	//reading DR clears RXNE (and ORE after the SR read of the caller)
+	if (pUSARTHandle->USART_Config.USART_ParityControl == USART_PARITY_DISABLE)
+	{
+		data = (uint8_t)(pUSARTHandle->pUSARTx->DR & 0xFF);
+	}
+	else
+	{
+		data = (uint8_t)(pUSARTHandle->pUSARTx->DR & 0x7F);
+	}
 
-	*(  DRV_NVIC_IPR_BASE_ADDR + iprx ) |=  ( IRQPriority << shift_amount );
+	if (count >= pUSARTHandle->RxRingSize)
+	{
+		pUSARTHandle->RxDrops++;
+		return;
+	}
+
+	pUSARTHandle->pRxRing[head & (pUSARTHandle->RxRingSize - 1)] = data;
+	USART_MEMORY_BARRIER();
+	pUSARTHandle->RxHead = head + 1;
+
+	if (((count + 1) >= pUSARTHandle->RxHighWater) && !pUSARTHandle->RxAboveHigh)
+	{
+		pUSARTHandle->RxAboveHigh = SET;
 
+		//throttle the sender before the ring overflows, not after ORE
+		usart_rts_control(pUSARTHandle, DISABLE);
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_RX_HIGH_WATER);
+	}
 }
 
 /*********************************************************************
- * @fn      		  - USART_IRQHandler
+ * @fn      		  - USART_StreamStart
  *
- * @brief             -
+ * @brief             - switches the USART to continuous full-duplex streaming over two rings
  *
- * @param[in]         -
- * @param[in]         -
- * @param[in]         -
+ * @param[in]         - USART handle, initialized with 8 bit frames
+ * @param[in]         - TX ring storage and its size, power of two
+ * @param[in]         - RX ring storage and its size, power of two
  *
- * @return            -
+ * @return            - USART_OK, USART_ERR_PARAM or USART_ERR_BUSY
  *
- * @Note              - Resolve all the TODOs
-
+ * @Note              - the ISR moves bytes between DR and the rings without any per call setup,
+ *                      USART_StreamWrite/USART_StreamRead never block. One producer and one
+ *                      consumer per ring, the rings need no locking. Set RxHighWater, RxLowWater
+ *                      and TxLowWater before the call or leave them 0 for the defaults.
  */
-void USART_IRQHandling(USART_Handle_t *pUSARTHandle)
+uint8_t USART_StreamStart(USART_Handle_t *pUSARTHandle, uint8_t *pTxRing, uint32_t TxSize, uint8_t *pRxRing, uint32_t RxSize)
 {
+	if ((TxSize == 0) || (TxSize & (TxSize - 1)) || (RxSize == 0) || (RxSize & (RxSize - 1))) return USART_ERR_PARAM;
+	if (pUSARTHandle->USART_Config.USART_WordLength != USART_WORDLEN_8BITS) return USART_ERR_PARAM;
+	if ((pUSARTHandle->TxBusyState != USART_READY) || (pUSARTHandle->RxBusyState != USART_READY)) return USART_ERR_BUSY;
+
+	pUSARTHandle->pTxRing = pTxRing;
+	pUSARTHandle->pRxRing = pRxRing;
+	pUSARTHandle->TxRingSize = TxSize;
+	pUSARTHandle->RxRingSize = RxSize;
+	pUSARTHandle->TxHead = 0;
+	pUSARTHandle->TxTail = 0;
+	pUSARTHandle->RxHead = 0;
+	pUSARTHandle->RxTail = 0;
+	pUSARTHandle->RxAboveHigh = RESET;
+	pUSARTHandle->RxDrops = 0;
+	usart_rts_control(pUSARTHandle, ENABLE);
+
+	if ((pUSARTHandle->RxHighWater == 0) || (pUSARTHandle->RxHighWater > RxSize)) pUSARTHandle->RxHighWater = RxSize - (RxSize / 4);
+	if ((pUSARTHandle->RxLowWater == 0) || (pUSARTHandle->RxLowWater >= pUSARTHandle->RxHighWater)) pUSARTHandle->RxLowWater = RxSize / 4;
+	if ((pUSARTHandle->TxLowWater == 0) || (pUSARTHandle->TxLowWater >= TxSize)) pUSARTHandle->TxLowWater = TxSize / 4;
+
+	//the interrupt driven single buffer transfers report busy while streaming
+	pUSARTHandle->TxBusyState = USART_BUSY_IN_TX;
+	pUSARTHandle->RxBusyState = USART_BUSY_IN_RX;
+	pUSARTHandle->Streaming = SET;
+
+	(void)pUSARTHandle->pUSARTx->DR;
+	pUSARTHandle->pUSARTx->CR1 |= ( 1 << USART_CR1_RXNEIE);
+
+	return USART_OK;
+}
 
-	uint32_t temp1 , temp2, temp3;
-
-	uint16_t *pdata;
-
-/*************************Check for TC flag ********************************************/
+//stops streaming, bytes still in the rings are discarded
+void USART_StreamStop(USART_Handle_t *pUSARTHandle)
+{
+	uint32_t primask;
+
+	DRV_ENTER_CRITICAL(primask);
+	pUSARTHandle->pUSARTx->CR1 &= ~(( 1 << USART_CR1_TXEIE) | ( 1 << USART_CR1_RXNEIE));
+	pUSARTHandle->Streaming = RESET;
+	pUSARTHandle->TxBusyState = USART_READY;
+	pUSARTHandle->RxBusyState = USART_READY;
+	DRV_EXIT_CRITICAL(primask);
+}
 
-    //Implement the code to check the state of TC bit in the SR
-	temp1 = pUSARTHandle->pUSARTx->SR & ( 1 << USART_SR_TC);
+/*********************************************************************
+ * @fn      		  - USART_StreamWrite
+ *
+ * @brief             - queues bytes for transmission
+ *
+ * @param[in]         - USART handle in streaming mode
+ * @param[in]         - data
+ * @param[in]         - number of bytes
+ *
+ * @return            - number of bytes queued, less than Len when the TX ring is full
+ *
+ * @Note              - non-blocking, only one context may write
+ */
+uint32_t USART_StreamWrite(USART_Handle_t *pUSARTHandle, const uint8_t *pData, uint32_t Len)
+{
+	uint32_t head = pUSARTHandle->TxHead;
+	uint32_t space = pUSARTHandle->TxRingSize - (head - pUSARTHandle->TxTail);
+	uint32_t mask = pUSARTHandle->TxRingSize - 1;
+	uint32_t primask;
 
-	 //Implement the code to check the state of TCIE bit
-	temp2 = pUSARTHandle->pUSARTx->CR1 & ( 1 << USART_CR1_TCIE);
+	if (Len > space) Len = space;
+	if (Len == 0) return 0;
 
-	if(temp1 && temp2 )
+	for (uint32_t i = 0; i < Len; i++)
 	{
-		//this interrupt is because of TC
+		pUSARTHandle->pTxRing[(head + i) & mask] = pData[i];
+	}
 
-		//close transmission and call application callback if TxLen is zero
-		if ( pUSARTHandle->TxBusyState == USART_BUSY_IN_TX)
-		{
-			//Check the TxLen . If it is zero then close the data transmission
-			if(! pUSARTHandle->TxLen )
-			{
-				//Implement the code to clear the TC flag
-				pUSARTHandle->pUSARTx->SR &= ~( 1 << USART_SR_TC);
+	USART_MEMORY_BARRIER();
+	pUSARTHandle->TxHead = head + Len;
 
-				//Implement the code to clear the TCIE control bit
-				pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_TCIE);
+	//CR1 is also written by the ISR
+	DRV_ENTER_CRITICAL(primask);
+	usart_de_control(pUSARTHandle, ENABLE);
+	pUSARTHandle->pUSARTx->CR1 |= ( 1 << USART_CR1_TXEIE);
+	DRV_EXIT_CRITICAL(primask);
 
-				//Reset the application state
-				pUSARTHandle->TxBusyState = USART_READY;
+	return Len;
+}
 
-				//Reset Buffer address to NULL
-				pUSARTHandle->pTxBuffer = NULL;
+/*********************************************************************
+ * @fn      		  - USART_StreamRead
+ *
+ * @brief             - takes received bytes out of the RX ring
+ *
+ * @param[in]         - USART handle in streaming mode
+ * @param[out]        - destination
+ * @param[in]         - maximum number of bytes
+ *
+ * @return            - number of bytes copied, 0 if nothing was received
+ *
+ * @Note              - non-blocking, only one context may read. USART_EVENT_RX_LOW_WATER is
+ *                      raised from here once the ring drains after a high watermark.
+ */
+uint32_t USART_StreamRead(USART_Handle_t *pUSARTHandle, uint8_t *pData, uint32_t Len)
+{
+	uint32_t tail = pUSARTHandle->RxTail;
+	uint32_t count = pUSARTHandle->RxHead - tail;
+	uint32_t mask = pUSARTHandle->RxRingSize - 1;
 
-				//Reset the length to zero
-				pUSARTHandle->TxLen = 0;
+	if (Len > count) Len = count;
 
-				//Call the applicaton call back with event USART_EVENT_TX_CMPLT
-				USART_ApplicationEventCallback(pUSARTHandle,USART_EVENT_TX_CMPLT);
-			}
+	if (Len != 0)
+	{
+		USART_MEMORY_BARRIER();
+		for (uint32_t i = 0; i < Len; i++)
+		{
+			pData[i] = pUSARTHandle->pRxRing[(tail + i) & mask];
 		}
+		USART_MEMORY_BARRIER();
+		pUSARTHandle->RxTail = tail + Len;
 	}
 
-/*************************Check for TXE flag ********************************************/
+	if (pUSARTHandle->RxAboveHigh && ((count - Len) <= pUSARTHandle->RxLowWater))
+	{
+		pUSARTHandle->RxAboveHigh = RESET;
+		usart_rts_control(pUSARTHandle, ENABLE);
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_RX_LOW_WATER);
+	}
 
-	//Implement the code to check the state of TXE bit in the SR
-	temp1 = pUSARTHandle->pUSARTx->SR & ( 1 << USART_SR_TXE);
+	return Len;
+}
 
-	//Implement the code to check the state of TXEIE bit in CR1
-	temp2 = pUSARTHandle->pUSARTx->CR1 & ( 1 << USART_CR1_TXEIE);
+uint32_t USART_StreamRxCount(USART_Handle_t *pUSARTHandle)
+{
+	return pUSARTHandle->RxHead - pUSARTHandle->RxTail;
+}
 
+uint32_t USART_StreamTxFree(USART_Handle_t *pUSARTHandle)
+{
+	return pUSARTHandle->TxRingSize - (pUSARTHandle->TxHead - pUSARTHandle->TxTail);
+}
 
-	if(temp1 && temp2 )
-	{
-		//this interrupt is because of TXE
 
-		if(pUSARTHandle->TxBusyState == USART_BUSY_IN_TX)
-		{
-			//Keep sending data until Txlen reaches to zero
-			if(pUSARTHandle->TxLen > 0)
-			{
-				//Check the USART_WordLength item for 9BIT or 8BIT in a frame
-				if(pUSARTHandle->USART_Config.USART_WordLength == USART_WORDLEN_9BITS)
-				{
-					//if 9BIT , load the DR with 2bytes masking the bits other than first 9 bits
-					pdata = (uint16_t*) pUSARTHandle->pTxBuffer;
-
-					//loading only first 9 bits , so we have to mask with the value 0x01FF
-					pUSARTHandle->pUSARTx->DR = (*pdata & (uint16_t)0x01FF);
-
-					//check for USART_ParityControl
-					if(pUSARTHandle->USART_Config.USART_ParityControl == USART_PARITY_DISABLE)
-					{
-						//No parity is used in this transfer , so, 9bits of user data will be sent
-						//Implement the code to increment pTxBuffer twice
-						pUSARTHandle->pTxBuffer++;
-						pUSARTHandle->pTxBuffer++;
-						pUSARTHandle->TxLen -= 2;
-
-						//Implement the code to decrement the length
-						pUSARTHandle->pTxBuffer++;
-						pUSARTHandle->TxLen--;
-					}
-					else
-					{
-						//Parity bit is used in this transfer . so , 8bits of user data will be sent
-						//The 9th bit will be replaced by parity bit by the hardware
-						pUSARTHandle->pTxBuffer++;
-
-						//Implement the code to decrement the length
-						pUSARTHandle->TxLen--;
-					}
-				}
-				else
-				{
-					//This is 8bit data transfer
-					pUSARTHandle->pUSARTx->DR = (*pUSARTHandle->pTxBuffer  & (uint8_t)0xFF);
-
-					//Implement the code to increment the buffer address
-					pUSARTHandle->pTxBuffer++;
-
-					//Implement the code to decrement the length
-					pUSARTHandle->TxLen--;
-				}
+/*
+ * Circular DMA reception
+ */
 
-			}
-			if (pUSARTHandle->TxLen == 0 )
-			{
-				//TxLen is zero
-				//Implement the code to clear the TXEIE bit (disable interrupt for TXE flag )
-				pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_TXEIE);
-			}
-		}
-	}
+//reports a slice, the bytes stay held by the app until USART_DMARxRelease
+static void usart_dmarx_slice(USART_Handle_t *pUSARTHandle, uint16_t Len)
+{
+	USART_DMARx_t *pDMARx = pUSARTHandle->pDMARx;
+	uint32_t primask;
 
-/*************************Check for RXNE flag ********************************************/
+	pDMARx->pSlice = &pDMARx->pBuf[pDMARx->ReadPos];
+	pDMARx->SliceLen = Len;
 
-	temp1 = pUSARTHandle->pUSARTx->SR & ( 1 << USART_SR_RXNE);
-	temp2 = pUSARTHandle->pUSARTx->CR1 & ( 1 << USART_CR1_RXNEIE);
+	//the app can't hold more than the buffer, saturate so a missing release doesn't wrap Held
+	DRV_ENTER_CRITICAL(primask);
+	if (Len > (pDMARx->BufLen - pDMARx->Held)) pDMARx->Held = pDMARx->BufLen;
+	else pDMARx->Held += Len;
+	DRV_EXIT_CRITICAL(primask);
 
+	USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_RX_SLICE);
+}
 
-	if(temp1 && temp2 )
-	{
-		//this interrupt is because of rxne
-		//this interrupt is because of txe
-		if(pUSARTHandle->RxBusyState == USART_BUSY_IN_RX)
-		{
-			//TXE is set so send data
-			if(pUSARTHandle->RxLen > 0)
-			{
-				//Check the USART_WordLength to decide whether we are going to receive 9bit of data in a frame or 8 bit
-				if(pUSARTHandle->USART_Config.USART_WordLength == USART_WORDLEN_9BITS)
-				{
-					//We are going to receive 9bit data in a frame
+//hands everything the DMA wrote since the last call to the app, as one or two slices
+static void usart_dmarx_collect(USART_Handle_t *pUSARTHandle)
+{
+	USART_DMARx_t *pDMARx = pUSARTHandle->pDMARx;
+	uint16_t pos = pDMARx->BufLen - DMA_GetDataCounter(pDMARx->pRxDMA);
+	uint8_t wrapped;
 
-					//Now, check are we using USART_ParityControl control or not
-					if(pUSARTHandle->USART_Config.USART_ParityControl == USART_PARITY_DISABLE)
-					{
-						//No parity is used. so, all 9bits will be of user data
+	if (pos == pDMARx->BufLen) pos = 0;
+	wrapped = (pos < pDMARx->ReadPos);
+	if (wrapped) pDMARx->SeenWraps++;
 
-						//read only first 9 bits so mask the DR with 0x01FF
-						*((uint16_t*) pUSARTHandle->pRxBuffer) = (pUSARTHandle->pUSARTx->DR  & (uint16_t)0x01FF);
+	//the DMA wrapped more often than the write position shows, it went past ReadPos
+	if ((int32_t)(pDMARx->DmaWraps - pDMARx->SeenWraps) > 0)
+	{
+		pDMARx->SeenWraps = pDMARx->DmaWraps;
+		pDMARx->ReadPos = pos;
+		pDMARx->Overruns++;
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_RX_OVERRUN);
+		return;
+	}
 
-						//Now increment the pRxBuffer two times
-						pUSARTHandle->pRxBuffer++;
-						pUSARTHandle->pRxBuffer++;
+	if (pos == pDMARx->ReadPos) return;
 
-						//Implement the code to decrement the length
-						pUSARTHandle->RxLen -= 2;
-					}
-					else
-					{
-						//Parity is used. so, 8bits will be of user data and 1 bit is parity
-						 *pUSARTHandle->pRxBuffer = (pUSARTHandle->pUSARTx->DR  & (uint8_t)0xFF);
+	if (wrapped)
+	{
+		//the tail of the buffer first
+		usart_dmarx_slice(pUSARTHandle, pDMARx->BufLen - pDMARx->ReadPos);
+		pDMARx->ReadPos = 0;
+		if (pUSARTHandle->pDMARx != pDMARx) return;
+	}
 
-						 //Now increment the pRxBuffer
-						 pUSARTHandle->pRxBuffer++;
+	if (pos != 0)
+	{
+		usart_dmarx_slice(pUSARTHandle, pos - pDMARx->ReadPos);
+		pDMARx->ReadPos = pos;
+	}
 
-						 //Implement the code to decrement the length
-						 pUSARTHandle->RxLen--;
-					}
-				}
-				else
-				{
-					//We are going to receive 8bit data in a frame
+	//everything written is handed over here, the held bytes are the distance between the
+	//DMA write position and the consumer. Up to half a buffer arrives before the next check.
+	if ((pDMARx->Held >= pUSARTHandle->RxHighWater) && !pUSARTHandle->RxAboveHigh)
+	{
+		pUSARTHandle->RxAboveHigh = SET;
+		usart_rts_control(pUSARTHandle, DISABLE);
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_RX_HIGH_WATER);
+	}
+}
 
-					//Now, check are we using USART_ParityControl control or not
-					if(pUSARTHandle->USART_Config.USART_ParityControl == USART_PARITY_DISABLE)
-					{
-						//No parity is used , so all 8bits will be of user data
+/*
+ * ReadPos has a single owner at a time: a call that interrupts another one (USART and RX
+ * DMA interrupts at different priorities) only leaves a note, the running call picks it up
+ * before it returns. The frame end is reported after the slices that precede it.
+ */
+static void usart_dmarx_process(USART_Handle_t *pUSARTHandle, uint8_t FrameEnd)
+{
+	USART_DMARx_t *pDMARx = pUSARTHandle->pDMARx;
+	uint32_t primask;
 
-						//read 8 bits from DR
-						 *pUSARTHandle->pRxBuffer = (uint8_t) (pUSARTHandle->pUSARTx->DR  & (uint8_t)0xFF);
-					}
+	DRV_ENTER_CRITICAL(primask);
+	if (FrameEnd) pDMARx->FrameEnd = SET;
+	if (pDMARx->Busy)
+	{
+		pDMARx->Again = SET;
+		DRV_EXIT_CRITICAL(primask);
+		return;
+	}
+	pDMARx->Busy = SET;
+	DRV_EXIT_CRITICAL(primask);
 
-					else
-					{
-						//Parity is used, so , 7 bits will be of user data and 1 bit is parity
+	while(1)
+	{
+		//a frame end noted from here on belongs to data the next pass collects
+		DRV_ENTER_CRITICAL(primask);
+		pDMARx->Again = RESET;
+		FrameEnd = pDMARx->FrameEnd;
+		pDMARx->FrameEnd = RESET;
+		DRV_EXIT_CRITICAL(primask);
 
-						//read only 7 bits , hence mask the DR with 0X7F
-						 *pUSARTHandle->pRxBuffer = (uint8_t) (pUSARTHandle->pUSARTx->DR  & (uint8_t)0x7F);
+		usart_dmarx_collect(pUSARTHandle);
 
-					}
+		if (FrameEnd)
+		{
+			pDMARx->FrameCount++;
+			USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_RX_FRAME_END);
+		}
 
-					//Now , increment the pRxBuffer
-					pUSARTHandle->pRxBuffer++;
+		DRV_ENTER_CRITICAL(primask);
+		//the callbacks may have stopped the reception
+		if (!pDMARx->Again || (pUSARTHandle->pDMARx != pDMARx))
+		{
+			pDMARx->Busy = RESET;
+			DRV_EXIT_CRITICAL(primask);
+			break;
+		}
+		DRV_EXIT_CRITICAL(primask);
+	}
+}
 
-					//Implement the code to decrement the length
-					pUSARTHandle->RxLen--;
-				}
+/*********************************************************************
+ * @fn      		  - USART_DMARxStart
+ *
+ * @brief             - starts continuous reception into a circular DMA buffer
+ *
+ * @param[in]         - USART handle, initialized with 8 bit frames
+ * @param[in]         - context with pBuf, BufLen and pRxDMA filled in
+ *
+ * @return            - previous RxBusyState, USART_READY means the reception was started
+ *
+ * @Note              - received bytes are reported as (pointer, length) slices into pBuf with
+ *                      USART_EVENT_RX_SLICE, without copying, from the DMA half/full transfer
+ *                      interrupts and from the USART IDLE interrupt. USART_EVENT_RX_FRAME_END
+ *                      follows the slices of a frame once the line goes idle. The interrupt
+ *                      rate follows the frame rate, not the byte rate. A slice must be consumed
+ *                      before the DMA wraps around onto it, so size pBuf for the worst case
+ *                      callback latency. With software RTS the consumer returns the slices with
+ *                      USART_DMARxRelease, RxHighWater/RxLowWater (0 selects 1/4 and 1/8 of
+ *                      BufLen, at most 1/2) apply to the bytes it still holds.
+ */
+uint8_t USART_DMARxStart(USART_Handle_t *pUSARTHandle, USART_DMARx_t *pDMARx)
+{
+	uint8_t state = pUSARTHandle->RxBusyState;
 
+	if(state == USART_READY)
+	{
+		pDMARx->ReadPos = 0;
+		pDMARx->pSlice = NULL;
+		pDMARx->SliceLen = 0;
+		pDMARx->FrameCount = 0;
+		pDMARx->Held = 0;
+		pDMARx->Overruns = 0;
+		pDMARx->Busy = RESET;
+		pDMARx->Again = RESET;
+		pDMARx->FrameEnd = RESET;
+		pDMARx->DmaWraps = 0;
+		pDMARx->SeenWraps = 0;
+
+		//held bytes are checked every half buffer, the watermark needs that much headroom
+		if ((pUSARTHandle->RxHighWater == 0) || (pUSARTHandle->RxHighWater > (pDMARx->BufLen / 2U))) pUSARTHandle->RxHighWater = pDMARx->BufLen / 4U;
+		if ((pUSARTHandle->RxLowWater == 0) || (pUSARTHandle->RxLowWater >= pUSARTHandle->RxHighWater)) pUSARTHandle->RxLowWater = pDMARx->BufLen / 8U;
+		pUSARTHandle->RxAboveHigh = RESET;
+
+		pUSARTHandle->pDMARx = pDMARx;
+		pUSARTHandle->RxBusyState = USART_BUSY_IN_RX;
+
+		pDMARx->pRxDMA->DMAConfig.DMA_Direction = DMA_DIR_PERIPH_TO_MEM;
+		pDMARx->pRxDMA->DMAConfig.DMA_DataSize = DMA_DATA_SIZE_BYTE;
+		pDMARx->pRxDMA->DMAConfig.DMA_MemInc = ENABLE;
+		pDMARx->pRxDMA->DMAConfig.DMA_Mode = DMA_MODE_CIRCULAR;
+		pDMARx->pRxDMA->DMAConfig.DMA_ITControl = DMA_IT_HT | DMA_IT_TC | DMA_IT_TE;
+		DMA_Init(pDMARx->pRxDMA);
+
+		//drop a stale byte and a pending IDLE flag
+		(void)pUSARTHandle->pUSARTx->SR;
+		(void)pUSARTHandle->pUSARTx->DR;
 
-			}//if of >0
+		DMA_StartTransfer(pDMARx->pRxDMA, (uint32_t)&pUSARTHandle->pUSARTx->DR,
+				(uint32_t)pDMARx->pBuf, 0, pDMARx->BufLen);
 
-			if(! pUSARTHandle->RxLen)
-			{
-				//disable the rxne
-				pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_RXNEIE );
-				pUSARTHandle->RxBusyState = USART_READY;
-				USART_ApplicationEventCallback(pUSARTHandle,USART_EVENT_RX_CMPLT);
-			}
-		}
+		pUSARTHandle->pUSARTx->CR3 |= ( 1 << USART_CR3_DMAR);
+		pUSARTHandle->pUSARTx->CR1 |= ( 1 << USART_CR1_IDLEIE);
+		usart_rts_control(pUSARTHandle, ENABLE);
 	}
+	return state;
+}
 
+void USART_DMARxStop(USART_Handle_t *pUSARTHandle)
+{
+	if (pUSARTHandle->pDMARx == NULL) return;
 
-/*************************Check for CTS flag ********************************************/
-
-	//Implement the code to check the status of CTS bit in the SR
-	temp1 = pUSARTHandle->pUSARTx->SR & ( 1 << USART_SR_CTS);
+	pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_IDLEIE);
+	pUSARTHandle->pUSARTx->CR3 &= ~( 1 << USART_CR3_DMAR);
+	DMA_StopTransfer(pUSARTHandle->pDMARx->pRxDMA);
+	usart_rts_control(pUSARTHandle, DISABLE);
 
-	//Implement the code to check the state of CTSE bit in CR3
-	temp2 = pUSARTHandle->pUSARTx->CR3 & ( 1 << USART_CR3_CTSE);
+	pUSARTHandle->pDMARx = NULL;
+	pUSARTHandle->RxBusyState = USART_READY;
+}
 
-	//Implement the code to check the state of CTSIE bit in CR3
-	temp3 = pUSARTHandle->pUSARTx->CR3 & ( 1 << USART_CR3_CTSIE);
+/*********************************************************************
+ * @fn      		  - USART_DMARxRelease
+ *
+ * @brief             - returns consumed bytes of the reported slices to the receiver
+ *
+ * @param[in]         - USART handle in circular DMA reception
+ * @param[in]         - number of bytes consumed, oldest first
+ *
+ * @return            - none
+ *
+ * @Note              - may be called from the USART_EVENT_RX_SLICE callback or later from thread
+ *                      mode. Once the held bytes drop to RxLowWater after a high watermark, RTS
+ *                      is asserted again and USART_EVENT_RX_LOW_WATER is raised from here.
+ */
+void USART_DMARxRelease(USART_Handle_t *pUSARTHandle, uint16_t Len)
+{
+	USART_DMARx_t *pDMARx = pUSARTHandle->pDMARx;
+	uint8_t resume = RESET;
+	uint32_t primask;
 
+	if (pDMARx == NULL) return;
 
-	if(temp1  && temp2 )
+	//Held is also increased by the USART and DMA interrupts
+	DRV_ENTER_CRITICAL(primask);
+	if (Len > pDMARx->Held) Len = pDMARx->Held;
+	pDMARx->Held -= Len;
+	if (pUSARTHandle->RxAboveHigh && (pDMARx->Held <= pUSARTHandle->RxLowWater))
 	{
-		//Implement the code to clear the CTS flag in SR
-		pUSARTHandle->pUSARTx->SR &= ~(1 << USART_SR_CTS);
+		pUSARTHandle->RxAboveHigh = RESET;
+		resume = SET;
+	}
+	DRV_EXIT_CRITICAL(primask);
 
-		//this interrupt is because of cts
-		USART_ApplicationEventCallback(pUSARTHandle,USART_EVENT_CTS);
+	if (resume)
+	{
+		usart_rts_control(pUSARTHandle, ENABLE);
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_RX_LOW_WATER);
 	}
+}
 
-/*************************Check for IDLE detection flag ********************************************/
+/*********************************************************************
+ * @fn      		  - USART_DMARxIRQHandling
+ *
+ * @brief             - to be called from the IRQ handler of the RX DMA stream
+ *
+ * @param[in]         - USART handle
+ *
+ * @return            - none
+ *
+ * @Note              - half and full transfer hand over the bytes received so far, so a frame
+ *                      longer than half the buffer is delivered before it is overwritten
+ */
+void USART_DMARxIRQHandling(USART_Handle_t *pUSARTHandle)
+{
+	uint8_t flags;
 
-	//Implement the code to check the status of IDLE flag bit in the SR
-	temp1 = pUSARTHandle->pUSARTx->SR & ( 1 << USART_SR_IDLE);
+	if (pUSARTHandle->pDMARx == NULL) return;
 
-	//Implement the code to check the state of IDLEIE bit in CR1
-	temp2 = pUSARTHandle->pUSARTx->CR1 & ( 1 << USART_CR1_IDLEIE);
+	flags = DMA_GetFlags(pUSARTHandle->pDMARx->pRxDMA);
+	DMA_ClearFlags(pUSARTHandle->pDMARx->pRxDMA, flags);
 
+	if (flags & DMA_FLAG_TC)
+	{
+		pUSARTHandle->pDMARx->DmaWraps++;
+	}
 
-	if(temp1 && temp2)
+	if (flags & (DMA_FLAG_HT | DMA_FLAG_TC))
 	{
-		//Implement the code to clear the IDLE flag. Refer to the RM to understand the clear sequence
-		uint32_t dummy = pUSARTHandle->pUSARTx->SR;;
-		dummy = pUSARTHandle->pUSARTx->DR;
+		usart_dmarx_process(pUSARTHandle, RESET);
+	}
 
-		//this interrupt is because of idle
-		USART_ApplicationEventCallback(pUSARTHandle,USART_EVENT_IDLE);
+	if (flags & DMA_FLAG_TE)
+	{
+		//the hardware has disabled the stream, nothing more will be received
+		USART_DMARxStop(pUSARTHandle);
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_DMA_ERR);
 	}
+}
 
-/*************************Check for Overrun detection flag ********************************************/
 
-	//Implement the code to check the status of ORE flag  in the SR
-	temp1 = pUSARTHandle->pUSARTx->SR & USART_SR_ORE;
+/*
+ * Scatter-gather DMA transmission
+ */
 
-	//Implement the code to check the status of RXNEIE  bit in the CR1
-	temp2 = pUSARTHandle->pUSARTx->CR1 & USART_CR1_RXNEIE;
+static USART_TxSeg_t *usart_dmatx_skip_empty(USART_TxSeg_t *pSeg)
+{
+	while ((pSeg != NULL) && (pSeg->Len == 0))
+	{
+		pSeg = pSeg->pNext;
+	}
+	return pSeg;
+}
 
+static void usart_dmatx_start_seg(USART_Handle_t *pUSARTHandle, USART_TxSeg_t *pSeg)
+{
+	USART_DMATx_t *pDMATx = pUSARTHandle->pDMATx;
 
-	if(temp1  && temp2 )
-	{
-		//Need not to clear the ORE flag here, instead give an api for the application to clear the ORE flag .
-		uint32_t dummy = pUSARTHandle->pUSARTx->SR;;
-		dummy = pUSARTHandle->pUSARTx->DR;
+	pDMATx->pCurSeg = pSeg;
+	usart_de_control(pUSARTHandle, ENABLE);
 
-		//this interrupt is because of Overrun error
-		USART_ApplicationEventCallback(pUSARTHandle,USART_ERREVENT_ORE);
+	if (usart_dmatx_skip_empty(pSeg->pNext) == NULL)
+	{
+		//last segment, the chain is done once its last bit left the shift register.
+		//TC may still be set from the gap before this segment, rc_w0 so the others are kept
+		pUSARTHandle->pUSARTx->SR = ~( 1 << USART_SR_TC);
+		pUSARTHandle->pUSARTx->CR1 |= ( 1 << USART_CR1_TCIE);
 	}
 
+	DMA_StartTransfer(pDMATx->pTxDMA, (uint32_t)&pUSARTHandle->pUSARTx->DR, (uint32_t)pSeg->pData, 0, pSeg->Len);
+}
 
+static void usart_dmatx_chain_done(USART_Handle_t *pUSARTHandle, uint8_t Status)
+{
+	USART_DMATx_t *pDMATx = pUSARTHandle->pDMATx;
+	USART_TxChain_t *pChain = pDMATx->pHead;
 
-/*************************Check for Error Flag ********************************************/
+	pDMATx->pHead = pChain->pNext;
+	if (pDMATx->pHead == NULL) pDMATx->pTail = NULL;
 
-//Noise Flag, Overrun error and Framing Error in multibuffer communication
-//We dont discuss multibuffer communication in this course. please refer to the RM
-//The blow code will get executed in only if multibuffer mode is used.
+	pChain->pNext = NULL;
+	pChain->Status = Status;
+	pDMATx->ChainCount++;
+	pDMATx->pDoneChain = pChain;
+	USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_TX_CHAIN_DONE);
+}
 
-	temp2 =  pUSARTHandle->pUSARTx->CR3 & ( 1 << USART_CR3_EIE) ;
+//starts the chain at the head of the queue, chains submitted from the callbacks are picked up here
+static void usart_dmatx_kick(USART_Handle_t *pUSARTHandle)
+{
+	USART_DMATx_t *pDMATx = pUSARTHandle->pDMATx;
+	USART_TxSeg_t *pSeg;
 
-	if(temp2 )
+	while (pDMATx->pHead != NULL)
 	{
-		temp1 = pUSARTHandle->pUSARTx->SR;
-		if(temp1 & ( 1 << USART_SR_FE))
-		{
-			/*
-				This bit is set by hardware when a de-synchronization, excessive noise or a break character
-				is detected. It is cleared by a software sequence (an read to the USART_SR register
-				followed by a read to the USART_DR register).
-			*/
-			uint32_t dummy = pUSARTHandle->pUSARTx->SR;;
-			dummy = pUSARTHandle->pUSARTx->DR;
-			USART_ApplicationEventCallback(pUSARTHandle,USART_ERREVENT_FE);
-		}
-
-		if(temp1 & ( 1 << USART_SR_NF) )
+		pSeg = usart_dmatx_skip_empty(pDMATx->pHead->pSegs);
+		if (pSeg != NULL)
 		{
-			/*
-				This bit is set by hardware when noise is detected on a received frame. It is cleared by a
-				software sequence (an read to the USART_SR register followed by a read to the
-				USART_DR register).
-			*/
-			uint32_t dummy = pUSARTHandle->pUSARTx->SR;;
-			dummy = pUSARTHandle->pUSARTx->DR;
-			USART_ApplicationEventCallback(pUSARTHandle,USART_ERREVENT_NF);
+			usart_dmatx_start_seg(pUSARTHandle, pSeg);
+			return;
 		}
 
-		if(temp1 & ( 1 << USART_SR_ORE) )
-		{
-			USART_ApplicationEventCallback(pUSARTHandle,USART_ERREVENT_ORE);
-		}
+		//nothing to send in this chain
+		usart_dmatx_chain_done(pUSARTHandle, USART_OK);
 	}
 
-
+	pDMATx->pCurSeg = NULL;
+	pDMATx->Active = RESET;
 }
 
-
-/*
- * Other Peripheral Control APIs
+/*********************************************************************
+ * @fn      		  - USART_DMATxStart
+ *
+ * @brief             - switches transmission to the scatter-gather DMA path
+ *
+ * @param[in]         - USART handle
+ * @param[in]         - context with pTxDMA filled in
+ *
+ * @return            - previous TxBusyState, USART_READY means the path was set up
+ *
+ * @Note              - chains are queued with USART_DMATxSubmit. The DMA completion interrupt
+ *                      walks the segments of a chain without copying, TC is only used for the
+ *                      last segment. The next queued chain starts from the TC interrupt.
  */
-void USART_PeripheralControl(USART_RegDef_t *pUSARTx, uint8_t EnOrDi)
+uint8_t USART_DMATxStart(USART_Handle_t *pUSARTHandle, USART_DMATx_t *pDMATx)
 {
-	if (EnOrDi == ENABLE)
+	uint8_t state = pUSARTHandle->TxBusyState;
+
+	if(state == USART_READY)
+	{
+		pDMATx->pHead = NULL;
+		pDMATx->pTail = NULL;
+		pDMATx->pCurSeg = NULL;
+		pDMATx->pDoneChain = NULL;
+		pDMATx->Active = RESET;
+		pDMATx->ChainCount = 0;
+
+		pDMATx->pTxDMA->DMAConfig.DMA_Direction = DMA_DIR_MEM_TO_PERIPH;
+		pDMATx->pTxDMA->DMAConfig.DMA_DataSize = DMA_DATA_SIZE_BYTE;
+		pDMATx->pTxDMA->DMAConfig.DMA_MemInc = ENABLE;
+		pDMATx->pTxDMA->DMAConfig.DMA_Mode = DMA_MODE_NORMAL;
+		pDMATx->pTxDMA->DMAConfig.DMA_ITControl = DMA_IT_TC | DMA_IT_TE;
+		DMA_Init(pDMATx->pTxDMA);
+
+		pUSARTHandle->pDMATx = pDMATx;
+		pUSARTHandle->TxBusyState = USART_BUSY_IN_TX;
+		pUSARTHandle->TxLen = 0;
+		pUSARTHandle->pUSARTx->CR3 |= ( 1 << USART_CR3_DMAT);
+	}
+	return state;
+}
+
+//queued chains are dropped without a callback and owned by the app again
+void USART_DMATxStop(USART_Handle_t *pUSARTHandle)
+{
+	uint32_t primask;
+
+	if (pUSARTHandle->pDMATx == NULL) return;
+
+	DRV_ENTER_CRITICAL(primask);
+	pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_TCIE);
+	pUSARTHandle->pUSARTx->CR3 &= ~( 1 << USART_CR3_DMAT);
+	DMA_StopTransfer(pUSARTHandle->pDMATx->pTxDMA);
+
+	pUSARTHandle->pDMATx = NULL;
+	pUSARTHandle->TxBusyState = USART_READY;
+	DRV_EXIT_CRITICAL(primask);
+}
+
+/*********************************************************************
+ * @fn      		  - USART_DMATxSubmit
+ *
+ * @brief             - queues a chain of segments
+ *
+ * @param[in]         - USART handle with the DMA transmission path started
+ * @param[in]         - chain, owned by the driver until USART_EVENT_TX_CHAIN_DONE
+ *
+ * @return            - USART_OK or USART_ERR_PARAM
+ *
+ * @Note              - can be called from the event callback
+ */
+uint8_t USART_DMATxSubmit(USART_Handle_t *pUSARTHandle, USART_TxChain_t *pChain)
+{
+	USART_DMATx_t *pDMATx = pUSARTHandle->pDMATx;
+	uint32_t primask;
+
+	if ((pDMATx == NULL) || (pChain == NULL)) return USART_ERR_PARAM;
+
+	pChain->Status = USART_ERR_BUSY;
+	pChain->pNext = NULL;
+
+	DRV_ENTER_CRITICAL(primask);
+	if (pDMATx->pTail == NULL)
+	{
+		pDMATx->pHead = pChain;
+	}
+	else
+	{
+		pDMATx->pTail->pNext = pChain;
+	}
+	pDMATx->pTail = pChain;
+
+	if (!pDMATx->Active)
+	{
+		pDMATx->Active = SET;
+		usart_dmatx_kick(pUSARTHandle);
+	}
+	DRV_EXIT_CRITICAL(primask);
+
+	return USART_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - USART_DMATxIRQHandling
+ *
+ * @brief             - to be called from the IRQ handler of the TX DMA stream
+ *
+ * @param[in]         - USART handle
+ *
+ * @return            - none
+ *
+ * @Note              - the DMA is done with a segment when its last byte is in DR, the next
+ *                      segment is started right away so the line does not go idle
+ */
+void USART_DMATxIRQHandling(USART_Handle_t *pUSARTHandle)
+{
+	USART_DMATx_t *pDMATx = pUSARTHandle->pDMATx;
+	USART_TxSeg_t *pNext;
+	uint8_t flags;
+
+	if ((pDMATx == NULL) || (pDMATx->pCurSeg == NULL)) return;
+
+	flags = DMA_GetFlags(pDMATx->pTxDMA);
+	DMA_ClearFlags(pDMATx->pTxDMA, flags);
+
+	if (flags & DMA_FLAG_TE)
+	{
+		//the hardware has disabled the stream, give up on this chain
+		pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_TCIE);
+		usart_dmatx_chain_done(pUSARTHandle, USART_ERR_DMA);
+		usart_dmatx_kick(pUSARTHandle);
+		return;
+	}
+
+	if (flags & DMA_FLAG_TC)
+	{
+		pNext = usart_dmatx_skip_empty(pDMATx->pCurSeg->pNext);
+		if (pNext != NULL)
+		{
+			usart_dmatx_start_seg(pUSARTHandle, pNext);
+		}
+		//else the last segment, the USART TC interrupt completes the chain
+	}
+}
+
+
+/*
+ * Multiprocessor communication
+ */
+
+/*********************************************************************
+ * @fn      		  - USART_EnterMute
+ *
+ * @brief             - puts the receiver in mute mode, RXNE stays clear until the wakeup condition
+ *
+ * @param[in]         - USART peripheral
+ *
+ * @return            - none
+ *
+ * @Note              - Address mark: call once, the hardware wakes up on an address byte matching
+ *                      USART_NodeAddr and goes mute again by itself on a non-matching one, so an
+ *                      unaddressed node only sees the address bytes. Data bytes must have the
+ *                      MSB clear then.
+ *                      Idle line: call after the first byte of a frame that is not for this node,
+ *                      the hardware wakes up at the next idle line. A byte must have been
+ *                      received before the first call.
+ */
+void USART_EnterMute(USART_RegDef_t *pUSARTx)
+{
+	pUSARTx->CR1 |= ( 1 << USART_CR1_RWU);
+}
+
+uint8_t USART_IsMuted(USART_RegDef_t *pUSARTx)
+{
+	return (pUSARTx->CR1 & ( 1 << USART_CR1_RWU)) ? SET : RESET;
+}
+
+/*********************************************************************
+ * @fn      		  - USART_SendAddress
+ *
+ * @brief             - sends an address byte (MSB set) for address mark wakeup
+ *
+ * @param[in]         - USART handle
+ * @param[in]         - 4 bit address of the node to wake up
+ *
+ * @return            - none
+ *
+ * @Note              - blocking until the byte is in DR. The transceiver stays on, the data
+ *                      send that follows switches it back at its TC.
+ */
+void USART_SendAddress(USART_Handle_t *pUSARTHandle, uint8_t NodeAddr)
+{
+	uint16_t mark = (pUSARTHandle->USART_Config.USART_WordLength == USART_WORDLEN_9BITS) ? 0x100 : 0x80;
+
+	usart_de_control(pUSARTHandle, ENABLE);
+
+	while(! USART_GetFlagStatus(pUSARTHandle->pUSARTx,USART_FLAG_TXE));
+	pUSARTHandle->pUSARTx->DR = mark | (NodeAddr & 0x0F);
+}
+
+
+/*
+ * Automatic baud rate detection
+ */
+
+//rates a measurement is rounded to when it is within USART_AUTOBAUD_SNAP_PCT
+#define USART_AUTOBAUD_SNAP_PCT		3
+
+static const uint32_t usart_std_baud[] = {
+	USART_STD_BAUD_1200, USART_STD_BAUD_2400, 4800, USART_STD_BAUD_9600, USART_STD_BAUD_19200,
+	USART_STD_BAUD_38400, USART_STD_BAUD_57600, USART_STD_BAUD_115200, USART_STD_BAUD_230400,
+	USART_STD_BAUD_460800, USART_STD_BAUD_921600, 1000000, USART_STD_BAUD_2M, USART_STD_BAUD_3M
+};
+
+//bits between consecutive edges of each sync character, from the start edge to the stop bit
+static const uint8_t usart_autobaud_start_bit[] = { 1 };
+static const uint8_t usart_autobaud_sync_55[] = { 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+static const uint8_t usart_autobaud_sync_7f[] = { 1, 7, 1 };
+
+static const uint8_t *usart_autobaud_pattern(uint8_t Sync, uint8_t *pEdges, uint8_t *pBits)
+{
+	if (Sync == USART_AUTOBAUD_SYNC_0X55)
+	{
+		*pEdges = 10;
+		*pBits = 9;
+		return usart_autobaud_sync_55;
+	}
+	if (Sync == USART_AUTOBAUD_SYNC_0X7F)
+	{
+		*pEdges = 4;
+		*pBits = 9;
+		return usart_autobaud_sync_7f;
+	}
+	*pEdges = 2;
+	*pBits = 1;
+	return usart_autobaud_start_bit;
+}
+
+static void usart_pin_af(GPIO_RegDef_t *pGPIOx, uint8_t Pin, uint8_t AltFn)
+{
+	pGPIOx->AFR[Pin / 8] &= ~(0xF << (4 * (Pin % 8)));
+	pGPIOx->AFR[Pin / 8] |= ((AltFn & 0xF) << (4 * (Pin % 8)));
+}
+
+static void usart_autobaud_arm(USART_Handle_t *pUSARTHandle)
+{
+	USART_AutoBaud_t *pAutoBaud = pUSARTHandle->pAutoBaud;
+	uint8_t edges, bits;
+
+	usart_autobaud_pattern(pAutoBaud->Sync, &edges, &bits);
+	DMA_StartTransfer(pAutoBaud->pCapDMA, (uint32_t)&pAutoBaud->pTIMHandle->pTIMx->CCR[pAutoBaud->TIMChannel - 1],
+			(uint32_t)pAutoBaud->Captures, 0, edges);
+}
+
+static void usart_autobaud_release(USART_Handle_t *pUSARTHandle)
+{
+	USART_AutoBaud_t *pAutoBaud = pUSARTHandle->pAutoBaud;
+	TIM_RegDef_t *pTIMx = pAutoBaud->pTIMHandle->pTIMx;
+
+	TIM_CCDMAConfig(pTIMx, pAutoBaud->TIMChannel, DISABLE);
+	TIM_ICDisable(pTIMx, pAutoBaud->TIMChannel);
+	TIM_Stop(pTIMx);
+	DMA_StopTransfer(pAutoBaud->pCapDMA);
+
+	//give the pin back to the USART
+	usart_pin_af(pAutoBaud->pRxPort, pAutoBaud->RxPin, pAutoBaud->RxAF);
+	pUSARTHandle->pAutoBaud = NULL;
+	pUSARTHandle->RxBusyState = USART_READY;
+}
+
+//baud rate of the captured character, 0 if the edges do not fit the sync pattern
+static uint32_t usart_autobaud_measure(USART_AutoBaud_t *pAutoBaud)
+{
+	const uint8_t *pPattern;
+	uint8_t edges, bits;
+	uint32_t span, interval, expected;
+
+	pPattern = usart_autobaud_pattern(pAutoBaud->Sync, &edges, &bits);
+	span = pAutoBaud->Captures[edges - 1] - pAutoBaud->Captures[0];
+	if (span < bits) return 0;
+
+	//every interval within 25 % of its share of the span
+	for (uint8_t i = 0; i < (edges - 1); i++)
+	{
+		interval = pAutoBaud->Captures[i + 1] - pAutoBaud->Captures[i];
+		expected = (uint32_t)(((uint64_t)span * pPattern[i]) / bits);
+		if ((interval < (expected - (expected / 4))) || (interval > (expected + (expected / 4)))) return 0;
+	}
+
+	return (uint32_t)(((uint64_t)pAutoBaud->pTIMHandle->AchievedCounterHz * bits + (span / 2)) / span);
+}
+
+/*********************************************************************
+ * @fn      		  - USART_AutoBaudStart
+ *
+ * @brief             - measures the baud rate of the next sync character and programs it
+ *
+ * @param[in]         - USART handle, initialized
+ * @param[in]         - detection context with the timer, channel, DMA, pin and sync fields filled in
+ *
+ * @return            - USART_OK, USART_ERR_PARAM or USART_ERR_BUSY
+ *
+ * @Note              - The USART is disabled and the RX pin is switched to the timer. Every edge
+ *                      is timestamped at the full timer clock by input capture and moved by the
+ *                      DMA, so even at 3 Mbaud (28 timer clocks per bit at 84 MHz) no edge
+ *                      depends on interrupt latency. One character is enough, characters that
+ *                      do not fit the pattern are skipped. The sync character itself is not
+ *                      received. USART_EVENT_AUTOBAUD reports the result.
+ */
+uint8_t USART_AutoBaudStart(USART_Handle_t *pUSARTHandle, USART_AutoBaud_t *pAutoBaud)
+{
+	TIM_RegDef_t *pTIMx;
+
+	if ((pAutoBaud->TIMChannel < 1) || (pAutoBaud->TIMChannel > 4)) return USART_ERR_PARAM;
+	if (pUSARTHandle->RxBusyState != USART_READY) return USART_ERR_BUSY;
+
+	//free running 32 bit counter at the timer clock, the 16 bit timers cannot span 1200 baud
+	pTIMx = pAutoBaud->pTIMHandle->pTIMx;
+	if ((pTIMx != DRV_TIM2) && (pTIMx != DRV_TIM5)) return USART_ERR_PARAM;
+	pAutoBaud->pTIMHandle->TIMConfig.TIM_CounterHz = TIM_GetClock(pTIMx);
+	pAutoBaud->pTIMHandle->TIMConfig.TIM_Period = 0xFFFFFFFF;
+	if (TIM_Init(pAutoBaud->pTIMHandle) != TIM_OK) return USART_ERR_PARAM;
+
+	pAutoBaud->MeasuredBaud = 0;
+	pAutoBaud->Baud = 0;
+	pAutoBaud->Rejects = 0;
+	pAutoBaud->Status = USART_ERR_BUSY;
+
+	pUSARTHandle->pAutoBaud = pAutoBaud;
+	pUSARTHandle->RxBusyState = USART_BUSY_IN_RX;
+
+	USART_PeripheralControl(pUSARTHandle->pUSARTx, DISABLE);
+	usart_pin_af(pAutoBaud->pRxPort, pAutoBaud->RxPin, pAutoBaud->TIMAF);
+
+	pAutoBaud->pCapDMA->DMAConfig.DMA_Direction = DMA_DIR_PERIPH_TO_MEM;
+	pAutoBaud->pCapDMA->DMAConfig.DMA_DataSize = DMA_DATA_SIZE_WORD;
+	pAutoBaud->pCapDMA->DMAConfig.DMA_MemInc = ENABLE;
+	pAutoBaud->pCapDMA->DMAConfig.DMA_Mode = DMA_MODE_NORMAL;
+	pAutoBaud->pCapDMA->DMAConfig.DMA_ITControl = DMA_IT_TC | DMA_IT_TE;
+	DMA_Init(pAutoBaud->pCapDMA);
+	usart_autobaud_arm(pUSARTHandle);
+
+	//every edge, no filter, at 3 Mbaud there is no room for one
+	TIM_ICConfig(pTIMx, pAutoBaud->TIMChannel, TIM_IC_BOTH, 0);
+	TIM_CCDMAConfig(pTIMx, pAutoBaud->TIMChannel, ENABLE);
+	TIM_Start(pTIMx);
+
+	return USART_OK;
+}
+
+//gives up on the detection, the pin goes back to the USART which stays disabled
+void USART_AutoBaudStop(USART_Handle_t *pUSARTHandle)
+{
+	if (pUSARTHandle->pAutoBaud == NULL) return;
+
+	usart_autobaud_release(pUSARTHandle);
+}
+
+/*********************************************************************
+ * @fn      		  - USART_AutoBaudDMAIRQHandling
+ *
+ * @brief             - to be called from the IRQ handler of the capture DMA stream
+ *
+ * @param[in]         - USART handle
+ *
+ * @return            - none
+ *
+ * @Note              - a measurement within USART_AUTOBAUD_SNAP_PCT of a standard rate is
+ *                      rounded to it, the rate is then programmed with USART_SetBaudRate
+ */
+void USART_AutoBaudDMAIRQHandling(USART_Handle_t *pUSARTHandle)
+{
+	USART_AutoBaud_t *pAutoBaud = pUSARTHandle->pAutoBaud;
+	uint32_t baud;
+	uint8_t flags;
+
+	if (pAutoBaud == NULL) return;
+
+	flags = DMA_GetFlags(pAutoBaud->pCapDMA);
+	DMA_ClearFlags(pAutoBaud->pCapDMA, flags);
+
+	if (flags & DMA_FLAG_TE)
+	{
+		pAutoBaud->Status = USART_ERR_DMA;
+		usart_autobaud_release(pUSARTHandle);
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_AUTOBAUD);
+		return;
+	}
+
+	if (!(flags & DMA_FLAG_TC)) return;
+
+	baud = usart_autobaud_measure(pAutoBaud);
+	if ((baud < (USART_AUTOBAUD_MIN - (USART_AUTOBAUD_MIN / 20))) || (baud > (USART_AUTOBAUD_MAX + (USART_AUTOBAUD_MAX / 20))))
+	{
+		//not the sync character, wait for the next one
+		pAutoBaud->Rejects++;
+		usart_autobaud_arm(pUSARTHandle);
+		return;
+	}
+
+	pAutoBaud->MeasuredBaud = baud;
+	for (uint8_t i = 0; i < (sizeof(usart_std_baud) / sizeof(usart_std_baud[0])); i++)
+	{
+		uint32_t tol = (usart_std_baud[i] / 100) * USART_AUTOBAUD_SNAP_PCT;
+
+		if ((baud + tol >= usart_std_baud[i]) && (baud <= usart_std_baud[i] + tol))
+		{
+			baud = usart_std_baud[i];
+			break;
+		}
+	}
+	pAutoBaud->Baud = baud;
+
+	usart_autobaud_release(pUSARTHandle);
+
+	//OVER8 may change, UE is still off here
+	pAutoBaud->Status = USART_SetBaudRate(pUSARTHandle->pUSARTx, baud);
+	if (pAutoBaud->Status == USART_OK)
+	{
+		USART_PeripheralControl(pUSARTHandle->pUSARTx, ENABLE);
+	}
+
+	USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_AUTOBAUD);
+}
+
+
+/*
+ * IRQ Configuration and ISR handling
+ */
+void USART_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnorDi)
+{
+
+	if(EnorDi == ENABLE)
+	{
+		if(IRQNumber <= 31)
+		{
+			//program ISER0 register
+			*DRV_NVIC_ISER0 |= ( 1 << IRQNumber );
+
+		}else if(IRQNumber > 31 && IRQNumber < 64 ) //32 to 63
+		{
+			//program ISER1 register
+			*DRV_NVIC_ISER1 |= ( 1 << (IRQNumber % 32) );
+		}
+		else if(IRQNumber >= 64 && IRQNumber < 96 )
+		{
+			//program ISER2 register //64 to 95
+			*DRV_NVIC_ISER3 |= ( 1 << (IRQNumber % 64) );
+		}
+	}else
+	{
+		if(IRQNumber <= 31)
+		{
+			//program ICER0 register
+			*DRV_NVIC_ICER0 |= ( 1 << IRQNumber );
+		}else if(IRQNumber > 31 && IRQNumber < 64 )
+		{
+			//program ICER1 register
+			*DRV_NVIC_ICER1 |= ( 1 << (IRQNumber % 32) );
+		}
+		else if(IRQNumber >= 6 && IRQNumber < 96 )
+		{
+			//program ICER2 register
+			*DRV_NVIC_ICER3 |= ( 1 << (IRQNumber % 64) );
+		}
+	}
+
+}
+
+void USART_IRQPriorityConfig(uint8_t IRQNumber,uint32_t IRQPriority)
+{
+	//1. first lets find out the ipr register
+	uint8_t iprx = IRQNumber / 4;
+	uint8_t iprx_section  = IRQNumber %4 ;
+
+	uint8_t shift_amount = ( 8 * iprx_section) + ( 8 - NO_PR_BITS_IMPLEMENTED) ;
+
+	*(  DRV_NVIC_IPR_BASE_ADDR + iprx ) |=  ( IRQPriority << shift_amount );
+
+}
+
+//SR flags the ISR dispatches on, as masks
+#define USART_SR_MASK_RX_ERR		(( 1 << USART_SR_PE) | ( 1 << USART_SR_FE) | ( 1 << USART_SR_NF) | ( 1 << USART_SR_ORE))
+#define USART_SR_MASK_DR_CLEARED	(USART_SR_MASK_RX_ERR | ( 1 << USART_SR_IDLE))
+
+//one frame of an interrupt driven USART_SendDataIT transfer, returns 1 if DR was written
+static uint8_t usart_it_tx(USART_Handle_t *pUSARTHandle)
+{
+	uint8_t written = 0;
+
+	if(pUSARTHandle->TxLen > 0)
+	{
+		written = 1;
+
+		if((pUSARTHandle->USART_Config.USART_WordLength == USART_WORDLEN_9BITS) &&
+		   (pUSARTHandle->USART_Config.USART_ParityControl == USART_PARITY_DISABLE))
+		{
+			//9 bits of user data, two bytes of the buffer per frame
+			pUSARTHandle->pUSARTx->DR = (*((uint16_t*)pUSARTHandle->pTxBuffer) & (uint16_t)0x01FF);
+			pUSARTHandle->pTxBuffer += 2;
+			pUSARTHandle->TxLen = (pUSARTHandle->TxLen > 2) ? (pUSARTHandle->TxLen - 2) : 0;
+		}
+		else
+		{
+			//8 bits of user data, with 9 bit frames the 9th bit is replaced by the parity bit
+			pUSARTHandle->pUSARTx->DR = (*pUSARTHandle->pTxBuffer & (uint8_t)0xFF);
+			pUSARTHandle->pTxBuffer++;
+			pUSARTHandle->TxLen--;
+		}
+	}
+
+	if (pUSARTHandle->TxLen == 0 )
+	{
+		//the TC interrupt closes the transfer
+		pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_TXEIE);
+	}
+
+	return written;
+}
+
+//one frame of an interrupt driven USART_ReceiveDataIT transfer, reads DR
+static void usart_it_rx(USART_Handle_t *pUSARTHandle)
+{
+	uint16_t data = (uint16_t)pUSARTHandle->pUSARTx->DR;
+
+	if(pUSARTHandle->USART_Config.USART_WordLength == USART_WORDLEN_9BITS)
+	{
+		if(pUSARTHandle->USART_Config.USART_ParityControl == USART_PARITY_DISABLE)
+		{
+			//all 9 bits are user data
+			*((uint16_t*) pUSARTHandle->pRxBuffer) = (data & (uint16_t)0x01FF);
+			pUSARTHandle->pRxBuffer += 2;
+			pUSARTHandle->RxLen = (pUSARTHandle->RxLen > 2) ? (pUSARTHandle->RxLen - 2) : 0;
+		}
+		else
+		{
+			//8 bits of user data and the parity bit
+			*pUSARTHandle->pRxBuffer = (uint8_t)(data & 0xFF);
+			pUSARTHandle->pRxBuffer++;
+			pUSARTHandle->RxLen--;
+		}
+	}
+	else
+	{
+		if(pUSARTHandle->USART_Config.USART_ParityControl == USART_PARITY_DISABLE)
+		{
+			*pUSARTHandle->pRxBuffer = (uint8_t)(data & 0xFF);
+		}
+		else
+		{
+			//7 bits of user data and the parity bit
+			*pUSARTHandle->pRxBuffer = (uint8_t)(data & 0x7F);
+		}
+		pUSARTHandle->pRxBuffer++;
+		pUSARTHandle->RxLen--;
+	}
+
+	if(! pUSARTHandle->RxLen)
+	{
+		//no room until the next USART_ReceiveDataIT
+		usart_rts_control(pUSARTHandle, DISABLE);
+		pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_RXNEIE );
+		pUSARTHandle->RxBusyState = USART_READY;
+		USART_ApplicationEventCallback(pUSARTHandle,USART_EVENT_RX_CMPLT);
+	}
+}
+
+static void usart_rx(USART_Handle_t *pUSARTHandle)
+{
+	if(pUSARTHandle->Streaming)
+	{
+		usart_stream_rx(pUSARTHandle);
+	}
+	else if((pUSARTHandle->RxBusyState == USART_BUSY_IN_RX) && (pUSARTHandle->RxLen > 0))
+	{
+		usart_it_rx(pUSARTHandle);
+	}
+	else
+	{
+		//nobody is waiting for the byte, reading DR clears RXNE
+		(void)pUSARTHandle->pUSARTx->DR;
+	}
+}
+
+static void usart_tc(USART_Handle_t *pUSARTHandle)
+{
+	//rc_w0, writing 1 to the other flags leaves them alone
+	pUSARTHandle->pUSARTx->SR = ~( 1 << USART_SR_TC);
+
+	if((pUSARTHandle->TxBusyState == USART_BUSY_IN_TX) && (pUSARTHandle->TxLen != 0) && !pUSARTHandle->pDMATx && !pUSARTHandle->Streaming)
+	{
+		//TC of the idle line before the first byte of an interrupt driven transfer
+		return;
+	}
+
+	pUSARTHandle->pUSARTx->CR1 &= ~( 1 << USART_CR1_TCIE);
+
+	if(pUSARTHandle->pDMATx)
+	{
+		//last segment of a chain is out
+		usart_dmatx_chain_done(pUSARTHandle, USART_OK);
+		usart_dmatx_kick(pUSARTHandle);
+
+		if(! pUSARTHandle->pDMATx->Active)
+		{
+			usart_de_control(pUSARTHandle, DISABLE);
+		}
+	}
+	else if(pUSARTHandle->Streaming)
+	{
+		//only enabled for the transceiver, release it if nothing was queued meanwhile
+		if(pUSARTHandle->TxHead == pUSARTHandle->TxTail)
+		{
+			usart_de_control(pUSARTHandle, DISABLE);
+		}
+	}
+	else if(pUSARTHandle->TxBusyState == USART_BUSY_IN_TX)
+	{
+		pUSARTHandle->TxBusyState = USART_READY;
+		usart_de_control(pUSARTHandle, DISABLE);
+		pUSARTHandle->pTxBuffer = NULL;
+		pUSARTHandle->TxLen = 0;
+		USART_ApplicationEventCallback(pUSARTHandle,USART_EVENT_TX_CMPLT);
+	}
+}
+
+/*********************************************************************
+ * @fn      		  - USART_IRQHandling
+ *
+ * @brief             - interrupt dispatcher, to be called from the USART IRQ handler
+ *
+ * @param[in]         - USART handle
+ *
+ * @return            - none
+ *
+ * @Note              - SR, CR1 and CR3 are sampled once and the pending mask is computed from
+ *                      the flags whose interrupt is enabled. A lone RXNE takes a fast path.
+ *                      PE, FE, NF, ORE and IDLE are all cleared by the SR read above followed by
+ *                      one DR read, which is the data read itself when RXNE is pending as well,
+ *                      so DR is read exactly once per entry. The byte that came with FE/NF/PE is
+ *                      still delivered, the error event follows it.
+ */
+void USART_IRQHandling(USART_Handle_t *pUSARTHandle)
+{
+	USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+	uint32_t sr = pUSARTx->SR;
+	uint32_t cr1 = pUSARTx->CR1;
+	uint32_t cr3 = pUSARTx->CR3;
+	uint32_t enabled = 0;
+	uint32_t pending;
+
+	uint8_t written = 0;
+
+	//flags whose interrupt is enabled
+	if (cr1 & ( 1 << USART_CR1_RXNEIE)) enabled |= ( 1 << USART_SR_RXNE) | ( 1 << USART_SR_ORE);
+	if (cr1 & ( 1 << USART_CR1_TXEIE))  enabled |= ( 1 << USART_SR_TXE);
+	if (cr1 & ( 1 << USART_CR1_TCIE))   enabled |= ( 1 << USART_SR_TC);
+	if (cr1 & ( 1 << USART_CR1_IDLEIE)) enabled |= ( 1 << USART_SR_IDLE);
+	if (cr1 & ( 1 << USART_CR1_PEIE))   enabled |= ( 1 << USART_SR_PE);
+	if (cr3 & ( 1 << USART_CR3_EIE))    enabled |= ( 1 << USART_SR_FE) | ( 1 << USART_SR_NF) | ( 1 << USART_SR_ORE);
+	if (cr3 & ( 1 << USART_CR3_CTSIE))  enabled |= ( 1 << USART_SR_CTS);
+
+	pending = sr & enabled;
+
+	//fast path, a received byte and nothing else to look at
+	if (pending == ( 1 << USART_SR_RXNE))
+	{
+		usart_rx(pUSARTHandle);
+		return;
+	}
+
+/*************************Reception and errors ********************************************/
+
+	if (sr & ( 1 << USART_SR_RXNE) & enabled)
+	{
+		//the DR read completes the clear sequence of the error and IDLE flags
+		usart_rx(pUSARTHandle);
+	}
+	else if (pending & USART_SR_MASK_DR_CLEARED)
+	{
+		(void)pUSARTx->DR;
+	}
+
+	if (pending & ( 1 << USART_SR_PE))
+	{
+		USART_ApplicationEventCallback(pUSARTHandle,USART_EVENT_PE);
+	}
+	if (pending & ( 1 << USART_SR_FE))
+	{
+		USART_ApplicationEventCallback(pUSARTHandle,USART_ERREVENT_FE);
+	}
+	if (pending & ( 1 << USART_SR_NF))
+	{
+		USART_ApplicationEventCallback(pUSARTHandle,USART_ERREVENT_NF);
+	}
+	if (pending & ( 1 << USART_SR_ORE))
+	{
+		USART_ApplicationEventCallback(pUSARTHandle,USART_ERREVENT_ORE);
+	}
+
+	if (pending & ( 1 << USART_SR_IDLE))
+	{
+		if(pUSARTHandle->pDMARx)
+		{
+			//end of a frame, hand over the rest of it
+			usart_dmarx_process(pUSARTHandle, SET);
+		}
+		else
+		{
+			USART_ApplicationEventCallback(pUSARTHandle,USART_EVENT_IDLE);
+		}
+	}
+
+/*************************Transmission ********************************************/
+
+	//TXE before TC, the last TXE of a transfer arms the TC that closes it
+	if (pending & ( 1 << USART_SR_TXE))
+	{
+		if(pUSARTHandle->Streaming)
+		{
+			written = usart_stream_tx(pUSARTHandle);
+		}
+		else if(pUSARTHandle->TxBusyState == USART_BUSY_IN_TX)
+		{
+			written = usart_it_tx(pUSARTHandle);
+		}
+		else
+		{
+			pUSARTx->CR1 &= ~( 1 << USART_CR1_TXEIE);
+		}
+	}
+
+	//the sampled TC is stale once DR was written in this entry
+	if ((pending & ( 1 << USART_SR_TC)) && !written)
+	{
+		usart_tc(pUSARTHandle);
+	}
+
+/*************************CTS ********************************************/
+
+	if (pending & ( 1 << USART_SR_CTS))
+	{
+		pUSARTx->SR = ~( 1 << USART_SR_CTS);
+		USART_ApplicationEventCallback(pUSARTHandle,USART_EVENT_CTS);
+	}
+}
+
+
+/*
+ * Other Peripheral Control APIs
+ */
+void USART_PeripheralControl(USART_RegDef_t *pUSARTx, uint8_t EnOrDi)
+{
+	if (EnOrDi == ENABLE)
 	{
 		pUSARTx->CR1 |= (1 << USART_CR1_UE);
 	}
@@ -799,81 +1819,122 @@ void USART_ClearFlag(USART_RegDef_t *pUSARTx, uint16_t StatusFlagName)
  */
 void USART_ApplicationEventCallback(USART_Handle_t *pUSARTHandle,uint8_t AppEv);
 
+//evaluates one oversampling mode, returns 0 if the rate is out of its BRR range
+static uint8_t usart_baud_try(uint32_t PCLKx, uint32_t BaudRate, uint8_t Over8, USART_Baud_t *pBaud)
+{
+	//baud = fck / (8 * (2 - OVER8) * USARTDIV), so USARTDIV in 1/16 (OVER8 = 0) or
+	//1/8 (OVER8 = 1) steps is fck / baud in both modes
+	uint32_t steps = Over8 ? 8 : 16;
+	uint32_t div = (uint32_t)(((uint64_t)PCLKx + (BaudRate / 2)) / BaudRate);
+	uint32_t achieved;
+
+	//DIV_Mantissa is at least 1 and 12 bits wide
+	if ((div < steps) || ((div / steps) > 0xFFF)) return 0;
+
+	achieved = (uint32_t)(((uint64_t)PCLKx + (div / 2)) / div);
+
+	pBaud->Over8 = Over8;
+	pBaud->BRR = (uint16_t)(((div / steps) << USART_BRR_DIV_Mantissa) | (div % steps));
+	pBaud->AchievedBaud = achieved;
+	pBaud->ErrorPpm = (int32_t)((((int64_t)achieved - (int64_t)BaudRate) * 1000000) / BaudRate);
+
+	return 1;
+}
+
 /*********************************************************************
- * @fn      		  - USART_SetBaudRate
+ * @fn      		  - USART_SolveBaudRate
  *
- * @brief             -
+ * @brief             - computes BRR and OVER8 for a baud rate without touching the USART
  *
- * @param[in]         -
- * @param[in]         -
- * @param[in]         -
+ * @param[in]         - USART peripheral, selects the APB clock
+ * @param[in]         - requested baud rate
+ * @param[in]         - largest accepted error in ppm
+ * @param[out]        - achieved baud rate, error, BRR and OVER8
  *
- * @return            -
+ * @return            - USART_OK or USART_ERR_BAUD
  *
- * @Note              -  Resolve all the TODOs
-
+ * @Note              - both oversampling modes are solved with exact integer rounding, the one
+ *                      with the lower error wins. On a tie oversampling by 16 is kept, it is
+ *                      more tolerant to clock deviation and noise. Oversampling by 8 reaches
+ *                      up to fck/8, e.g. 10.5 Mbaud on USART1/6 at 84 MHz.
  */
-void USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate)
+uint8_t USART_SolveBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate, uint32_t TolPpm, USART_Baud_t *pBaud)
 {
-
-	//Variable to hold the APB clock
+	USART_Baud_t by16, by8;
+	uint8_t ok16, ok8;
 	uint32_t PCLKx;
 
-	uint32_t usartdiv;
+	if (BaudRate == 0) return USART_ERR_BAUD;
 
-	//variables to hold Mantissa and Fraction values
-	uint32_t M_part,F_part;
-
-  uint32_t tempreg=0;
-
-  //Get the value of APB bus clock in to the variable PCLKx
-  if(pUSARTx == DRV_USART1 || pUSARTx == DRV_USART6)
-  {
-	   //USART1 and USART6 are hanging on APB2 bus
-	   PCLKx = RCC_GetPCLK2Value();
-  }else
-  {
-	   PCLKx = RCC_GetPCLK1Value();
-  }
+	//USART1 and USART6 are hanging on APB2 bus
+	if(pUSARTx == DRV_USART1 || pUSARTx == DRV_USART6)
+	{
+		PCLKx = RCC_GetPCLK2Value();
+	}else
+	{
+		PCLKx = RCC_GetPCLK1Value();
+	}
 
-  //Check for OVER8 configuration bit
-  if(pUSARTx->CR1 & (1 << USART_CR1_OVER8))
-  {
-	   //OVER8 = 1 , over sampling by 8
-	   usartdiv = ((25 * PCLKx) / (2 *BaudRate));
-  }else
-  {
-	   //over sampling by 16
-	  usartdiv = ((25 * PCLKx) / (4 *BaudRate));
-  }
+	ok16 = usart_baud_try(PCLKx, BaudRate, 0, &by16);
+	ok8 = usart_baud_try(PCLKx, BaudRate, 1, &by8);
 
-  //Calculate the Mantissa part
-  M_part = usartdiv/100;
+	if (ok16 && ok8)
+	{
+		uint32_t err16 = (by16.ErrorPpm < 0) ? -by16.ErrorPpm : by16.ErrorPpm;
+		uint32_t err8 = (by8.ErrorPpm < 0) ? -by8.ErrorPpm : by8.ErrorPpm;
 
-  //Place the Mantissa part in appropriate bit position . refer USART_BRR
-  tempreg |= M_part << 4;
+		*pBaud = (err8 < err16) ? by8 : by16;
+	}
+	else if (ok16)
+	{
+		*pBaud = by16;
+	}
+	else if (ok8)
+	{
+		*pBaud = by8;
+	}
+	else
+	{
+		return USART_ERR_BAUD;
+	}
 
-  //Extract the fraction part
-  F_part = (usartdiv - (M_part * 100));
+	if ((uint32_t)((pBaud->ErrorPpm < 0) ? -pBaud->ErrorPpm : pBaud->ErrorPpm) > TolPpm) return USART_ERR_BAUD;
 
-  //Calculate the final fractional
-  if(pUSARTx->CR1 & ( 1 << USART_CR1_OVER8))
-   {
-	  //OVER8 = 1 , over sampling by 8
-	  F_part = ((( F_part * 8)+ 50) / 100)& ((uint8_t)0x07);
+	return USART_OK;
+}
 
-   }else
-   {
-	   //over sampling by 16
-	   F_part = ((( F_part * 16)+ 50) / 100) & ((uint8_t)0x0F);
+/*********************************************************************
+ * @fn      		  - USART_SetBaudRate
+ *
+ * @brief             - programs BRR and OVER8 for a baud rate
+ *
+ * @param[in]         - USART peripheral
+ * @param[in]         - baud rate
+ *
+ * @return            - USART_OK, or USART_ERR_BAUD if the rate is off by more than
+ *                      USART_BAUD_TOLERANCE_PPM or out of range, the USART is left unchanged then
+ *
+ * @Note              - OVER8 is only to be changed while the USART is disabled (UE = 0).
+ *                      Use USART_SolveBaudRate to get the achieved rate and its error.
+ */
+uint8_t USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate)
+{
+	USART_Baud_t baud;
 
-   }
+	if (USART_SolveBaudRate(pUSARTx, BaudRate, USART_BAUD_TOLERANCE_PPM, &baud) != USART_OK)
+	{
+		return USART_ERR_BAUD;
+	}
 
-  //Place the fractional part in appropriate bit position . refer USART_BRR
-  tempreg |= F_part;
+	if (baud.Over8)
+	{
+		pUSARTx->CR1 |= (1 << USART_CR1_OVER8);
+	}
+	else
+	{
+		pUSARTx->CR1 &= ~(1 << USART_CR1_OVER8);
+	}
+	pUSARTx->BRR = baud.BRR;
 
-  //copy the value of tempreg in to BRR register
-  pUSARTx->BRR = tempreg;
+	return USART_OK;
 }
-
-
@@ -0,0 +1,241 @@
+/*
+ * stm32f401xx_usart_link_driver.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#include "stm32f401xx_usart_link_driver.h"
+
+//nibble tables, 4 bits per step keeps them small
+static const uint16_t link_crc16_table[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+static const uint32_t link_crc32_table[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+
+uint16_t LINK_Crc16(const uint8_t *pData, uint32_t Len)
+{
+	uint16_t crc = 0xFFFF;
+
+	while (Len--)
+	{
+		crc = (uint16_t)((crc << 4) ^ link_crc16_table[(crc >> 12) ^ (*pData >> 4)]);
+		crc = (uint16_t)((crc << 4) ^ link_crc16_table[(crc >> 12) ^ (*pData & 0x0F)]);
+		pData++;
+	}
+	return crc;
+}
+
+uint32_t LINK_Crc32(const uint8_t *pData, uint32_t Len)
+{
+	uint32_t crc = 0xFFFFFFFF;
+
+	while (Len--)
+	{
+		crc ^= *pData++;
+		crc = (crc >> 4) ^ link_crc32_table[crc & 0x0F];
+		crc = (crc >> 4) ^ link_crc32_table[crc & 0x0F];
+	}
+	return ~crc;
+}
+
+static uint32_t link_crc(LINK_Handle_t *pLINKHandle, const uint8_t *pData, uint32_t Len)
+{
+	if (pLINKHandle->CrcType == LINK_CRC32)
+	{
+		return LINK_Crc32(pData, Len);
+	}
+	return LINK_Crc16(pData, Len);
+}
+
+//decodes a received frame in place and checks its CRC
+static void link_rx_frame(LINK_Handle_t *pLINKHandle)
+{
+	uint8_t *pBuf = pLINKHandle->RxBuf;
+	uint16_t len = pLINKHandle->RxLen;
+	uint16_t pos = 0, next;
+	uint8_t crclen = LINK_CRC_LEN(pLINKHandle->CrcType);
+	uint32_t crc, rxcrc;
+
+	//back to back delimiters are idle fill, not frames
+	if (len == 0) return;
+
+	//every code byte after the first one stands for a zero of the data
+	while (pos < len)
+	{
+		next = pos + pBuf[pos];
+		if ((pBuf[pos] == 0) || (next > len))
+		{
+			pLINKHandle->FramingErrors++;
+			return;
+		}
+		if (pos != 0) pBuf[pos] = 0;
+		pos = next;
+	}
+
+	//the data starts after the first code byte
+	len -= 1;
+	if (len < crclen)
+	{
+		pLINKHandle->FramingErrors++;
+		return;
+	}
+	len -= crclen;
+
+	rxcrc = 0;
+	for (uint8_t i = 0; i < crclen; i++)
+	{
+		rxcrc |= (uint32_t)pBuf[1 + len + i] << (8 * i);
+	}
+	crc = link_crc(pLINKHandle, &pBuf[1], len);
+	if (crc != rxcrc)
+	{
+		pLINKHandle->CrcErrors++;
+		return;
+	}
+
+	pLINKHandle->FramesOk++;
+	if (pLINKHandle->pFrameCallback != NULL)
+	{
+		pLINKHandle->pFrameCallback(pLINKHandle, &pBuf[1], len);
+	}
+}
+
+
+void LINK_Init(LINK_Handle_t *pLINKHandle)
+{
+	pLINKHandle->RxLen = 0;
+	pLINKHandle->RxDiscard = RESET;
+	pLINKHandle->FramesOk = 0;
+	pLINKHandle->CrcErrors = 0;
+	pLINKHandle->FramingErrors = 0;
+	pLINKHandle->Overflows = 0;
+}
+
+/*********************************************************************
+ * @fn      		  - LINK_Encode
+ *
+ * @brief             - appends the CRC and COBS encodes a frame in place
+ *
+ * @param[in]         - link handle
+ * @param[in]         - TX buffer of LINK_TX_BUF_SIZE bytes, payload at LINK_TX_PAYLOAD(pBuf)
+ * @param[in]         - payload length, up to LINK_MAX_PAYLOAD(CrcType)
+ *
+ * @return            - number of bytes to send from pBuf including the delimiter, 0 if Len is
+ *                      too long
+ *
+ * @Note              - with a single COBS block every zero is replaced by the distance to the
+ *                      next one, the first zero's distance goes into the reserved first byte
+ */
+uint16_t LINK_Encode(LINK_Handle_t *pLINKHandle, uint8_t *pBuf, uint16_t Len)
+{
+	uint8_t crclen = LINK_CRC_LEN(pLINKHandle->CrcType);
+	uint16_t code = 0;
+	uint16_t end;
+	uint32_t crc;
+
+	if (Len > LINK_MAX_PAYLOAD(pLINKHandle->CrcType)) return 0;
+
+	crc = link_crc(pLINKHandle, &pBuf[1], Len);
+	for (uint8_t i = 0; i < crclen; i++)
+	{
+		pBuf[1 + Len + i] = (uint8_t)(crc >> (8 * i));
+	}
+
+	end = 1 + Len + crclen;
+	for (uint16_t i = 1; i < end; i++)
+	{
+		if (pBuf[i] == 0)
+		{
+			pBuf[code] = (uint8_t)(i - code);
+			code = i;
+		}
+	}
+	pBuf[code] = (uint8_t)(end - code);
+	pBuf[end] = 0;
+
+	return end + 1;
+}
+
+/*********************************************************************
+ * @fn      		  - LINK_Send
+ *
+ * @brief             - encodes a frame and queues it on a streaming USART
+ *
+ * @param[in]         - link handle
+ * @param[in]         - USART in streaming mode
+ * @param[in]         - TX buffer, payload at LINK_TX_PAYLOAD(pBuf)
+ * @param[in]         - payload length
+ *
+ * @return            - LINK_OK, LINK_ERR_PARAM or LINK_ERR_BUSY
+ *
+ * @Note              - a frame is queued whole or not at all. For the DMA path call
+ *                      LINK_Encode and submit pBuf as a segment instead.
+ */
+uint8_t LINK_Send(LINK_Handle_t *pLINKHandle, USART_Handle_t *pUSARTHandle, uint8_t *pBuf, uint16_t Len)
+{
+	uint16_t enclen;
+
+	if (Len > LINK_MAX_PAYLOAD(pLINKHandle->CrcType)) return LINK_ERR_PARAM;
+	if (USART_StreamTxFree(pUSARTHandle) < (uint32_t)(Len + LINK_CRC_LEN(pLINKHandle->CrcType) + 2)) return LINK_ERR_BUSY;
+
+	enclen = LINK_Encode(pLINKHandle, pBuf, Len);
+	USART_StreamWrite(pUSARTHandle, pBuf, enclen);
+
+	return LINK_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - LINK_RxBytes
+ *
+ * @brief             - feeds received bytes into the frame assembler
+ *
+ * @param[in]         - link handle
+ * @param[in]         - bytes
+ * @param[in]         - number of bytes
+ *
+ * @return            - none
+ *
+ * @Note              - every delimiter closes a frame, which is decoded in place and handed to
+ *                      pFrameCallback if its CRC matches. Can be called from the DMA slice
+ *                      event, the callback then runs in interrupt context.
+ */
+void LINK_RxBytes(LINK_Handle_t *pLINKHandle, const uint8_t *pData, uint32_t Len)
+{
+	uint8_t byte;
+
+	for (uint32_t i = 0; i < Len; i++)
+	{
+		byte = pData[i];
+
+		if (byte == 0)
+		{
+			if (!pLINKHandle->RxDiscard)
+			{
+				link_rx_frame(pLINKHandle);
+			}
+			pLINKHandle->RxDiscard = RESET;
+			pLINKHandle->RxLen = 0;
+		}
+		else if (pLINKHandle->RxDiscard)
+		{
+			continue;
+		}
+		else if (pLINKHandle->RxLen >= LINK_MAX_ENCODED)
+		{
+			//resynchronise at the next delimiter
+			pLINKHandle->Overflows++;
+			pLINKHandle->RxDiscard = SET;
+		}
+		else
+		{
+			pLINKHandle->RxBuf[pLINKHandle->RxLen++] = byte;
+		}
+	}
+}
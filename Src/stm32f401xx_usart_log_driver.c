@@ -0,0 +1,130 @@
+/*
+ * stm32f401xx_usart_log_driver.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#include "stm32f401xx_usart_log_driver.h"
+
+//logger the LOG_x macros write to, set by LOG_Init
+static LOG_Handle_t *log_handle = NULL;
+
+
+/*********************************************************************
+ * @fn      		  - LOG_Init
+ *
+ * @brief             - resets the ring and makes this logger the target of the LOG_x macros
+ *
+ * @param[in]         - handle with pUSARTHandle, pRing and RingWords filled in
+ *
+ * @return            - LOG_OK or LOG_ERR_PARAM
+ *
+ * @Note              - the USART has to be in streaming mode already
+ */
+uint8_t LOG_Init(LOG_Handle_t *pLOGHandle)
+{
+	uint32_t words = pLOGHandle->RingWords;
+
+	if ((words < (2 + LOG_MAX_ARGS)) || (words & (words - 1))) return LOG_ERR_PARAM;
+	if (!pLOGHandle->pUSARTHandle->Streaming) return LOG_ERR_PARAM;
+
+	DWT_CycleCounterInit();
+
+	pLOGHandle->Head = 0;
+	pLOGHandle->Tail = 0;
+	pLOGHandle->TxBytes = 0;
+	pLOGHandle->Records = 0;
+	pLOGHandle->Drops = 0;
+
+	log_handle = pLOGHandle;
+
+	return LOG_OK;
+}
+
+/*********************************************************************
+ * @fn      		  - LOG_Write
+ *
+ * @brief             - stores one record, called by the LOG_x macros
+ *
+ * @param[in]         - record header, see LOG_HEADER
+ * @param[in]         - arguments, only the number given in the header is stored
+ *
+ * @return            - none
+ *
+ * @Note              - interrupts are masked only for the few stores of one record, which is
+ *                      cheaper than a compare-and-swap reservation on a single core and keeps
+ *                      the records of different contexts whole. A full ring drops the record.
+ */
+void LOG_Write(uint32_t Header, uint32_t A0, uint32_t A1, uint32_t A2, uint32_t A3)
+{
+	LOG_Handle_t *pLOGHandle = log_handle;
+	uint32_t nargs = (Header >> 21) & 0x7;
+	uint32_t mask, head, primask;
+
+	if (pLOGHandle == NULL) return;
+	mask = pLOGHandle->RingWords - 1;
+
+	DRV_ENTER_CRITICAL(primask);
+	head = pLOGHandle->Head;
+	if ((pLOGHandle->RingWords - (head - pLOGHandle->Tail)) < (2 + nargs))
+	{
+		pLOGHandle->Drops++;
+		DRV_EXIT_CRITICAL(primask);
+		return;
+	}
+
+	pLOGHandle->pRing[head & mask] = Header;
+	pLOGHandle->pRing[(head + 1) & mask] = *DRV_DWT_CYCCNT;
+	if (nargs > 0) pLOGHandle->pRing[(head + 2) & mask] = A0;
+	if (nargs > 1) pLOGHandle->pRing[(head + 3) & mask] = A1;
+	if (nargs > 2) pLOGHandle->pRing[(head + 4) & mask] = A2;
+	if (nargs > 3) pLOGHandle->pRing[(head + 5) & mask] = A3;
+
+	pLOGHandle->Head = head + 2 + nargs;
+	pLOGHandle->Records++;
+	DRV_EXIT_CRITICAL(primask);
+}
+
+/*********************************************************************
+ * @fn      		  - LOG_Process
+ *
+ * @brief             - moves stored records into the USART TX ring
+ *
+ * @param[in]         - logger handle
+ *
+ * @return            - number of bytes passed to the USART
+ *
+ * @Note              - never blocks. Call it from the main loop or a low priority interrupt,
+ *                      USART_EVENT_TX_LOW_WATER is a good trigger. Only one context may call it.
+ */
+uint32_t LOG_Process(LOG_Handle_t *pLOGHandle)
+{
+	uint32_t mask = pLOGHandle->RingWords - 1;
+	uint32_t shipped = 0;
+	uint32_t tail, words, bytes, sent;
+
+	while ((tail = pLOGHandle->Tail) != pLOGHandle->Head)
+	{
+		//contiguous words up to the head or the end of the ring
+		words = pLOGHandle->Head - tail;
+		if (words > (pLOGHandle->RingWords - (tail & mask)))
+		{
+			words = pLOGHandle->RingWords - (tail & mask);
+		}
+		bytes = (words * 4) - pLOGHandle->TxBytes;
+
+		sent = USART_StreamWrite(pLOGHandle->pUSARTHandle,
+				(uint8_t *)&pLOGHandle->pRing[tail & mask] + pLOGHandle->TxBytes, bytes);
+		shipped += sent;
+
+		sent += pLOGHandle->TxBytes;
+		pLOGHandle->TxBytes = sent % 4;
+		pLOGHandle->Tail = tail + (sent / 4);
+
+		//USART TX ring full
+		if (sent < (words * 4)) break;
+	}
+
+	return shipped;
+}
@@ -0,0 +1,138 @@
+/*
+ * host_regs.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#define _GNU_SOURCE
+
+#include <stddef.h>
+
+#include "host_regs.h"
+#include "host_sim.h"
+
+uint32_t sim_reg_reads[SIM_REG_COUNT];
+uint32_t sim_reg_writes[SIM_REG_COUNT];
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <signal.h>
+#include <string.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define EFLAGS_TF						(1 << 8)		//single step
+#define PF_ERR_WRITE					(1 << 1)		//page fault caused by a store
+
+static const SIM_RegModel_t *sim_reg_model;
+static uint8_t *sim_reg_page;
+static size_t sim_reg_page_size;
+static uint32_t sim_reg_offset;
+static uint8_t sim_reg_write;
+
+//the driver touched the block: let the model catch up, open the page and step one instruction
+static void sim_regs_fault(int Sig, siginfo_t *pInfo, void *pCtx)
+{
+	ucontext_t *pUc = pCtx;
+	uint8_t *addr = pInfo->si_addr;
+
+	(void)Sig;
+
+	if ((addr < sim_reg_page) || (addr >= sim_reg_page + sim_reg_page_size))
+	{
+		//a real crash of the code under test
+		signal(SIGSEGV, SIG_DFL);
+		return;
+	}
+
+	sim_reg_offset = (uint32_t)(addr - sim_reg_page);
+	sim_reg_write = (pUc->uc_mcontext.gregs[REG_ERR] & PF_ERR_WRITE) ? 1 : 0;
+	sim_ns += SIM_REG_NS;
+
+	mprotect(sim_reg_page, sim_reg_page_size, PROT_READ | PROT_WRITE);
+	if (sim_reg_model->pBefore != NULL) sim_reg_model->pBefore(sim_reg_offset, sim_reg_write);
+	pUc->uc_mcontext.gregs[REG_EFL] |= EFLAGS_TF;
+}
+
+//the access is done, apply its side effects and close the page again
+static void sim_regs_step(int Sig, siginfo_t *pInfo, void *pCtx)
+{
+	ucontext_t *pUc = pCtx;
+
+	(void)Sig;
+	(void)pInfo;
+
+	pUc->uc_mcontext.gregs[REG_EFL] &= ~EFLAGS_TF;
+
+	if ((sim_reg_offset / 4) < SIM_REG_COUNT)
+	{
+		if (sim_reg_write) sim_reg_writes[sim_reg_offset / 4]++;
+		else sim_reg_reads[sim_reg_offset / 4]++;
+	}
+	if (sim_reg_model->pAfter != NULL) sim_reg_model->pAfter(sim_reg_offset, sim_reg_write);
+	mprotect(sim_reg_page, sim_reg_page_size, PROT_NONE);
+}
+
+void *sim_regs_map(const SIM_RegModel_t *pModel)
+{
+	struct sigaction sa;
+
+	if (sim_reg_page == NULL)
+	{
+		sim_reg_page_size = (size_t)sysconf(_SC_PAGESIZE);
+		sim_reg_page = mmap(NULL, sim_reg_page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (sim_reg_page == MAP_FAILED)
+		{
+			sim_reg_page = NULL;
+			return NULL;
+		}
+
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_flags = SA_SIGINFO;
+		sa.sa_sigaction = sim_regs_fault;
+		sigaction(SIGSEGV, &sa, NULL);
+		sa.sa_sigaction = sim_regs_step;
+		sigaction(SIGTRAP, &sa, NULL);
+	}
+
+	sim_reg_model = pModel;
+	memset(sim_reg_reads, 0, sizeof(sim_reg_reads));
+	memset(sim_reg_writes, 0, sizeof(sim_reg_writes));
+
+	sim_regs_unlock();
+	memset(sim_reg_page, 0, sim_reg_page_size);
+	sim_regs_lock();
+
+	return sim_reg_page;
+}
+
+//direct access for the model and the checks, not counted
+void sim_regs_unlock(void)
+{
+	mprotect(sim_reg_page, sim_reg_page_size, PROT_READ | PROT_WRITE);
+}
+
+void sim_regs_lock(void)
+{
+	mprotect(sim_reg_page, sim_reg_page_size, PROT_NONE);
+}
+
+#else
+
+void *sim_regs_map(const SIM_RegModel_t *pModel)
+{
+	(void)pModel;
+	return NULL;
+}
+
+void sim_regs_unlock(void)
+{
+}
+
+void sim_regs_lock(void)
+{
+}
+
+#endif
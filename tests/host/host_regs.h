@@ -0,0 +1,35 @@
+/*
+ * host_regs.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ *
+ * Register block of a peripheral model for the host checks. The block sits on a page without
+ * access rights, every load/store of the driver traps and is single stepped, so the model sees
+ * each access in program order with its side effects (flags cleared by reading SR/DR, bits set
+ * by writes) exactly like the bus would. x86-64 Linux only, sim_regs_map returns NULL elsewhere.
+ */
+
+#ifndef TESTS_HOST_HOST_REGS_H_
+#define TESTS_HOST_HOST_REGS_H_
+
+#include <stdint.h>
+
+#define SIM_REG_NS						48				//one APB access, 4 PCLK cycles at 84 MHz
+#define SIM_REG_COUNT					64				//32 bit registers in the mapped block
+
+//peripheral model, Offset in bytes from the start of the block
+typedef struct{
+	void (*pBefore)(uint32_t Offset, uint8_t Write);	//brings the registers up to sim_ns
+	void (*pAfter)(uint32_t Offset, uint8_t Write);		//side effects of the access
+}SIM_RegModel_t;
+
+void *sim_regs_map(const SIM_RegModel_t *pModel);
+void sim_regs_unlock(void);
+void sim_regs_lock(void);
+
+//accesses per register since the last sim_regs_map
+extern uint32_t sim_reg_reads[SIM_REG_COUNT];
+extern uint32_t sim_reg_writes[SIM_REG_COUNT];
+
+#endif /* TESTS_HOST_HOST_REGS_H_ */
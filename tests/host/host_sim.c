@@ -0,0 +1,205 @@
+/*
+ * host_sim.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ */
+
+#include "host_sim.h"
+
+int sim_failures;
+uint64_t sim_ns;
+uint32_t sim_sclk_hz = 1000000;
+
+static const SIM_SpiDev_t *sim_spi_dev;
+
+
+void sim_spi_attach(const SIM_SpiDev_t *pDev, uint32_t SclkHz)
+{
+	sim_spi_dev = pDev;
+	sim_sclk_hz = SclkHz;
+}
+
+void sim_advance_ns(uint64_t Ns)
+{
+	sim_ns += Ns;
+}
+
+/*
+ * Driver dependencies
+ */
+void GPIO_WriteToOutputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t Value)
+{
+	(void)pGPIOx;
+	(void)PinNumber;
+
+	if ((sim_spi_dev != NULL) && (sim_spi_dev->pSelect != NULL))
+	{
+		sim_spi_dev->pSelect(Value == GPIO_PIN_RESET);
+	}
+}
+
+void SPI_PeripheralControl(SPI_RegDef_t *pSPIx, uint8_t EnOrDi)
+{
+	(void)pSPIx;
+	(void)EnOrDi;
+}
+
+void SPI_TransferData(SPI_RegDef_t *pSPIx, uint8_t *pTxBuffer, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint8_t out, in;
+
+	(void)pSPIx;
+
+	for (uint32_t i = 0; i < Len; i++)
+	{
+		out = (pTxBuffer != NULL) ? pTxBuffer[i] : 0xFF;
+		in = (sim_spi_dev != NULL) ? sim_spi_dev->pExchange(out) : 0xFF;
+		if (pRxBuffer != NULL)
+		{
+			pRxBuffer[i] = in;
+		}
+		sim_ns += (8ULL * 1000000000ULL) / sim_sclk_hz;
+	}
+}
+
+//fastest PCLK / 2^n not above MaxSclkHz, as the prescaler would give it
+uint32_t SPI_SetSclkFreq(SPI_Handle_t *pSPIHandle, uint32_t MaxSclkHz)
+{
+	uint32_t sclk = SIM_PCLK_HZ / 2;
+
+	(void)pSPIHandle;
+
+	while ((sclk > MaxSclkHz) && (sclk > (SIM_PCLK_HZ / 256)))
+	{
+		sclk /= 2;
+	}
+	sim_sclk_hz = sclk;
+
+	return sclk;
+}
+
+void DWT_CycleCounterInit(void)
+{
+}
+
+uint32_t DWT_GetCycles(void)
+{
+	sim_ns += SIM_POLL_NS;
+	return (uint32_t)((sim_ns * SIM_HCLK_HZ) / 1000000000ULL);
+}
+
+uint32_t DWT_UsToCycles(uint32_t Us)
+{
+	return (uint32_t)((Us * SIM_HCLK_HZ) / 1000000ULL);
+}
+
+uint32_t DWT_MsToCycles(uint32_t Ms)
+{
+	uint64_t cycles = (Ms * SIM_HCLK_HZ) / 1000ULL;
+
+	return (cycles > 0xFFFFFFFFULL) ? 0xFFFFFFFFU : (uint32_t)cycles;
+}
+
+uint8_t DWT_IsElapsed(uint32_t Start, uint32_t Cycles)
+{
+	return ((uint32_t)(DWT_GetCycles() - Start) >= Cycles) ? SET : RESET;
+}
+
+//DMA, TIM and clock calls of paths the checks do not use
+void DMA_Init(DMA_Handle_t *pDMAHandle)
+{
+	(void)pDMAHandle;
+}
+
+void DMA_StartTransfer(DMA_Handle_t *pDMAHandle, uint32_t PeriphAddr, uint32_t Mem0Addr, uint32_t Mem1Addr, uint16_t Len)
+{
+	(void)pDMAHandle;
+	(void)PeriphAddr;
+	(void)Mem0Addr;
+	(void)Mem1Addr;
+	(void)Len;
+}
+
+void DMA_StopTransfer(DMA_Handle_t *pDMAHandle)
+{
+	(void)pDMAHandle;
+}
+
+uint16_t DMA_GetDataCounter(DMA_Handle_t *pDMAHandle)
+{
+	(void)pDMAHandle;
+	return 0;
+}
+
+uint8_t DMA_GetFlags(DMA_Handle_t *pDMAHandle)
+{
+	(void)pDMAHandle;
+	return 0;
+}
+
+void DMA_ClearFlags(DMA_Handle_t *pDMAHandle, uint8_t Flags)
+{
+	(void)pDMAHandle;
+	(void)Flags;
+}
+
+uint32_t TIM_GetClock(TIM_RegDef_t *pTIMx)
+{
+	(void)pTIMx;
+	return SIM_PCLK_HZ;
+}
+
+uint8_t TIM_Init(TIM_Handle_t *pTIMHandle)
+{
+	(void)pTIMHandle;
+	return TIM_OK;
+}
+
+void TIM_Start(TIM_RegDef_t *pTIMx)
+{
+	(void)pTIMx;
+}
+
+void TIM_Stop(TIM_RegDef_t *pTIMx)
+{
+	(void)pTIMx;
+}
+
+void TIM_ICConfig(TIM_RegDef_t *pTIMx, uint8_t Channel, uint8_t Polarity, uint8_t Filter)
+{
+	(void)pTIMx;
+	(void)Channel;
+	(void)Polarity;
+	(void)Filter;
+}
+
+void TIM_ICDisable(TIM_RegDef_t *pTIMx, uint8_t Channel)
+{
+	(void)pTIMx;
+	(void)Channel;
+}
+
+void TIM_CCDMAConfig(TIM_RegDef_t *pTIMx, uint8_t Channel, uint8_t EnorDi)
+{
+	(void)pTIMx;
+	(void)Channel;
+	(void)EnorDi;
+}
+
+uint8_t GPIO_ReadFromInputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber)
+{
+	(void)pGPIOx;
+	(void)PinNumber;
+	return GPIO_PIN_SET;
+}
+
+uint32_t RCC_GetPCLK1Value(void)
+{
+	return SIM_PCLK_HZ / 2;
+}
+
+uint32_t RCC_GetPCLK2Value(void)
+{
+	return SIM_PCLK_HZ;
+}
@@ -0,0 +1,41 @@
+/*
+ * host_sim.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ *
+ * Host side stand-ins for the SPI, GPIO and DWT calls of the drivers. Time is virtual: SPI
+ * bytes cost their time on the wire at the current SCLK and every DWT read costs a polling
+ * step, so device models can keep busy times and throughput can be measured off-target.
+ * DMA, TIM and RCC calls of paths the checks do not take are no-ops.
+ */
+
+#ifndef TESTS_HOST_HOST_SIM_H_
+#define TESTS_HOST_HOST_SIM_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "stm32f401xx.h"
+
+#define SIM_HCLK_HZ						84000000ULL
+#define SIM_PCLK_HZ						84000000ULL		//SPI1 on APB2
+#define SIM_POLL_NS						200				//one DWT read in a polling loop
+
+//SPI device model, selected while its chip select pin is low
+typedef struct{
+	void    (*pSelect)(uint8_t Active);		//chip select edge, Active on the falling edge
+	uint8_t (*pExchange)(uint8_t Byte);		//one byte in each direction
+}SIM_SpiDev_t;
+
+extern uint64_t sim_ns;
+extern uint32_t sim_sclk_hz;
+
+void sim_spi_attach(const SIM_SpiDev_t *pDev, uint32_t SclkHz);
+void sim_advance_ns(uint64_t Ns);
+
+extern int sim_failures;
+
+#define CHECK(cond)		do { if (!(cond)) { sim_failures++; printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); } } while (0)
+
+#endif /* TESTS_HOST_HOST_SIM_H_ */
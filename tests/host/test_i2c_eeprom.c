@@ -0,0 +1,344 @@
+/*
+ * test_i2c_eeprom.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ *
+ * Host checks of the 24Cxx EEPROM driver (stm32f401xx_i2c_eeprom_driver) against a model that
+ * NACKs its address during the write cycle, wraps page writes inside the page and counts pages
+ * that did. The I2C calls of the driver are replaced at transfer level; queued transactions
+ * run one per I2C_TxnProcess call, which stands in for the interrupt that chains them.
+ */
+
+#include <string.h>
+
+#include "host_sim.h"
+#include "stm32f401xx_i2c_eeprom_driver.h"
+
+#define MODEL_SCL_HZ				400000
+#define MODEL_WRITE_CYCLE_NS		3500000ULL		//typical tWR, the datasheet maximum is 5 ms
+#define MODEL_MAX_CAPACITY			32768
+
+//bus time of Bytes bytes plus the address byte, START and STOP, 9 clocks per byte
+#define MODEL_BUS_NS(Bytes)			(((uint64_t)((Bytes) + 1) * 9 + 2) * 1000000000ULL / MODEL_SCL_HZ)
+
+static struct{
+	uint8_t  Mem[MODEL_MAX_CAPACITY];
+	uint32_t Capacity;
+	uint16_t PageSize;
+	uint8_t  AddrSize;
+	uint8_t  DevAddr;
+	uint64_t BusyUntil;
+	uint8_t  Stuck;					//never leaves the write cycle
+
+	//counters
+	uint32_t PageWrites;
+	uint32_t PageWraps;				//page writes that ran past the end of their page
+	uint32_t BusyNacks;
+	uint8_t  Polled;				//the address was NACKed since the last page write
+	uint64_t MaxGapNs;				//longest delay between the end of a polled write cycle and the next page
+}ee;
+
+static uint8_t model_busy(void)
+{
+	return ee.Stuck || (sim_ns < ee.BusyUntil);
+}
+
+//the device answers to DevAddr..DevAddr+7 when the address bits spill into the device address
+static uint8_t model_addressed(uint8_t SlaveAddr)
+{
+	uint32_t blocks = ee.Capacity >> (8 * ee.AddrSize);
+
+	if (blocks < 1) blocks = 1;
+	return (SlaveAddr >= ee.DevAddr) && (SlaveAddr < (ee.DevAddr + blocks));
+}
+
+static uint32_t model_addr(uint8_t SlaveAddr, uint16_t MemAddr)
+{
+	return ((uint32_t)(SlaveAddr - ee.DevAddr) << (8 * ee.AddrSize)) | MemAddr;
+}
+
+static uint8_t model_write(uint8_t SlaveAddr, uint32_t Addr, const uint8_t *pData, uint32_t Len)
+{
+	uint32_t page = Addr & ~(uint32_t)(ee.PageSize - 1);
+	uint64_t gap;
+
+	sim_advance_ns(MODEL_BUS_NS(ee.AddrSize + Len));
+	if (!model_addressed(SlaveAddr)) return I2C_ERR_NACK;
+	if (model_busy())
+	{
+		ee.BusyNacks++;
+		ee.Polled = 1;
+		return I2C_ERR_NACK;
+	}
+
+	gap = sim_ns - MODEL_BUS_NS(ee.AddrSize + Len) - ee.BusyUntil;
+	if (ee.Polled && (gap > ee.MaxGapNs)) ee.MaxGapNs = gap;
+	ee.Polled = 0;
+
+	for (uint32_t i = 0; i < Len; i++)
+	{
+		if ((Addr & (ee.PageSize - 1)) + i == ee.PageSize) ee.PageWraps++;
+		ee.Mem[page + ((Addr + i) & (ee.PageSize - 1))] = pData[i];
+	}
+
+	ee.PageWrites++;
+	ee.BusyUntil = sim_ns + MODEL_WRITE_CYCLE_NS;
+	return I2C_OK;
+}
+
+/*
+ * I2C driver calls used by the EEPROM driver
+ */
+uint8_t I2C_MasterProbe(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr)
+{
+	(void)pI2CHandle;
+
+	sim_advance_ns(MODEL_BUS_NS(0));
+	if (!model_addressed(SlaveAddr)) return I2C_ERR_NACK;
+	if (model_busy())
+	{
+		ee.BusyNacks++;
+		ee.Polled = 1;
+		return I2C_ERR_NACK;
+	}
+	return I2C_OK;
+}
+
+uint8_t I2C_MemWrite(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pTxBuffer, uint32_t Len)
+{
+	(void)pI2CHandle;
+
+	if (MemAddrSize != ee.AddrSize) return I2C_ERR_PARAM;
+	return model_write(SlaveAddr, model_addr(SlaveAddr, MemAddr), pTxBuffer, Len);
+}
+
+uint8_t I2C_MemRead(I2C_Handle_t *pI2CHandle, uint8_t SlaveAddr, uint16_t MemAddr, uint8_t MemAddrSize, uint8_t *pRxBuffer, uint32_t Len)
+{
+	uint32_t addr = model_addr(SlaveAddr, MemAddr);
+
+	(void)pI2CHandle;
+
+	sim_advance_ns(MODEL_BUS_NS(MemAddrSize) + MODEL_BUS_NS(Len));
+	if ((MemAddrSize != ee.AddrSize) || !model_addressed(SlaveAddr) || model_busy()) return I2C_ERR_NACK;
+
+	//the address counter rolls over at the end of the memory on reads
+	for (uint32_t i = 0; i < Len; i++)
+	{
+		pRxBuffer[i] = ee.Mem[(addr + i) % ee.Capacity];
+	}
+	return I2C_OK;
+}
+
+//transactions submitted and not yet run, the driver has at most one in flight
+static I2C_Txn_t *txn_pending;
+static uint32_t txn_submitted;
+
+uint8_t I2C_TxnSubmit(I2C_Handle_t *pI2CHandle, I2C_Txn_t *pTxn, uint8_t Prio)
+{
+	(void)pI2CHandle;
+
+	if ((pTxn == NULL) || (Prio >= I2C_TXN_PRIO_LEVELS)) return I2C_ERR_PARAM;
+	CHECK(txn_pending == NULL);
+
+	pTxn->Status = I2C_TXN_PENDING;
+	txn_pending = pTxn;
+	txn_submitted++;
+	return I2C_OK;
+}
+
+void I2C_TxnProcess(I2C_Handle_t *pI2CHandle)
+{
+	I2C_Txn_t *pTxn = txn_pending;
+	uint8_t status;
+
+	(void)pI2CHandle;
+
+	if (pTxn == NULL) return;
+	txn_pending = NULL;
+
+	if (pTxn->Flags & I2C_TXN_PROBE)
+	{
+		status = I2C_MasterProbe(pI2CHandle, pTxn->SlaveAddr);
+	}
+	else
+	{
+		//address bytes first, as ee_submit_page lays them out
+		uint32_t addr = pTxn->pTxBuffer[0];
+		if (ee.AddrSize == I2C_MEMADD_SIZE_16BIT) addr = (addr << 8) | pTxn->pTxBuffer[1];
+		status = model_write(pTxn->SlaveAddr, model_addr(pTxn->SlaveAddr, (uint16_t)addr),
+				&pTxn->pTxBuffer[ee.AddrSize], pTxn->TxLen - ee.AddrSize);
+	}
+
+	pTxn->Status = (status == I2C_OK) ? I2C_TXN_DONE : I2C_TXN_ERROR;
+	pTxn->pCallback(pTxn, (status == I2C_OK) ? I2C_EV_TX_CMPLT : I2C_ERROR_AF);
+}
+
+static I2C_Handle_t i2c;
+static I2C_TxnQueue_t queue;
+static EE_Handle_t eeprom;
+
+static void model_setup(uint32_t Capacity, uint16_t PageSize, uint8_t AddrSize)
+{
+	memset(&ee, 0, sizeof(ee));
+	memset(ee.Mem, 0xFF, sizeof(ee.Mem));
+	ee.Capacity = Capacity;
+	ee.PageSize = PageSize;
+	ee.AddrSize = AddrSize;
+	ee.DevAddr = 0x50;
+
+	memset(&eeprom, 0, sizeof(eeprom));
+	i2c.pQueue = &queue;
+	eeprom.pI2CHandle = &i2c;
+	eeprom.DevAddr = 0x50;
+	eeprom.AddrSize = AddrSize;
+	eeprom.PageSize = PageSize;
+	eeprom.Capacity = Capacity;
+
+	CHECK(EE_Init(&eeprom) == EE_OK);
+}
+
+static uint8_t pattern(uint32_t Addr, uint8_t Seed)
+{
+	return (uint8_t)((Addr * 13) + Seed + (Addr >> 8));
+}
+
+//unaligned blocking write and read back, for one geometry
+static void check_blocking(uint32_t Addr, uint32_t Len, uint8_t Seed)
+{
+	static uint8_t data[MODEL_MAX_CAPACITY], back[MODEL_MAX_CAPACITY];
+
+	for (uint32_t i = 0; i < Len; i++)
+	{
+		data[i] = pattern(Addr + i, Seed);
+	}
+
+	CHECK(EE_Write(&eeprom, Addr, data, Len) == EE_OK);
+	CHECK(EE_Read(&eeprom, Addr, back, Len) == EE_OK);
+	CHECK(memcmp(data, back, Len) == 0);
+	CHECK(memcmp(&ee.Mem[Addr], data, Len) == 0);
+}
+
+static uint32_t async_done;
+static uint8_t async_status[4];
+
+static void async_callback(EE_Write_t *pReq, uint8_t Status)
+{
+	async_status[(uintptr_t)pReq->pContext] = Status;
+	async_done++;
+}
+
+//queued requests complete in order, each page follows the write cycle of the previous one
+static void check_async(void)
+{
+	static uint8_t data[4][300];
+	EE_Write_t req[4];
+	uint32_t addr[4] = {0x0005, 0x0200, 0x1F80, 0x7FF0};
+	uint32_t len[4] = {300, 64, 200, 16};
+
+	async_done = 0;
+	ee.Polled = 0;
+	ee.MaxGapNs = 0;
+	for (uint32_t r = 0; r < 4; r++)
+	{
+		for (uint32_t i = 0; i < len[r]; i++)
+		{
+			data[r][i] = pattern(addr[r] + i, (uint8_t)(0x40 + r));
+		}
+		memset(&req[r], 0, sizeof(req[r]));
+		req[r].Addr = addr[r];
+		req[r].pData = data[r];
+		req[r].Len = len[r];
+		req[r].pCallback = async_callback;
+		req[r].pContext = (void *)(uintptr_t)r;
+		CHECK(EE_WriteAsync(&eeprom, &req[r]) == EE_OK);
+	}
+
+	//blocking calls are refused while requests are queued
+	CHECK(EE_Write(&eeprom, 0, data[0], 1) == EE_ERR_BUSY);
+
+	while (!EE_IsIdle(&eeprom));
+
+	CHECK(async_done == 4);
+	for (uint32_t r = 0; r < 4; r++)
+	{
+		CHECK(async_status[r] == EE_OK);
+		CHECK(req[r].Status == EE_OK);
+		CHECK(memcmp(&ee.Mem[addr[r]], data[r], len[r]) == 0);
+	}
+
+	//the next page goes out on the first ACK, within one poll of the end of the write cycle
+	CHECK(ee.MaxGapNs <= 2 * MODEL_BUS_NS(0));
+	CHECK(eeprom.PollCount > 0);
+}
+
+//a device that never ends its write cycle is reported, not waited for forever
+static void check_timeout(void)
+{
+	EE_Write_t req;
+	uint8_t byte = 0xA5;
+
+	CHECK(EE_Write(&eeprom, 0x100, &byte, 1) == EE_OK);
+	ee.Stuck = 1;
+	CHECK(EE_Write(&eeprom, 0x101, &byte, 1) == EE_ERR_TIMEOUT);
+
+	memset(&req, 0, sizeof(req));
+	req.Addr = 0x102;
+	req.pData = &byte;
+	req.Len = 1;
+	req.pCallback = async_callback;
+	async_done = 0;
+	CHECK(EE_WriteAsync(&eeprom, &req) == EE_OK);
+	while (!EE_IsIdle(&eeprom));
+	CHECK(async_done == 1);
+	CHECK(req.Status == EE_ERR_TIMEOUT);
+	ee.Stuck = 0;
+}
+
+//virtual time of a 4 KB write with ACK polling, against a fixed 5 ms delay per page
+static void benchmark(void)
+{
+	static uint8_t data[4096];
+	uint32_t pages = sizeof(data) / eeprom.PageSize;
+	uint64_t start, ns, fixed_ns;
+
+	for (uint32_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = pattern(i, 0x77);
+	}
+
+	CHECK(EE_WaitReady(&eeprom) == EE_OK);
+	start = sim_ns;
+	CHECK(EE_Write(&eeprom, 0x2000, data, sizeof(data)) == EE_OK);
+	CHECK(EE_WaitReady(&eeprom) == EE_OK);
+	ns = sim_ns - start;
+	fixed_ns = pages * (MODEL_BUS_NS(2 + eeprom.PageSize) + 5000000ULL);
+
+	printf("test_i2c_eeprom: 4 KB in %u pages, ACK polling %.1f ms (%.0f B/s), fixed 5 ms delay %.1f ms\n",
+			pages, ns / 1e6, sizeof(data) / (ns / 1e9), fixed_ns / 1e6);
+	CHECK(ns < fixed_ns);
+}
+
+int main(void)
+{
+	//24C256: 32 KB, 64 byte pages, 16 bit addresses
+	model_setup(32768, 64, I2C_MEMADD_SIZE_16BIT);
+	check_blocking(0x0000, 64, 1);
+	check_blocking(0x003F, 2, 2);
+	check_blocking(0x0123, 1000, 3);
+	check_blocking(0x7FC0, 64, 4);
+	CHECK(EE_Write(&eeprom, 0x7FFF, ee.Mem, 2) == EE_ERR_RANGE);
+	check_async();
+	check_timeout();
+	benchmark();
+	CHECK(ee.PageWraps == 0);
+
+	//24C16: 2 KB, 16 byte pages, 8 bit addresses, the upper bits go into the device address
+	model_setup(2048, 16, I2C_MEMADD_SIZE_8BIT);
+	check_blocking(0x00F8, 300, 5);
+	check_blocking(0x0700, 256, 6);
+	CHECK(ee.PageWraps == 0);
+
+	printf("test_i2c_eeprom: %s\n", sim_failures ? "FAILED" : "OK");
+	return sim_failures ? 1 : 0;
+}
@@ -0,0 +1,410 @@
+/*
+ * test_i2c_master_rx.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ *
+ * Bus level checks of the I2C master reception (stm32f401xx_i2c_driver) for N=1, N=2 and N>2,
+ * blocking and interrupt driven. The unmodified driver runs against a register model of the
+ * I2C peripheral (host_regs) and a slave transmitter on a 400 kHz bus. The model decides
+ * ACK/NACK when each byte ends, applies POS, stretches SCL while DR and the shift register are
+ * full (BTF) and sends STOP after the current byte, like the reference manual describes. It
+ * counts bytes the slave had to send past the last one, early NACKs, STOP after an ACKed byte
+ * and DR reads without data; it also records ACK/POS at the moment ADDR is cleared.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "host_regs.h"
+#include "host_sim.h"
+#include "stm32f401xx_i2c_driver.h"
+
+#define MODEL_BIT_NS				2500ULL			//400 kHz
+#define MODEL_BYTE_NS				(9 * MODEL_BIT_NS)	//8 data bits and the ACK bit
+#define MODEL_SLAVE_ADDR			0x50
+
+//@model_phase
+#define MODEL_IDLE					0
+#define MODEL_START					1				//START requested, SB after one bit time
+#define MODEL_SB					2
+#define MODEL_ADDR_TX				3				//address byte on the bus
+#define MODEL_ADDR					4				//ADDR set, SCL stretched
+#define MODEL_RX					5
+#define MODEL_RX_END				6				//last byte NACKed, waiting for STOP or a repeated start
+
+static I2C_RegDef_t *regs;
+
+static struct{
+	uint8_t  Phase;					//@model_phase
+	uint64_t EventAt;				//end of the START/address/byte in progress
+	uint8_t  SR1Read;				//SR1 was read with SB/ADDR set, first half of their clear sequence
+	uint8_t  Shifting;				//a data byte is on the bus
+	uint8_t  ShiftFull;				//a received byte waits in the shift register (BTF)
+	uint8_t  ShiftData;
+	uint8_t  LastAck;				//ACK given to the last received byte
+	uint8_t  AckLatched;			//ACK as sampled at the previous byte, applies to the next with POS
+
+	//slave
+	const uint8_t *pData;
+	uint32_t Expected;				//bytes the master asked for
+	uint32_t Sent;
+
+	//counters
+	uint32_t Stops;
+	uint32_t Overrun;				//bytes clocked after the master ACKed the last one
+	uint32_t EarlyNack;				//NACK before the last byte
+	uint32_t StopAfterAck;			//STOP sent behind an ACKed byte, the slave still drives SDA
+	uint32_t EmptyReads;			//DR read without RXNE
+	uint8_t  AckAtAddrClear;
+	uint8_t  PosAtAddrClear;
+	uint64_t EndNs;					//time of the STOP
+}bus;
+
+static void model_stop(void)
+{
+	regs->CR1 &= ~(1 << I2C_CR1_STOP);
+	regs->SR2 &= ~((1 << I2C_SR2_MSL) | (1 << I2C_SR2_BUSY));
+	bus.Phase = MODEL_IDLE;
+	bus.Stops++;
+	bus.EndNs = bus.EventAt;
+}
+
+static void model_next_byte(uint64_t Now)
+{
+	bus.Shifting = 1;
+	bus.EventAt = Now + MODEL_BYTE_NS;
+}
+
+//end of a data byte, the ACK bit is driven from ACK, or from the latched ACK with POS
+static void model_byte_done(void)
+{
+	uint8_t data = (bus.Sent < bus.Expected) ? bus.pData[bus.Sent] : 0xFF;
+	uint8_t ack = (regs->CR1 & (1 << I2C_CR1_POS)) ? bus.AckLatched : ((regs->CR1 >> I2C_CR1_ACK) & 1);
+
+	bus.AckLatched = (regs->CR1 >> I2C_CR1_ACK) & 1;
+	bus.Shifting = 0;
+	bus.Sent++;
+	bus.LastAck = ack;
+
+	if (ack && (bus.Sent >= bus.Expected)) bus.Overrun++;
+	if (!ack && (bus.Sent < bus.Expected)) bus.EarlyNack++;
+
+	if (regs->SR1 & (1 << I2C_SR1_RXNE))
+	{
+		bus.ShiftFull = 1;
+		bus.ShiftData = data;
+		regs->SR1 |= (1 << I2C_SR1_BTF);
+	}
+	else
+	{
+		regs->DR = data;
+		regs->SR1 |= (1 << I2C_SR1_RXNE);
+		if (ack) model_next_byte(bus.EventAt);
+	}
+
+	if (!ack) bus.Phase = MODEL_RX_END;
+
+	if (regs->CR1 & (1 << I2C_CR1_STOP))
+	{
+		if (ack) bus.StopAfterAck++;
+		model_stop();
+	}
+}
+
+//runs the bus up to sim_ns
+static void model_run(void)
+{
+	while (1)
+	{
+		switch (bus.Phase)
+		{
+		case MODEL_START:
+			if (sim_ns < bus.EventAt) return;
+			regs->CR1 &= ~(1 << I2C_CR1_START);
+			regs->SR1 |= (1 << I2C_SR1_SB);
+			regs->SR2 |= (1 << I2C_SR2_MSL) | (1 << I2C_SR2_BUSY);
+			bus.Phase = MODEL_SB;
+			break;
+
+		case MODEL_ADDR_TX:
+			if (sim_ns < bus.EventAt) return;
+			if ((regs->DR & 0xFF) == ((MODEL_SLAVE_ADDR << 1) | 1))
+			{
+				regs->SR1 |= (1 << I2C_SR1_ADDR);
+				regs->SR2 &= ~(1 << I2C_SR2_TRA);
+				bus.AckLatched = (regs->CR1 >> I2C_CR1_ACK) & 1;
+				bus.Phase = MODEL_ADDR;
+			}
+			else
+			{
+				regs->SR1 |= (1 << I2C_SR1_AF);
+				bus.Phase = MODEL_RX_END;
+			}
+			break;
+
+		case MODEL_RX:
+			if (!bus.Shifting || (sim_ns < bus.EventAt)) return;
+			model_byte_done();
+			break;
+
+		default:
+			return;
+		}
+	}
+}
+
+static void model_before(uint32_t Offset, uint8_t Write)
+{
+	(void)Offset;
+	(void)Write;
+
+	model_run();
+}
+
+static void model_after(uint32_t Offset, uint8_t Write)
+{
+	switch (Offset)
+	{
+	case offsetof(I2C_RegDef_t, CR1):
+		if (!Write) break;
+		if ((regs->CR1 & (1 << I2C_CR1_START)) && ((bus.Phase == MODEL_IDLE) || (bus.Phase == MODEL_RX_END)))
+		{
+			bus.Phase = MODEL_START;
+			bus.EventAt = sim_ns + MODEL_BIT_NS;
+		}
+		//STOP goes out after the byte in progress, at once while SCL is stretched
+		if ((regs->CR1 & (1 << I2C_CR1_STOP)) && !bus.Shifting && (bus.Phase == MODEL_RX_END || bus.ShiftFull))
+		{
+			if (bus.LastAck) bus.StopAfterAck++;
+			bus.EventAt = sim_ns;
+			model_stop();
+		}
+		break;
+
+	case offsetof(I2C_RegDef_t, SR1):
+		if (Write) break;
+		bus.SR1Read = (regs->SR1 & ((1 << I2C_SR1_SB) | (1 << I2C_SR1_ADDR))) ? 1 : 0;
+		break;
+
+	case offsetof(I2C_RegDef_t, SR2):
+		if (Write || !bus.SR1Read || !(regs->SR1 & (1 << I2C_SR1_ADDR))) break;
+		//ADDR cleared, the slave starts with the first byte
+		regs->SR1 &= ~(1 << I2C_SR1_ADDR);
+		bus.SR1Read = 0;
+		bus.AckAtAddrClear = (regs->CR1 >> I2C_CR1_ACK) & 1;
+		bus.PosAtAddrClear = (regs->CR1 >> I2C_CR1_POS) & 1;
+		bus.Phase = MODEL_RX;
+		model_next_byte(sim_ns);
+		break;
+
+	case offsetof(I2C_RegDef_t, DR):
+		if (Write)
+		{
+			if ((bus.Phase == MODEL_SB) && bus.SR1Read)
+			{
+				regs->SR1 &= ~(1 << I2C_SR1_SB);
+				bus.SR1Read = 0;
+				bus.Phase = MODEL_ADDR_TX;
+				bus.EventAt = sim_ns + MODEL_BYTE_NS;
+			}
+			break;
+		}
+		if (!(regs->SR1 & (1 << I2C_SR1_RXNE)))
+		{
+			bus.EmptyReads++;
+			break;
+		}
+		if (bus.ShiftFull)
+		{
+			//the shift register moves to DR, SCL is released for the next byte if it was ACKed
+			regs->DR = bus.ShiftData;
+			regs->SR1 &= ~(1 << I2C_SR1_BTF);
+			bus.ShiftFull = 0;
+			if (bus.LastAck && (bus.Phase == MODEL_RX)) model_next_byte(sim_ns);
+		}
+		else
+		{
+			regs->SR1 &= ~(1 << I2C_SR1_RXNE);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+static const SIM_RegModel_t i2c_model = {model_before, model_after};
+
+static I2C_Handle_t handle;
+static uint32_t rx_cmplt;
+
+void I2C_ApplicationEventCallback(I2C_Handle_t *pI2CHandle, uint8_t AppEv)
+{
+	(void)pI2CHandle;
+
+	if (AppEv == I2C_EV_RX_CMPLT) rx_cmplt++;
+}
+
+static void setup(const uint8_t *pData, uint32_t Len)
+{
+	memset(&bus, 0, sizeof(bus));
+	bus.pData = pData;
+	bus.Expected = Len;
+
+	sim_regs_unlock();
+	memset(regs, 0, sizeof(*regs));
+	regs->CR1 = (1 << I2C_CR1_PE) | (1 << I2C_CR1_ACK);
+	sim_regs_lock();
+
+	memset(&handle, 0, sizeof(handle));
+	handle.pI2Cx = regs;
+	handle.I2CConfig.I2C_ACKControl = I2C_ACK_ENABLE;
+	handle.I2CConfig.I2C_Mode = I2C_MODE_I2C;
+	rx_cmplt = 0;
+}
+
+//the bus is back to idle with the slave stopped at the right byte and CR1 restored
+static void check_bus(const char *pWhat, uint32_t Len, const uint8_t *pData, const uint8_t *pBack)
+{
+	uint32_t cr1;
+
+	sim_regs_unlock();
+	cr1 = regs->CR1;
+	sim_regs_lock();
+
+	if ((bus.Overrun != 0) || (bus.EarlyNack != 0) || (bus.StopAfterAck != 0) || (bus.EmptyReads != 0) || (bus.Stops != 1))
+	{
+		printf("test_i2c_master_rx: %s N=%u: overrun %u, early NACK %u, STOP after ACK %u, empty reads %u, stops %u\n",
+				pWhat, (unsigned)Len, (unsigned)bus.Overrun, (unsigned)bus.EarlyNack, (unsigned)bus.StopAfterAck,
+				(unsigned)bus.EmptyReads, (unsigned)bus.Stops);
+		sim_failures++;
+	}
+	CHECK(bus.Sent == Len);
+	CHECK(memcmp(pData, pBack, Len) == 0);
+	CHECK(!(cr1 & (1 << I2C_CR1_POS)));
+	CHECK(cr1 & (1 << I2C_CR1_ACK));
+
+	//the reference manual set-up has to be in place before ADDR is cleared
+	if (Len == 1) CHECK(!bus.AckAtAddrClear);
+	if (Len == 2) CHECK(!bus.AckAtAddrClear && bus.PosAtAddrClear);
+}
+
+static void check_blocking(uint32_t Len)
+{
+	static uint8_t data[32], back[32];
+
+	for (uint32_t i = 0; i < Len; i++)
+	{
+		data[i] = (uint8_t)(0xA0 + i);
+	}
+	memset(back, 0, sizeof(back));
+	setup(data, Len);
+
+	CHECK(I2C_MasterRecieveData(&handle, back, Len, MODEL_SLAVE_ADDR, I2C_DISABLE_SR) == I2C_OK);
+	check_bus("blocking", Len, data, back);
+}
+
+static uint8_t irq_pending(void)
+{
+	uint32_t cr2, sr1;
+
+	sim_regs_unlock();
+	model_run();
+	cr2 = regs->CR2;
+	sr1 = regs->SR1;
+	sim_regs_lock();
+
+	if (!(cr2 & (1 << I2C_CR2_ITEVTEN))) return 0;
+	if (sr1 & (I2C_SB_FLAG | I2C_ADDR_FLAG | I2C_BTF_FLAG | I2C_STOPF_FLAG)) return 1;
+	if ((cr2 & (1 << I2C_CR2_ITBUFEN)) && (sr1 & (I2C_RXNE_FLAG | I2C_TXE_FLAG))) return 1;
+	return 0;
+}
+
+//interrupt driven, the handler entered LatencyNs after the event is pending
+static void check_it(uint32_t Len, uint64_t LatencyNs)
+{
+	static uint8_t data[32], back[32];
+	uint64_t pending_since = 0, deadline;
+	uint8_t pending = 0;
+
+	for (uint32_t i = 0; i < Len; i++)
+	{
+		data[i] = (uint8_t)(0x30 + 7 * i);
+	}
+	memset(back, 0, sizeof(back));
+	setup(data, Len);
+
+	CHECK(I2C_MasterRecieveDataIT(&handle, back, Len, MODEL_SLAVE_ADDR, I2C_DISABLE_SR) == I2C_READY);
+
+	deadline = sim_ns + (Len + 4) * 2 * MODEL_BYTE_NS + (Len + 4) * LatencyNs;
+	while ((handle.TxRxState != I2C_READY) && (sim_ns < deadline))
+	{
+		if (!irq_pending())
+		{
+			pending = 0;
+			sim_advance_ns(SIM_POLL_NS);
+			continue;
+		}
+		if (!pending)
+		{
+			pending = 1;
+			pending_since = sim_ns;
+		}
+		if (sim_ns - pending_since < LatencyNs)
+		{
+			sim_advance_ns(SIM_POLL_NS);
+			continue;
+		}
+		I2C_EV_IRQHandling(&handle);
+		pending = 0;
+	}
+
+	//the STOP of N=2 and N>2 may still be on its way out when the handle is released
+	sim_advance_ns(MODEL_BYTE_NS);
+	sim_regs_unlock();
+	model_run();
+	sim_regs_lock();
+
+	CHECK(handle.TxRxState == I2C_READY);
+	CHECK(rx_cmplt == 1);
+	check_bus(LatencyNs ? "interrupt, late" : "interrupt", Len, data, back);
+}
+
+//time from the call to the STOP, against the 9 bit times per byte the bus needs
+static void benchmark(void)
+{
+	static uint8_t data[16], back[16];
+	uint64_t start;
+
+	setup(data, sizeof(data));
+	start = sim_ns;
+	CHECK(I2C_MasterRecieveData(&handle, back, sizeof(back), MODEL_SLAVE_ADDR, I2C_DISABLE_SR) == I2C_OK);
+
+	printf("test_i2c_master_rx: 16 bytes at 400 kHz in %.1f us (bus minimum %.1f us)\n",
+			(bus.EndNs - start) / 1e3, (17 * MODEL_BYTE_NS + MODEL_BIT_NS) / 1e3);
+}
+
+int main(void)
+{
+	static const uint32_t lengths[] = {1, 2, 3, 4, 7};
+
+	regs = sim_regs_map(&i2c_model);
+	if (regs == NULL)
+	{
+		printf("test_i2c_master_rx: skipped, no register trap on this host\n");
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+	{
+		check_blocking(lengths[i]);
+		check_it(lengths[i], 0);
+		//longer than a byte on the bus, BTF has to hold the tail back
+		check_it(lengths[i], 3 * MODEL_BYTE_NS);
+	}
+	benchmark();
+
+	printf("test_i2c_master_rx: %s\n", sim_failures ? "FAILED" : "OK");
+	return sim_failures ? 1 : 0;
+}
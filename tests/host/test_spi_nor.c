@@ -0,0 +1,309 @@
+/*
+ * test_spi_nor.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ *
+ * Host checks of the SPI NOR driver (stm32f401xx_spi_nor_driver) against a model of a 25/W25
+ * series flash. The model only lets programming clear bits, wraps page programs inside their
+ * page like the real part and counts every command the driver sends while WIP is set or
+ * without WEL. Also prints the write/read throughput at the model's typical timings.
+ */
+
+#include <string.h>
+
+#include "host_sim.h"
+#include "stm32f401xx_spi_nor_driver.h"
+
+#define MODEL_CAPACITY_CODE			0x14		//1 MB
+#define MODEL_CAPACITY				(1UL << MODEL_CAPACITY_CODE)
+#define MODEL_SCLK_HZ				21000000
+
+//typical times of a W25Q80
+#define MODEL_PAGE_PROGRAM_NS		700000ULL
+#define MODEL_SECTOR_ERASE_NS		45000000ULL
+#define MODEL_BLOCK_ERASE_NS		150000000ULL
+
+static struct{
+	uint8_t  Mem[MODEL_CAPACITY];
+	uint8_t  Selected;
+	uint32_t Index;					//bytes since the falling chip select edge
+	uint8_t  Cmd;
+	uint32_t Addr;
+	uint8_t  Wel;
+	uint64_t BusyUntil;
+
+	uint8_t  Page[NOR_PAGE_SIZE];	//page program data, applied on the rising edge
+	uint8_t  PageWritten[NOR_PAGE_SIZE];
+	uint32_t PageLen;
+
+	//counters
+	uint32_t FastReads;
+	uint32_t Programs;
+	uint32_t BusyViolations;		//commands other than a status read while WIP is set
+	uint32_t WelViolations;			//program/erase without write enable
+	uint32_t PageWraps;				//page programs that crossed the end of their page
+	uint32_t Overwrites;			//programmed ones over zeros, which cannot be brought back
+}nor;
+
+static uint8_t model_busy(void)
+{
+	return sim_ns < nor.BusyUntil;
+}
+
+static void model_select(uint8_t Active)
+{
+	uint32_t base;
+
+	if (Active)
+	{
+		nor.Selected = 1;
+		nor.Index = 0;
+		nor.PageLen = 0;
+		return;
+	}
+
+	nor.Selected = 0;
+	if (nor.Index < 4) return;
+
+	if (nor.Cmd == NOR_CMD_PAGE_PROGRAM)
+	{
+		base = nor.Addr & ~(NOR_PAGE_SIZE - 1);
+		for (uint32_t i = 0; i < NOR_PAGE_SIZE; i++)
+		{
+			if (!nor.PageWritten[i]) continue;
+			if (nor.Page[i] & ~nor.Mem[base + i]) nor.Overwrites++;
+			nor.Mem[base + i] &= nor.Page[i];
+		}
+		nor.Programs++;
+		nor.Wel = 0;
+		nor.BusyUntil = sim_ns + MODEL_PAGE_PROGRAM_NS;
+	}
+	else if (nor.Cmd == NOR_CMD_SECTOR_ERASE)
+	{
+		memset(&nor.Mem[nor.Addr & ~(NOR_SECTOR_SIZE - 1)], 0xFF, NOR_SECTOR_SIZE);
+		nor.Wel = 0;
+		nor.BusyUntil = sim_ns + MODEL_SECTOR_ERASE_NS;
+	}
+	else if (nor.Cmd == NOR_CMD_BLOCK_ERASE)
+	{
+		memset(&nor.Mem[nor.Addr & ~(NOR_BLOCK_SIZE - 1)], 0xFF, NOR_BLOCK_SIZE);
+		nor.Wel = 0;
+		nor.BusyUntil = sim_ns + MODEL_BLOCK_ERASE_NS;
+	}
+}
+
+static uint8_t model_exchange(uint8_t Byte)
+{
+	static const uint8_t id[3] = {0xEF, 0x40, MODEL_CAPACITY_CODE};
+	uint32_t index = nor.Index++;
+	uint32_t offset;
+
+	if (!nor.Selected) return 0xFF;
+
+	if (index == 0)
+	{
+		nor.Cmd = Byte;
+		nor.Addr = 0;
+
+		if ((Byte != NOR_CMD_READ_STATUS1) && model_busy())
+		{
+			nor.BusyViolations++;
+		}
+		if (Byte == NOR_CMD_WRITE_ENABLE)
+		{
+			nor.Wel = 1;
+		}
+		else if ((Byte == NOR_CMD_PAGE_PROGRAM) || (Byte == NOR_CMD_SECTOR_ERASE) || (Byte == NOR_CMD_BLOCK_ERASE))
+		{
+			if (!nor.Wel) nor.WelViolations++;
+			memset(nor.PageWritten, 0, sizeof(nor.PageWritten));
+		}
+		else if (Byte == NOR_CMD_FAST_READ)
+		{
+			nor.FastReads++;
+		}
+		return 0xFF;
+	}
+
+	switch (nor.Cmd)
+	{
+	case NOR_CMD_READ_STATUS1:
+		return (model_busy() ? NOR_SR_WIP : 0) | (nor.Wel ? NOR_SR_WEL : 0);
+
+	case NOR_CMD_READ_JEDEC_ID:
+		return (index <= 3) ? id[index - 1] : 0xFF;
+
+	case NOR_CMD_FAST_READ:
+		if (index <= 3)
+		{
+			nor.Addr = (nor.Addr << 8) | Byte;
+			return 0xFF;
+		}
+		if (index == 4) return 0xFF;	//dummy byte
+		return nor.Mem[(nor.Addr + index - 5) % MODEL_CAPACITY];
+
+	case NOR_CMD_PAGE_PROGRAM:
+		if (index <= 3)
+		{
+			nor.Addr = ((nor.Addr << 8) | Byte) % MODEL_CAPACITY;
+			return 0xFF;
+		}
+		//the page address counter wraps, the real part overwrites the start of the page
+		offset = ((nor.Addr & (NOR_PAGE_SIZE - 1)) + nor.PageLen) % NOR_PAGE_SIZE;
+		if ((nor.Addr & (NOR_PAGE_SIZE - 1)) + nor.PageLen == NOR_PAGE_SIZE) nor.PageWraps++;
+		nor.Page[offset] = Byte;
+		nor.PageWritten[offset] = 1;
+		nor.PageLen++;
+		return 0xFF;
+
+	case NOR_CMD_SECTOR_ERASE:
+	case NOR_CMD_BLOCK_ERASE:
+		if (index <= 3)
+		{
+			nor.Addr = ((nor.Addr << 8) | Byte) % MODEL_CAPACITY;
+		}
+		return 0xFF;
+
+	default:
+		return 0xFF;
+	}
+}
+
+static const SIM_SpiDev_t nor_dev = {model_select, model_exchange};
+
+static SPI_Handle_t spi;
+static GPIO_RegDef_t cs_port;
+static NOR_Handle_t flash;
+
+static uint8_t pattern(uint32_t Addr)
+{
+	return (uint8_t)((Addr * 31) ^ (Addr >> 8));
+}
+
+static void check_init(void)
+{
+	memset(nor.Mem, 0xFF, sizeof(nor.Mem));
+	sim_spi_attach(&nor_dev, MODEL_SCLK_HZ);
+
+	flash.pSPIHandle = &spi;
+	flash.pCSPort = &cs_port;
+	flash.CSPin = 4;
+
+	CHECK(NOR_Init(&flash) == NOR_OK);
+	CHECK(flash.ManufacturerID == 0xEF);
+	CHECK(flash.Capacity == MODEL_CAPACITY);
+}
+
+//unaligned write across several pages, read back through both read paths
+static void check_write_read(void)
+{
+	static uint8_t data[1000], back[1000];
+	uint32_t addr = 0x10F0;
+
+	for (uint32_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = pattern(addr + i);
+	}
+
+	CHECK(NOR_EraseSector(&flash, addr) == NOR_OK);
+	CHECK(NOR_Write(&flash, addr, data, sizeof(data)) == NOR_OK);
+	CHECK(NOR_Read(&flash, addr, back, sizeof(back)) == NOR_OK);
+	CHECK(memcmp(data, back, sizeof(data)) == 0);
+
+	//short reads go through the read-ahead cache
+	memset(back, 0, sizeof(back));
+	for (uint32_t i = 0; i < sizeof(back); i += 10)
+	{
+		CHECK(NOR_Read(&flash, addr + i, &back[i], 10) == NOR_OK);
+	}
+	CHECK(memcmp(data, back, sizeof(data)) == 0);
+
+	//the rest of the sector is still erased
+	CHECK(NOR_Read(&flash, 0x1000, back, 0xF0) == NOR_OK);
+	for (uint32_t i = 0; i < 0xF0; i++)
+	{
+		CHECK(back[i] == 0xFF);
+	}
+}
+
+//a run of small sequential reads costs one fast read per cache line
+static void check_cache(void)
+{
+	uint8_t back[16];
+	uint32_t before;
+
+	CHECK(NOR_Read(&flash, 0x8000, back, 1) == NOR_OK);
+	before = nor.FastReads;
+	for (uint32_t addr = 0x9000; addr < 0x9100; addr += sizeof(back))
+	{
+		CHECK(NOR_Read(&flash, addr, back, sizeof(back)) == NOR_OK);
+	}
+	CHECK(nor.FastReads - before == 0x100 / NOR_READAHEAD_SIZE);
+
+	//a write into the cached line has to be seen by the next read
+	CHECK(NOR_EraseSector(&flash, 0x9000) == NOR_OK);
+	CHECK(NOR_Read(&flash, 0x9000, back, sizeof(back)) == NOR_OK);
+	CHECK(back[0] == 0xFF);
+	back[0] = 0x5A;
+	CHECK(NOR_Write(&flash, 0x9000, back, 1) == NOR_OK);
+	CHECK(NOR_Read(&flash, 0x9000, back, sizeof(back)) == NOR_OK);
+	CHECK(back[0] == 0x5A);
+}
+
+static void check_range(void)
+{
+	uint8_t byte = 0;
+
+	CHECK(NOR_Read(&flash, MODEL_CAPACITY, &byte, 1) == NOR_ERR_RANGE);
+	CHECK(NOR_Read(&flash, MODEL_CAPACITY - 1, &byte, 2) == NOR_ERR_RANGE);
+	CHECK(NOR_Write(&flash, MODEL_CAPACITY - 1, &byte, 2) == NOR_ERR_RANGE);
+	CHECK(NOR_EraseSector(&flash, MODEL_CAPACITY) == NOR_ERR_RANGE);
+	CHECK(NOR_Read(&flash, MODEL_CAPACITY - 1, &byte, 1) == NOR_OK);
+}
+
+//virtual time of a 64 KB block write and read at MODEL_SCLK_HZ
+static void benchmark(void)
+{
+	static uint8_t data[NOR_BLOCK_SIZE], back[NOR_BLOCK_SIZE];
+	uint32_t addr = 0x20000;
+	uint64_t start, write_ns, read_ns;
+
+	for (uint32_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = pattern(i);
+	}
+
+	CHECK(NOR_EraseBlock(&flash, addr) == NOR_OK);
+	CHECK(NOR_WaitReady(&flash) == NOR_OK);
+
+	start = sim_ns;
+	CHECK(NOR_Write(&flash, addr, data, sizeof(data)) == NOR_OK);
+	CHECK(NOR_WaitReady(&flash) == NOR_OK);
+	write_ns = sim_ns - start;
+
+	start = sim_ns;
+	CHECK(NOR_Read(&flash, addr, back, sizeof(back)) == NOR_OK);
+	read_ns = sim_ns - start;
+	CHECK(memcmp(data, back, sizeof(data)) == 0);
+
+	printf("test_spi_nor: 64 KB program %.1f KB/s, read %.1f KB/s (SCLK %u Hz, tPP %llu us)\n",
+			64.0 / (write_ns / 1e9), 64.0 / (read_ns / 1e9), MODEL_SCLK_HZ, MODEL_PAGE_PROGRAM_NS / 1000);
+}
+
+int main(void)
+{
+	check_init();
+	check_write_read();
+	check_cache();
+	check_range();
+	benchmark();
+
+	CHECK(nor.BusyViolations == 0);
+	CHECK(nor.WelViolations == 0);
+	CHECK(nor.PageWraps == 0);
+	CHECK(nor.Overwrites == 0);
+
+	printf("test_spi_nor: %s\n", sim_failures ? "FAILED" : "OK");
+	return sim_failures ? 1 : 0;
+}
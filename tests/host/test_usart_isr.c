@@ -0,0 +1,324 @@
+/*
+ * test_usart_isr.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ *
+ * Register level checks of the USART interrupt dispatcher (USART_IRQHandling) against a model
+ * of the USART (host_regs): RXNE/ORE/IDLE/FE/NF with their SR-then-DR clear sequence, TXE/TC
+ * with the double buffered transmitter and rc_w0 writes to SR. Full duplex traffic at 1 Mbaud
+ * with a framing error, a noise error, an overrun forced by a masked interrupt and idle gaps.
+ * Checks that every entry reads SR exactly once and DR at most once, that no SR write clears
+ * a flag it did not mean to and prints the register accesses per entry as a cost figure.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "host_regs.h"
+#include "host_sim.h"
+#include "stm32f401xx_usart_driver.h"
+
+#define MODEL_FRAME_NS				10000ULL		//1 Mbaud, 8N1
+#define MODEL_RX_LEN				120
+#define MODEL_TX_LEN				100
+#define MODEL_SR_RC_W0				((1 << USART_SR_RXNE) | (1 << USART_SR_TC) | (1 << USART_SR_LBD) | (1 << USART_SR_CTS))
+#define MODEL_SR_DR_CLEARED			((1 << USART_SR_PE) | (1 << USART_SR_FE) | (1 << USART_SR_NF) | (1 << USART_SR_ORE) | (1 << USART_SR_IDLE))
+
+static USART_RegDef_t *regs;
+
+static struct{
+	//receiver, frame i is complete at RxAt[i]
+	uint8_t  RxData[MODEL_RX_LEN];
+	uint8_t  RxErr[MODEL_RX_LEN];	//FE/NF set with the frame
+	uint64_t RxAt[MODEL_RX_LEN];
+	uint32_t RxNext;
+	uint64_t IdleAt;				//one idle frame after the last frame, 0 when not armed
+	uint32_t SrSeen;				//flags of the last SR read, cleared by the next DR access
+
+	//transmitter
+	uint8_t  TxShifting;
+	uint8_t  TxShift;
+	uint8_t  TxDrFull;
+	uint8_t  TxDr;
+	uint64_t TxEndAt;
+	uint8_t  Line[MODEL_TX_LEN + 8];
+	uint32_t LineLen;
+
+	uint32_t SrBeforeWrite;
+
+	//counters
+	uint32_t Lost;					//frames lost to an overrun
+	uint32_t LostIndex;
+	uint32_t RxneClearedByWrite;	//an SR write cleared RXNE, a received frame would be lost
+	uint32_t TxOverwrites;			//DR written while TXE was clear
+}uart;
+
+static void model_rx_frame(void)
+{
+	uint32_t i = uart.RxNext++;
+
+	if (regs->SR & (1 << USART_SR_RXNE))
+	{
+		regs->SR |= (1 << USART_SR_ORE);
+		uart.Lost++;
+		uart.LostIndex = i;
+	}
+	else
+	{
+		regs->DR = uart.RxData[i];
+		regs->SR |= (1 << USART_SR_RXNE) | uart.RxErr[i];
+	}
+
+	//IDLE needs a whole idle frame before the next start bit
+	if ((uart.RxNext == MODEL_RX_LEN) || (uart.RxAt[uart.RxNext] >= uart.RxAt[i] + 2 * MODEL_FRAME_NS))
+	{
+		uart.IdleAt = uart.RxAt[i] + MODEL_FRAME_NS;
+	}
+	else
+	{
+		uart.IdleAt = 0;
+	}
+}
+
+static void model_tx_frame(void)
+{
+	uart.Line[uart.LineLen++] = uart.TxShift;
+
+	if (uart.TxDrFull)
+	{
+		uart.TxShift = uart.TxDr;
+		uart.TxDrFull = 0;
+		uart.TxEndAt += MODEL_FRAME_NS;
+		regs->SR |= (1 << USART_SR_TXE);
+	}
+	else
+	{
+		uart.TxShifting = 0;
+		regs->SR |= (1 << USART_SR_TC);
+	}
+}
+
+//runs both directions up to sim_ns, events in time order
+static void model_run(void)
+{
+	while (1)
+	{
+		uint64_t rx = (uart.RxNext < MODEL_RX_LEN) ? uart.RxAt[uart.RxNext] : UINT64_MAX;
+		uint64_t tx = uart.TxShifting ? uart.TxEndAt : UINT64_MAX;
+		uint64_t idle = uart.IdleAt ? uart.IdleAt : UINT64_MAX;
+
+		if ((rx <= tx) && (rx <= idle) && (rx <= sim_ns))
+		{
+			model_rx_frame();
+		}
+		else if ((tx <= idle) && (tx <= sim_ns))
+		{
+			model_tx_frame();
+		}
+		else if (idle <= sim_ns)
+		{
+			regs->SR |= (1 << USART_SR_IDLE);
+			uart.IdleAt = 0;
+		}
+		else
+		{
+			return;
+		}
+	}
+}
+
+static void model_before(uint32_t Offset, uint8_t Write)
+{
+	model_run();
+	if (Write && (Offset == offsetof(USART_RegDef_t, SR))) uart.SrBeforeWrite = regs->SR;
+}
+
+static void model_after(uint32_t Offset, uint8_t Write)
+{
+	uint32_t value;
+
+	switch (Offset)
+	{
+	case offsetof(USART_RegDef_t, SR):
+		if (!Write)
+		{
+			uart.SrSeen = regs->SR;
+			break;
+		}
+		//only the rc_w0 bits can be cleared, writing 1 leaves them alone
+		value = regs->SR;
+		if ((uart.SrBeforeWrite & (1 << USART_SR_RXNE)) && !(value & (1 << USART_SR_RXNE))) uart.RxneClearedByWrite++;
+		regs->SR = uart.SrBeforeWrite & (~MODEL_SR_RC_W0 | value);
+		break;
+
+	case offsetof(USART_RegDef_t, DR):
+		if (!Write)
+		{
+			//SR read then DR read clears the error and IDLE flags seen by that SR read
+			regs->SR &= ~((uart.SrSeen & MODEL_SR_DR_CLEARED) | (1 << USART_SR_RXNE));
+			uart.SrSeen = 0;
+			break;
+		}
+		if (uart.SrSeen & (1 << USART_SR_TC)) regs->SR &= ~(1 << USART_SR_TC);
+		uart.SrSeen = 0;
+
+		value = regs->DR & 0xFF;
+		if (!uart.TxShifting)
+		{
+			uart.TxShift = (uint8_t)value;
+			uart.TxShifting = 1;
+			uart.TxEndAt = sim_ns + MODEL_FRAME_NS;
+			regs->SR &= ~(1 << USART_SR_TC);
+		}
+		else if (!(regs->SR & (1 << USART_SR_TXE)))
+		{
+			uart.TxOverwrites++;
+		}
+		else
+		{
+			uart.TxDr = (uint8_t)value;
+			uart.TxDrFull = 1;
+			regs->SR &= ~((1 << USART_SR_TXE) | (1 << USART_SR_TC));
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+static const SIM_RegModel_t usart_model = {model_before, model_after};
+
+static USART_Handle_t handle;
+static uint32_t events[32];
+
+void USART_ApplicationEventCallback(USART_Handle_t *pUSARTHandle, uint8_t AppEv)
+{
+	(void)pUSARTHandle;
+
+	if (AppEv < 32) events[AppEv]++;
+}
+
+//the NVIC view: an enabled flag is set
+static uint8_t irq_pending(void)
+{
+	uint32_t sr, cr1;
+
+	sim_regs_unlock();
+	model_run();
+	sr = regs->SR;
+	cr1 = regs->CR1;
+	sim_regs_lock();
+
+	if ((cr1 & (1 << USART_CR1_RXNEIE)) && (sr & ((1 << USART_SR_RXNE) | (1 << USART_SR_ORE)))) return 1;
+	if ((cr1 & (1 << USART_CR1_TXEIE)) && (sr & (1 << USART_SR_TXE))) return 1;
+	if ((cr1 & (1 << USART_CR1_TCIE)) && (sr & (1 << USART_SR_TC))) return 1;
+	if ((cr1 & (1 << USART_CR1_IDLEIE)) && (sr & (1 << USART_SR_IDLE))) return 1;
+	return 0;
+}
+
+int main(void)
+{
+	static uint8_t tx[MODEL_TX_LEN], rx[MODEL_RX_LEN];
+	uint32_t reads[SIM_REG_COUNT], writes[SIM_REG_COUNT];
+	uint32_t entries = 0, accesses = 0, max_accesses = 0, sr_reads_bad = 0, dr_reads_bad = 0, n;
+	uint64_t t0, mask_from, mask_until, start, isr_ns = 0, max_isr_ns = 0, end;
+
+	regs = sim_regs_map(&usart_model);
+	if (regs == NULL)
+	{
+		printf("test_usart_isr: skipped, no register trap on this host\n");
+		return 0;
+	}
+
+	//two bursts with an idle gap, a framing and a noise error in the first one
+	t0 = sim_ns + 5 * MODEL_FRAME_NS;
+	for (uint32_t i = 0; i < MODEL_RX_LEN; i++)
+	{
+		uart.RxData[i] = (uint8_t)(i * 13 + 1);
+		uart.RxAt[i] = t0 + (i + 1) * MODEL_FRAME_NS + ((i >= 60) ? 5 * MODEL_FRAME_NS : 0);
+	}
+	uart.RxErr[20] = (1 << USART_SR_FE);
+	uart.RxErr[30] = (1 << USART_SR_NF);
+	for (uint32_t i = 0; i < MODEL_TX_LEN; i++)
+	{
+		tx[i] = (uint8_t)(0xFF - i);
+	}
+
+	//a higher priority interrupt holds the USART off for two frames in the second burst
+	mask_from = uart.RxAt[80] - MODEL_FRAME_NS / 2;
+	mask_until = mask_from + 2 * MODEL_FRAME_NS;
+
+	sim_regs_unlock();
+	regs->SR = (1 << USART_SR_TXE) | (1 << USART_SR_TC);
+	regs->CR1 = (1 << USART_CR1_UE) | (1 << USART_CR1_TE) | (1 << USART_CR1_RE) | (1 << USART_CR1_IDLEIE);
+	regs->CR3 = (1 << USART_CR3_EIE);
+	sim_regs_lock();
+
+	handle.pUSARTx = regs;
+	handle.USART_Config.USART_WordLength = USART_WORDLEN_8BITS;
+	handle.USART_Config.USART_ParityControl = USART_PARITY_DISABLE;
+
+	//one frame is lost to the overrun
+	CHECK(USART_ReceiveDataIT(&handle, rx, MODEL_RX_LEN - 1) == USART_READY);
+	CHECK(USART_SendDataIT(&handle, tx, MODEL_TX_LEN) == USART_READY);
+
+	end = uart.RxAt[MODEL_RX_LEN - 1] + 4 * MODEL_FRAME_NS;
+	while (sim_ns < end)
+	{
+		if (((sim_ns >= mask_from) && (sim_ns < mask_until)) || !irq_pending())
+		{
+			sim_advance_ns(SIM_POLL_NS);
+			continue;
+		}
+
+		memcpy(reads, sim_reg_reads, sizeof(reads));
+		memcpy(writes, sim_reg_writes, sizeof(writes));
+		start = sim_ns;
+
+		USART_IRQHandling(&handle);
+
+		entries++;
+		n = 0;
+		for (uint32_t r = 0; r < SIM_REG_COUNT; r++)
+		{
+			n += (sim_reg_reads[r] - reads[r]) + (sim_reg_writes[r] - writes[r]);
+		}
+		accesses += n;
+		if (n > max_accesses) max_accesses = n;
+		isr_ns += sim_ns - start;
+		if (sim_ns - start > max_isr_ns) max_isr_ns = sim_ns - start;
+
+		if (sim_reg_reads[offsetof(USART_RegDef_t, SR) / 4] - reads[offsetof(USART_RegDef_t, SR) / 4] != 1) sr_reads_bad++;
+		if (sim_reg_reads[offsetof(USART_RegDef_t, DR) / 4] - reads[offsetof(USART_RegDef_t, DR) / 4] > 1) dr_reads_bad++;
+	}
+
+	CHECK(handle.TxBusyState == USART_READY);
+	CHECK(handle.RxBusyState == USART_READY);
+	CHECK(uart.LineLen == MODEL_TX_LEN);
+	CHECK(memcmp(uart.Line, tx, MODEL_TX_LEN) == 0);
+
+	//every frame but the overrun one arrives, including the ones with FE/NF
+	CHECK(uart.Lost == 1);
+	CHECK(memcmp(rx, uart.RxData, uart.LostIndex) == 0);
+	CHECK(memcmp(&rx[uart.LostIndex], &uart.RxData[uart.LostIndex + 1], MODEL_RX_LEN - 1 - uart.LostIndex) == 0);
+
+	CHECK(events[USART_EVENT_TX_CMPLT] == 1);
+	CHECK(events[USART_EVENT_RX_CMPLT] == 1);
+	CHECK(events[USART_ERREVENT_FE] == 1);
+	CHECK(events[USART_ERREVENT_NF] == 1);
+	CHECK(events[USART_ERREVENT_ORE] == 1);
+	CHECK(events[USART_EVENT_IDLE] == 2);
+
+	CHECK(sr_reads_bad == 0);
+	CHECK(dr_reads_bad == 0);
+	CHECK(uart.RxneClearedByWrite == 0);
+	CHECK(uart.TxOverwrites == 0);
+
+	printf("test_usart_isr: %u entries, %.2f register accesses per entry (max %u), %.0f ns per entry (max %llu ns) at %u ns per access\n",
+			(unsigned)entries, (double)accesses / entries, (unsigned)max_accesses, (double)isr_ns / entries,
+			(unsigned long long)max_isr_ns, (unsigned)SIM_REG_NS);
+	printf("test_usart_isr: %s\n", sim_failures ? "FAILED" : "OK");
+	return sim_failures ? 1 : 0;
+}
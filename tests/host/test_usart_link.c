@@ -0,0 +1,148 @@
+/*
+ * test_usart_link.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Nikola Sokolović
+ *
+ * Host round trip of the packet link layer (stm32f401xx_usart_link_driver): CRC check values,
+ * COBS encoding at the block limits and the receive path on corrupted frames. Built and run
+ * with "make" in this directory.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "stm32f401xx_usart_link_driver.h"
+
+static int failures;
+
+#define CHECK(cond)		do { if (!(cond)) { failures++; printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); } } while (0)
+
+//LINK_Send is not exercised, the USART streaming calls only have to link
+uint32_t USART_StreamTxFree(USART_Handle_t *pUSARTHandle) { (void)pUSARTHandle; return 0; }
+uint32_t USART_StreamWrite(USART_Handle_t *pUSARTHandle, const uint8_t *pData, uint32_t Len)
+{
+	(void)pUSARTHandle; (void)pData;
+	return Len;
+}
+
+static uint8_t rx_data[LINK_MAX_BLOCK];
+static uint16_t rx_len;
+static uint32_t rx_frames;
+
+static void frame_callback(LINK_Handle_t *pLINKHandle, uint8_t *pData, uint16_t Len)
+{
+	(void)pLINKHandle;
+	memcpy(rx_data, pData, Len);
+	rx_len = Len;
+	rx_frames++;
+}
+
+static void link_setup(LINK_Handle_t *pLink, uint8_t CrcType)
+{
+	memset(pLink, 0, sizeof(*pLink));
+	pLink->CrcType = CrcType;
+	pLink->pFrameCallback = frame_callback;
+	LINK_Init(pLink);
+	rx_frames = 0;
+}
+
+//encodes a payload, checks the wire format and feeds it back through the receiver
+static void round_trip(uint8_t CrcType, const uint8_t *pPayload, uint16_t Len)
+{
+	LINK_Handle_t link;
+	uint8_t buf[LINK_TX_BUF_SIZE];
+	uint16_t enclen;
+
+	link_setup(&link, CrcType);
+	memcpy(LINK_TX_PAYLOAD(buf), pPayload, Len);
+
+	enclen = LINK_Encode(&link, buf, Len);
+	CHECK(enclen == Len + LINK_CRC_LEN(CrcType) + 2);
+	CHECK(memchr(buf, 0, enclen - 1) == NULL);
+	CHECK(buf[enclen - 1] == 0);
+
+	//idle fill in front of the frame is not a frame
+	LINK_RxBytes(&link, (const uint8_t *)"\0\0", 2);
+	LINK_RxBytes(&link, buf, enclen);
+	CHECK(rx_frames == 1);
+	CHECK(link.FramesOk == 1);
+	CHECK(link.CrcErrors == 0);
+	CHECK(link.FramingErrors == 0);
+	CHECK(rx_len == Len);
+	CHECK(memcmp(rx_data, pPayload, Len) == 0);
+}
+
+//flips a bit of the CRC on the wire, the frame has to be dropped and counted
+static void corrupted_crc(uint8_t CrcType)
+{
+	LINK_Handle_t link;
+	uint8_t buf[LINK_TX_BUF_SIZE];
+	uint16_t enclen;
+
+	link_setup(&link, CrcType);
+	memcpy(LINK_TX_PAYLOAD(buf), "corrupted", 9);
+	enclen = LINK_Encode(&link, buf, 9);
+
+	//the last byte before the delimiter belongs to the CRC, keep it non zero
+	buf[enclen - 2] ^= (buf[enclen - 2] == 0x01) ? 0x03 : 0x01;
+	LINK_RxBytes(&link, buf, enclen);
+	CHECK(rx_frames == 0);
+	CHECK(link.CrcErrors == 1);
+	CHECK(link.FramesOk == 0);
+
+	//the receiver resynchronises at the delimiter
+	memcpy(LINK_TX_PAYLOAD(buf), "good", 4);
+	enclen = LINK_Encode(&link, buf, 4);
+	LINK_RxBytes(&link, buf, enclen);
+	CHECK(rx_frames == 1);
+	CHECK((rx_len == 4) && (memcmp(rx_data, "good", 4) == 0));
+}
+
+static void payloads(uint8_t CrcType)
+{
+	LINK_Handle_t link;
+	uint8_t buf[LINK_TX_BUF_SIZE + 4];
+	uint8_t data[LINK_MAX_BLOCK];
+	uint16_t max = LINK_MAX_PAYLOAD(CrcType);
+	uint16_t lens[] = { 0, 1, (uint16_t)(max - 1), max };
+
+	for (uint32_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++)
+	{
+		//all zero, no zero, and a mix with zeros at both ends
+		memset(data, 0, sizeof(data));
+		round_trip(CrcType, data, lens[i]);
+
+		memset(data, 0xFF, sizeof(data));
+		round_trip(CrcType, data, lens[i]);
+
+		for (uint32_t j = 0; j < sizeof(data); j++)
+		{
+			data[j] = (uint8_t)((j * 37) % 7 == 0 ? 0 : j);
+		}
+		round_trip(CrcType, data, lens[i]);
+	}
+
+	//payload + CRC has to fit one COBS block, 253 and 254 bytes never do
+	link_setup(&link, CrcType);
+	CHECK(LINK_Encode(&link, buf, 253) == 0);
+	CHECK(LINK_Encode(&link, buf, 254) == 0);
+	CHECK(LINK_Encode(&link, buf, max + 1) == 0);
+}
+
+int main(void)
+{
+	static const uint8_t check[] = "123456789";
+
+	//catalogue check values
+	CHECK(LINK_Crc16(check, 9) == 0x29B1);
+	CHECK(LINK_Crc32(check, 9) == 0xCBF43926);
+
+	payloads(LINK_CRC16);
+	payloads(LINK_CRC32);
+	corrupted_crc(LINK_CRC16);
+	corrupted_crc(LINK_CRC32);
+
+	printf("test_usart_link: %s\n", failures ? "FAILED" : "OK");
+	return failures ? 1 : 0;
+}
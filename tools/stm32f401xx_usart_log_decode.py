@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+#
+# stm32f401xx_usart_log_decode.py
+#
+#  Created on: Oct 19, 2026
+#      Author: Nikola Sokolović
+#
+# Host side decoder of the deferred binary log (stm32f401xx_usart_log_driver). Reads the
+# format strings from the log_fmt section of the firmware ELF and turns the record stream
+# captured from the USART back into text. No packages beyond the standard library.
+#
+#   tools/stm32f401xx_usart_log_decode.py firmware.elf capture.bin
+#   stty -F /dev/ttyACM0 115200 raw && tools/stm32f401xx_usart_log_decode.py firmware.elf /dev/ttyACM0
+#
+# Record, little endian 32 bit words: header ([31:24] 0xA5, [23:21] number of arguments,
+# [20:0] offset in log_fmt), DWT cycle count, arguments. Bytes that do not form a valid
+# header (start of a capture, lost bytes) are skipped until the next one.
+
+import argparse
+import re
+import struct
+import sys
+
+LOG_RECORD_MARKER = 0xA5
+LOG_MAX_ARGS = 4
+
+SHT_NOBITS = 8
+
+
+class Elf:
+    """Section headers of an ELF file, 32 or 64 bit, little endian."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        if self.data[:4] != b'\x7fELF' or self.data[5] != 1:
+            raise ValueError('%s: not a little endian ELF file' % path)
+
+        if self.data[4] == 1:
+            shoff, = struct.unpack_from('<I', self.data, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from('<HHH', self.data, 0x2E)
+            fmt = '<IIIIIIIIII'
+        else:
+            shoff, = struct.unpack_from('<Q', self.data, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from('<HHH', self.data, 0x3A)
+            fmt = '<IIQQQQIIQQ'
+
+        self.sections = []
+        for i in range(shnum):
+            name, stype, _, addr, offset, size = struct.unpack_from(fmt, self.data, shoff + i * shentsize)[:6]
+            self.sections.append([name, stype, addr, offset, size])
+
+        names = self.sections[shstrndx]
+        for s in self.sections:
+            s[0] = self.cstring(self.data, names[3] + s[0])
+
+    @staticmethod
+    def cstring(data, offset):
+        end = data.find(b'\0', offset)
+        return data[offset:end if end >= 0 else len(data)].decode('utf-8', 'replace')
+
+    def section(self, name):
+        for sname, stype, _, offset, size in self.sections:
+            if sname == name and stype != SHT_NOBITS:
+                return self.data[offset:offset + size]
+        raise ValueError('section %s not found' % name)
+
+    def string_at(self, addr):
+        """NUL terminated string at a target address, for %s arguments."""
+        for _, stype, saddr, offset, size in self.sections:
+            if stype != SHT_NOBITS and saddr and saddr <= addr < saddr + size:
+                return self.cstring(self.data, offset + addr - saddr)
+        return '<0x%08x>' % addr
+
+
+# %[flags][width][.precision][length]conversion
+CONVERSION = re.compile(r'%([-+ #0]*)(\d*)(?:\.(\d+))?(hh|h|ll|l|z|t|j)?([diuxXcpso%])')
+
+
+def format_record(elf, fmt, args):
+    args = list(args)
+    out = []
+    pos = 0
+
+    for m in CONVERSION.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, _, conv = m.groups()
+        if conv == '%':
+            out.append('%')
+            continue
+        if not args:
+            out.append(m.group(0))
+            continue
+        value = args.pop(0)
+        spec = '%' + flags + width + ('.' + prec if prec else '')
+        if conv in 'di':
+            out.append((spec + 'd') % (value - (1 << 32) if value & 0x80000000 else value))
+        elif conv == 'u':
+            out.append((spec + 'd') % value)
+        elif conv in 'xXo':
+            out.append((spec + conv) % value)
+        elif conv == 'c':
+            out.append((spec + 'c') % chr(value & 0xFF))
+        elif conv == 'p':
+            out.append('0x%08x' % value)
+        else:
+            out.append((spec + 's') % elf.string_at(value))
+
+    out.append(fmt[pos:])
+    return ''.join(out)
+
+
+def decode(elf, stream, hz):
+    fmts = elf.section('log_fmt')
+    buf = b''
+    skipped = 0
+    base = 0
+    last = None
+
+    def header_ok(word):
+        offset = word & 0x1FFFFF
+        return ((word >> 24) == LOG_RECORD_MARKER and ((word >> 21) & 0x7) <= LOG_MAX_ARGS
+                and offset < len(fmts) and (offset == 0 or fmts[offset - 1] == 0))
+
+    while True:
+        chunk = stream.read1(4096) if hasattr(stream, 'read1') else stream.read(4096)
+        if not chunk:
+            break
+        buf += chunk
+
+        while len(buf) >= 4:
+            header, = struct.unpack_from('<I', buf, 0)
+            if not header_ok(header):
+                # resync one byte at a time
+                buf = buf[1:]
+                skipped += 1
+                continue
+
+            nargs = (header >> 21) & 0x7
+            if len(buf) < 4 * (2 + nargs):
+                break
+            words = struct.unpack_from('<%dI' % (2 + nargs), buf, 0)
+            buf = buf[4 * (2 + nargs):]
+
+            if skipped:
+                print('-- %d bytes skipped' % skipped)
+                skipped = 0
+
+            # the DWT counter wraps every 2^32 cycles
+            if last is not None and words[1] < last:
+                base += 1 << 32
+            last = words[1]
+            cycles = base + words[1]
+            stamp = '%12.6f' % (cycles / hz) if hz else '%12d' % cycles
+
+            text = format_record(elf, Elf.cstring(fmts, header & 0x1FFFFF), words[2:])
+            print('[%s] %s' % (stamp, text), flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decodes the binary USART log of the firmware.')
+    parser.add_argument('elf', help='firmware ELF file with the log_fmt section')
+    parser.add_argument('input', nargs='?', default='-', help='captured stream or serial device, - for stdin')
+    parser.add_argument('--hz', type=float, default=0, help='HCLK in Hz, prints timestamps in seconds')
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    if args.input == '-':
+        decode(elf, sys.stdin.buffer, args.hz)
+    else:
+        with open(args.input, 'rb', buffering=0) as stream:
+            decode(elf, stream, args.hz)
+
+
+if __name__ == '__main__':
+    main()